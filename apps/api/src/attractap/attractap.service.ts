@@ -38,6 +38,10 @@ export class AttractapService {
     return await this.nfcCardRepository.find();
   }
 
+  public async getActiveNFCCards(): Promise<NFCCard[]> {
+    return await this.nfcCardRepository.find({ where: { isActive: true }, relations: ['user'] });
+  }
+
   public async updateLastReaderConnection(id: number) {
     return await this.readerRepository.update(id, { lastConnection: new Date() });
   }
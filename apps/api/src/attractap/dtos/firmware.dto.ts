@@ -44,8 +44,8 @@ export class AttractapFirmware {
   filename: string;
 
   @ApiProperty({
-    description: 'The filename of the firmware for OTA updates (zlib compressed)',
-    example: 'attractap_eth.bin.zz',
+    description: 'The filename of the firmware for OTA updates (application image only)',
+    example: 'attractap_eth.ota.bin',
   })
   filenameOTA: string;
 }
@@ -0,0 +1,102 @@
+import {
+  ACCESS_LIST_OPERATIONS_PER_UPDATE,
+  AccessListEntry,
+  AccessListTable,
+  buildAccessListUpdates,
+  encodeAccessListTable,
+  signAccessListTable,
+} from './access-list';
+
+const KEY = 'reader-token';
+
+function entry(uid: string, resourceMask = 1, expiresAt = 0): AccessListEntry {
+  return { uid, resourceMask, expiresAt };
+}
+
+function table(entries: AccessListEntry[], resourceIds = [7]): Omit<AccessListTable, 'version'> {
+  return { issuedAt: 1700000000, expiresAt: 1700086400, resourceIds, entries };
+}
+
+// Replays updates the way the reader does: reset, then removes, then upserts
+function applyUpdates(start: Map<string, AccessListEntry>, updates: ReturnType<typeof buildAccessListUpdates>) {
+  const entries = new Map(start);
+  for (const { data } of updates) {
+    if (data.reset) {
+      entries.clear();
+    }
+    data.remove.forEach((uid) => entries.delete(uid));
+    data.upsert.forEach(([uid, resourceMask, expiresAt]) => entries.set(uid, { uid, resourceMask, expiresAt }));
+  }
+  return entries;
+}
+
+describe('access list', () => {
+  it('encodes the canonical form expected by the firmware', () => {
+    const encoded = encodeAccessListTable({ version: 3, ...table([entry('04a1b2', 5, 9)]) });
+    expect(encoded.toString('hex')).toBe(
+      '03000000' + '00f15365' + '80425565' + '01' + '07000000' + '0100' + '03' + '04a1b2' + '05000000' + '09000000'
+    );
+  });
+
+  it('starts with a reset when the reader has no known table', () => {
+    const updates = buildAccessListUpdates(KEY, undefined, table([entry('04b0'), entry('04a0')]));
+
+    expect(updates).toHaveLength(1);
+    expect(updates[0].data).toMatchObject({ version: 1, baseVersion: 0, reset: true, remove: [] });
+    expect(updates[0].table.entries.map((e) => e.uid)).toEqual(['04a0', '04b0']);
+    expect(updates[0].data.signature).toBe(signAccessListTable(KEY, updates[0].table));
+  });
+
+  it('only sends changed entries on top of a known table', () => {
+    const [initial] = buildAccessListUpdates(KEY, undefined, table([entry('04a0'), entry('04b0'), entry('04c0')]));
+    const updates = buildAccessListUpdates(
+      KEY,
+      initial.table,
+      table([entry('04a0'), entry('04b0', 3), entry('04d0')])
+    );
+
+    expect(updates).toHaveLength(1);
+    expect(updates[0].data).toMatchObject({
+      version: 2,
+      baseVersion: 1,
+      reset: false,
+      remove: ['04c0'],
+      upsert: [
+        ['04b0', 3, 0],
+        ['04d0', 1, 0],
+      ],
+    });
+  });
+
+  it('resets when the resources of the reader changed', () => {
+    const [initial] = buildAccessListUpdates(KEY, undefined, table([entry('04a0')]));
+    const [update] = buildAccessListUpdates(KEY, initial.table, table([entry('04a0')], [7, 8]));
+
+    expect(update.data.reset).toBe(true);
+    expect(update.data.upsert).toEqual([['04a0', 1, 0]]);
+  });
+
+  it('splits large changes into a chain of signed updates', () => {
+    const entries = Array.from({ length: ACCESS_LIST_OPERATIONS_PER_UPDATE * 2 + 1 }, (_, i) =>
+      entry(`04${i.toString(16).padStart(4, '0')}`)
+    );
+    const updates = buildAccessListUpdates(KEY, undefined, table(entries));
+
+    expect(updates).toHaveLength(3);
+    updates.forEach(({ data, table }, index) => {
+      expect(data.baseVersion).toBe(index);
+      expect(data.version).toBe(index + 1);
+      expect(data.reset).toBe(index === 0);
+      expect(data.signature).toBe(signAccessListTable(KEY, table));
+    });
+    expect(Array.from(applyUpdates(new Map(), updates).values())).toHaveLength(entries.length);
+  });
+
+  it('still refreshes the expiry when nothing changed', () => {
+    const [initial] = buildAccessListUpdates(KEY, undefined, table([entry('04a0')]));
+    const updates = buildAccessListUpdates(KEY, initial.table, { ...table([entry('04a0')]), expiresAt: 1700172800 });
+
+    expect(updates).toHaveLength(1);
+    expect(updates[0].data).toMatchObject({ version: 2, upsert: [], remove: [], expiresAt: 1700172800 });
+  });
+});
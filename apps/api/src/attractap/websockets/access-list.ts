@@ -0,0 +1,202 @@
+import { createHmac } from 'crypto';
+
+// Limits of the reader side table (see AccessList in the firmware)
+export const ACCESS_LIST_MAX_RESOURCES = 32;
+export const ACCESS_LIST_MAX_ENTRIES = 256;
+export const ACCESS_LIST_MAX_UID_BYTES = 10;
+// Keeps a single update well below the reader's incoming message limit
+export const ACCESS_LIST_OPERATIONS_PER_UPDATE = 64;
+
+export interface AccessListEntry {
+  // Lowercase hex, as sent by the reader in NFC_TAP
+  uid: string;
+  // Bit i grants the resource at resourceIds[i]
+  resourceMask: number;
+  // Unix seconds, 0 if the entry is valid as long as the list is
+  expiresAt: number;
+}
+
+export interface AccessListTable {
+  version: number;
+  issuedAt: number;
+  expiresAt: number;
+  resourceIds: number[];
+  // Sorted by uid (see compareAccessListUids)
+  entries: AccessListEntry[];
+}
+
+/**
+ * One step from baseVersion to version. The signature covers the table as it is after
+ * applying the step, so the reader can tell a diverged or tampered copy apart.
+ */
+export interface AttractapAccessListData {
+  version: number;
+  baseVersion: number;
+  reset: boolean;
+  issuedAt: number;
+  expiresAt: number;
+  resources: number[];
+  upsert: Array<[string, number, number]>;
+  remove: string[];
+  signature: string;
+}
+
+export interface AttractapAccessListConfirmation {
+  version: number;
+  applied: boolean;
+}
+
+export interface AccessListUpdate {
+  data: AttractapAccessListData;
+  table: AccessListTable;
+}
+
+// Byte order of the uids, which is the same as comparing the lowercase hex strings
+export function compareAccessListUids(a: string, b: string): number {
+  return a < b ? -1 : a > b ? 1 : 0;
+}
+
+/**
+ * Canonical binary form of a table, the input of its signature. Must match the firmware:
+ * little endian u32 version, issuedAt, expiresAt; u8 resource count and u32 ids; u16 entry count;
+ * per entry u8 uid length, uid bytes, u32 resource mask, u32 expiresAt.
+ */
+export function encodeAccessListTable(table: AccessListTable): Buffer {
+  const parts: Buffer[] = [];
+
+  const header = Buffer.alloc(13);
+  header.writeUInt32LE(table.version >>> 0, 0);
+  header.writeUInt32LE(table.issuedAt >>> 0, 4);
+  header.writeUInt32LE(table.expiresAt >>> 0, 8);
+  header.writeUInt8(table.resourceIds.length, 12);
+  parts.push(header);
+
+  const resources = Buffer.alloc(table.resourceIds.length * 4);
+  table.resourceIds.forEach((id, index) => resources.writeUInt32LE(id >>> 0, index * 4));
+  parts.push(resources);
+
+  const count = Buffer.alloc(2);
+  count.writeUInt16LE(table.entries.length, 0);
+  parts.push(count);
+
+  for (const entry of table.entries) {
+    const uid = Buffer.from(entry.uid, 'hex');
+    const fields = Buffer.alloc(9);
+    fields.writeUInt8(uid.length, 0);
+    fields.writeUInt32LE(entry.resourceMask >>> 0, 1);
+    fields.writeUInt32LE(entry.expiresAt >>> 0, 5);
+    parts.push(fields.subarray(0, 1), uid, fields.subarray(1));
+  }
+
+  return Buffer.concat(parts);
+}
+
+export function signAccessListTable(key: string, table: AccessListTable): string {
+  return createHmac('sha256', key).update(encodeAccessListTable(table)).digest('hex');
+}
+
+function sameEntry(a: AccessListEntry, b: AccessListEntry): boolean {
+  return a.resourceMask === b.resourceMask && a.expiresAt === b.expiresAt;
+}
+
+/**
+ * Splits the way from `previous` (the table the reader has, if known) to `next` into signed
+ * updates of at most ACCESS_LIST_OPERATIONS_PER_UPDATE operations each. Without a usable
+ * previous table the first update resets the reader's list, continuing from `readerVersion`.
+ */
+export function buildAccessListUpdates(
+  key: string,
+  previous: AccessListTable | undefined,
+  next: Omit<AccessListTable, 'version'>,
+  readerVersion = 0
+): AccessListUpdate[] {
+  const sameResources =
+    previous !== undefined &&
+    previous.resourceIds.length === next.resourceIds.length &&
+    previous.resourceIds.every((id, index) => id === next.resourceIds[index]);
+  const reset = !sameResources;
+  const base = reset ? undefined : previous;
+
+  const current = new Map<string, AccessListEntry>();
+  base?.entries.forEach((entry) => current.set(entry.uid, entry));
+
+  const wanted = new Map<string, AccessListEntry>();
+  next.entries.forEach((entry) => wanted.set(entry.uid, entry));
+
+  const operations: Array<{ remove?: string; upsert?: AccessListEntry }> = [];
+  for (const uid of current.keys()) {
+    if (!wanted.has(uid)) {
+      operations.push({ remove: uid });
+    }
+  }
+  for (const entry of next.entries) {
+    const existing = current.get(entry.uid);
+    if (!existing || !sameEntry(existing, entry)) {
+      operations.push({ upsert: entry });
+    }
+  }
+
+  const updates: AccessListUpdate[] = [];
+  let version = previous?.version ?? readerVersion;
+  let first = true;
+
+  // Always at least one update, an empty one still refreshes issuedAt/expiresAt
+  do {
+    const chunk = operations.splice(0, ACCESS_LIST_OPERATIONS_PER_UPDATE);
+    const baseVersion = version;
+    version = (version + 1) >>> 0 || 1;
+
+    if (first && reset) {
+      current.clear();
+    }
+    for (const operation of chunk) {
+      if (operation.remove !== undefined) {
+        current.delete(operation.remove);
+      } else if (operation.upsert) {
+        current.set(operation.upsert.uid, operation.upsert);
+      }
+    }
+
+    const table: AccessListTable = {
+      version,
+      issuedAt: next.issuedAt,
+      expiresAt: next.expiresAt,
+      resourceIds: next.resourceIds,
+      entries: Array.from(current.values()).sort((a, b) => compareAccessListUids(a.uid, b.uid)),
+    };
+
+    updates.push({
+      table,
+      data: {
+        version,
+        baseVersion,
+        reset: first && reset,
+        issuedAt: table.issuedAt,
+        expiresAt: table.expiresAt,
+        resources: table.resourceIds,
+        upsert: chunk
+          .filter((operation) => operation.upsert)
+          .map((operation): [string, number, number] => [
+            operation.upsert.uid,
+            operation.upsert.resourceMask,
+            operation.upsert.expiresAt,
+          ]),
+        remove: chunk.filter((operation) => operation.remove !== undefined).map((operation) => operation.remove),
+        signature: signAccessListTable(key, table),
+      },
+    });
+    first = false;
+  } while (operations.length > 0);
+
+  return updates;
+}
+
+// True if both tables grant the same, regardless of version and expiry
+export function accessListContentEqual(a: Omit<AccessListTable, 'version'>, b: Omit<AccessListTable, 'version'>) {
+  return (
+    a.resourceIds.length === b.resourceIds.length &&
+    a.resourceIds.every((id, index) => id === b.resourceIds[index]) &&
+    a.entries.length === b.entries.length &&
+    a.entries.every((entry, index) => entry.uid === b.entries[index].uid && sameEntry(entry, b.entries[index]))
+  );
+}
@@ -3,7 +3,15 @@ import { ReaderState } from './reader-state.interface';
 import { NoResourcesAttachedState } from './no-resources-attached.state';
 import { WaitForResourceSelectionState } from './wait-for-resource-selection.state';
 import { GatewayServices } from '../websocket.gateway';
-import { AuthenticatedWebSocket, AttractapEvent, AttractapEventType, AttractapResponse } from '../websocket.types';
+import {
+  AuthenticatedWebSocket,
+  AttractapEvent,
+  AttractapEventType,
+  AttractapResponse,
+  ATTRACTAP_SERVER_FEATURES,
+  AttractapEncoding,
+} from '../websocket.types';
+import { selectAttractapEncoding } from '../websocket.encoding';
 import { verifyToken } from '../websocket.utils';
 import { WaitForFirmwareUpdateState } from './wait-for-firmware-update.state';
 import { AttractapFirmware } from '../../dtos/firmware.dto';
@@ -12,6 +20,7 @@ import { WaitForNFCTapState } from './wait-for-nfc-tap.state';
 export class InitialReaderState implements ReaderState {
   private waitingForFirmwareInfo = false;
   private reauthenticateInterval: NodeJS.Timeout | null = null;
+  private requestedEncoding = AttractapEncoding.JSON;
 
   private readonly logger = new Logger(InitialReaderState.name);
 
@@ -80,10 +89,20 @@ export class InitialReaderState implements ReaderState {
     // refresh reader from database
     this.socket.reader = await this.services.attractapService.findReaderById(this.socket.reader.id);
 
+    // Confirmed in the current encoding; the negotiated one applies to everything after it
+    const encoding = this.socket.encoding ?? this.requestedEncoding;
     const authenticatedResponse = new AttractapResponse(AttractapEventType.READER_AUTHENTICATED, {
       name: this.socket.reader.name,
+      features: ATTRACTAP_SERVER_FEATURES,
+      encoding,
     });
     await this.socket.sendMessage(authenticatedResponse);
+    this.socket.encoding = encoding;
+
+    // In the background, building the list may take a while on large installations
+    this.services.gateway
+      .publishAccessList(this.socket)
+      .catch((error) => this.logger.error('Failed to publish access list', error));
 
     this.waitingForFirmwareInfo = true;
     await this.socket.sendMessage(new AttractapEvent(AttractapEventType.READER_FIRMWARE_INFO, {}));
@@ -167,6 +186,10 @@ export class InitialReaderState implements ReaderState {
     }
 
     this.socket.reader = reader;
+    this.requestedEncoding = selectAttractapEncoding(data.payload.encodings);
+    this.socket.accessListKey = data.payload.token;
+    // Only reported by firmware that keeps an access list
+    this.socket.accessListVersion = data.payload.accessListVersion;
 
     return await this.onIsAuthenticated();
   }
@@ -1,14 +1,28 @@
-import { AuthenticatedWebSocket, AttractapEvent, AttractapEventType } from '../websocket.types';
+import {
+  AuthenticatedWebSocket,
+  AttractapEncoding,
+  AttractapEvent,
+  AttractapEventType,
+  AttractapResponse,
+} from '../websocket.types';
+import { encodeAttractapMessage } from '../websocket.encoding';
 import { ReaderState } from './reader-state.interface';
 import { GatewayServices } from '../websocket.gateway';
 import { Logger } from '@nestjs/common';
+import { createHash } from 'crypto';
 import { AttractapFirmware } from '../../dtos/firmware.dto';
 
+interface LoadedFirmware {
+  chunks: Buffer[];
+  size: number;
+  // Of the whole image, the reader checks it after writing the last chunk
+  sha256: string;
+}
+
 export class WaitForFirmwareUpdateState implements ReaderState {
   private firmwareDefinition: AttractapFirmware;
   private readonly logger = new Logger(WaitForFirmwareUpdateState.name);
-  private static readonly chunks: Map<string, Buffer[]> = new Map();
-  private firmwareSize = 0;
+  private static readonly firmwares: Map<string, LoadedFirmware> = new Map();
 
   public constructor(private readonly socket: AuthenticatedWebSocket, private readonly services: GatewayServices) {}
 
@@ -18,7 +32,7 @@ export class WaitForFirmwareUpdateState implements ReaderState {
       this.socket.reader.firmware.variant
     );
 
-    const chunks = await this.loadFirmware();
+    const firmware = await this.loadFirmware();
 
     await this.socket.sendMessage(
       new AttractapEvent(AttractapEventType.READER_FIRMWARE_UPDATE_REQUIRED, {
@@ -28,8 +42,9 @@ export class WaitForFirmwareUpdateState implements ReaderState {
           this.socket.reader.firmware.variant
         ),
         firmware: {
-          chunks: chunks.length,
-          totalSize: this.firmwareSize,
+          chunks: firmware.chunks.length,
+          totalSize: firmware.size,
+          sha256: firmware.sha256,
         },
       })
     );
@@ -47,31 +62,19 @@ export class WaitForFirmwareUpdateState implements ReaderState {
     return undefined;
   }
 
-  private async loadFirmware(): Promise<Buffer[]> {
-    if (
-      WaitForFirmwareUpdateState.chunks.has(
-        JSON.stringify({
-          name: this.firmwareDefinition.name,
-          variant: this.firmwareDefinition.variant,
-        })
-      )
-    ) {
-      return WaitForFirmwareUpdateState.chunks.get(
-        JSON.stringify({
-          name: this.firmwareDefinition.name,
-          variant: this.firmwareDefinition.variant,
-        })
-      );
+  private async loadFirmware(): Promise<LoadedFirmware> {
+    const cacheKey = JSON.stringify({
+      name: this.firmwareDefinition.name,
+      variant: this.firmwareDefinition.variant,
+    });
+    if (WaitForFirmwareUpdateState.firmwares.has(cacheKey)) {
+      return WaitForFirmwareUpdateState.firmwares.get(cacheKey);
     }
 
     const chunks: Buffer[] = [];
+    const hash = createHash('sha256');
 
     this.logger.debug(`Loading firmware: ${this.firmwareDefinition.name}, variant: ${this.firmwareDefinition.variant}`);
-    this.firmwareSize = await this.services.firmwareService.getFirmwareBinarySize(
-      this.firmwareDefinition.name,
-      this.firmwareDefinition.variant
-    );
-    this.logger.debug(`Firmware size: ${this.firmwareSize} bytes`);
 
     const currentStream = this.services.firmwareService.getFirmwareStream(
       this.firmwareDefinition.name,
@@ -81,6 +84,7 @@ export class WaitForFirmwareUpdateState implements ReaderState {
     let totalBytesLoaded = 0;
     currentStream.on('data', (chunk: Buffer) => {
       chunks.push(chunk);
+      hash.update(chunk);
       totalBytesLoaded += chunk.length;
 
       // Log first chunk's first few bytes to verify it's valid ESP32 firmware
@@ -91,6 +95,7 @@ export class WaitForFirmwareUpdateState implements ReaderState {
       }
     });
 
+    let streamFailed = false;
     await new Promise<void>((resolve) => {
       currentStream.on('end', () => {
         this.logger.debug(
@@ -101,19 +106,21 @@ export class WaitForFirmwareUpdateState implements ReaderState {
 
       currentStream.on('error', (error) => {
         this.logger.error(`Firmware stream error for reader ${this.socket.reader.id}:`, error);
+        streamFailed = true;
         resolve();
       });
     });
 
-    WaitForFirmwareUpdateState.chunks.set(
-      JSON.stringify({
-        name: this.firmwareDefinition.name,
-        variant: this.firmwareDefinition.variant,
-      }),
-      chunks
-    );
+    // Size and hash of what is actually streamed (the OTA image, not the merged flash image)
+    const firmware: LoadedFirmware = { chunks, size: totalBytesLoaded, sha256: hash.digest('hex') };
+    this.logger.debug(`Firmware size: ${firmware.size} bytes, sha256: ${firmware.sha256}`);
+
+    // A truncated image is not cached, the next reader tries again
+    if (!streamFailed) {
+      WaitForFirmwareUpdateState.firmwares.set(cacheKey, firmware);
+    }
 
-    return chunks;
+    return firmware;
   }
 
   private async onStreamChunk(eventData: AttractapEvent['data']): Promise<void> {
@@ -124,7 +131,7 @@ export class WaitForFirmwareUpdateState implements ReaderState {
       return;
     }
 
-    const chunks = await this.loadFirmware();
+    const { chunks } = await this.loadFirmware();
 
     if (chunkIndex >= chunks.length) {
       this.logger.error(`Chunk index is out of bounds for firmware update`);
@@ -141,6 +148,13 @@ export class WaitForFirmwareUpdateState implements ReaderState {
       this.logger.debug(`First byte: 0x${chunk[0].toString(16)} (expected ESP32 magic: 0xE9)`);
     }
 
+    if (this.socket.encoding === AttractapEncoding.MSGPACK) {
+      // Binary frames carry MessagePack messages on this connection, so the chunk travels as a bin field
+      const message = new AttractapResponse(AttractapEventType.READER_FIRMWARE_STREAM_CHUNK, { chunkIndex, data: chunk });
+      this.socket.sendBinaryData(encodeAttractapMessage(message, AttractapEncoding.MSGPACK) as Buffer);
+      return;
+    }
+
     this.socket.sendBinaryData(chunk);
   }
 
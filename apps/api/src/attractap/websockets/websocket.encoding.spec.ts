@@ -0,0 +1,132 @@
+import { pack } from 'msgpackr';
+import { performance } from 'perf_hooks';
+import { encodeAttractapMessage, parseAttractapFrame, selectAttractapEncoding } from './websocket.encoding';
+import { AttractapEncoding, AttractapEvent, AttractapEventType, AttractapResponse } from './websocket.types';
+
+// Representative payloads as exchanged with the reader firmware
+const KEY = '00112233445566778899aabbccddeeff';
+const samplePayloads: Record<AttractapEventType, unknown> = {
+  [AttractapEventType.READER_REGISTER]: { id: 12, token: 'a'.repeat(64) },
+  [AttractapEventType.READER_AUTHENTICATE]: {},
+  [AttractapEventType.NFC_AUTHENTICATE]: { keyNumber: 1, authenticationKey: KEY },
+  [AttractapEventType.READER_UNAUTHORIZED]: { message: 'PLEASE_REREGISTER' },
+  [AttractapEventType.READER_REQUEST_AUTHENTICATION]: { id: 12, token: 'a'.repeat(64), encodings: ['MSGPACK'] },
+  [AttractapEventType.READER_AUTHENTICATED]: { name: 'Laser Cutter', features: ['BATCH'], encoding: 'MSGPACK' },
+  [AttractapEventType.NFC_TAP]: { cardUID: '04a1b2c3d4e5f6' },
+  [AttractapEventType.NFC_CHANGE_KEY]: { keyNumber: 0, authKey: KEY, oldKey: KEY, newKey: KEY },
+  [AttractapEventType.NFC_ENABLE_CARD_CHECKING]: { type: 'toggle-resource-usage', user: { id: 3, username: 'jane' } },
+  [AttractapEventType.WAIT_FOR_PROCESSING]: { message: 'Processing...' },
+  [AttractapEventType.DISPLAY_TEXT]: { message: 'Tap your card', duration: 5000 },
+  [AttractapEventType.DISPLAY_SUCCESS]: { message: 'Usage started', duration: 3000 },
+  [AttractapEventType.DISPLAY_ERROR]: { message: 'Unknown card', duration: 3000 },
+  [AttractapEventType.CANCEL]: {},
+  [AttractapEventType.READER_FIRMWARE_UPDATE_REQUIRED]: {
+    current: { name: 'attractap_solo', variant: 'default', version: '1.0.0' },
+    available: { name: 'attractap_solo', variant: 'default', version: '1.1.0' },
+    firmware: { chunks: 256, totalSize: 1048576 },
+  },
+  [AttractapEventType.READER_FIRMWARE_STREAM_CHUNK]: { chunkIndex: 42 },
+  [AttractapEventType.READER_FIRMWARE_INFO]: { name: 'attractap_solo', variant: 'default', version: '1.0.0' },
+  [AttractapEventType.SELECT_ITEM]: {
+    label: 'Select resource',
+    options: [
+      { id: 1, label: 'Laser Cutter' },
+      { id: 2, label: '3D Printer' },
+    ],
+  },
+  [AttractapEventType.CONFIRM_ACTION]: { message: 'Start usage?' },
+  [AttractapEventType.HEARTBEAT]: { seq: 1234, ts: 98765432 },
+  [AttractapEventType.READER_JOURNAL_ENTRY]: {
+    id: 1073741825,
+    kind: 'NFC_TAP',
+    cardUID: '04a1b2c3d4e5f6',
+    ageMs: 42000,
+  },
+  [AttractapEventType.READER_ACCESS_LIST]: {
+    version: 2,
+    baseVersion: 1,
+    reset: false,
+    issuedAt: 1700000000,
+    expiresAt: 1700086400,
+    resources: [7],
+    upsert: [['04a1b2c3d4e5f6', 1, 0]],
+    remove: ['04c0ffee'],
+    signature: 'ab'.repeat(32),
+  },
+};
+
+// ns per call after a short warm up, for the per-type benchmark below
+const BENCHMARK_ITERATIONS = 2000;
+function nsPerOp(operation: () => unknown): number {
+  for (let i = 0; i < BENCHMARK_ITERATIONS / 10; i++) {
+    operation();
+  }
+  const start = performance.now();
+  for (let i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    operation();
+  }
+  return ((performance.now() - start) * 1e6) / BENCHMARK_ITERATIONS;
+}
+
+describe('websocket encoding', () => {
+  describe.each(Object.values(AttractapEventType))('%s', (type) => {
+    const messages = [
+      new AttractapEvent(type, samplePayloads[type]),
+      new AttractapResponse(type, samplePayloads[type]),
+    ];
+
+    it.each(Object.values(AttractapEncoding))('round-trips in %s', (encoding) => {
+      for (const message of messages) {
+        const encoded = encodeAttractapMessage(message, encoding);
+        expect(parseAttractapFrame(encoded)).toEqual({ event: message.event, data: message.data });
+      }
+    });
+
+    it('is not larger as MessagePack', () => {
+      const json = encodeAttractapMessage(messages[0], AttractapEncoding.JSON) as string;
+      const msgpack = encodeAttractapMessage(messages[0], AttractapEncoding.MSGPACK) as Buffer;
+      expect(msgpack.length).toBeLessThanOrEqual(Buffer.byteLength(json));
+    });
+  });
+
+  // Same frames as BenchmarkEncodingPerEventType in the firmware's test_api_command
+  it('reports frame size and encode/decode time per event type', () => {
+    const rows = Object.values(AttractapEventType).map((type) => {
+      const message = new AttractapEvent(type, samplePayloads[type]);
+      const json = encodeAttractapMessage(message, AttractapEncoding.JSON) as string;
+      const msgpack = encodeAttractapMessage(message, AttractapEncoding.MSGPACK) as Buffer;
+      return {
+        type,
+        jsonBytes: Buffer.byteLength(json),
+        jsonEncodeNs: Math.round(nsPerOp(() => encodeAttractapMessage(message, AttractapEncoding.JSON))),
+        jsonDecodeNs: Math.round(nsPerOp(() => parseAttractapFrame(json))),
+        msgpackBytes: msgpack.length,
+        msgpackEncodeNs: Math.round(nsPerOp(() => encodeAttractapMessage(message, AttractapEncoding.MSGPACK))),
+        msgpackDecodeNs: Math.round(nsPerOp(() => parseAttractapFrame(msgpack))),
+      };
+    });
+    console.table(rows);
+
+    for (const row of rows) {
+      expect(row.msgpackBytes).toBeLessThanOrEqual(row.jsonBytes);
+    }
+  });
+
+  it('parses JSON text delivered as a buffer', () => {
+    expect(parseAttractapFrame(Buffer.from('{"event":"HEARTBEAT"}'))).toEqual({ event: 'HEARTBEAT' });
+  });
+
+  it('parses MessagePack batches as assembled by the reader firmware', () => {
+    // Envelope template with a patched fixarray header, followed by the packed messages
+    const ack = { event: 'RESPONSE', data: { type: 'ACK_DISPLAY_TEXT', payload: {} } };
+    const tap = { event: 'EVENT', data: { type: 'NFC_TAP', payload: { cardUID: '04a1b2' } } };
+    const batch = Buffer.concat([Buffer.from('\x82\xa5event\xa5BATCH\xa4data\x92', 'latin1'), pack(ack), pack(tap)]);
+    expect(parseAttractapFrame(batch)).toEqual({ event: 'BATCH', data: [ack, tap] });
+  });
+
+  it('selects MessagePack only when offered', () => {
+    expect(selectAttractapEncoding(['MSGPACK'])).toBe(AttractapEncoding.MSGPACK);
+    expect(selectAttractapEncoding(['CBOR'])).toBe(AttractapEncoding.JSON);
+    expect(selectAttractapEncoding(undefined)).toBe(AttractapEncoding.JSON);
+  });
+});
@@ -0,0 +1,61 @@
+import { pack, unpack } from 'msgpackr';
+import { AttractapEncoding } from './websocket.types';
+
+type WsData = string | Buffer | ArrayBuffer | Buffer[];
+
+const JSON_OBJECT_START = '{'.charCodeAt(0);
+
+function toBuffer(data: Exclude<WsData, string>): Buffer {
+  if (Buffer.isBuffer(data)) {
+    return data;
+  }
+
+  if (Array.isArray(data)) {
+    return Buffer.concat(data);
+  }
+
+  return Buffer.from(data);
+}
+
+/**
+ * Parses an incoming reader frame into { event, data }.
+ * JSON messages are objects, MessagePack messages are maps, so the first byte tells them apart
+ * regardless of whether the frame was sent as text or binary.
+ */
+// eslint-disable-next-line @typescript-eslint/no-explicit-any
+export function parseAttractapFrame(data: WsData): { event: string; data: any } {
+  if (typeof data === 'string') {
+    return JSON.parse(data);
+  }
+
+  const buffer = toBuffer(data);
+  if (buffer.length > 0 && buffer[0] === JSON_OBJECT_START) {
+    return JSON.parse(buffer.toString('utf8'));
+  }
+
+  return unpack(buffer);
+}
+
+/**
+ * Serializes an outgoing message for a reader. JSON goes out as a text frame,
+ * MessagePack as a binary frame.
+ */
+export function encodeAttractapMessage(message: unknown, encoding = AttractapEncoding.JSON): string | Buffer {
+  if (encoding === AttractapEncoding.MSGPACK) {
+    return pack(message);
+  }
+
+  return JSON.stringify(message);
+}
+
+/**
+ * Picks the encoding for a connection from the encodings a reader offered
+ * in its READER_REQUEST_AUTHENTICATION response.
+ */
+export function selectAttractapEncoding(offered: unknown): AttractapEncoding {
+  if (Array.isArray(offered) && offered.includes(AttractapEncoding.MSGPACK)) {
+    return AttractapEncoding.MSGPACK;
+  }
+
+  return AttractapEncoding.JSON;
+}
@@ -12,7 +12,16 @@ import { Inject, Logger } from '@nestjs/common';
 import { WebsocketService } from './websocket.service';
 import { InitialReaderState } from './reader-states/initial.state';
 import { EnrollNTAG424State } from './reader-states/enroll-ntag424.state';
-import { AuthenticatedWebSocket, AttractapEvent, AttractapMessage, AttractapEventType } from './websocket.types';
+import {
+  AuthenticatedWebSocket,
+  AttractapEvent,
+  AttractapMessage,
+  AttractapEventType,
+  AttractapBatchedMessage,
+  AttractapHeartbeatData,
+  AttractapJournalEntryData,
+  AttractapResponse,
+} from './websocket.types';
 import { AttractapService } from '../attractap.service';
 import { nanoid } from 'nanoid';
 import { ResetNTAG424State } from './reader-states/reset-ntag424.state';
@@ -26,6 +35,19 @@ import { AttractapFirmwareService } from '../firmware.service';
 import { ResourceMaintenanceService } from '../../resources/maintenances/maintenance.service';
 import { Mutex } from 'async-mutex';
 import { LicenseModuleType, LicenseService } from '../../license/license.service';
+import { Attractap } from '@attraccess/database-entities';
+import { encodeAttractapMessage } from './websocket.encoding';
+import {
+  ACCESS_LIST_MAX_ENTRIES,
+  ACCESS_LIST_MAX_RESOURCES,
+  AccessListEntry,
+  AccessListTable,
+  AccessListUpdate,
+  AttractapAccessListConfirmation,
+  accessListContentEqual,
+  buildAccessListUpdates,
+  compareAccessListUids,
+} from './access-list';
 
 export interface GatewayServices {
   websocketService: WebsocketService;
@@ -46,6 +68,19 @@ export class AttractapGateway implements OnGatewayConnection, OnGatewayDisconnec
   private readonly logger = new Logger(AttractapGateway.name);
   private readonly clientResponseAwaitersMutex = new Mutex();
 
+  // Recently confirmed journal entry ids per reader, to drop entries the reader sends again
+  private static readonly JOURNAL_DEDUP_WINDOW = 256;
+  private readonly confirmedJournalEntries = new Map<number, number[]>();
+
+  // Access list pushed to readers for offline decisions. A reader is sent a delta against the
+  // table it confirmed last (if this process still knows it), one signed update at a time.
+  private static readonly ACCESS_LIST_TTL_S = 24 * 60 * 60;
+  private static readonly ACCESS_LIST_REFRESH_MS = 15 * 60 * 1000;
+  private static readonly ACCESS_LIST_CONFIRMATION_TIMEOUT_MS = 30 * 1000;
+  private readonly confirmedAccessLists = new Map<number, AccessListTable>();
+  private readonly pendingAccessListUpdates = new Map<string, { updates: AccessListUpdate[]; sentAt: number }>();
+  private readonly accessListRefreshTimers = new Map<string, NodeJS.Timeout>();
+
   @Inject(WebsocketService)
   private websocketService: WebsocketService;
 
@@ -127,7 +162,7 @@ export class AttractapGateway implements OnGatewayConnection, OnGatewayDisconnec
           `Sending ${message.event} of type ${message.data.type} (attempt ${i + 1}/${RETRY_COUNT})`,
           message.data.payload
         );
-        (client as unknown as WebSocket).send(JSON.stringify(message));
+        (client as unknown as WebSocket).send(encodeAttractapMessage(message, client.encoding));
 
         this.logger.debug(
           `Waiting for response for ${message.event} of type ${message.data.type} (attempt ${i + 1}/${RETRY_COUNT})`
@@ -157,6 +192,13 @@ export class AttractapGateway implements OnGatewayConnection, OnGatewayDisconnec
 
     this.websocketService.sockets.set(client.id, client);
 
+    this.accessListRefreshTimers.set(
+      client.id,
+      setInterval(() => {
+        this.publishAccessList(client).catch((error) => this.logger.error('Failed to refresh access list', error));
+      }, AttractapGateway.ACCESS_LIST_REFRESH_MS)
+    );
+
     await this.clientWasActive(client);
 
     this.logger.debug('Transitioning to initial state');
@@ -234,6 +276,10 @@ export class AttractapGateway implements OnGatewayConnection, OnGatewayDisconnec
       this.clientResponseAwaiters = this.clientResponseAwaiters.filter((awaiter) => awaiter.clientId !== client.id);
     });
 
+    clearInterval(this.accessListRefreshTimers.get(client.id));
+    this.accessListRefreshTimers.delete(client.id);
+    this.pendingAccessListUpdates.delete(client.id);
+
     const readerId = client.reader?.id;
     if (readerId) {
       this.logger.log(`Client for reader ${readerId} disconnected.`);
@@ -251,9 +297,18 @@ export class AttractapGateway implements OnGatewayConnection, OnGatewayDisconnec
   }
 
   @SubscribeMessage('HEARTBEAT')
-  public async onHeartbeat(@ConnectedSocket() client: AuthenticatedWebSocket) {
+  public async onHeartbeat(
+    @ConnectedSocket() client: AuthenticatedWebSocket,
+    @MessageBody() heartbeat?: AttractapHeartbeatData
+  ) {
     this.logger.debug(`Heartbeat from client ${client.id}.`);
 
+    // Echo right away, before any database work, so the reader measures the transport round trip
+    if (heartbeat?.seq !== undefined) {
+      const echo = new AttractapResponse(AttractapEventType.HEARTBEAT, { seq: heartbeat.seq, ts: heartbeat.ts });
+      (client as unknown as WebSocket).send(encodeAttractapMessage(echo, client.encoding));
+    }
+
     await this.clientWasActive(client);
   }
 
@@ -271,6 +326,11 @@ export class AttractapGateway implements OnGatewayConnection, OnGatewayDisconnec
 
     this.logger.debug(`Received event from client ${client.id}: ${JSON.stringify(eventData)}`);
 
+    if (eventData.type === AttractapEventType.READER_JOURNAL_ENTRY) {
+      await this.onJournalEntry(client, eventData.payload as AttractapJournalEntryData);
+      return undefined;
+    }
+
     if (eventData.type === AttractapEventType.NFC_TAP) {
       this.logger.debug(`Updating last seen for NFC card ${eventData.payload.cardUID}`);
       await this.attractapService.updateNFCCardLastSeen(eventData.payload.cardUID);
@@ -281,6 +341,41 @@ export class AttractapGateway implements OnGatewayConnection, OnGatewayDisconnec
     return undefined;
   }
 
+  private async onJournalEntry(client: AuthenticatedWebSocket, entry: AttractapJournalEntryData) {
+    if (!client.reader || typeof entry?.id !== 'number') {
+      this.logger.warn(`Ignoring journal entry from unauthenticated client ${client.id}`);
+      return;
+    }
+
+    const confirmed = this.confirmedJournalEntries.get(client.reader.id) ?? [];
+    if (confirmed.includes(entry.id)) {
+      this.logger.debug(`Journal entry #${entry.id} of reader ${client.reader.id} was already processed`);
+    } else {
+      // Replayed input is only recorded, it must not start or stop anything after the fact
+      const age = entry.ageMs !== undefined ? `${Math.round(entry.ageMs / 1000)}s ago` : 'before a reboot';
+      if (entry.kind === 'NFC_TAP') {
+        this.logger.log(`Reader ${client.reader.id} was tapped offline by card ${entry.cardUID} (${age})`);
+        if (entry.cardUID) {
+          await this.attractapService.updateNFCCardLastSeen(entry.cardUID);
+        }
+      } else if (entry.kind === 'KEYPAD_CONFIRM') {
+        this.logger.log(`Reader ${client.reader.id} keypad input "${entry.value ?? ''}" confirmed offline (${age})`);
+      } else {
+        this.logger.log(`Reader ${client.reader.id} got offline journal entry of kind ${entry.kind} (${age})`);
+      }
+
+      confirmed.push(entry.id);
+      if (confirmed.length > AttractapGateway.JOURNAL_DEDUP_WINDOW) {
+        confirmed.shift();
+      }
+      this.confirmedJournalEntries.set(client.reader.id, confirmed);
+    }
+
+    // Sent directly: the confirmation is the acknowledgement, the reader does not ACK it
+    const confirmation = new AttractapResponse(AttractapEventType.READER_JOURNAL_ENTRY, { id: entry.id });
+    (client as unknown as WebSocket).send(encodeAttractapMessage(confirmation, client.encoding));
+  }
+
   @SubscribeMessage('RESPONSE')
   public async onResponse(
     @MessageBody() responseData: AttractapEvent['data'],
@@ -293,6 +388,11 @@ export class AttractapGateway implements OnGatewayConnection, OnGatewayDisconnec
 
     await this.clientWasActive(client);
 
+    if (responseData.type === AttractapEventType.READER_ACCESS_LIST) {
+      await this.onAccessListConfirmation(client, responseData.payload as AttractapAccessListConfirmation);
+      return undefined;
+    }
+
     if (responseData.type.startsWith('ACK_')) {
       this.logger.debug(`Received ACK response from client ${client.id}: ${JSON.stringify(responseData)}`);
 
@@ -307,6 +407,156 @@ export class AttractapGateway implements OnGatewayConnection, OnGatewayDisconnec
     return undefined;
   }
 
+  /**
+   * Brings the reader's access list up to date. Skipped for readers that did not report an
+   * access list version (firmware without support) and while an earlier update is in flight.
+   */
+  public async publishAccessList(client: AuthenticatedWebSocket) {
+    if (!client.reader || !client.accessListKey || client.accessListVersion === undefined) {
+      return;
+    }
+
+    const pending = this.pendingAccessListUpdates.get(client.id);
+    if (pending && Date.now() - pending.sentAt < AttractapGateway.ACCESS_LIST_CONFIRMATION_TIMEOUT_MS) {
+      return;
+    }
+    this.pendingAccessListUpdates.delete(client.id);
+
+    const next = await this.buildAccessList(client.reader);
+    const confirmed = this.confirmedAccessLists.get(client.reader.id);
+    const previous = confirmed?.version === client.accessListVersion ? confirmed : undefined;
+
+    const expiresInS = previous ? previous.expiresAt - next.issuedAt : 0;
+    if (previous && accessListContentEqual(previous, next) && expiresInS > AttractapGateway.ACCESS_LIST_TTL_S / 2) {
+      return;
+    }
+
+    const updates = buildAccessListUpdates(client.accessListKey, previous, next, client.accessListVersion);
+    this.logger.debug(
+      `Sending access list v${updates[updates.length - 1].data.version} (${next.entries.length} entries) ` +
+        `to reader ${client.reader.id} in ${updates.length} update(s)`
+    );
+
+    this.pendingAccessListUpdates.set(client.id, { updates, sentAt: Date.now() });
+    this.sendAccessListUpdate(client, updates[0]);
+  }
+
+  private sendAccessListUpdate(client: AuthenticatedWebSocket, update: AccessListUpdate) {
+    // Sent directly: the reader answers with a READER_ACCESS_LIST response instead of an ACK
+    const message = new AttractapEvent(AttractapEventType.READER_ACCESS_LIST, update.data);
+    (client as unknown as WebSocket).send(encodeAttractapMessage(message, client.encoding));
+  }
+
+  private async onAccessListConfirmation(
+    client: AuthenticatedWebSocket,
+    confirmation: AttractapAccessListConfirmation
+  ) {
+    const pending = this.pendingAccessListUpdates.get(client.id);
+    if (!client.reader || !pending) {
+      return;
+    }
+
+    const [update, ...remaining] = pending.updates;
+    client.accessListVersion = confirmation?.version ?? 0;
+
+    if (!confirmation?.applied || confirmation.version !== update.data.version) {
+      this.logger.warn(
+        `Reader ${client.reader.id} rejected access list v${update.data.version} (has v${client.accessListVersion})`
+      );
+      this.pendingAccessListUpdates.delete(client.id);
+      this.confirmedAccessLists.delete(client.reader.id);
+
+      // A rejected delta is retried as a full list, a rejected full list waits for the next refresh
+      if (!update.data.reset) {
+        await this.publishAccessList(client);
+      }
+      return;
+    }
+
+    this.confirmedAccessLists.set(client.reader.id, update.table);
+
+    if (remaining.length === 0) {
+      this.pendingAccessListUpdates.delete(client.id);
+      return;
+    }
+
+    this.pendingAccessListUpdates.set(client.id, { updates: remaining, sentAt: Date.now() });
+    this.sendAccessListUpdate(client, remaining[0]);
+  }
+
+  private async buildAccessList(reader: Attractap): Promise<Omit<AccessListTable, 'version'>> {
+    const resources = [...reader.resources].sort((a, b) => a.id - b.id);
+    if (resources.length > ACCESS_LIST_MAX_RESOURCES) {
+      this.logger.warn(`Reader ${reader.id} has more than ${ACCESS_LIST_MAX_RESOURCES} resources, not all are cached`);
+      resources.length = ACCESS_LIST_MAX_RESOURCES;
+    }
+
+    const entries: AccessListEntry[] = [];
+    for (const card of await this.attractapService.getActiveNFCCards()) {
+      const uid = card.uid.toLowerCase();
+      if (!card.user || !/^([0-9a-f]{2}){1,10}$/.test(uid)) {
+        continue;
+      }
+
+      let resourceMask = 0;
+      for (const [index, resource] of resources.entries()) {
+        if (await this.resourceUsageService.canControllResource(resource.id, card.user)) {
+          resourceMask |= 1 << index;
+        }
+      }
+
+      if (resourceMask !== 0) {
+        entries.push({ uid, resourceMask: resourceMask >>> 0, expiresAt: 0 });
+      }
+    }
+
+    entries.sort((a, b) => compareAccessListUids(a.uid, b.uid));
+    if (entries.length > ACCESS_LIST_MAX_ENTRIES) {
+      this.logger.warn(`Access list of reader ${reader.id} exceeds ${ACCESS_LIST_MAX_ENTRIES} entries, truncating`);
+      entries.length = ACCESS_LIST_MAX_ENTRIES;
+    }
+
+    const issuedAt = Math.floor(Date.now() / 1000);
+    return {
+      issuedAt,
+      expiresAt: issuedAt + AttractapGateway.ACCESS_LIST_TTL_S,
+      resourceIds: resources.map((resource) => resource.id),
+      entries,
+    };
+  }
+
+  @SubscribeMessage('BATCH')
+  public async onBatch(
+    @MessageBody() messages: AttractapBatchedMessage[],
+    @ConnectedSocket() client: AuthenticatedWebSocket
+  ) {
+    if (!Array.isArray(messages)) {
+      this.logger.warn(`Received malformed batch from client ${client.id}`);
+      return undefined;
+    }
+
+    this.logger.debug(`Received batch of ${messages.length} messages from client ${client.id}`);
+
+    // In order, exactly as if the messages had arrived as separate frames
+    for (const message of messages) {
+      switch (message?.event) {
+        case 'HEARTBEAT':
+          await this.onHeartbeat(client, message.data as AttractapHeartbeatData);
+          break;
+        case 'EVENT':
+          await this.onClientEvent(message.data as AttractapEvent['data'], client);
+          break;
+        case 'RESPONSE':
+          await this.onResponse(message.data as AttractapEvent['data'], client);
+          break;
+        default:
+          this.logger.warn(`Ignoring unknown batched message ${message?.event} from client ${client.id}`);
+      }
+    }
+
+    return undefined;
+  }
+
   public async startEnrollOfNewNfcCard(data: { readerId: number; userId: number }) {
     const reader = await this.attractapService.findReaderById(data.readerId);
 
@@ -29,6 +29,9 @@ export enum AttractapEventType {
   READER_FIRMWARE_INFO = 'READER_FIRMWARE_INFO',
   SELECT_ITEM = 'SELECT_ITEM',
   CONFIRM_ACTION = 'CONFIRM_ACTION',
+  HEARTBEAT = 'HEARTBEAT',
+  READER_JOURNAL_ENTRY = 'READER_JOURNAL_ENTRY',
+  READER_ACCESS_LIST = 'READER_ACCESS_LIST',
 }
 
 // eslint-disable-next-line @typescript-eslint/no-explicit-any
@@ -72,10 +75,66 @@ export class AttractapResponse<TPayload = any | undefined> {
 // eslint-disable-next-line @typescript-eslint/no-explicit-any
 export type AttractapMessage<TPayload = any | undefined> = AttractapEvent<TPayload> | AttractapResponse<TPayload>;
 
+/**
+ * Optional protocol features the server announces in the READER_AUTHENTICATED payload.
+ * Readers only use a feature after it was announced on the current connection.
+ */
+export enum AttractapFeature {
+  // Client may wrap several messages into one { event: 'BATCH', data: [...] } frame
+  BATCH = 'BATCH',
+}
+
+export const ATTRACTAP_SERVER_FEATURES: AttractapFeature[] = [AttractapFeature.BATCH];
+
+/**
+ * Wire encoding of a connection. Readers offer encodings in their READER_REQUEST_AUTHENTICATION
+ * response, the server confirms one in READER_AUTHENTICATED (still sent as JSON) and uses it from then on.
+ * MessagePack messages travel in binary frames.
+ */
+export enum AttractapEncoding {
+  JSON = 'JSON',
+  MSGPACK = 'MSGPACK',
+}
+
+/**
+ * Heartbeat sent by readers. seq/ts are optional (older firmware sends none) and
+ * are echoed back untouched as a HEARTBEAT response so the reader can measure the round trip.
+ */
+export interface AttractapHeartbeatData {
+  seq?: number;
+  ts?: number;
+}
+
+/**
+ * Input the reader recorded while it had no server connection, replayed one entry at a time
+ * after it authenticated again. Confirmed with a READER_JOURNAL_ENTRY response carrying the id;
+ * the reader resends unconfirmed entries, so the same id can arrive more than once.
+ */
+export interface AttractapJournalEntryData {
+  id: number;
+  kind: 'NFC_TAP' | 'KEYPAD_CONFIRM' | 'KEYPAD_CANCEL';
+  // NFC_TAP only
+  cardUID?: string;
+  // KEYPAD_CONFIRM only, the digits entered
+  value?: string;
+  // Only present if the reader has not rebooted since recording the entry
+  ageMs?: number;
+}
+
+export interface AttractapBatchedMessage {
+  event: 'HEARTBEAT' | 'EVENT' | 'RESPONSE';
+  data: AttractapEvent['data'] | AttractapHeartbeatData;
+}
+
 export interface AuthenticatedWebSocket extends Omit<WebSocket, 'send'> {
   id: string;
   reader?: Attractap;
   state?: ReaderState;
+  encoding?: AttractapEncoding;
+  // Signing key of the access list (the reader token, only kept in memory for this connection)
+  accessListKey?: string;
+  // Version of the access list the reader confirmed last
+  accessListVersion?: number;
   transitionToState: (state: ReaderState) => Promise<void>;
   sendMessage: (message: AttractapMessage) => Promise<void>;
   sendBinaryData: (data: Buffer) => void;
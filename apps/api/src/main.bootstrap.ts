@@ -3,6 +3,7 @@ import { AppModule } from './app/app.module';
 import { SwaggerModule, DocumentBuilder } from '@nestjs/swagger';
 import { ValidationPipe, ClassSerializerInterceptor, Logger, LogLevel } from '@nestjs/common';
 import { WsAdapter } from '@nestjs/platform-ws';
+import { parseAttractapFrame } from './attractap/websockets/websocket.encoding';
 import { NestExpressApplication } from '@nestjs/platform-express';
 import session from 'express-session';
 import { ConfigService } from '@nestjs/config';
@@ -142,7 +143,8 @@ export async function bootstrap() {
   const globalPrefix = appConfig.GLOBAL_PREFIX;
   app.setGlobalPrefix(globalPrefix);
 
-  app.useWebSocketAdapter(new WsAdapter(app));
+  // Readers may negotiate MessagePack, see attractap/websockets/websocket.encoding.ts
+  app.useWebSocketAdapter(new WsAdapter(app, { messageParser: parseAttractapFrame }));
 
   // We dont use this for actual sessions/authentication
   // we need this for SSO logins since for those we need to persist some state between requests
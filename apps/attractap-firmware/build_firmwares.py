@@ -69,6 +69,9 @@ def main():
         environments = []
         for section in config.sections():
             if section.startswith('env:'):
+                # The native environment only runs the host tests, it has no firmware
+                if config[section].get('platform', '').strip() == 'native':
+                    continue
                 env_name = section[4:]  # Remove 'env:' prefix
                 environments.append(env_name)
         
@@ -313,6 +316,11 @@ def main():
                 print(f"Error: Failed to create merged firmware for environment '{env}': {e}")
                 sys.exit(1)
 
+            # The application image alone is what readers write to their other OTA slot
+            firmware_ota_filename = f"{firmware_name}_{firmware_variant}.ota.bin"
+            shutil.copyfile(firmware_path, os.path.join(output_dir, firmware_ota_filename))
+            print(f"OTA firmware created at: {os.path.join(output_dir, firmware_ota_filename)}")
+
             firmware_info.append({
                 "name": firmware_name,
                 "friendlyName": firmware_friendly_name,
@@ -320,7 +328,8 @@ def main():
                 "variantFriendlyName": firmware_variant_friendly_name,
                 "version": firmware_version,
                 "boardFamily": board_family,
-                "filename": firmware_filename
+                "filename": firmware_filename,
+                "filenameOTA": firmware_ota_filename
             })
         
         # Create single consolidated firmware manifest
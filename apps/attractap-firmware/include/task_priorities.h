@@ -6,6 +6,7 @@
 #define TASK_PRIORITY_WIFI 5
 #define TASK_PRIORITY_ETHERNET 5
 #define TASK_PRIORITY_WEBSOCKET 1
+#define TASK_PRIORITY_WEBSOCKET_CLIENT 5
 #define TASK_PRIORITY_NFC 3
 #define TASK_PRIORITY_DISPLAY_TOUCHSCREEN 1
 #define TASK_PRIORITY_DISPLAY_MANAGER 1
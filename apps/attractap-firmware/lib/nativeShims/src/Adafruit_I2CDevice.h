@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Wire.h"
+
+// Adafruit BusIO stand-in on top of the Wire stand-in, answers only through a
+// device model attached to Wire
+class Adafruit_I2CDevice
+{
+public:
+    Adafruit_I2CDevice(uint8_t address, TwoWire *theWire = &Wire) : address(address), wire(theWire) {}
+
+    // Like BusIO, begin(false) succeeds without probing the address
+    bool begin(bool addressDetect = true) { return this->wire->begin() && (!addressDetect || this->detected()); }
+    bool detected()
+    {
+        this->wire->beginTransmission(this->address);
+        return this->wire->endTransmission() == 0;
+    }
+
+    bool read(uint8_t *buffer, size_t length, bool stop = true)
+    {
+        (void)stop;
+        return this->wire->requestFrom(this->address, length) == length &&
+               this->wire->readBytes(buffer, length) == length;
+    }
+    bool write(const uint8_t *buffer, size_t length, bool stop = true, const uint8_t *prefixBuffer = nullptr, size_t prefixLength = 0)
+    {
+        this->wire->beginTransmission(this->address);
+        if (prefixLength != 0 && this->wire->write(prefixBuffer, prefixLength) != prefixLength)
+        {
+            return false;
+        }
+        if (this->wire->write(buffer, length) != length)
+        {
+            return false;
+        }
+        return this->wire->endTransmission(stop) == 0;
+    }
+
+private:
+    uint8_t address;
+    TwoWire *wire;
+};
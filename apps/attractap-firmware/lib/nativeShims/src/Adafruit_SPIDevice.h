@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "SPI.h"
+
+typedef enum _BitOrder
+{
+    SPI_BITORDER_MSBFIRST = MSBFIRST,
+    SPI_BITORDER_LSBFIRST = LSBFIRST,
+} BusIOBitOrder;
+
+// Adafruit BusIO stand-in on top of the SPI stand-in, reads are all zero
+class Adafruit_SPIDevice
+{
+public:
+    Adafruit_SPIDevice(int8_t cs, uint32_t frequency = 1000000, BusIOBitOrder dataOrder = SPI_BITORDER_MSBFIRST,
+                       uint8_t dataMode = SPI_MODE0, SPIClass *theSPI = &SPI)
+        : spi(theSPI)
+    {
+        (void)cs;
+        (void)frequency;
+        (void)dataOrder;
+        (void)dataMode;
+    }
+    // Software SPI
+    Adafruit_SPIDevice(int8_t cs, int8_t sck, int8_t miso, int8_t mosi, uint32_t frequency = 1000000,
+                       BusIOBitOrder dataOrder = SPI_BITORDER_MSBFIRST, uint8_t dataMode = SPI_MODE0)
+        : spi(nullptr)
+    {
+        (void)cs;
+        (void)sck;
+        (void)miso;
+        (void)mosi;
+        (void)frequency;
+        (void)dataOrder;
+        (void)dataMode;
+    }
+
+    bool begin()
+    {
+        if (this->spi != nullptr)
+        {
+            this->spi->begin();
+        }
+        return true;
+    }
+
+    bool write(const uint8_t *buffer, size_t length, const uint8_t *prefixBuffer = nullptr, size_t prefixLength = 0)
+    {
+        (void)buffer;
+        (void)length;
+        (void)prefixBuffer;
+        (void)prefixLength;
+        return true;
+    }
+    bool write_then_read(const uint8_t *writeBuffer, size_t writeLength, uint8_t *readBuffer, size_t readLength,
+                         uint8_t sendValue = 0xFF)
+    {
+        (void)writeBuffer;
+        (void)writeLength;
+        (void)sendValue;
+        memset(readBuffer, 0, readLength);
+        return true;
+    }
+
+private:
+    SPIClass *spi;
+};
@@ -0,0 +1,166 @@
+#include "Arduino.h"
+
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "esp_system.h"
+#include "esp_ota_ops.h"
+
+EspClass ESP;
+
+static std::chrono::steady_clock::time_point bootTime()
+{
+    static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+    return boot;
+}
+
+static std::mutex randomMutex;
+static std::mt19937 randomGenerator(std::random_device{}());
+
+unsigned long millis()
+{
+    return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - bootTime()).count();
+}
+
+unsigned long micros()
+{
+    return (unsigned long)(uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - bootTime()).count();
+}
+
+void delay(uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    if (us > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    (void)pin;
+    (void)value;
+}
+
+int digitalRead(uint8_t pin)
+{
+    (void)pin;
+    return LOW;
+}
+
+long random(long max)
+{
+    return max <= 0 ? 0 : random(0, max);
+}
+
+long random(long min, long max)
+{
+    if (min >= max)
+    {
+        return min;
+    }
+    std::lock_guard<std::mutex> lock(randomMutex);
+    return std::uniform_int_distribution<long>(min, max - 1)(randomGenerator);
+}
+
+void randomSeed(unsigned long seed)
+{
+    std::lock_guard<std::mutex> lock(randomMutex);
+    randomGenerator.seed(seed);
+}
+
+extern "C" uint32_t esp_random(void)
+{
+    std::lock_guard<std::mutex> lock(randomMutex);
+    return (uint32_t)randomGenerator();
+}
+
+extern "C" void esp_fill_random(void *buffer, size_t length)
+{
+    uint8_t *bytes = (uint8_t *)buffer;
+    for (size_t i = 0; i < length; i++)
+    {
+        bytes[i] = (uint8_t)esp_random();
+    }
+}
+
+static esp_reset_reason_t resetReason = ESP_RST_POWERON;
+
+extern "C" esp_reset_reason_t esp_reset_reason(void)
+{
+    return resetReason;
+}
+
+extern "C" void esp_set_reset_reason(esp_reset_reason_t reason)
+{
+    resetReason = reason;
+}
+
+extern "C" void esp_restart(void)
+{
+    fprintf(stderr, "esp_restart() called, ending the host process\n");
+    fflush(stdout);
+    _Exit(EXIT_FAILURE);
+}
+
+extern "C" uint32_t esp_get_free_heap_size(void)
+{
+    return 0;
+}
+
+extern "C" uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return 0;
+}
+
+extern "C" const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_OTA_PARTITION_CONFLICT:
+        return "ESP_ERR_OTA_PARTITION_CONFLICT";
+    case ESP_ERR_OTA_VALIDATE_FAILED:
+        return "ESP_ERR_OTA_VALIDATE_FAILED";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+void EspClass::restart()
+{
+    esp_restart();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// Host stand-in for the ESP32 Arduino core, only what the firmware modules
+// built in the native environment use. Time is the host's monotonic clock.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "WString.h"
+#include "Print.h"
+#include "HardwareSerial.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define PROGMEM
+#define IRAM_ATTR
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// Pins do not exist on the host, writes are dropped and reads are LOW
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+class EspClass
+{
+public:
+    // There is nothing to restart into, the host process ends instead
+    [[noreturn]] void restart();
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMinFreeHeap() { return 0; }
+    uint32_t getHeapSize() { return 0; }
+    uint32_t getMaxAllocHeap() { return 0; }
+    const char *getChipModel() { return "host"; }
+};
+
+extern EspClass ESP;
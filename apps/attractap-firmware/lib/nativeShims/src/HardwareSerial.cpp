@@ -0,0 +1,94 @@
+#include "HardwareSerial.h"
+
+#include <string.h>
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return this->write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->muted)
+    {
+        fwrite(buffer, 1, size, stdout);
+    }
+    if (this->sink != nullptr)
+    {
+        this->sink->append((const char *)buffer, size);
+    }
+    return size;
+}
+
+void HardwareSerial::flush()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    fflush(stdout);
+}
+
+int HardwareSerial::available()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return (int)this->inputLength;
+}
+
+int HardwareSerial::read()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->inputLength == 0)
+    {
+        return -1;
+    }
+    return this->takeInput();
+}
+
+int HardwareSerial::peek()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->inputLength == 0 ? -1 : this->input[this->inputStart];
+}
+
+size_t HardwareSerial::readBytes(uint8_t *buffer, size_t length)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    size_t count = 0;
+    while (count < length && this->inputLength > 0)
+    {
+        buffer[count++] = this->takeInput();
+    }
+    return count;
+}
+
+void HardwareSerial::mute(bool muted)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->muted = muted;
+}
+
+void HardwareSerial::inject(const char *data)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    // Like a UART FIFO, bytes that do not fit are lost
+    for (size_t i = 0; data[i] != '\0' && this->inputLength < INPUT_SIZE; i++)
+    {
+        this->input[(this->inputStart + this->inputLength++) % INPUT_SIZE] = (uint8_t)data[i];
+    }
+}
+
+void HardwareSerial::capture(std::string *sink)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->sink = sink;
+}
+
+uint8_t HardwareSerial::takeInput()
+{
+    uint8_t c = this->input[this->inputStart];
+    this->inputStart = (this->inputStart + 1) % INPUT_SIZE;
+    this->inputLength--;
+    return c;
+}
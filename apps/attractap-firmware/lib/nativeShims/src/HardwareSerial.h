@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include "Print.h"
+
+// Serial port of the host build: output goes to stdout unless muted, input
+// is whatever a test queued with inject()
+class HardwareSerial : public Print
+{
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end() {}
+    operator bool() const { return true; }
+
+    using Print::write;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    void flush();
+
+    int available();
+    int read();
+    int peek();
+    size_t readBytes(uint8_t *buffer, size_t length);
+    size_t readBytes(char *buffer, size_t length) { return this->readBytes((uint8_t *)buffer, length); }
+
+    // Host only: drop all output, e.g. to keep benchmark logs quiet
+    void mute(bool muted);
+    // Host only: queue bytes to be read back through available()/read()
+    void inject(const char *data);
+    // Host only: also append all output to sink (muted or not), nullptr stops
+    void capture(std::string *sink);
+
+private:
+    static constexpr size_t INPUT_SIZE = 4096;
+
+    // Constant initialized, Loggers print while the program is still being initialized
+    std::mutex mutex;
+    bool muted = false;
+    std::string *sink = nullptr;
+    uint8_t input[INPUT_SIZE] = {};
+    size_t inputStart = 0;
+    size_t inputLength = 0;
+
+    uint8_t takeInput();
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
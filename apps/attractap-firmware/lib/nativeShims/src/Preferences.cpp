@@ -0,0 +1,177 @@
+#include "Preferences.h"
+
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using Namespace = std::map<std::string, std::vector<uint8_t>>;
+
+    // Function statics, Logger instances open their namespace during static initialization
+    std::mutex &storeMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::map<std::string, Namespace> &store()
+    {
+        static std::map<std::string, Namespace> namespaces;
+        return namespaces;
+    }
+
+    // NVS limits namespace and key names to 15 characters
+    bool validName(const char *name)
+    {
+        return name != nullptr && name[0] != '\0' && strlen(name) <= 15;
+    }
+}
+
+bool Preferences::begin(const char *name, bool readOnly, const char *partitionLabel)
+{
+    (void)partitionLabel;
+    if (this->started || !validName(name))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(storeMutex());
+    if (readOnly && store().find(name) == store().end())
+    {
+        return false;
+    }
+    store()[name];
+    this->name = name;
+    this->readOnly = readOnly;
+    this->started = true;
+    return true;
+}
+
+void Preferences::end()
+{
+    this->started = false;
+}
+
+bool Preferences::clear()
+{
+    if (!this->started || this->readOnly)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(storeMutex());
+    store()[this->name.c_str()].clear();
+    return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+    if (!this->started || this->readOnly || key == nullptr)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(storeMutex());
+    return store()[this->name.c_str()].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char *key)
+{
+    if (!this->started || key == nullptr)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(storeMutex());
+    Namespace &entries = store()[this->name.c_str()];
+    return entries.find(key) != entries.end();
+}
+
+size_t Preferences::putValue(const char *key, const void *value, size_t length)
+{
+    if (!this->started || this->readOnly || !validName(key))
+    {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(storeMutex());
+    const uint8_t *bytes = (const uint8_t *)value;
+    store()[this->name.c_str()][key].assign(bytes, bytes + length);
+    return length;
+}
+
+bool Preferences::readValue(const char *key, void *value, size_t length)
+{
+    if (!this->started || key == nullptr)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(storeMutex());
+    Namespace &entries = store()[this->name.c_str()];
+    auto entry = entries.find(key);
+    if (entry == entries.end() || entry->second.size() != length)
+    {
+        return false;
+    }
+    memcpy(value, entry->second.data(), length);
+    return true;
+}
+
+size_t Preferences::putString(const char *key, const char *value)
+{
+    if (value == nullptr)
+    {
+        return 0;
+    }
+    // Stored with its terminator, as NVS does
+    return this->putValue(key, value, strlen(value) + 1) > 0 ? strlen(value) : 0;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length)
+{
+    if (value == nullptr || length == 0)
+    {
+        return 0;
+    }
+    return this->putValue(key, value, length);
+}
+
+String Preferences::getString(const char *key, const String defaultValue)
+{
+    size_t length = this->getBytesLength(key);
+    if (length == 0)
+    {
+        return defaultValue;
+    }
+    std::vector<char> buffer(length);
+    this->readValue(key, buffer.data(), length);
+    buffer[length - 1] = '\0';
+    return String(buffer.data());
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+    if (!this->started || key == nullptr)
+    {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(storeMutex());
+    Namespace &entries = store()[this->name.c_str()];
+    auto entry = entries.find(key);
+    return entry == entries.end() ? 0 : entry->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t maxLength)
+{
+    size_t length = this->getBytesLength(key);
+    if (length == 0 || length > maxLength)
+    {
+        return 0;
+    }
+    return this->readValue(key, buffer, length) ? length : 0;
+}
+
+void Preferences::eraseAll()
+{
+    std::lock_guard<std::mutex> lock(storeMutex());
+    store().clear();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "WString.h"
+
+// NVS stand-in: namespaces live in memory for the lifetime of the process
+// and are shared by every Preferences instance, like the flash partition.
+class Preferences
+{
+public:
+    ~Preferences() { this->end(); }
+
+    bool begin(const char *name, bool readOnly = false, const char *partitionLabel = nullptr);
+    void end();
+
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+
+    size_t putBool(const char *key, bool value) { return this->putValue(key, &value, sizeof(value)); }
+    size_t putUChar(const char *key, uint8_t value) { return this->putValue(key, &value, sizeof(value)); }
+    size_t putUShort(const char *key, uint16_t value) { return this->putValue(key, &value, sizeof(value)); }
+    size_t putInt(const char *key, int32_t value) { return this->putValue(key, &value, sizeof(value)); }
+    size_t putUInt(const char *key, uint32_t value) { return this->putValue(key, &value, sizeof(value)); }
+    size_t putULong64(const char *key, uint64_t value) { return this->putValue(key, &value, sizeof(value)); }
+    size_t putString(const char *key, const char *value);
+    size_t putString(const char *key, const String &value) { return this->putString(key, value.c_str()); }
+    size_t putBytes(const char *key, const void *value, size_t length);
+
+    bool getBool(const char *key, bool defaultValue = false) { return this->getValue(key, defaultValue); }
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0) { return this->getValue(key, defaultValue); }
+    uint16_t getUShort(const char *key, uint16_t defaultValue = 0) { return this->getValue(key, defaultValue); }
+    int32_t getInt(const char *key, int32_t defaultValue = 0) { return this->getValue(key, defaultValue); }
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0) { return this->getValue(key, defaultValue); }
+    uint64_t getULong64(const char *key, uint64_t defaultValue = 0) { return this->getValue(key, defaultValue); }
+    String getString(const char *key, const String defaultValue = String());
+    size_t getBytesLength(const char *key);
+    size_t getBytes(const char *key, void *buffer, size_t maxLength);
+
+    // Host only: forget every namespace, as after erasing the nvs partition
+    static void eraseAll();
+
+private:
+    size_t putValue(const char *key, const void *value, size_t length);
+    bool readValue(const char *key, void *value, size_t length);
+
+    template <typename T>
+    T getValue(const char *key, T defaultValue)
+    {
+        T value;
+        return this->readValue(key, &value, sizeof(value)) ? value : defaultValue;
+    }
+
+    String name;
+    bool started = false;
+    bool readOnly = false;
+};
@@ -0,0 +1,63 @@
+#include "Print.h"
+
+#include <stdio.h>
+#include <string.h>
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        written += this->write(buffer[i]);
+    }
+    return written;
+}
+
+size_t Print::write(const char *text)
+{
+    if (text == nullptr)
+    {
+        return 0;
+    }
+    return this->write((const uint8_t *)text, strlen(text));
+}
+
+size_t Print::printf(const char *format, ...)
+{
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (length < 0)
+    {
+        return 0;
+    }
+    return this->write(buffer, (size_t)length < sizeof(buffer) ? (size_t)length : sizeof(buffer) - 1);
+}
+
+size_t Print::print(long value, int base)
+{
+    return this->print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+    return this->print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(long long value, int base)
+{
+    return this->print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long long value, int base)
+{
+    return this->print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(double value, int decimals)
+{
+    return this->print(String(value, (unsigned int)decimals));
+}
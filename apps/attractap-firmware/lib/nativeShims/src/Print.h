@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text);
+    size_t write(const char *buffer, size_t size) { return this->write((const uint8_t *)buffer, size); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t print(const __FlashStringHelper *text) { return this->write(reinterpret_cast<const char *>(text)); }
+    size_t print(const String &text) { return this->write(text.c_str(), text.length()); }
+    size_t print(const char *text) { return this->write(text); }
+    size_t print(char c) { return this->write((uint8_t)c); }
+    size_t print(unsigned char value, int base = DEC) { return this->print((unsigned long)value, base); }
+    size_t print(int value, int base = DEC) { return this->print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return this->print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(long long value, int base = DEC);
+    size_t print(unsigned long long value, int base = DEC);
+    size_t print(double value, int decimals = 2);
+
+    size_t println(void) { return this->write("\r\n"); }
+    template <typename T>
+    size_t println(const T &value)
+    {
+        size_t written = this->print(value);
+        return written + this->println();
+    }
+    template <typename T>
+    size_t println(const T &value, int format)
+    {
+        size_t written = this->print(value, format);
+        return written + this->println();
+    }
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x01
+#define SPI_MODE2 0x02
+#define SPI_MODE3 0x03
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+// SPI stand-in: nothing is connected, MISO reads back zeros
+class SPIClass
+{
+public:
+    void begin() {}
+    void end() {}
+    uint8_t transfer(uint8_t data)
+    {
+        (void)data;
+        return 0;
+    }
+};
+
+extern SPIClass SPI;
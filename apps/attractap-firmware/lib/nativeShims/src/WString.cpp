@@ -0,0 +1,219 @@
+#include "WString.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static std::string formatUnsigned(unsigned long long value, unsigned char base)
+{
+    if (base < 2 || base > 36)
+    {
+        base = 10;
+    }
+
+    char buffer[65];
+    size_t position = sizeof(buffer);
+    buffer[--position] = '\0';
+    do
+    {
+        unsigned digit = value % base;
+        // Lowercase like utoa() behind the ESP32 core's String(value, HEX)
+        buffer[--position] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+        value /= base;
+    } while (value != 0);
+    return std::string(buffer + position);
+}
+
+static std::string formatSigned(long long value, unsigned char base)
+{
+    if (value < 0 && base == 10)
+    {
+        return "-" + formatUnsigned(0ULL - (unsigned long long)value, base);
+    }
+    return formatUnsigned((unsigned long long)value, base);
+}
+
+static std::string formatFloat(double value, unsigned int decimals)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, value);
+    return buffer;
+}
+
+String::String(unsigned char value, unsigned char base) : value(formatUnsigned(value, base)) {}
+String::String(int value, unsigned char base) : value(formatSigned(value, base)) {}
+String::String(unsigned int value, unsigned char base) : value(formatUnsigned(value, base)) {}
+String::String(long value, unsigned char base) : value(formatSigned(value, base)) {}
+String::String(unsigned long value, unsigned char base) : value(formatUnsigned(value, base)) {}
+String::String(long long value, unsigned char base) : value(formatSigned(value, base)) {}
+String::String(unsigned long long value, unsigned char base) : value(formatUnsigned(value, base)) {}
+String::String(float value, unsigned int decimals) : value(formatFloat(value, decimals)) {}
+String::String(double value, unsigned int decimals) : value(formatFloat(value, decimals)) {}
+
+bool String::equalsIgnoreCase(const String &other) const
+{
+    if (this->value.length() != other.value.length())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < this->value.length(); i++)
+    {
+        if (tolower((unsigned char)this->value[i]) != tolower((unsigned char)other.value[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+    return this->value.length() >= suffix.value.length() &&
+           this->value.compare(this->value.length() - suffix.value.length(), suffix.value.length(), suffix.value) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+    size_t position = this->value.find(c, from);
+    return position == std::string::npos ? -1 : (int)position;
+}
+
+int String::indexOf(const String &other, unsigned int from) const
+{
+    size_t position = this->value.find(other.value, from);
+    return position == std::string::npos ? -1 : (int)position;
+}
+
+int String::lastIndexOf(char c) const
+{
+    size_t position = this->value.rfind(c);
+    return position == std::string::npos ? -1 : (int)position;
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+    // Arduino swaps reversed bounds and clamps both to the length
+    if (from > to)
+    {
+        unsigned int swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from >= this->value.length())
+    {
+        return String();
+    }
+    if (to > this->value.length())
+    {
+        to = this->value.length();
+    }
+    return String(this->value.c_str() + from, to - from);
+}
+
+void String::trim()
+{
+    size_t begin = 0;
+    size_t end = this->value.length();
+    while (begin < end && isspace((unsigned char)this->value[begin]))
+    {
+        begin++;
+    }
+    while (end > begin && isspace((unsigned char)this->value[end - 1]))
+    {
+        end--;
+    }
+    this->value = this->value.substr(begin, end - begin);
+}
+
+void String::toUpperCase()
+{
+    for (char &c : this->value)
+    {
+        c = toupper((unsigned char)c);
+    }
+}
+
+void String::toLowerCase()
+{
+    for (char &c : this->value)
+    {
+        c = tolower((unsigned char)c);
+    }
+}
+
+void String::replace(const String &find, const String &replacement)
+{
+    if (find.value.empty())
+    {
+        return;
+    }
+
+    size_t position = 0;
+    while ((position = this->value.find(find.value, position)) != std::string::npos)
+    {
+        this->value.replace(position, find.value.length(), replacement.value);
+        position += replacement.value.length();
+    }
+}
+
+void String::remove(unsigned int index, unsigned int count)
+{
+    if (index < this->value.length())
+    {
+        this->value.erase(index, count);
+    }
+}
+
+long String::toInt() const
+{
+    return strtol(this->value.c_str(), nullptr, 10);
+}
+
+void String::getBytes(unsigned char *buffer, unsigned int size, unsigned int index) const
+{
+    if (buffer == nullptr || size == 0)
+    {
+        return;
+    }
+
+    size_t length = 0;
+    if (index < this->value.length())
+    {
+        length = this->value.length() - index;
+        if (length > size - 1)
+        {
+            length = size - 1;
+        }
+        memcpy(buffer, this->value.c_str() + index, length);
+    }
+    buffer[length] = '\0';
+}
+
+String operator+(const String &left, const String &right)
+{
+    String result(left);
+    result.concat(right);
+    return result;
+}
+
+String operator+(const String &left, const char *right)
+{
+    String result(left);
+    result.concat(right);
+    return result;
+}
+
+String operator+(const char *left, const String &right)
+{
+    String result(left);
+    result.concat(right);
+    return result;
+}
+
+String operator+(const String &left, char right)
+{
+    String result(left);
+    result.concat(right);
+    return result;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class __FlashStringHelper;
+
+// The subset of the Arduino String API the firmware uses, backed by std::string
+class String
+{
+public:
+    String() {}
+    String(const char *value) : value(value != nullptr ? value : "") {}
+    String(const char *value, size_t length) : value(value != nullptr ? value : "", value != nullptr ? length : 0) {}
+    String(const __FlashStringHelper *value) : String(reinterpret_cast<const char *>(value)) {}
+    explicit String(char value) : value(1, value) {}
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned int decimals = 2);
+    explicit String(double value, unsigned int decimals = 2);
+
+    String &operator=(const char *other)
+    {
+        this->value = other != nullptr ? other : "";
+        return *this;
+    }
+
+    const char *c_str() const { return this->value.c_str(); }
+    unsigned int length() const { return (unsigned int)this->value.length(); }
+    bool isEmpty() const { return this->value.empty(); }
+    bool reserve(unsigned int size)
+    {
+        this->value.reserve(size);
+        return true;
+    }
+
+    bool concat(const String &other)
+    {
+        this->value += other.value;
+        return true;
+    }
+    bool concat(const char *other)
+    {
+        if (other == nullptr)
+        {
+            return false;
+        }
+        this->value += other;
+        return true;
+    }
+    bool concat(const char *other, unsigned int length)
+    {
+        if (other == nullptr)
+        {
+            return false;
+        }
+        this->value.append(other, length);
+        return true;
+    }
+    bool concat(char other)
+    {
+        this->value += other;
+        return true;
+    }
+    bool concat(int other) { return this->concat(String(other)); }
+    bool concat(unsigned int other) { return this->concat(String(other)); }
+    bool concat(long other) { return this->concat(String(other)); }
+    bool concat(unsigned long other) { return this->concat(String(other)); }
+
+    template <typename T>
+    String &operator+=(const T &other)
+    {
+        this->concat(other);
+        return *this;
+    }
+
+    bool equals(const String &other) const { return this->value == other.value; }
+    bool equals(const char *other) const { return this->value == (other != nullptr ? other : ""); }
+    bool equalsIgnoreCase(const String &other) const;
+    bool operator==(const String &other) const { return this->equals(other); }
+    bool operator==(const char *other) const { return this->equals(other); }
+    bool operator!=(const String &other) const { return !this->equals(other); }
+    bool operator!=(const char *other) const { return !this->equals(other); }
+    bool operator<(const String &other) const { return this->value < other.value; }
+    bool startsWith(const String &prefix) const { return this->value.compare(0, prefix.value.length(), prefix.value) == 0; }
+    bool endsWith(const String &suffix) const;
+
+    char charAt(unsigned int index) const { return index < this->value.length() ? this->value[index] : 0; }
+    char operator[](unsigned int index) const { return this->charAt(index); }
+    char &operator[](unsigned int index) { return this->value[index]; }
+
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const String &other, unsigned int from = 0) const;
+    int lastIndexOf(char c) const;
+    String substring(unsigned int from) const { return this->substring(from, this->length()); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    void trim();
+    void toUpperCase();
+    void toLowerCase();
+    void replace(const String &find, const String &replacement);
+    void remove(unsigned int index, unsigned int count = (unsigned int)-1);
+    long toInt() const;
+    void getBytes(unsigned char *buffer, unsigned int size, unsigned int index = 0) const;
+    void toCharArray(char *buffer, unsigned int size, unsigned int index = 0) const
+    {
+        this->getBytes((unsigned char *)buffer, size, index);
+    }
+
+private:
+    std::string value;
+};
+
+String operator+(const String &left, const String &right);
+String operator+(const String &left, const char *right);
+String operator+(const char *left, const String &right);
+String operator+(const String &left, char right);
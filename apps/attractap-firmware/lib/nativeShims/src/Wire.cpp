@@ -0,0 +1,102 @@
+#include "Wire.h"
+
+#include <string.h>
+
+TwoWire Wire;
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+    this->txAddress = address;
+    this->txLength = 0;
+    this->txOverflow = false;
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+    (void)sendStop;
+    TwoWireDevice *device = this->deviceAt(this->txAddress);
+    if (device == nullptr || this->txOverflow)
+    {
+        return 2;
+    }
+    // 3 is "NACK on data"
+    return device->onWrite(this->txBuffer, this->txLength) ? 0 : 3;
+}
+
+size_t TwoWire::write(const uint8_t *buffer, size_t length)
+{
+    size_t room = I2C_BUFFER_LENGTH - this->txLength;
+    if (length > room)
+    {
+        this->txOverflow = true;
+        length = room;
+    }
+    memcpy(this->txBuffer + this->txLength, buffer, length);
+    this->txLength += length;
+    return length;
+}
+
+size_t TwoWire::requestFrom(uint8_t address, size_t length, bool sendStop)
+{
+    (void)sendStop;
+    this->rxLength = 0;
+    this->rxIndex = 0;
+    TwoWireDevice *device = this->deviceAt(address);
+    if (device == nullptr || length > I2C_BUFFER_LENGTH)
+    {
+        return 0;
+    }
+    this->rxLength = device->onRead(this->rxBuffer, length);
+    return this->rxLength;
+}
+
+int TwoWire::read()
+{
+    if (this->rxIndex >= this->rxLength)
+    {
+        return -1;
+    }
+    this->bytesRead++;
+    return this->rxBuffer[this->rxIndex++];
+}
+
+size_t TwoWire::readBytes(uint8_t *buffer, size_t length)
+{
+    size_t count = this->rxLength - this->rxIndex < length ? this->rxLength - this->rxIndex : length;
+    memcpy(buffer, this->rxBuffer + this->rxIndex, count);
+    this->rxIndex += count;
+    this->bytesRead += count;
+    return count;
+}
+
+void TwoWire::attach(uint8_t address, TwoWireDevice *device)
+{
+    for (Attached &attached : this->devices)
+    {
+        if (attached.device != nullptr && attached.address == address)
+        {
+            attached.device = device;
+            return;
+        }
+    }
+    for (Attached &attached : this->devices)
+    {
+        if (attached.device == nullptr)
+        {
+            attached = {address, device};
+            return;
+        }
+    }
+}
+
+TwoWireDevice *TwoWire::deviceAt(uint8_t address) const
+{
+    for (const Attached &attached : this->devices)
+    {
+        if (attached.device != nullptr && attached.address == address)
+        {
+            return attached.device;
+        }
+    }
+    return nullptr;
+}
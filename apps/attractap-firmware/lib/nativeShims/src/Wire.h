@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Same as the ESP32 core, longer transfers are refused
+#define I2C_BUFFER_LENGTH 128
+
+// Host only: model of a device on the bus, see TwoWire::attach()
+class TwoWireDevice
+{
+public:
+    virtual ~TwoWireDevice() {}
+
+    // One write transaction, false NACKs it
+    virtual bool onWrite(const uint8_t *data, size_t length) = 0;
+    // One read transaction of length bytes, returns how many the device sent
+    virtual size_t onRead(uint8_t *data, size_t length) = 0;
+};
+
+// I2C stand-in: the host has no bus, addresses without an attached device
+// model NACK and reads from them return nothing
+class TwoWire
+{
+public:
+    bool begin() { return true; }
+    void setClock(uint32_t frequency) { (void)frequency; }
+
+    void beginTransmission(uint8_t address);
+    // 2 is the Arduino "NACK on address" result
+    uint8_t endTransmission(bool sendStop = true);
+    size_t write(uint8_t data) { return this->write(&data, 1); }
+    size_t write(const uint8_t *buffer, size_t length);
+
+    size_t requestFrom(uint8_t address, size_t length, bool sendStop = true);
+    int available() { return (int)(this->rxLength - this->rxIndex); }
+    int read();
+    size_t readBytes(uint8_t *buffer, size_t length);
+
+    // Host only: answer transactions to address with device, nullptr detaches
+    void attach(uint8_t address, TwoWireDevice *device);
+    // Host only: bytes handed out by read()/readBytes() since the start
+    uint32_t getBytesRead() const { return this->bytesRead; }
+
+private:
+    static const uint8_t MAX_DEVICES = 4;
+
+    struct Attached
+    {
+        uint8_t address;
+        TwoWireDevice *device;
+    };
+
+    Attached devices[MAX_DEVICES] = {};
+    uint8_t txAddress = 0;
+    uint8_t txBuffer[I2C_BUFFER_LENGTH] = {};
+    size_t txLength = 0;
+    bool txOverflow = false;
+    uint8_t rxBuffer[I2C_BUFFER_LENGTH] = {};
+    size_t rxLength = 0;
+    size_t rxIndex = 0;
+    uint32_t bytesRead = 0;
+
+    TwoWireDevice *deviceAt(uint8_t address) const;
+};
+
+extern TwoWire Wire;
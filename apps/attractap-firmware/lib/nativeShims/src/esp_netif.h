@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+#define esp_ip4_addr_get_byte(ipaddr, idx) (((const uint8_t *)(&(ipaddr)->addr))[idx])
+#define esp_ip4_addr1(ipaddr) esp_ip4_addr_get_byte(ipaddr, 0)
+#define esp_ip4_addr2(ipaddr) esp_ip4_addr_get_byte(ipaddr, 1)
+#define esp_ip4_addr3(ipaddr) esp_ip4_addr_get_byte(ipaddr, 2)
+#define esp_ip4_addr4(ipaddr) esp_ip4_addr_get_byte(ipaddr, 3)
+
+#define IPSTR "%d.%d.%d.%d"
+#define IP2STR(ipaddr) esp_ip4_addr1(ipaddr), esp_ip4_addr2(ipaddr), esp_ip4_addr3(ipaddr), esp_ip4_addr4(ipaddr)
@@ -0,0 +1,127 @@
+#include "esp_ota_ops.h"
+
+#include <mutex>
+
+namespace
+{
+    std::mutex otaMutex;
+    const esp_partition_t *bootPartition = nullptr;
+
+    // One update at a time, like the firmware does
+    const esp_ota_handle_t HANDLE = 1;
+    const esp_partition_t *updatePartition = nullptr;
+    size_t written = 0;
+
+    const esp_partition_t *runningPartition()
+    {
+        return esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, nullptr);
+    }
+}
+
+extern "C" const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return runningPartition();
+}
+
+extern "C" const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    (void)start_from;
+    return esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, nullptr);
+}
+
+extern "C" const esp_partition_t *esp_ota_get_boot_partition(void)
+{
+    std::lock_guard<std::mutex> lock(otaMutex);
+    return bootPartition != nullptr ? bootPartition : runningPartition();
+}
+
+extern "C" esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    if (partition == nullptr || out_handle == nullptr || partition->type != ESP_PARTITION_TYPE_APP)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (partition == runningPartition())
+    {
+        return ESP_ERR_OTA_PARTITION_CONFLICT;
+    }
+    if (image_size != OTA_SIZE_UNKNOWN && image_size != OTA_WITH_SEQUENTIAL_WRITES && image_size > partition->size)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    std::lock_guard<std::mutex> lock(otaMutex);
+    if (updatePartition != nullptr)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Sequential writes erase sector by sector on the way, the result is the same
+    esp_err_t err = esp_partition_erase_range(partition, 0, partition->size);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    updatePartition = partition;
+    written = 0;
+    *out_handle = HANDLE;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(otaMutex);
+    if (handle != HANDLE || updatePartition == nullptr)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = esp_partition_write(updatePartition, written, data, size);
+    if (err == ESP_OK)
+    {
+        written += size;
+    }
+    return err;
+}
+
+extern "C" esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(otaMutex);
+    if (handle != HANDLE || updatePartition == nullptr)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    bool empty = written == 0;
+    updatePartition = nullptr;
+    return empty ? ESP_ERR_OTA_VALIDATE_FAILED : ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(otaMutex);
+    if (handle != HANDLE || updatePartition == nullptr)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    updatePartition = nullptr;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    if (partition == nullptr || partition->type != ESP_PARTITION_TYPE_APP)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    std::lock_guard<std::mutex> lock(otaMutex);
+    bootPartition = partition;
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_ota_mark_app_valid_cancel_rollback(void)
+{
+    return ESP_OK;
+}
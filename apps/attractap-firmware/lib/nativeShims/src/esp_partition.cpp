@@ -0,0 +1,125 @@
+#include "esp_partition.h"
+#include "esp_spi_flash.h"
+
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    const esp_partition_t PARTITIONS[] = {
+        {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, 0x9000, 0x6000, "nvs", false},
+        {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_PHY, 0xf000, 0x1000, "phy_init", false},
+        {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, 0x1E0000, "app0", false},
+        {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x1F0000, 0x1E0000, "app1", false},
+        {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_OTA, 0x3D0000, 0x2000, "otadata", false},
+        {ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 0x3D2000, 0x2E000, "spiffs", false},
+    };
+    const size_t PARTITION_COUNT = sizeof(PARTITIONS) / sizeof(PARTITIONS[0]);
+
+    std::mutex flashMutex;
+    // Allocated erased on first access, the app partitions are rarely touched
+    std::vector<uint8_t> contents[PARTITION_COUNT];
+
+    std::vector<uint8_t> *contentsOf(const esp_partition_t *partition)
+    {
+        for (size_t i = 0; i < PARTITION_COUNT; i++)
+        {
+            if (partition == &PARTITIONS[i])
+            {
+                if (contents[i].empty())
+                {
+                    contents[i].assign(partition->size, 0xFF);
+                }
+                return &contents[i];
+            }
+        }
+        return nullptr;
+    }
+
+    bool inRange(const esp_partition_t *partition, size_t offset, size_t size)
+    {
+        return offset <= partition->size && size <= partition->size - offset;
+    }
+}
+
+extern "C" const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    for (const esp_partition_t &partition : PARTITIONS)
+    {
+        if (type != ESP_PARTITION_TYPE_ANY && partition.type != type)
+        {
+            continue;
+        }
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && partition.subtype != subtype)
+        {
+            continue;
+        }
+        if (label != nullptr && strcmp(partition.label, label) != 0)
+        {
+            continue;
+        }
+        return &partition;
+    }
+    return nullptr;
+}
+
+extern "C" esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    std::lock_guard<std::mutex> lock(flashMutex);
+    std::vector<uint8_t> *flash = contentsOf(partition);
+    if (flash == nullptr || dst == nullptr)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!inRange(partition, src_offset, size))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy(dst, flash->data() + src_offset, size);
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    std::lock_guard<std::mutex> lock(flashMutex);
+    std::vector<uint8_t> *flash = contentsOf(partition);
+    if (flash == nullptr || src == nullptr)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!inRange(partition, dst_offset, size))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Programming can only clear bits
+    const uint8_t *bytes = (const uint8_t *)src;
+    for (size_t i = 0; i < size; i++)
+    {
+        (*flash)[dst_offset + i] &= bytes[i];
+    }
+    return ESP_OK;
+}
+
+extern "C" esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    std::lock_guard<std::mutex> lock(flashMutex);
+    std::vector<uint8_t> *flash = contentsOf(partition);
+    if (flash == nullptr)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!inRange(partition, offset, size))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memset(flash->data() + offset, 0xFF, size);
+    return ESP_OK;
+}
@@ -0,0 +1,65 @@
+#include "event_groups.h"
+
+#include "waitUntil.hpp"
+
+struct EventGroupDef_t
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return new EventGroupDef_t();
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, const EventBits_t bitsToSet)
+{
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bitsToSet;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, const EventBits_t bitsToClear)
+{
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t before = group->bits;
+    group->bits &= ~bitsToClear;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, const EventBits_t bitsToWaitFor, const BaseType_t clearOnExit, const BaseType_t waitForAllBits, TickType_t ticksToWait)
+{
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto satisfied = [group, bitsToWaitFor, waitForAllBits]()
+    {
+        EventBits_t matched = group->bits & bitsToWaitFor;
+        return waitForAllBits ? matched == bitsToWaitFor : matched != 0;
+    };
+
+    if (!waitUntil(group->changed, lock, ticksToWait, satisfied))
+    {
+        // Like FreeRTOS, a timeout returns the current bits without clearing any
+        return group->bits;
+    }
+
+    EventBits_t seen = group->bits;
+    if (clearOnExit)
+    {
+        group->bits &= ~bitsToWaitFor;
+    }
+    return seen;
+}
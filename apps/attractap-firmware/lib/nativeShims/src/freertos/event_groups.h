@@ -0,0 +1,18 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct EventGroupDef_t *EventGroupHandle_t;
+typedef TickType_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+void vEventGroupDelete(EventGroupHandle_t group);
+
+// Return the bits as they were right after the call, before any waiter cleared them
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, const EventBits_t bitsToSet);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, const EventBits_t bitsToClear);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, const EventBits_t bitsToWaitFor, const BaseType_t clearOnExit, const BaseType_t waitForAllBits, TickType_t ticksToWait);
+
+#define xEventGroupSetBitsFromISR(group, bits, woken) xEventGroupSetBits(group, bits)
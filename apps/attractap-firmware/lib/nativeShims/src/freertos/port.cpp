@@ -0,0 +1,164 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "waitUntil.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+
+namespace
+{
+    std::recursive_mutex &criticalMutex()
+    {
+        static std::recursive_mutex mutex;
+        return mutex;
+    }
+
+    std::chrono::steady_clock::time_point schedulerStart()
+    {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return start;
+    }
+
+    // Thrown by vTaskDelete(NULL) to unwind the task thread back to its entry point
+    struct TaskDeleted
+    {
+    };
+
+    thread_local TaskHandle_t currentTask = nullptr;
+}
+
+struct tskTaskControlBlock
+{
+    TaskFunction_t function;
+    void *parameters;
+    char name[16];
+
+    std::mutex notifyMutex;
+    std::condition_variable notified;
+    uint32_t notifications = 0;
+};
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    criticalMutex().lock();
+    mux->count++;
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    mux->count--;
+    criticalMutex().unlock();
+}
+
+void vPortYield(void)
+{
+    std::this_thread::yield();
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameters, UBaseType_t priority, TaskHandle_t *createdTask)
+{
+    (void)stackDepth;
+    (void)priority;
+
+    TaskHandle_t task = new tskTaskControlBlock();
+    task->function = function;
+    task->parameters = parameters;
+    snprintf(task->name, sizeof(task->name), "%s", name != nullptr ? name : "");
+
+    if (createdTask != nullptr)
+    {
+        *createdTask = task;
+    }
+
+    std::thread([task]()
+                {
+        currentTask = task;
+        try
+        {
+            task->function(task->parameters);
+        }
+        catch (const TaskDeleted &)
+        {
+        } })
+        .detach();
+
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameters, UBaseType_t priority, TaskHandle_t *createdTask, BaseType_t coreId)
+{
+    (void)coreId;
+    return xTaskCreate(function, name, stackDepth, parameters, priority, createdTask);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == nullptr || task == currentTask)
+    {
+        throw TaskDeleted();
+    }
+    // Other tasks cannot be stopped from outside their thread
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(pdTICKS_TO_MS(ticks)));
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - schedulerStart()).count();
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait)
+{
+    // Threads that are no task (the test's main thread) have nobody to notify them
+    TaskHandle_t task = currentTask;
+    if (task == nullptr)
+    {
+        vTaskDelay(ticksToWait == portMAX_DELAY ? 0 : ticksToWait);
+        return 0;
+    }
+
+    std::unique_lock<std::mutex> lock(task->notifyMutex);
+    waitUntil(task->notified, lock, ticksToWait, [task]()
+              { return task->notifications > 0; });
+    uint32_t count = task->notifications;
+    if (count > 0)
+    {
+        task->notifications = clearCountOnExit ? 0 : count - 1;
+    }
+    return count;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    {
+        std::lock_guard<std::mutex> lock(task->notifyMutex);
+        task->notifications++;
+    }
+    task->notified.notify_one();
+    if (higherPriorityTaskWoken != nullptr)
+    {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return currentTask;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    (void)task;
+    return 0;
+}
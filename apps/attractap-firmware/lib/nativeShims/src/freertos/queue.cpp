@@ -0,0 +1,149 @@
+#include "queue.h"
+#include "semphr.h"
+
+#include <string.h>
+#include <deque>
+#include <vector>
+#include "waitUntil.hpp"
+
+struct QueueDefinition
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    if (length == 0)
+    {
+        return nullptr;
+    }
+    QueueHandle_t queue = new QueueDefinition();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+static BaseType_t queueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait, bool toFront)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitUntil(queue->changed, lock, ticksToWait, [queue]()
+                   { return queue->items.size() < queue->length; }))
+    {
+        return pdFAIL;
+    }
+
+    std::vector<uint8_t> copy(queue->itemSize);
+    if (queue->itemSize > 0)
+    {
+        memcpy(copy.data(), item, queue->itemSize);
+    }
+    if (toFront)
+    {
+        queue->items.push_front(std::move(copy));
+    }
+    else
+    {
+        queue->items.push_back(std::move(copy));
+    }
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait)
+{
+    return queueSend(queue, item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticksToWait)
+{
+    return queueSend(queue, item, ticksToWait, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->items.clear();
+    }
+    return queueSend(queue, item, 0, false);
+}
+
+static BaseType_t queueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait, bool remove)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitUntil(queue->changed, lock, ticksToWait, [queue]()
+                   { return !queue->items.empty(); }))
+    {
+        return pdFAIL;
+    }
+
+    if (queue->itemSize > 0 && buffer != nullptr)
+    {
+        memcpy(buffer, queue->items.front().data(), queue->itemSize);
+    }
+    if (remove)
+    {
+        queue->items.pop_front();
+        queue->changed.notify_all();
+    }
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait)
+{
+    return queueReceive(queue, buffer, ticksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticksToWait)
+{
+    return queueReceive(queue, buffer, ticksToWait, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return (UBaseType_t)queue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->length - (UBaseType_t)queue->items.size();
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->items.clear();
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+    SemaphoreHandle_t semaphore = xQueueCreate(maxCount, 0);
+    for (UBaseType_t i = 0; semaphore != nullptr && i < initialCount; i++)
+    {
+        xQueueSend(semaphore, nullptr, 0);
+    }
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
@@ -0,0 +1,239 @@
+#include "ringbuf.h"
+
+#include <string.h>
+#include <deque>
+#include <vector>
+#include "waitUntil.hpp"
+
+namespace
+{
+    constexpr size_t HEADER_SIZE = 8;
+
+    size_t alignUp(size_t length)
+    {
+        return (length + 3) & ~(size_t)3;
+    }
+
+    enum class ItemState
+    {
+        ACQUIRED,
+        WRITTEN,
+        RECEIVED,
+        RETURNED,
+    };
+
+    struct Item
+    {
+        size_t offset;
+        size_t length;
+        // Header plus aligned data plus whatever was skipped at the end of the buffer to place it
+        size_t span;
+        ItemState state;
+    };
+}
+
+struct RingbufferDefinition
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<uint8_t> storage;
+    // Oldest first; the front is released once it and everything before it were returned
+    std::deque<Item> items;
+    size_t write = 0;
+    size_t used = 0;
+    size_t maxItemSize = 0;
+
+    uint8_t *data(const Item &item) { return this->storage.data() + item.offset + HEADER_SIZE; }
+
+    Item *find(const void *pointer)
+    {
+        for (Item &item : this->items)
+        {
+            if (this->data(item) == pointer)
+            {
+                return &item;
+            }
+        }
+        return nullptr;
+    }
+
+    // Where an item needing `needed` bytes would start, and how much it wastes at the end
+    bool place(size_t needed, size_t &offset, size_t &skipped) const
+    {
+        size_t size = this->storage.size();
+        size_t tail = (this->write + size - this->used % size) % size;
+
+        if (this->used == 0)
+        {
+            offset = this->write + needed <= size ? this->write : 0;
+            skipped = offset == 0 ? (size - this->write) % size : 0;
+            return true;
+        }
+        if (this->used == size)
+        {
+            return false;
+        }
+        if (this->write < tail)
+        {
+            offset = this->write;
+            skipped = 0;
+            return tail - this->write >= needed;
+        }
+        if (size - this->write >= needed)
+        {
+            offset = this->write;
+            skipped = 0;
+            return true;
+        }
+        offset = 0;
+        skipped = size - this->write;
+        return tail >= needed;
+    }
+};
+
+RingbufHandle_t xRingbufferCreate(size_t bufferSize, RingbufferType_t type)
+{
+    size_t size = bufferSize & ~(size_t)3;
+    if (type != RINGBUF_TYPE_NOSPLIT || size < 2 * HEADER_SIZE + 4)
+    {
+        return nullptr;
+    }
+
+    RingbufHandle_t ring = new RingbufferDefinition();
+    ring->storage.assign(size, 0);
+    ring->maxItemSize = ((size / 2) & ~(size_t)3) - HEADER_SIZE;
+    return ring;
+}
+
+void vRingbufferDelete(RingbufHandle_t ring)
+{
+    delete ring;
+}
+
+size_t xRingbufferGetMaxItemSize(RingbufHandle_t ring)
+{
+    return ring->maxItemSize;
+}
+
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t ring)
+{
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    size_t best = 0;
+    for (size_t candidate = ring->maxItemSize & ~(size_t)3; candidate > 0; candidate -= 4)
+    {
+        size_t offset;
+        size_t skipped;
+        if (ring->place(HEADER_SIZE + candidate, offset, skipped))
+        {
+            best = candidate;
+            break;
+        }
+    }
+    return best;
+}
+
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t ring, void **item, size_t itemSize, TickType_t ticksToWait)
+{
+    if (itemSize > ring->maxItemSize)
+    {
+        return pdFALSE;
+    }
+
+    size_t needed = HEADER_SIZE + alignUp(itemSize);
+    size_t offset = 0;
+    size_t skipped = 0;
+    std::unique_lock<std::mutex> lock(ring->mutex);
+    if (!waitUntil(ring->changed, lock, ticksToWait, [&]()
+                   { return ring->place(needed, offset, skipped); }))
+    {
+        return pdFALSE;
+    }
+
+    // Mirrors the ESP-IDF layout: a dummy header marks a skipped tail when it fits
+    if (skipped >= HEADER_SIZE)
+    {
+        memset(ring->storage.data() + ring->write, 0xFF, HEADER_SIZE);
+    }
+    uint32_t header[2] = {(uint32_t)itemSize, 0};
+    memcpy(ring->storage.data() + offset, header, sizeof(header));
+
+    ring->items.push_back({offset, itemSize, skipped + needed, ItemState::ACQUIRED});
+    ring->used += skipped + needed;
+    ring->write = (offset + needed) % ring->storage.size();
+    *item = ring->data(ring->items.back());
+    return pdTRUE;
+}
+
+BaseType_t xRingbufferSendComplete(RingbufHandle_t ring, void *item)
+{
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    Item *entry = ring->find(item);
+    if (entry == nullptr || entry->state != ItemState::ACQUIRED)
+    {
+        return pdFALSE;
+    }
+    entry->state = ItemState::WRITTEN;
+    ring->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t ring, const void *item, size_t itemSize, TickType_t ticksToWait)
+{
+    void *slot = nullptr;
+    if (xRingbufferSendAcquire(ring, &slot, itemSize, ticksToWait) != pdTRUE)
+    {
+        return pdFALSE;
+    }
+    memcpy(slot, item, itemSize);
+    return xRingbufferSendComplete(ring, slot);
+}
+
+void *xRingbufferReceive(RingbufHandle_t ring, size_t *itemSize, TickType_t ticksToWait)
+{
+    std::unique_lock<std::mutex> lock(ring->mutex);
+    Item *next = nullptr;
+    // Items are handed out in the order they were acquired, an unfinished one blocks the rest
+    auto ready = [&]()
+    {
+        next = nullptr;
+        for (Item &item : ring->items)
+        {
+            if (item.state == ItemState::ACQUIRED || item.state == ItemState::WRITTEN)
+            {
+                next = item.state == ItemState::WRITTEN ? &item : nullptr;
+                break;
+            }
+        }
+        return next != nullptr;
+    };
+
+    if (!waitUntil(ring->changed, lock, ticksToWait, ready))
+    {
+        return nullptr;
+    }
+
+    next->state = ItemState::RECEIVED;
+    if (itemSize != nullptr)
+    {
+        *itemSize = next->length;
+    }
+    return ring->data(*next);
+}
+
+void vRingbufferReturnItem(RingbufHandle_t ring, void *item)
+{
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    Item *entry = ring->find(item);
+    if (entry == nullptr || entry->state != ItemState::RECEIVED)
+    {
+        return;
+    }
+    entry->state = ItemState::RETURNED;
+
+    while (!ring->items.empty() && ring->items.front().state == ItemState::RETURNED)
+    {
+        ring->used -= ring->items.front().span;
+        ring->items.pop_front();
+    }
+    ring->changed.notify_all();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Only no-split rings are provided. Items are laid out as in ESP-IDF: an
+// 8 byte header followed by the data rounded up to 4 bytes, never wrapped.
+
+typedef struct RingbufferDefinition *RingbufHandle_t;
+
+typedef enum
+{
+    RINGBUF_TYPE_NOSPLIT = 0,
+    RINGBUF_TYPE_ALLOWSPLIT,
+    RINGBUF_TYPE_BYTEBUF,
+    RINGBUF_TYPE_MAX,
+} RingbufferType_t;
+
+RingbufHandle_t xRingbufferCreate(size_t bufferSize, RingbufferType_t type);
+void vRingbufferDelete(RingbufHandle_t ring);
+
+size_t xRingbufferGetMaxItemSize(RingbufHandle_t ring);
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t ring);
+
+BaseType_t xRingbufferSend(RingbufHandle_t ring, const void *item, size_t itemSize, TickType_t ticksToWait);
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t ring, void **item, size_t itemSize, TickType_t ticksToWait);
+BaseType_t xRingbufferSendComplete(RingbufHandle_t ring, void *item);
+
+void *xRingbufferReceive(RingbufHandle_t ring, size_t *itemSize, TickType_t ticksToWait);
+void vRingbufferReturnItem(RingbufHandle_t ring, void *item);
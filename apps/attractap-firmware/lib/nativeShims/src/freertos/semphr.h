@@ -0,0 +1,18 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+// Semaphores are queues of zero sized items, as in FreeRTOS
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount);
+// Not recursive and without priority inheritance
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+
+#define xSemaphoreTake(semaphore, ticksToWait) xQueueReceive(semaphore, NULL, ticksToWait)
+#define xSemaphoreGive(semaphore) xQueueSend(semaphore, NULL, 0)
+#define xSemaphoreGiveFromISR(semaphore, woken) xQueueSend(semaphore, NULL, 0)
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
+#define uxSemaphoreGetCount(semaphore) uxQueueMessagesWaiting(semaphore)
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "FreeRTOS.h"
+
+// Waits on `condition` until `ready()` holds or the tick budget runs out,
+// portMAX_DELAY waits forever. Returns the final ready() result.
+template <typename Predicate>
+bool waitUntil(std::condition_variable &condition, std::unique_lock<std::mutex> &lock, TickType_t ticksToWait, Predicate ready)
+{
+    if (ticksToWait == portMAX_DELAY)
+    {
+        condition.wait(lock, ready);
+        return true;
+    }
+    return condition.wait_for(lock, std::chrono::milliseconds(pdTICKS_TO_MS(ticksToWait)), ready);
+}
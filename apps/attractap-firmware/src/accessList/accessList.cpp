@@ -0,0 +1,411 @@
+#include "accessList.hpp"
+
+#include <new>
+#include "mbedtls/md.h"
+#include "../settings/settings.hpp"
+
+static void putU32(uint8_t *out, uint32_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = (value >> 24) & 0xFF;
+}
+
+static int hexNibble(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool parseHex(const char *hex, uint8_t *out, size_t maxLength, size_t &length)
+{
+    if (hex == nullptr)
+    {
+        return false;
+    }
+
+    size_t hexLength = strlen(hex);
+    if (hexLength == 0 || hexLength % 2 != 0 || hexLength / 2 > maxLength)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < hexLength / 2; i++)
+    {
+        int high = hexNibble(hex[i * 2]);
+        int low = hexNibble(hex[i * 2 + 1]);
+        if (high < 0 || low < 0)
+        {
+            return false;
+        }
+        out[i] = (high << 4) | low;
+    }
+
+    length = hexLength / 2;
+    return true;
+}
+
+bool AccessList::load(const String &key)
+{
+    size_t length = Settings::loadAccessList(&this->table, sizeof(this->table));
+    const Header &header = this->table.header;
+
+    uint8_t signature[SIGNATURE_LENGTH];
+    bool valid = length >= sizeof(Header) &&
+                 header.magic == TABLE_MAGIC &&
+                 header.resourceCount <= MAX_RESOURCES &&
+                 header.entryCount <= MAX_ENTRIES &&
+                 length == storedSize(this->table) &&
+                 sign(this->table, key, signature) &&
+                 memcmp(signature, header.signature, SIGNATURE_LENGTH) == 0;
+
+    if (!valid)
+    {
+        // Also the case after re-registering, the old list was signed for another token
+        memset(&this->table.header, 0, sizeof(this->table.header));
+        if (length > 0)
+        {
+            Settings::clearAccessList();
+        }
+        return false;
+    }
+
+    // Age of an older version does not apply to this one
+    uint32_t ageVersion = 0;
+    uint32_t ageS = 0;
+    if (!Settings::getAccessListAge(ageVersion, ageS) || ageVersion != header.version)
+    {
+        ageS = 0;
+    }
+
+    this->clockBaseS = header.issuedAt + ageS;
+    this->clockBaseMs = 0;
+    this->savedAgeS = ageS;
+    return true;
+}
+
+AccessList::UpdateResult AccessList::applyUpdate(JsonObjectConst update, const String &key, uint32_t nowMs)
+{
+    // Built in a scratch copy so a rejected update leaves the current list alone
+    Table *next = new (std::nothrow) Table;
+    if (next == nullptr)
+    {
+        this->stats.rejected++;
+        return UPDATE_NO_MEMORY;
+    }
+
+    UpdateResult result = this->buildUpdate(*next, update, key);
+    if (result == UPDATE_APPLIED && !Settings::saveAccessList(next, storedSize(*next)))
+    {
+        result = UPDATE_NOT_SAVED;
+    }
+
+    if (result == UPDATE_APPLIED)
+    {
+        memcpy(&this->table, next, storedSize(*next));
+        this->clockBaseS = this->table.header.issuedAt;
+        this->clockBaseMs = nowMs;
+        this->savedAgeS = 0;
+        this->stats.updates++;
+    }
+    else
+    {
+        this->stats.rejected++;
+    }
+
+    delete next;
+    return result;
+}
+
+AccessList::UpdateResult AccessList::buildUpdate(Table &next, JsonObjectConst update, const String &key)
+{
+    uint32_t version = update["version"].as<uint32_t>();
+    bool reset = update["reset"].as<bool>();
+    JsonArrayConst resources = update["resources"].as<JsonArrayConst>();
+    if (version == 0 || resources.isNull() || resources.size() > MAX_RESOURCES)
+    {
+        return UPDATE_INVALID;
+    }
+
+    if (!reset && update["baseVersion"].as<uint32_t>() != this->table.header.version)
+    {
+        return UPDATE_BASE_MISMATCH;
+    }
+
+    uint8_t expectedSignature[SIGNATURE_LENGTH];
+    if (!parseSignature(update["signature"].as<const char *>(), expectedSignature))
+    {
+        return UPDATE_INVALID;
+    }
+
+    if (reset)
+    {
+        memset(&next.header, 0, sizeof(next.header));
+    }
+    else
+    {
+        memcpy(&next, &this->table, storedSize(this->table));
+    }
+
+    Header &header = next.header;
+    header.magic = TABLE_MAGIC;
+    header.version = version;
+    header.issuedAt = update["issuedAt"].as<uint32_t>();
+    header.expiresAt = update["expiresAt"].as<uint32_t>();
+    header.resourceCount = 0;
+    for (JsonVariantConst resourceId : resources)
+    {
+        header.resourceIds[header.resourceCount++] = resourceId.as<uint32_t>();
+    }
+
+    for (JsonVariantConst removed : update["remove"].as<JsonArrayConst>())
+    {
+        Entry entry;
+        bool found;
+        if (!parseUid(removed.as<const char *>(), entry))
+        {
+            return UPDATE_INVALID;
+        }
+
+        size_t index = find(next, entry.uid, entry.uidLength, found);
+        if (found)
+        {
+            memmove(&next.entries[index], &next.entries[index + 1], (header.entryCount - index - 1) * sizeof(Entry));
+            header.entryCount--;
+        }
+    }
+
+    for (JsonVariantConst upserted : update["upsert"].as<JsonArrayConst>())
+    {
+        Entry entry = {};
+        bool found;
+        if (!parseUid(upserted[0].as<const char *>(), entry))
+        {
+            return UPDATE_INVALID;
+        }
+        entry.resourceMask = upserted[1].as<uint32_t>();
+        entry.expiresAt = upserted[2].as<uint32_t>();
+
+        size_t index = find(next, entry.uid, entry.uidLength, found);
+        if (!found)
+        {
+            if (header.entryCount >= MAX_ENTRIES)
+            {
+                return UPDATE_TOO_LARGE;
+            }
+            memmove(&next.entries[index + 1], &next.entries[index], (header.entryCount - index) * sizeof(Entry));
+            header.entryCount++;
+        }
+        next.entries[index] = entry;
+    }
+
+    if (!sign(next, key, header.signature) || memcmp(header.signature, expectedSignature, SIGNATURE_LENGTH) != 0)
+    {
+        return UPDATE_BAD_SIGNATURE;
+    }
+
+    return UPDATE_APPLIED;
+}
+
+AccessList::Decision AccessList::lookup(const uint8_t *uid, size_t uidLength, uint32_t nowMs)
+{
+    this->stats.lookups++;
+
+    uint32_t now = this->nowSeconds(nowMs);
+    if (this->table.header.version == 0 || now >= this->table.header.expiresAt)
+    {
+        return ACCESS_UNKNOWN;
+    }
+
+    bool found;
+    size_t index = find(this->table, uid, uidLength, found);
+    if (!found)
+    {
+        return ACCESS_DENIED;
+    }
+
+    const Entry &entry = this->table.entries[index];
+    if (entry.resourceMask == 0 || (entry.expiresAt != 0 && now >= entry.expiresAt))
+    {
+        return ACCESS_DENIED;
+    }
+
+    this->stats.granted++;
+    return ACCESS_GRANTED;
+}
+
+void AccessList::checkpoint(uint32_t nowMs)
+{
+    if (this->table.header.version == 0)
+    {
+        return;
+    }
+
+    uint32_t ageS = this->nowSeconds(nowMs) - this->table.header.issuedAt;
+    if (ageS - this->savedAgeS < AGE_CHECKPOINT_S)
+    {
+        return;
+    }
+
+    Settings::saveAccessListAge(this->table.header.version, ageS);
+    this->savedAgeS = ageS;
+}
+
+void AccessList::clear()
+{
+    memset(&this->table.header, 0, sizeof(this->table.header));
+    Settings::clearAccessList();
+}
+
+AccessList::Stats AccessList::getStats() const
+{
+    Stats stats = this->stats;
+    stats.version = this->table.header.version;
+    stats.entries = this->table.header.entryCount;
+    stats.expiresAt = this->table.header.expiresAt;
+    return stats;
+}
+
+const char *AccessList::updateResultName(UpdateResult result)
+{
+    switch (result)
+    {
+    case UPDATE_APPLIED:
+        return "applied";
+    case UPDATE_BASE_MISMATCH:
+        return "base version mismatch";
+    case UPDATE_INVALID:
+        return "invalid";
+    case UPDATE_TOO_LARGE:
+        return "too many entries";
+    case UPDATE_BAD_SIGNATURE:
+        return "bad signature";
+    case UPDATE_NO_MEMORY:
+        return "out of memory";
+    case UPDATE_NOT_SAVED:
+        return "not saved";
+    default:
+        return "unknown";
+    }
+}
+
+uint32_t AccessList::nowSeconds(uint32_t nowMs) const
+{
+    return this->clockBaseS + (nowMs - this->clockBaseMs) / 1000;
+}
+
+size_t AccessList::storedSize(const Table &table)
+{
+    return sizeof(Header) + table.header.entryCount * sizeof(Entry);
+}
+
+size_t AccessList::find(const Table &table, const uint8_t *uid, size_t uidLength, bool &found)
+{
+    // Byte order, a UID that is a prefix of another one sorts first
+    size_t low = 0;
+    size_t high = table.header.entryCount;
+    while (low < high)
+    {
+        size_t middle = (low + high) / 2;
+        const Entry &entry = table.entries[middle];
+
+        int order = memcmp(entry.uid, uid, min((size_t)entry.uidLength, uidLength));
+        if (order == 0)
+        {
+            order = (int)entry.uidLength - (int)uidLength;
+        }
+
+        if (order == 0)
+        {
+            found = true;
+            return middle;
+        }
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    found = false;
+    return low;
+}
+
+bool AccessList::parseUidHex(const char *hex, uint8_t *uid, size_t &uidLength)
+{
+    return parseHex(hex, uid, MAX_UID_LENGTH, uidLength);
+}
+
+bool AccessList::parseUid(const char *hex, Entry &entry)
+{
+    size_t length;
+    if (!parseHex(hex, entry.uid, MAX_UID_LENGTH, length))
+    {
+        return false;
+    }
+    entry.uidLength = length;
+    return true;
+}
+
+bool AccessList::parseSignature(const char *hex, uint8_t signature[SIGNATURE_LENGTH])
+{
+    size_t length;
+    return parseHex(hex, signature, SIGNATURE_LENGTH, length) && length == SIGNATURE_LENGTH;
+}
+
+bool AccessList::sign(const Table &table, const String &key, uint8_t signature[SIGNATURE_LENGTH])
+{
+    // Canonical encoding, see encodeAccessListTable in the api app
+    const Header &header = table.header;
+    uint8_t buffer[4 + 4 + 4 + 1];
+
+    mbedtls_md_context_t context;
+    mbedtls_md_init(&context);
+    bool ok = mbedtls_md_setup(&context, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1) == 0 &&
+              mbedtls_md_hmac_starts(&context, (const uint8_t *)key.c_str(), key.length()) == 0;
+
+    putU32(buffer, header.version);
+    putU32(buffer + 4, header.issuedAt);
+    putU32(buffer + 8, header.expiresAt);
+    buffer[12] = header.resourceCount;
+    ok = ok && mbedtls_md_hmac_update(&context, buffer, 13) == 0;
+
+    for (uint8_t i = 0; i < header.resourceCount; i++)
+    {
+        putU32(buffer, header.resourceIds[i]);
+        ok = ok && mbedtls_md_hmac_update(&context, buffer, 4) == 0;
+    }
+
+    buffer[0] = header.entryCount & 0xFF;
+    buffer[1] = header.entryCount >> 8;
+    ok = ok && mbedtls_md_hmac_update(&context, buffer, 2) == 0;
+
+    for (uint16_t i = 0; i < header.entryCount; i++)
+    {
+        const Entry &entry = table.entries[i];
+        ok = ok && mbedtls_md_hmac_update(&context, &entry.uidLength, 1) == 0;
+        ok = ok && mbedtls_md_hmac_update(&context, entry.uid, entry.uidLength) == 0;
+        putU32(buffer, entry.resourceMask);
+        putU32(buffer + 4, entry.expiresAt);
+        ok = ok && mbedtls_md_hmac_update(&context, buffer, 8) == 0;
+    }
+
+    ok = ok && mbedtls_md_hmac_finish(&context, signature) == 0;
+    mbedtls_md_free(&context);
+    return ok;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Local copy of the server's access decisions for this reader (card UID ->
+// resources the card may use), so a tap can still be answered while the
+// server is unreachable. The server pushes it as a chain of updates
+// (READER_ACCESS_LIST), each a delta on top of the previous version.
+//
+// Entries are kept sorted by UID and looked up with a binary search. The
+// table is persisted as one NVS blob through Settings. Every version is
+// signed by the server with an HMAC-SHA256 keyed with the reader's API token
+// over a canonical encoding of the table; the signature is checked after each
+// update and again when the blob is loaded.
+class AccessList
+{
+public:
+    static const size_t MAX_ENTRIES = 256;
+    static const size_t MAX_RESOURCES = 32;
+    static const size_t MAX_UID_LENGTH = 10;
+    static const size_t SIGNATURE_LENGTH = 32;
+    // How often the list's age is saved, see checkpoint()
+    static const uint32_t AGE_CHECKPOINT_S = 600;
+
+    enum Decision
+    {
+        // No list, or the list expired
+        ACCESS_UNKNOWN,
+        ACCESS_DENIED,
+        ACCESS_GRANTED,
+    };
+
+    enum UpdateResult
+    {
+        UPDATE_APPLIED,
+        // A delta for another version than the one we have
+        UPDATE_BASE_MISMATCH,
+        UPDATE_INVALID,
+        UPDATE_TOO_LARGE,
+        UPDATE_BAD_SIGNATURE,
+        UPDATE_NO_MEMORY,
+        UPDATE_NOT_SAVED,
+    };
+
+    struct Stats
+    {
+        uint32_t version;
+        uint32_t entries;
+        uint32_t expiresAt;
+        uint32_t updates;
+        uint32_t rejected;
+        uint32_t lookups;
+        uint32_t granted;
+    };
+
+    /*
+     *  Load the persisted list, dropping it if its signature does not match
+     *  @param key: signing key (the reader's API token)
+     *  @return true if a valid list was loaded
+     */
+    bool load(const String &key);
+
+    /*
+     *  Apply an update pushed by the server; nothing changes unless it is applied
+     *  @param update: payload of READER_ACCESS_LIST
+     *  @param key: signing key (the reader's API token)
+     *  @param nowMs: millis() when it was received, pins the list's issuedAt
+     */
+    UpdateResult applyUpdate(JsonObjectConst update, const String &key, uint32_t nowMs);
+
+    Decision lookup(const uint8_t *uid, size_t uidLength, uint32_t nowMs);
+
+    /*
+     *  Save the age of the list every AGE_CHECKPOINT_S, call regularly. After
+     *  a reboot the list ages on from the last checkpoint, so the time the
+     *  reader was off is all expiry can be late by.
+     */
+    void checkpoint(uint32_t nowMs);
+
+    // Forget the list, in memory and in NVS
+    void clear();
+
+    uint32_t getVersion() const { return this->table.header.version; }
+    Stats getStats() const;
+
+    static const char *updateResultName(UpdateResult result);
+
+    /*
+     *  Parse a hex card UID as reported by NFC
+     *  @param uid: receives the bytes, holds MAX_UID_LENGTH
+     *  @return false if it is not an even number of hex digits or too long
+     */
+    static bool parseUidHex(const char *hex, uint8_t *uid, size_t &uidLength);
+
+private:
+    struct Entry
+    {
+        uint8_t uidLength;
+        uint8_t uid[MAX_UID_LENGTH];
+        uint8_t reserved;
+        // Bit i grants resource i of Header::resourceIds
+        uint32_t resourceMask;
+        // Unix seconds, 0 if valid as long as the list is
+        uint32_t expiresAt;
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t issuedAt;
+        uint32_t expiresAt;
+        uint32_t resourceIds[MAX_RESOURCES];
+        uint8_t resourceCount;
+        uint8_t reserved;
+        uint16_t entryCount;
+        uint8_t signature[SIGNATURE_LENGTH];
+    };
+
+    // Stored as is; only the used entries are written
+    struct Table
+    {
+        Header header;
+        Entry entries[MAX_ENTRIES];
+    };
+
+    static const uint32_t TABLE_MAGIC = 0x314c4341; // "ACL1"
+
+    Table table = {};
+    Stats stats = {};
+
+    // No wall clock on the reader: the time is the issuedAt of the current
+    // list plus the time since it arrived. After a reboot the age is taken
+    // from the last checkpoint and counted on from boot, so expiry can only be
+    // late, never early.
+    uint32_t clockBaseS = 0;
+    uint32_t clockBaseMs = 0;
+    uint32_t savedAgeS = 0;
+    uint32_t nowSeconds(uint32_t nowMs) const;
+
+    static size_t storedSize(const Table &table);
+    static size_t find(const Table &table, const uint8_t *uid, size_t uidLength, bool &found);
+    static bool parseUid(const char *hex, Entry &entry);
+    static bool parseSignature(const char *hex, uint8_t signature[SIGNATURE_LENGTH]);
+    static bool sign(const Table &table, const String &key, uint8_t signature[SIGNATURE_LENGTH]);
+
+    UpdateResult buildUpdate(Table &next, JsonObjectConst update, const String &key);
+};
@@ -1,7 +1,16 @@
 #include "api.hpp"
 
-void API::setup()
+void API::setup(FirmwareUpdate *firmwareUpdate)
 {
+    this->firmwareUpdate = firmwareUpdate;
+    this->setupJournal();
+
+    if (this->accessList.load(Settings::getAttraccessAuthConfig().apiKey))
+    {
+        AccessList::Stats stats = this->accessList.getStats();
+        logger.infof("Loaded access list v%u with %u entries", stats.version, stats.entries);
+    }
+    this->stateSubscription = State::subscribe(State::STATE_CHANGE_NETWORK | State::STATE_CHANGE_WEBSOCKET);
     xTaskCreate(taskFn, "API", 8192, this, TASK_PRIORITY_API, NULL);
 }
 
@@ -11,24 +20,124 @@ void API::taskFn(void *parameter)
     while (true)
     {
         api->loop();
-        vTaskDelay(20 / portTICK_PERIOD_MS);
+        api->pendingStateChanges |= State::waitForChanges(api->stateSubscription, 20);
     }
 }
 
 void API::updateSateInfo()
 {
-    uint32_t lastStateChangeTime = State::getLastStateChangeTime();
-    if (this->lastKnownAppStateChangeTime >= lastStateChangeTime)
+    if (this->pendingStateChanges == 0)
     {
         return;
     }
 
-    this->lastKnownAppStateChangeTime = lastStateChangeTime;
+    this->pendingStateChanges = 0;
 
     auto websocketState = State::getWebsocketState();
-    auto networkState = State::getNetworkState();
 
-    this->loopIsEnabled = websocketState.connected && (networkState.wifi_connected || networkState.ethernet_connected);
+    // A new connection starts out in JSON until the encoding is negotiated again
+    if (!websocketState.connected)
+    {
+        this->outgoingEncoding = API_ENCODING_JSON;
+        this->sessionAuthenticated = false;
+        this->journalEntryInFlight = 0;
+        this->nfc_tap_sent_at = 0;
+    }
+}
+
+void API::setupJournal()
+{
+    if (!this->journalStorage.begin(JOURNAL_PARTITION_LABEL, JOURNAL_SECTORS))
+    {
+        logger.errorf("No \"%s\" partition, offline taps are not journaled", JOURNAL_PARTITION_LABEL);
+        return;
+    }
+
+    // Random ids keep a reflashed reader from reusing ids the server already saw
+    this->journalReady = this->journal.begin(esp_random(), esp_random() & 0x7FFFFFFF);
+    if (!this->journalReady)
+    {
+        logger.error("Tap journal storage is unusable");
+        return;
+    }
+
+    TapJournal::Stats stats = this->journal.getStats();
+    logger.infof("Tap journal: %u pending, capacity %u, %u corrupt", stats.pending, stats.capacity, stats.corrupt);
+}
+
+void API::journalInput(TapJournal::EntryKind kind, const uint8_t *data, size_t length)
+{
+    const char *what = kind == TapJournal::ENTRY_NFC_TAP ? "NFC tap" : "keypad input";
+    if (!this->journal.append(kind, data, length, millis()))
+    {
+        logger.errorf("Failed to journal %s", what);
+        return;
+    }
+
+    logger.infof("Offline, journaled %s (%u pending)", what, this->journal.getStats().pending);
+}
+
+void API::replayJournal()
+{
+    if (!this->journalReady || !this->sessionAuthenticated)
+    {
+        return;
+    }
+
+    // Stop and wait: the next entry only goes out once the previous one is confirmed
+    if (this->journalEntryInFlight != 0 && millis() - this->journalEntrySentAt < JOURNAL_RETRY_MS)
+    {
+        return;
+    }
+
+    TapJournal::Entry entry;
+    if (!this->journal.peek(entry))
+    {
+        this->journalEntryInFlight = 0;
+        return;
+    }
+
+    JsonObject payload = this->beginMessage(false, "READER_JOURNAL_ENTRY");
+    payload["id"] = entry.id;
+    switch (entry.kind)
+    {
+    case TapJournal::ENTRY_NFC_TAP:
+    {
+        char cardUid[TapJournal::MAX_DATA_LENGTH * 2 + 1];
+        for (uint8_t i = 0; i < entry.length; i++)
+        {
+            snprintf(cardUid + i * 2, 3, "%02x", entry.data[i]);
+        }
+        cardUid[entry.length * 2] = '\0';
+        payload["kind"] = "NFC_TAP";
+        payload["cardUID"] = cardUid;
+        break;
+    }
+    case TapJournal::ENTRY_KEYPAD_CONFIRM:
+    case TapJournal::ENTRY_KEYPAD_CANCEL:
+    {
+        char value[TapJournal::MAX_DATA_LENGTH + 1];
+        memcpy(value, entry.data, entry.length);
+        value[entry.length] = '\0';
+        payload["kind"] = entry.kind == TapJournal::ENTRY_KEYPAD_CONFIRM ? "KEYPAD_CONFIRM" : "KEYPAD_CANCEL";
+        payload["value"] = value;
+        break;
+    }
+    default:
+        // Written by a newer firmware; the server still confirms it by id
+        payload["kind"] = "UNKNOWN";
+        break;
+    }
+    // Uptime is only meaningful within the boot that recorded the entry
+    if (entry.bootId == this->journal.getBootId())
+    {
+        payload["ageMs"] = millis() - entry.uptimeMs;
+    }
+    this->sendPendingMessage();
+
+    logger.infof("Replaying journal entry #%u", entry.id);
+    this->journalEntryInFlight = entry.id;
+    this->journalEntrySentAt = millis();
 }
 
 void API::loop()
@@ -37,118 +146,379 @@ void API::loop()
     // Always try to drain/process any available incoming messages
     this->processAvailableMessages();
     this->processInputEvents();
+    this->replayJournal();
+    this->serviceFirmwareUpdate();
+    this->accessList.checkpoint(millis());
 
-    // Only send heartbeat when connection is usable
-    if (this->loopIsEnabled)
+    if (this->offlineDecisionShownAt != 0 && millis() - this->offlineDecisionShownAt >= OFFLINE_DECISION_DISPLAY_MS)
     {
-        this->sendHeartbeat();
+        this->clearOfflineDecision();
     }
 }
 
 void API::processAvailableMessages()
 {
-    String message;
+    ApiCommand command;
 
-    if (!State::getNextIncomingWebsocketMessage(message))
+    if (!State::getNextApiCommand(command))
     {
         return;
     }
 
-    JsonDocument doc;
-    deserializeJson(doc, message);
+    if (this->nfc_tap_sent_at != 0 && isTapAnswer(command.type))
+    {
+        unsigned long latency = millis() - this->nfc_tap_sent_at;
+        // A state that ignored the tap answers nothing, don't pin its next command on it
+        if (latency <= TAP_ANSWER_TIMEOUT_MS)
+        {
+            this->tapLatency.record(latency);
+        }
+        this->nfc_tap_sent_at = 0;
+    }
 
-    auto data = doc["data"].as<JsonObject>();
-    String eventType = data["type"].as<String>();
-    auto payload = data["payload"].as<JsonObject>();
+    // Confirmations of replayed entries are themselves acknowledgements
+    if (command.type == API_COMMAND_READER_JOURNAL_ENTRY)
+    {
+        if (command.document != nullptr)
+        {
+            this->onJournalEntryConfirmed((*command.document)["data"].as<JsonObject>());
+        }
+        ApiCommandDecoder::release(command);
+        return;
+    }
+    if (command.type == API_COMMAND_READER_ACCESS_LIST)
+    {
+        if (command.document != nullptr)
+        {
+            this->onAccessListUpdate((*command.document)["data"].as<JsonObject>());
+        }
+        ApiCommandDecoder::release(command);
+        return;
+    }
+    // Answered by the request for the next chunk
+    if (command.type == API_COMMAND_READER_FIRMWARE_STREAM_CHUNK)
+    {
+        if (command.document != nullptr)
+        {
+            this->onFirmwareChunk((*command.document)["data"].as<JsonObject>());
+        }
+        ApiCommandDecoder::release(command);
+        return;
+    }
+
+    logger.infof("Received message of type %s, sending ACK", command.name);
+    this->sendAck(command.name);
+
+    switch (command.type)
+    {
+    case API_COMMAND_NFC_CHANGE_KEY:
+        this->onNfcChangeKey(command.nfcChangeKey, command.payloadValid);
+        break;
+
+    case API_COMMAND_NFC_AUTHENTICATE:
+        this->onNfcAuthenticate(command.nfcAuthenticate, command.payloadValid);
+        break;
+
+    default:
+        this->processDocumentCommand(command);
+        break;
+    }
 
-    String payloadString;
-    serializeJson(payload, payloadString);
+    ApiCommandDecoder::release(command);
+}
 
-    logger.info(("Received message of type " + eventType + " with payload " + payloadString).c_str());
-    logger.info(("Sending ACK for event " + eventType).c_str());
-    this->sendAck(eventType.c_str());
+bool API::isTapAnswer(ApiCommandType type)
+{
+    switch (type)
+    {
+    // What the reader states send first on NFC_TAP: wait-for-nfc-tap shows
+    // DISPLAY_TEXT, enroll and reset disable card checking
+    case API_COMMAND_DISPLAY_TEXT:
+    case API_COMMAND_WAIT_FOR_PROCESSING:
+    case API_COMMAND_DISPLAY_ERROR:
+    case API_COMMAND_NFC_AUTHENTICATE:
+    case API_COMMAND_NFC_CHANGE_KEY:
+        return true;
+    default:
+        return false;
+    }
+}
 
-    if (eventType == "READER_REGISTER")
+void API::processDocumentCommand(ApiCommand &command)
+{
+    if (command.document == nullptr)
     {
-        this->onRegistrationData(data);
+        logger.errorf("Command %s has no document", command.name);
+        return;
     }
-    else if (eventType == "READER_UNAUTHORIZED")
+
+    auto data = (*command.document)["data"].as<JsonObject>();
+    auto payload = data["payload"].as<JsonObject>();
+
+    switch (command.type)
     {
+    case API_COMMAND_READER_REGISTER:
+        this->onRegistrationData(data);
+        break;
+    case API_COMMAND_READER_UNAUTHORIZED:
         this->onUnauthorized(data);
+        break;
+    case API_COMMAND_READER_AUTHENTICATED:
+        this->onReaderAuthenticated(data);
+        break;
+    case API_COMMAND_READER_REQUEST_AUTHENTICATION:
+        this->onRequestAuthentication(data);
+        break;
+
+    case API_COMMAND_READER_FIRMWARE_INFO:
+        this->onFirmwareInfo(data);
+        break;
+    case API_COMMAND_READER_FIRMWARE_UPDATE_REQUIRED:
+        this->onFirmwareUpdateRequired(payload);
+        break;
+
+    case API_COMMAND_NFC_ENABLE_CARD_CHECKING:
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_WAIT_FOR_NFC_TAP, payload);
+        break;
+    case API_COMMAND_WAIT_FOR_PROCESSING:
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_WAIT_FOR_PROCESSING, payload);
+        break;
+
+    case API_COMMAND_DISPLAY_SUCCESS:
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_SUCCESS, payload);
+        break;
+    case API_COMMAND_DISPLAY_ERROR:
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_ERROR, payload);
+        break;
+    case API_COMMAND_DISPLAY_TEXT:
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_TEXT, payload);
+        break;
+
+    case API_COMMAND_SELECT_ITEM:
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_RESOURCE_SELECTION, payload);
+        break;
+    case API_COMMAND_CONFIRM_ACTION:
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_CONFIRM_ACTION, payload);
+        break;
+
+    default:
+    {
+        String payloadString;
+        serializeJson(payload, payloadString);
+        logger.errorf("Unknown event type: %s", command.name);
+        logger.error(payloadString.c_str());
+        break;
+    }
     }
-    else if (eventType == "READER_AUTHENTICATED")
+}
+
+void API::onJournalEntryConfirmed(JsonObject data)
+{
+    uint32_t id = data["payload"]["id"].as<uint32_t>();
+    if (!this->journal.acknowledge(id))
     {
-        this->onReaderAuthenticated(data);
+        logger.errorf("Confirmation for unexpected journal entry #%u", id);
+        return;
     }
-    else if (eventType == "READER_REQUEST_AUTHENTICATION")
+
+    if (id == this->journalEntryInFlight)
     {
-        this->onRequestAuthentication(data);
+        this->journalEntryInFlight = 0;
     }
+}
 
-    else if (eventType == "READER_FIRMWARE_INFO")
+void API::onAccessListUpdate(JsonObject data)
+{
+    AccessList::UpdateResult result = this->accessList.applyUpdate(data["payload"].as<JsonObjectConst>(),
+                                                                   Settings::getAttraccessAuthConfig().apiKey,
+                                                                   millis());
+
+    AccessList::Stats stats = this->accessList.getStats();
+    if (result == AccessList::UPDATE_APPLIED)
     {
-        this->onFirmwareInfo(data);
+        logger.infof("Access list updated to v%u (%u entries)", stats.version, stats.entries);
     }
-    else if (eventType == "READER_FIRMWARE_UPDATE_REQUIRED")
+    else
     {
-        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_FIRMWARE_UPDATE, payload);
+        logger.errorf("Access list update rejected: %s", AccessList::updateResultName(result));
     }
 
-    else if (eventType == "NFC_ENABLE_CARD_CHECKING")
+    // Tells the server which version we have, it resends from there if needed
+    JsonObject payload = this->beginMessage(true, "READER_ACCESS_LIST");
+    payload["version"] = stats.version;
+    payload["applied"] = result == AccessList::UPDATE_APPLIED;
+    this->sendPendingMessage();
+}
+
+void API::onFirmwareUpdateRequired(JsonObject payload)
+{
+    JsonObject firmware = payload["firmware"].as<JsonObject>();
+    logger.infof("Firmware update required: %s -> %s", FIRMWARE_VERSION, payload["available"]["version"].as<const char *>());
+
+    if (this->firmwareUpdate == nullptr ||
+        !this->firmwareUpdate->start(firmware["totalSize"].as<uint32_t>(), firmware["chunks"].as<uint32_t>(), firmware["sha256"].as<const char *>()))
     {
-        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_WAIT_FOR_NFC_TAP, payload);
+        JsonDocument doc;
+        doc["message"] = "Update failed";
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_ERROR, doc.as<JsonObject>());
+        return;
     }
-    else if (eventType == "WAIT_FOR_PROCESSING")
+
+    this->firmwareChunkRetries = 0;
+    this->showFirmwareUpdateProgress(true);
+    this->requestFirmwareChunk();
+}
+
+void API::requestFirmwareChunk()
+{
+    JsonObject payload = this->beginMessage(false, "READER_FIRMWARE_STREAM_CHUNK");
+    payload["chunkIndex"] = this->firmwareUpdate->getNextChunk();
+    this->sendPendingMessage();
+
+    this->firmwareChunkRequested = true;
+    this->firmwareChunkRequestedAt = millis();
+}
+
+void API::onFirmwareChunk(JsonObject data)
+{
+    JsonObject payload = data["payload"].as<JsonObject>();
+    MsgPackBinary chunk = payload["data"].as<MsgPackBinary>();
+    int32_t chunkIndex = payload["chunkIndex"].is<uint32_t>() ? payload["chunkIndex"].as<int32_t>() : -1;
+
+    if (this->firmwareUpdate == nullptr || chunk.data() == nullptr)
     {
-        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_WAIT_FOR_PROCESSING, payload);
+        logger.error("Dropping firmware chunk without data");
+        return;
     }
-    else if (eventType == "NFC_CHANGE_KEY")
+    if (chunkIndex < 0 && !this->firmwareChunkRequested)
     {
-        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_WAIT_FOR_PROCESSING, payload);
+        logger.error("Dropping unrequested firmware chunk");
+        return;
+    }
 
-        uint8_t keyNumber = data["payload"]["keyNumber"].as<uint8_t>();
-        String authKeyHex = data["payload"]["authKey"].as<String>();
-        String oldKeyHex = data["payload"]["oldKey"].as<String>();
-        String newKeyHex = data["payload"]["newKey"].as<String>();
+    switch (this->firmwareUpdate->processChunk(chunkIndex, (const uint8_t *)chunk.data(), chunk.size()))
+    {
+    case FirmwareStream::CHUNK_WRITTEN:
+        this->firmwareChunkRetries = 0;
+        this->showFirmwareUpdateProgress(false);
+        this->requestFirmwareChunk();
+        break;
 
-        State::pushNfcCommandToQueue(State::NfcCommandType::NFC_COMMAND_TYPE_CHANGE_KEY, String(keyNumber) + " " + authKeyHex + " " + oldKeyHex + " " + newKeyHex);
+    case FirmwareStream::CHUNK_COMPLETE:
+    {
+        this->firmwareChunkRequested = false;
+        JsonDocument doc;
+        doc["message"] = "Updated, restarting";
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_SUCCESS, doc.as<JsonObject>());
+        this->firmwareRestartAt = millis() + FIRMWARE_RESTART_DELAY_MS;
+        break;
     }
-    else if (eventType == "NFC_AUTHENTICATE")
+
+    case FirmwareStream::CHUNK_FAILED:
     {
-        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_WAIT_FOR_PROCESSING, payload);
+        this->firmwareChunkRequested = false;
+        JsonDocument doc;
+        doc["message"] = "Update failed";
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_ERROR, doc.as<JsonObject>());
+        break;
+    }
 
-        String authKeyHex = data["payload"]["authenticationKey"].as<String>();
-        uint8_t keyNumber = data["payload"]["keyNumber"].as<uint8_t>();
+    case FirmwareStream::CHUNK_IGNORED:
+        break;
+    }
+}
 
-        State::pushNfcCommandToQueue(State::NfcCommandType::NFC_COMMAND_TYPE_AUTHENTICATE, String(keyNumber) + " " + authKeyHex);
+void API::serviceFirmwareUpdate()
+{
+    if (this->firmwareRestartAt != 0 && (long)(millis() - this->firmwareRestartAt) >= 0)
+    {
+        logger.info("Restarting into the updated firmware");
+        ESP.restart();
     }
 
-    else if (eventType == "DISPLAY_SUCCESS")
+    if (this->firmwareUpdate == nullptr || !this->firmwareUpdate->isDownloading())
     {
-        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_SUCCESS, payload);
+        return;
     }
-    else if (eventType == "DISPLAY_ERROR")
+
+    // After a reconnect the server announces the update again, which continues it
+    if (!this->sessionAuthenticated)
     {
-        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_ERROR, payload);
+        this->firmwareChunkRequested = false;
+        return;
     }
-    else if (eventType == "DISPLAY_TEXT")
+
+    if (this->firmwareChunkRequested && millis() - this->firmwareChunkRequestedAt < FIRMWARE_CHUNK_TIMEOUT_MS)
     {
-        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_TEXT, payload);
+        return;
     }
 
-    else if (eventType == "SELECT_ITEM")
+    if (this->firmwareChunkRetries >= FIRMWARE_CHUNK_RETRIES)
     {
-        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_RESOURCE_SELECTION, payload);
+        this->firmwareChunkRequested = false;
+        this->firmwareUpdate->abort("server stopped sending chunks");
+        JsonDocument doc;
+        doc["message"] = "Update failed";
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_ERROR, doc.as<JsonObject>());
+        return;
     }
-    else if (eventType == "CONFIRM_ACTION")
+
+    this->firmwareChunkRetries++;
+    logger.errorf("No firmware chunk %u, requesting it again", this->firmwareUpdate->getNextChunk());
+    this->requestFirmwareChunk();
+}
+
+void API::showFirmwareUpdateProgress(bool force)
+{
+    FirmwareStream::Progress progress = this->firmwareUpdate->getProgress();
+    uint8_t percent = progress.totalSize > 0 ? (uint64_t)progress.bytesWritten * 100 / progress.totalSize : 0;
+
+    // Every redraw copies the payload into the state, so only whole steps are shown
+    if (!force && percent < this->firmwareProgressShown + FIRMWARE_PROGRESS_STEP)
     {
-        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_CONFIRM_ACTION, payload);
+        return;
     }
-    else
+    this->firmwareProgressShown = percent;
+
+    JsonDocument doc;
+    doc["progress"] = percent;
+    State::setApiEventData(State::ApiEventState::API_EVENT_STATE_FIRMWARE_UPDATE, doc.as<JsonObject>());
+}
+
+void API::onNfcChangeKey(const ApiNfcChangeKeyCommand &changeKey, bool payloadValid)
+{
+    State::setApiEventData(State::ApiEventState::API_EVENT_STATE_WAIT_FOR_PROCESSING, JsonObject());
+
+    if (!payloadValid)
     {
-        logger.error(("Unknown event type: " + eventType).c_str());
-        logger.error(payloadString.c_str());
+        this->logger.error("NFC_CHANGE_KEY with invalid payload");
+        this->onNfcCardChangeKeyFailed(0);
+        return;
     }
+
+    State::NfcCommand command;
+    command.type = State::NfcCommandType::NFC_COMMAND_TYPE_CHANGE_KEY;
+    command.correlationId = ++this->nfc_command_correlation_id;
+    command.changeKey = changeKey;
+    State::pushNfcCommandToQueue(command);
+}
+
+void API::onNfcAuthenticate(const ApiNfcAuthenticateCommand &authenticate, bool payloadValid)
+{
+    State::setApiEventData(State::ApiEventState::API_EVENT_STATE_WAIT_FOR_PROCESSING, JsonObject());
+
+    if (!payloadValid)
+    {
+        this->logger.error("NFC_AUTHENTICATE with invalid payload");
+        this->onNfcCardAuthenticateFailed(0);
+        return;
+    }
+
+    State::NfcCommand command;
+    command.type = State::NfcCommandType::NFC_COMMAND_TYPE_AUTHENTICATE;
+    command.correlationId = ++this->nfc_command_correlation_id;
+    command.authenticate = authenticate;
+    State::pushNfcCommandToQueue(command);
 }
 
 void API::processInputEvents()
@@ -180,32 +550,20 @@ void API::processInputEvents()
     }
 
     case State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_CHANGE_KEY_SUCCESS:
-    {
-        String payload(event.payload);
-        this->onNfcCardChangeKeySuccess(payload);
+        this->onNfcCardChangeKeySuccess(event.correlationId);
         break;
-    }
 
     case State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_CHANGE_KEY_FAILED:
-    {
-        String payload(event.payload);
-        this->onNfcCardChangeKeyFailed(payload);
+        this->onNfcCardChangeKeyFailed(event.correlationId);
         break;
-    }
 
     case State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_SUCCESS:
-    {
-        String payload(event.payload);
-        this->onNfcCardAuthenticateSuccess(payload);
+        this->onNfcCardAuthenticateSuccess(event.correlationId);
         break;
-    }
 
     case State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_FAILED:
-    {
-        String payload(event.payload);
-        this->onNfcCardAuthenticateFailed(payload);
+        this->onNfcCardAuthenticateFailed(event.correlationId);
         break;
-    }
 
     default:
         this->logger.errorf("Unknown input event type: %d", event.type);
@@ -246,6 +604,7 @@ void API::onUnauthorized(JsonObject data)
 
     logger.error(("UNAUTHORIZED: " + message).c_str());
     Settings::clearAttraccessAuthConfig();
+    this->accessList.clear();
 
     State::setApiState(false, "");
 }
@@ -257,45 +616,104 @@ bool API::isRegistered()
 
 void API::sendAck(const char *type)
 {
-    this->sendMessage(true, ("ACK_" + String(type)).c_str());
+    static const char ACK_PREFIX[] = "{\"event\":\"RESPONSE\",\"data\":{\"type\":\"ACK_";
+    static const char ACK_SUFFIX[] = "\",\"payload\":{}}}";
+
+    if (this->outgoingEncoding == API_ENCODING_MSGPACK)
+    {
+        char ackType[API_COMMAND_NAME_MAX_LEN + 4];
+        snprintf(ackType, sizeof(ackType), "ACK_%s", type);
+        this->sendMessage(true, ackType);
+        return;
+    }
+
+    // Known event names only consist of [A-Z0-9_]; anything else needs escaping
+    size_t typeLength = strlen(type);
+    for (size_t i = 0; i < typeLength; i++)
+    {
+        if (!isalnum((unsigned char)type[i]) && type[i] != '_')
+        {
+            this->sendMessage(true, ("ACK_" + String(type)).c_str());
+            return;
+        }
+    }
+
+    this->sendTemplateMessage(ACK_PREFIX, sizeof(ACK_PREFIX) - 1, type, typeLength, ACK_SUFFIX, sizeof(ACK_SUFFIX) - 1);
 }
 
-void API::sendMessage(bool is_response, const char *type)
+void API::sendTemplateMessage(const char *prefix, size_t prefixLength, const char *infix, size_t infixLength, const char *suffix, size_t suffixLength)
 {
-    JsonDocument doc;
-    JsonObject payload = doc.to<JsonObject>();
-    this->sendMessage(is_response, type, payload);
+    size_t length = prefixLength + infixLength + suffixLength;
+    char *slot = State::reserveOutgoingWebsocketMessage(length);
+    if (slot == nullptr)
+    {
+        logger.error("Outgoing queue full, dropping message");
+        return;
+    }
+
+    memcpy(slot, prefix, prefixLength);
+    memcpy(slot + prefixLength, infix, infixLength);
+    memcpy(slot + prefixLength + infixLength, suffix, suffixLength);
+
+    logger.debugf("pushing message to queue: %.*s", (int)length, slot);
+    State::commitOutgoingWebsocketMessage(slot);
 }
 
-void API::sendMessage(bool is_response, const char *type, JsonObject payload)
+JsonObject API::beginMessage(bool is_response, const char *type)
 {
-    JsonDocument event;
-    if (is_response)
+    this->outgoingDoc.clear();
+    this->outgoingArena.reset();
+
+    this->outgoingDoc["event"] = is_response ? "RESPONSE" : "EVENT";
+    this->outgoingDoc["data"]["type"] = type;
+    return this->outgoingDoc["data"]["payload"].to<JsonObject>();
+}
+
+void API::sendPendingMessage()
+{
+    if (this->outgoingDoc.overflowed())
     {
-        event["event"] = "RESPONSE";
+        ArenaAllocator::Stats stats = this->outgoingArena.getStats();
+        logger.errorf("Outgoing message exceeds arena (%u bytes), dropping it", stats.capacity);
     }
     else
     {
-        event["event"] = "EVENT";
-    }
-    event["data"]["type"] = type;
-
-    // Create a copy of the payload in the destination document
-    JsonObject eventPayload = event["data"]["payload"].to<JsonObject>();
-    for (JsonPair p : payload)
-    {
-        eventPayload[p.key()] = p.value();
+        bool msgPack = this->outgoingEncoding == API_ENCODING_MSGPACK;
+        size_t length = msgPack ? measureMsgPack(this->outgoingDoc) : measureJson(this->outgoingDoc);
+        char *slot = State::reserveOutgoingWebsocketMessage(length);
+        if (slot == nullptr)
+        {
+            logger.error("Outgoing queue full, dropping message");
+        }
+        else
+        {
+            if (msgPack)
+            {
+                serializeMsgPack(this->outgoingDoc, slot, length);
+                logger.debugf("pushing message to queue: %u bytes MessagePack", (unsigned)length);
+            }
+            else
+            {
+                serializeJson(this->outgoingDoc, slot, length);
+                logger.debugf("pushing message to queue: %.*s", (int)length, slot);
+            }
+            State::commitOutgoingWebsocketMessage(slot);
+        }
     }
 
-    String payloadString = event["data"]["payload"].as<String>();
-
-    logger.debug(("Sending " + String(is_response ? "response" : "event") + " of type " + String(type) + " with payload " + payloadString).c_str());
+    logger.debugf("outgoing arena: used=%u highWater=%u allocations=%u",
+                  this->outgoingArena.used(),
+                  this->outgoingArena.getStats().highWater,
+                  this->outgoingArena.getStats().allocations);
 
-    String json;
-    serializeJson(event, json);
+    this->outgoingDoc.clear();
+    this->outgoingArena.reset();
+}
 
-    this->logger.info(("pushing message to queue: " + json).c_str());
-    State::pushOutgoingWebsocketMessageToQueue(json);
+void API::sendMessage(bool is_response, const char *type)
+{
+    this->beginMessage(is_response, type);
+    this->sendPendingMessage();
 }
 
 void API::onRequestAuthentication(JsonObject data)
@@ -308,43 +726,26 @@ void API::onRequestAuthentication(JsonObject data)
     }
 
     logger.info("Sending authentication request");
-    JsonDocument doc;
-    JsonObject payload = doc.to<JsonObject>();
-    payload["id"] = Settings::getAttraccessAuthConfig().readerId;
-    payload["token"] = Settings::getAttraccessAuthConfig().apiKey;
-    this->sendMessage(true, "READER_REQUEST_AUTHENTICATION", payload);
-}
-
-void API::sendHeartbeat()
-{
-    // send every 5 seconds
-    if (this->heartbeat_sent_at != 0 && millis() - this->heartbeat_sent_at < (1000 * 5))
-    {
-        return;
-    }
-
-    JsonDocument event;
-    event["event"] = "HEARTBEAT";
-
-    String json;
-    serializeJson(event, json);
-
-    this->logger.info(("pushing heartbeat to websocket queue: " + json).c_str());
-    State::pushOutgoingWebsocketMessageToQueue(json);
-
-    this->heartbeat_sent_at = millis();
+    AttraccessAuthConfig authConfig = Settings::getAttraccessAuthConfig();
+    JsonObject payload = this->beginMessage(true, "READER_REQUEST_AUTHENTICATION");
+    payload["id"] = authConfig.readerId;
+    payload["token"] = authConfig.apiKey;
+    // Offered encodings, the server picks one in READER_AUTHENTICATED
+    payload["encodings"].add("MSGPACK");
+    // Lets the server send the access list as a delta
+    payload["accessListVersion"] = this->accessList.getVersion();
+    this->sendPendingMessage();
 }
 
 void API::onFirmwareInfo(JsonObject data)
 {
     logger.info("Requested firmware info");
 
-    JsonDocument doc;
-    JsonObject response = doc.to<JsonObject>();
+    JsonObject response = this->beginMessage(true, "READER_FIRMWARE_INFO");
     response["name"] = FIRMWARE_NAME;
     response["variant"] = FIRMWARE_VARIANT;
     response["version"] = FIRMWARE_VERSION;
-    this->sendMessage(true, "READER_FIRMWARE_INFO", response);
+    this->sendPendingMessage();
 }
 
 void API::onReaderAuthenticated(JsonObject data)
@@ -352,22 +753,41 @@ void API::onReaderAuthenticated(JsonObject data)
     logger.info("READER_AUTHENTICATED");
 
     String deviceName = data["payload"]["name"].as<String>();
+    this->outgoingEncoding = data["payload"]["encoding"] == "MSGPACK" ? API_ENCODING_MSGPACK : API_ENCODING_JSON;
+    logger.infof("Using %s encoding", this->outgoingEncoding == API_ENCODING_MSGPACK ? "MessagePack" : "JSON");
 
     State::setApiState(true, deviceName);
+    this->sessionAuthenticated = true;
+
+    // Reaching the server is what an updated firmware has to prove
+    if (this->firmwareUpdate != nullptr)
+    {
+        this->firmwareUpdate->confirmRunningImage();
+    }
 
     logger.info("Reader Authentication successful.");
 }
 
 void API::onKeyPadConfirmPressed(String value)
 {
+    // The selection or confirmation asked for is gone with the session, so
+    // the input is only recorded; the server does not act on it after the fact
+    if (!this->sessionAuthenticated)
+    {
+        if (this->journalReady)
+        {
+            this->journalInput(TapJournal::ENTRY_KEYPAD_CONFIRM, (const uint8_t *)value.c_str(), value.length());
+        }
+        return;
+    }
+
     switch (State::getApiEventData().state)
     {
     case State::ApiEventState::API_EVENT_STATE_RESOURCE_SELECTION:
     {
-        JsonDocument doc;
-        JsonObject payload = doc.to<JsonObject>();
+        JsonObject payload = this->beginMessage(true, "SELECT_ITEM");
         payload["value"] = value;
-        this->sendMessage(true, "SELECT_ITEM", payload);
+        this->sendPendingMessage();
         break;
     }
     case State::ApiEventState::API_EVENT_STATE_CONFIRM_ACTION:
@@ -383,53 +803,143 @@ void API::onKeyPadConfirmPressed(String value)
 
 void API::onKeyPadCancelPressed()
 {
+    if (!this->sessionAuthenticated)
+    {
+        if (this->journalReady)
+        {
+            this->journalInput(TapJournal::ENTRY_KEYPAD_CANCEL, nullptr, 0);
+        }
+        return;
+    }
+
     this->logger.error("onKeyPadCancelPressed but not in a cancelable api state");
 }
 
 void API::onNfcCardDetected(String cardUid)
 {
     this->logger.info(("NFC card detected: " + cardUid).c_str());
-    JsonDocument doc;
-    JsonObject payload = doc.to<JsonObject>();
+
+    if (!this->sessionAuthenticated)
+    {
+        uint8_t uid[AccessList::MAX_UID_LENGTH];
+        size_t uidLength = 0;
+        if (!AccessList::parseUidHex(cardUid.c_str(), uid, uidLength))
+        {
+            this->logger.errorf("Offline: malformed card UID %s", cardUid.c_str());
+            return;
+        }
+
+        this->showOfflineDecision(this->accessList.lookup(uid, uidLength, millis()));
+        if (this->journalReady)
+        {
+            this->journalInput(TapJournal::ENTRY_NFC_TAP, uid, uidLength);
+        }
+        return;
+    }
+
+    JsonObject payload = this->beginMessage(false, "NFC_TAP");
     payload["cardUID"] = cardUid;
-    this->sendMessage(false, "NFC_TAP", payload);
+    this->sendPendingMessage();
+    this->nfc_tap_sent_at = millis();
 }
 
-void API::onNfcCardChangeKeySuccess(String payload)
+void API::showOfflineDecision(AccessList::Decision decision)
 {
-    this->logger.info(("NFC card change key success: " + payload).c_str());
     JsonDocument doc;
-    JsonObject responsePayload = doc.to<JsonObject>();
+    doc["offline"] = true;
+
+    switch (decision)
+    {
+    case AccessList::ACCESS_GRANTED:
+        // Only the UID was checked, the card did not authenticate; the server
+        // decides on the tap once the journal is replayed
+        this->logger.info("Offline: card is on the access list, tap recorded");
+        doc["message"] = "Recorded while offline";
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_SUCCESS, doc.as<JsonObject>());
+        break;
+    case AccessList::ACCESS_DENIED:
+        this->logger.info("Offline: card is not on the access list");
+        doc["message"] = "Access denied";
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_ERROR, doc.as<JsonObject>());
+        break;
+    default:
+        this->logger.info("Offline: no valid access list");
+        doc["message"] = "Server unreachable";
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_DISPLAY_ERROR, doc.as<JsonObject>());
+        break;
+    }
+
+    this->offlineDecisionShownAt = millis();
+}
+
+void API::clearOfflineDecision()
+{
+    this->offlineDecisionShownAt = 0;
+
+    // Leave anything the server sent in the meantime alone
+    State::ApiEventData current = State::getApiEventData();
+    if (State::isOfflineDecision(current))
+    {
+        State::setApiEventData(State::ApiEventState::API_EVENT_STATE_NONE, JsonObject());
+    }
+}
+
+bool API::logNfcResult(const char *result, uint32_t correlationId)
+{
+    if (correlationId != 0 && correlationId != this->nfc_command_correlation_id)
+    {
+        this->logger.errorf("NFC card %s for stale command #%u (latest #%u), not reported", result, correlationId, this->nfc_command_correlation_id);
+        return false;
+    }
+
+    this->logger.infof("NFC card %s (command #%u)", result, correlationId);
+    return true;
+}
+
+void API::onNfcCardChangeKeySuccess(uint32_t correlationId)
+{
+    if (!this->logNfcResult("change key success", correlationId))
+    {
+        return;
+    }
+
+    JsonObject responsePayload = this->beginMessage(true, "NFC_CHANGE_KEY");
     responsePayload["successful"] = true;
-    this->sendMessage(true, "NFC_CHANGE_KEY", responsePayload);
+    this->sendPendingMessage();
 }
 
-void API::onNfcCardChangeKeyFailed(String payload)
+void API::onNfcCardChangeKeyFailed(uint32_t correlationId)
 {
-    this->logger.error(("NFC card change key failed: " + payload).c_str());
+    if (!this->logNfcResult("change key failed", correlationId))
+    {
+        return;
+    }
 
-    JsonDocument doc;
-    JsonObject responsePayload = doc.to<JsonObject>();
+    JsonObject responsePayload = this->beginMessage(true, "NFC_CHANGE_KEY");
     responsePayload["successful"] = false;
-    this->sendMessage(true, "NFC_CHANGE_KEY", responsePayload);
+    this->sendPendingMessage();
 }
 
-void API::onNfcCardAuthenticateSuccess(String payload)
+void API::onNfcCardAuthenticateSuccess(uint32_t correlationId)
 {
-    this->logger.info(("NFC card authenticate success: " + payload).c_str());
+    if (!this->logNfcResult("authenticate success", correlationId))
+    {
+        return;
+    }
 
-    JsonDocument doc;
-    JsonObject responsePayload = doc.to<JsonObject>();
+    JsonObject responsePayload = this->beginMessage(true, "NFC_AUTHENTICATE");
     responsePayload["successful"] = true;
-    this->sendMessage(true, "NFC_AUTHENTICATE", responsePayload);
+    this->sendPendingMessage();
 }
 
-void API::onNfcCardAuthenticateFailed(String payload)
+void API::onNfcCardAuthenticateFailed(uint32_t correlationId)
 {
-    this->logger.error(("NFC card authenticate failed: " + payload).c_str());
+    if (!this->logNfcResult("authenticate failed", correlationId))
+    {
+        return;
+    }
 
-    JsonDocument doc;
-    JsonObject responsePayload = doc.to<JsonObject>();
+    JsonObject responsePayload = this->beginMessage(true, "NFC_AUTHENTICATE");
     responsePayload["successful"] = false;
-    this->sendMessage(true, "NFC_AUTHENTICATE", responsePayload);
+    this->sendPendingMessage();
 }
@@ -5,28 +5,51 @@
 #include "task_priorities.h"
 #include "state/state.hpp"
 #include "../logger/logger.hpp"
+#include "apiCommand.hpp"
+#include "arenaAllocator.hpp"
+#include "../metrics/latencyHistogram.hpp"
+#include "../journal/partitionJournalStorage.hpp"
+#include "../journal/tapJournal.hpp"
+#include "../accessList/accessList.hpp"
+#include "../firmwareUpdate/firmwareUpdate.hpp"
 
 class API
 {
 public:
-    API() : logger("API"), lastKnownAppStateChangeTime(0) {}
+    API() : logger("API"),
+            outgoingArena(outgoingArenaBuffer, sizeof(outgoingArenaBuffer)),
+            outgoingDoc(&outgoingArena),
+            journal(journalStorage) {}
 
-    void setup();
+    void setup(FirmwareUpdate *firmwareUpdate);
+
+    ArenaAllocator::Stats getOutgoingArenaStats() const { return outgoingArena.getStats(); }
+
+    // Time from pushing an NFC_TAP until the server's answer to it arrives
+    LatencyHistogram::Snapshot getTapLatency() const { return tapLatency.snapshot(); }
+
+    bool isJournalReady() const { return journalReady; }
+    TapJournal::Stats getJournalStats() const { return journal.getStats(); }
+    AccessList::Stats getAccessListStats() const { return accessList.getStats(); }
 
 private:
     static void taskFn(void *parameter);
     void loop();
     void processAvailableMessages();
+    void processDocumentCommand(ApiCommand &command);
     void processInputEvents();
 
     Logger logger;
 
     void updateSateInfo();
-    uint32_t lastKnownAppStateChangeTime;
-
-    bool loopIsEnabled = false;
+    EventGroupHandle_t stateSubscription = nullptr;
+    uint32_t pendingStateChanges = 0;
 
-    unsigned long heartbeat_sent_at = 0;
+    unsigned long nfc_tap_sent_at = 0;
+    LatencyHistogram tapLatency;
+    static const unsigned long TAP_ANSWER_TIMEOUT_MS = 10000;
+    // Whether a command is one the server sends in reaction to an NFC_TAP
+    static bool isTapAnswer(ApiCommandType type);
     bool isRegistered();
 
     String select_item_current_value = "";
@@ -34,22 +57,98 @@ private:
     String select_item_type = "";
     JsonArray select_item_options = JsonArray();
 
-    void sendAck(const char *type);
+    // Outgoing messages are built in a document backed by a static arena and
+    // serialized straight into a reserved slot of the outgoing ring.
+    static const size_t OUTGOING_ARENA_SIZE = 3072;
+    alignas(max_align_t) uint8_t outgoingArenaBuffer[OUTGOING_ARENA_SIZE];
+    ArenaAllocator outgoingArena;
+    JsonDocument outgoingDoc;
+
+    /*
+     *  Start a new outgoing message, discarding any unsent one
+     *  @return the payload object to fill before calling sendPendingMessage()
+     */
+    JsonObject beginMessage(bool is_response, const char *type);
+    void sendPendingMessage();
     void sendMessage(bool is_response, const char *type);
-    void sendMessage(bool is_response, const char *type, JsonObject payload);
-    void sendHeartbeat();
+
+    // Encoding of outgoing messages, MessagePack once the server confirmed it
+    // in READER_AUTHENTICATED for the current connection
+    ApiEncoding outgoingEncoding = API_ENCODING_JSON;
+
+    // Constant messages are emitted from byte templates without building a document
+    void sendTemplateMessage(const char *prefix, size_t prefixLength, const char *infix, size_t infixLength, const char *suffix, size_t suffixLength);
+    void sendAck(const char *type);
 
     void onRegistrationData(JsonObject data);
     void onUnauthorized(JsonObject data);
     void onRequestAuthentication(JsonObject data);
     void onReaderAuthenticated(JsonObject data);
     void onFirmwareInfo(JsonObject data);
+    void onNfcChangeKey(const ApiNfcChangeKeyCommand &changeKey, bool payloadValid);
+    void onNfcAuthenticate(const ApiNfcAuthenticateCommand &authenticate, bool payloadValid);
+    void onJournalEntryConfirmed(JsonObject data);
+    void onAccessListUpdate(JsonObject data);
+    void onFirmwareUpdateRequired(JsonObject payload);
+    void onFirmwareChunk(JsonObject data);
+
+    // Firmware download, stop and wait: the next chunk is only requested once
+    // the previous one was written
+    static const unsigned long FIRMWARE_CHUNK_TIMEOUT_MS = 10000;
+    static const uint8_t FIRMWARE_CHUNK_RETRIES = 3;
+    static const unsigned long FIRMWARE_RESTART_DELAY_MS = 2000;
+    static const uint8_t FIRMWARE_PROGRESS_STEP = 5;
+    FirmwareUpdate *firmwareUpdate = nullptr;
+    // Raw binary chunks carry no index, they are only accepted while one is requested
+    bool firmwareChunkRequested = false;
+    unsigned long firmwareChunkRequestedAt = 0;
+    uint8_t firmwareChunkRetries = 0;
+    uint8_t firmwareProgressShown = 0;
+    unsigned long firmwareRestartAt = 0;
+    void requestFirmwareChunk();
+    void serviceFirmwareUpdate();
+    void showFirmwareUpdateProgress(bool force);
+
+    // Taps and keypad input seen without an authenticated server session are kept on flash
+    // (first sectors of the otherwise unused spiffs partition) and replayed
+    // one at a time once the reader is authenticated again
+    static constexpr const char *JOURNAL_PARTITION_LABEL = "spiffs";
+    static const size_t JOURNAL_SECTORS = 16;
+    static const unsigned long JOURNAL_RETRY_MS = 5000;
+    PartitionJournalStorage journalStorage;
+    TapJournal journal;
+    bool journalReady = false;
+    // Cleared when the websocket drops, set again by READER_AUTHENTICATED
+    bool sessionAuthenticated = false;
+    // Id of the entry waiting for its confirmation, 0 if none
+    uint32_t journalEntryInFlight = 0;
+    unsigned long journalEntrySentAt = 0;
+    void setupJournal();
+    void journalInput(TapJournal::EntryKind kind, const uint8_t *data, size_t length);
+    void replayJournal();
+
+    // Answers taps from the cached access list while there is no server session
+    AccessList accessList;
+    static const unsigned long OFFLINE_DECISION_DISPLAY_MS = 3000;
+    unsigned long offlineDecisionShownAt = 0;
+    void showOfflineDecision(AccessList::Decision decision);
+    void clearOfflineDecision();
+
+    // Id of the last NfcCommand handed to the NFC task, used to match results
+    uint32_t nfc_command_correlation_id = 0;
+
+    /*
+     *  Log the result of an NFC command
+     *  @param correlationId: id of the command, 0 for commands answered without the NFC task
+     *  @return false if a newer command was sent since, the server no longer waits for this result
+     */
+    bool logNfcResult(const char *result, uint32_t correlationId);
 
     void onKeyPadConfirmPressed(String value);
     void onKeyPadCancelPressed();
     void onNfcCardDetected(String cardUid);
-    void onNfcCardChangeKeySuccess(String payload);
-    void onNfcCardChangeKeyFailed(String payload);
-    void onNfcCardAuthenticateSuccess(String payload);
-    void onNfcCardAuthenticateFailed(String payload);
+    void onNfcCardChangeKeySuccess(uint32_t correlationId);
+    void onNfcCardChangeKeyFailed(uint32_t correlationId);
+    void onNfcCardAuthenticateSuccess(uint32_t correlationId);
+    void onNfcCardAuthenticateFailed(uint32_t correlationId);
 };
\ No newline at end of file
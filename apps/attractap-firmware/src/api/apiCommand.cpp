@@ -0,0 +1,231 @@
+#include "apiCommand.hpp"
+
+namespace
+{
+    struct ApiCommandName
+    {
+        const char *name;
+        uint8_t length;
+        ApiCommandType type;
+    };
+
+#define API_COMMAND_NAME(name) {#name, sizeof(#name) - 1, API_COMMAND_##name}
+
+    // Scanned linearly; the length and first character are checked before the
+    // byte-wise compare, so a miss rarely costs more than two integer compares.
+    constexpr ApiCommandName API_COMMAND_NAMES[] = {
+        API_COMMAND_NAME(READER_REGISTER),
+        API_COMMAND_NAME(READER_UNAUTHORIZED),
+        API_COMMAND_NAME(READER_AUTHENTICATED),
+        API_COMMAND_NAME(READER_REQUEST_AUTHENTICATION),
+        API_COMMAND_NAME(READER_FIRMWARE_INFO),
+        API_COMMAND_NAME(READER_FIRMWARE_UPDATE_REQUIRED),
+        API_COMMAND_NAME(NFC_ENABLE_CARD_CHECKING),
+        API_COMMAND_NAME(WAIT_FOR_PROCESSING),
+        API_COMMAND_NAME(NFC_CHANGE_KEY),
+        API_COMMAND_NAME(NFC_AUTHENTICATE),
+        API_COMMAND_NAME(DISPLAY_SUCCESS),
+        API_COMMAND_NAME(DISPLAY_ERROR),
+        API_COMMAND_NAME(DISPLAY_TEXT),
+        API_COMMAND_NAME(SELECT_ITEM),
+        API_COMMAND_NAME(CONFIRM_ACTION),
+        API_COMMAND_NAME(HEARTBEAT),
+        API_COMMAND_NAME(READER_JOURNAL_ENTRY),
+        API_COMMAND_NAME(READER_ACCESS_LIST),
+        API_COMMAND_NAME(READER_FIRMWARE_STREAM_CHUNK),
+    };
+
+#undef API_COMMAND_NAME
+
+    inline int8_t hexNibble(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+}
+
+ApiCommandType ApiCommandDecoder::typeFromName(const char *name, size_t length)
+{
+    if (name == nullptr)
+    {
+        return API_COMMAND_UNKNOWN;
+    }
+
+    for (const ApiCommandName &entry : API_COMMAND_NAMES)
+    {
+        if (entry.length == length && entry.name[0] == name[0] && memcmp(entry.name, name, length) == 0)
+        {
+            return entry.type;
+        }
+    }
+
+    return API_COMMAND_UNKNOWN;
+}
+
+const char *ApiCommandDecoder::typeToName(ApiCommandType type)
+{
+    for (const ApiCommandName &entry : API_COMMAND_NAMES)
+    {
+        if (entry.type == type)
+        {
+            return entry.name;
+        }
+    }
+
+    return "UNKNOWN";
+}
+
+bool ApiCommandDecoder::hexToBytes(const char *hex, uint8_t *bytes, size_t length)
+{
+    memset(bytes, 0, length);
+
+    if (hex == nullptr || strlen(hex) != length * 2)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        int8_t high = hexNibble(hex[i * 2]);
+        int8_t low = hexNibble(hex[i * 2 + 1]);
+        if (high < 0 || low < 0)
+        {
+            return false;
+        }
+        bytes[i] = (uint8_t)((high << 4) | low);
+    }
+
+    return true;
+}
+
+bool ApiCommandDecoder::decode(const char *message, size_t length, ApiCommand &command, JsonDocument &scratch, ApiEncoding encoding)
+{
+    memset(&command, 0, sizeof(command));
+    command.type = API_COMMAND_UNKNOWN;
+    command.document = nullptr;
+
+    JsonDocument *doc = &scratch;
+    DeserializationError error = encoding == API_ENCODING_MSGPACK
+                                     ? deserializeMsgPack(*doc, message, length)
+                                     : deserializeJson(*doc, message, length);
+    if (error == DeserializationError::NoMemory)
+    {
+        // Larger than the scratch arena (e.g. a MessagePack firmware chunk)
+        scratch.clear();
+        doc = new JsonDocument();
+        error = encoding == API_ENCODING_MSGPACK
+                    ? deserializeMsgPack(*doc, message, length)
+                    : deserializeJson(*doc, message, length);
+        command.document = doc;
+    }
+    if (error)
+    {
+        release(command);
+        return false;
+    }
+
+    JsonObject data = (*doc)["data"].as<JsonObject>();
+    const char *name = data["type"].as<const char *>();
+    if (name == nullptr)
+    {
+        release(command);
+        return false;
+    }
+
+    size_t nameLength = strlen(name);
+    command.type = typeFromName(name, nameLength);
+    strncpy(command.name, name, sizeof(command.name) - 1);
+
+    JsonObject payload = data["payload"].as<JsonObject>();
+
+    switch (command.type)
+    {
+    case API_COMMAND_NFC_CHANGE_KEY:
+    {
+        ApiNfcChangeKeyCommand &changeKey = command.nfcChangeKey;
+        changeKey.keyNumber = payload["keyNumber"].as<uint8_t>();
+        bool valid = payload["keyNumber"].is<uint8_t>();
+        valid = hexToBytes(payload["authKey"].as<const char *>(), changeKey.authKey, API_COMMAND_KEY_LENGTH) && valid;
+        valid = hexToBytes(payload["oldKey"].as<const char *>(), changeKey.oldKey, API_COMMAND_KEY_LENGTH) && valid;
+        valid = hexToBytes(payload["newKey"].as<const char *>(), changeKey.newKey, API_COMMAND_KEY_LENGTH) && valid;
+        command.payloadValid = valid;
+        release(command);
+        return true;
+    }
+
+    case API_COMMAND_NFC_AUTHENTICATE:
+    {
+        ApiNfcAuthenticateCommand &authenticate = command.nfcAuthenticate;
+        authenticate.keyNumber = payload["keyNumber"].as<uint8_t>();
+        bool valid = payload["keyNumber"].is<uint8_t>();
+        valid = hexToBytes(payload["authenticationKey"].as<const char *>(), authenticate.authKey, API_COMMAND_KEY_LENGTH) && valid;
+        command.payloadValid = valid;
+        release(command);
+        return true;
+    }
+
+    default:
+        command.payloadValid = true;
+        return true;
+    }
+}
+
+bool ApiCommandDecoder::detach(ApiCommand &command, const JsonDocument &scratch)
+{
+    // Typed commands carry their payload with them
+    if (command.document != nullptr || command.type == API_COMMAND_NFC_CHANGE_KEY || command.type == API_COMMAND_NFC_AUTHENTICATE)
+    {
+        return true;
+    }
+
+    // Not a copy construction, that would keep using the scratch document's allocator
+    JsonDocument *doc = new JsonDocument();
+    if (!doc->set(scratch) || doc->overflowed())
+    {
+        delete doc;
+        return false;
+    }
+
+    command.document = doc;
+    return true;
+}
+
+JsonObjectConst ApiCommandDecoder::payloadOf(const ApiCommand &command, const JsonDocument &scratch)
+{
+    const JsonDocument &doc = command.document != nullptr ? *command.document : scratch;
+    return doc["data"]["payload"].as<JsonObjectConst>();
+}
+
+bool ApiCommandDecoder::wrapFirmwareChunk(const uint8_t *data, size_t length, ApiCommand &command)
+{
+    memset(&command, 0, sizeof(command));
+    command.type = API_COMMAND_READER_FIRMWARE_STREAM_CHUNK;
+    strncpy(command.name, typeToName(command.type), sizeof(command.name) - 1);
+
+    JsonDocument *doc = new JsonDocument();
+    JsonObject dataObject = (*doc)["data"].to<JsonObject>();
+    dataObject["type"] = command.name;
+    if (!dataObject["payload"]["data"].set(MsgPackBinary(data, length)))
+    {
+        delete doc;
+        return false;
+    }
+
+    command.payloadValid = true;
+    command.document = doc;
+    return true;
+}
+
+void ApiCommandDecoder::release(ApiCommand &command)
+{
+    if (command.document != nullptr)
+    {
+        delete command.document;
+        command.document = nullptr;
+    }
+}
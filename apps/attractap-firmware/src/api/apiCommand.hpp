@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Commands the server can send to the reader (see AttractapEventType in the api app)
+enum ApiCommandType : uint8_t
+{
+    API_COMMAND_UNKNOWN = 0,
+    API_COMMAND_READER_REGISTER,
+    API_COMMAND_READER_UNAUTHORIZED,
+    API_COMMAND_READER_AUTHENTICATED,
+    API_COMMAND_READER_REQUEST_AUTHENTICATION,
+    API_COMMAND_READER_FIRMWARE_INFO,
+    API_COMMAND_READER_FIRMWARE_UPDATE_REQUIRED,
+    API_COMMAND_NFC_ENABLE_CARD_CHECKING,
+    API_COMMAND_WAIT_FOR_PROCESSING,
+    API_COMMAND_NFC_CHANGE_KEY,
+    API_COMMAND_NFC_AUTHENTICATE,
+    API_COMMAND_DISPLAY_SUCCESS,
+    API_COMMAND_DISPLAY_ERROR,
+    API_COMMAND_DISPLAY_TEXT,
+    API_COMMAND_SELECT_ITEM,
+    API_COMMAND_CONFIRM_ACTION,
+    // Echo of a heartbeat, consumed by the websocket task
+    API_COMMAND_HEARTBEAT,
+    // Server confirmation of a replayed journal entry
+    API_COMMAND_READER_JOURNAL_ENTRY,
+    // Update of the offline access list, answered instead of ACKed
+    API_COMMAND_READER_ACCESS_LIST,
+    // Chunk of a firmware image, answered by requesting the next one
+    API_COMMAND_READER_FIRMWARE_STREAM_CHUNK,
+};
+
+// Wire encoding of a websocket message. JSON travels in text frames, MessagePack
+// (negotiated during READER_REQUEST_AUTHENTICATION) in binary frames.
+enum ApiEncoding : uint8_t
+{
+    API_ENCODING_JSON = 0,
+    API_ENCODING_MSGPACK,
+};
+
+static const size_t API_COMMAND_KEY_LENGTH = 16;
+static const size_t API_COMMAND_NAME_MAX_LEN = 40;
+
+struct ApiNfcChangeKeyCommand
+{
+    uint8_t keyNumber;
+    uint8_t authKey[API_COMMAND_KEY_LENGTH];
+    uint8_t oldKey[API_COMMAND_KEY_LENGTH];
+    uint8_t newKey[API_COMMAND_KEY_LENGTH];
+};
+
+struct ApiNfcAuthenticateCommand
+{
+    uint8_t keyNumber;
+    uint8_t authKey[API_COMMAND_KEY_LENGTH];
+};
+
+// Pre-decoded server command, trivially copyable so it can travel through a FreeRTOS queue
+struct ApiCommand
+{
+    ApiCommandType type;
+
+    // Event type as sent by the server, needed for the ACK and for logging
+    char name[API_COMMAND_NAME_MAX_LEN];
+
+    // False if a typed payload was missing fields or had malformed keys
+    bool payloadValid;
+
+    // Typed payload of the hot (NFC) commands
+    union
+    {
+        ApiNfcChangeKeyCommand nfcChangeKey;
+        ApiNfcAuthenticateCommand nfcAuthenticate;
+    };
+
+    // Parsed message for all other commands once detached from the decode
+    // document, owned by the receiver (see ApiCommandDecoder::release)
+    JsonDocument *document;
+};
+
+class ApiCommandDecoder
+{
+public:
+    /*
+     *  Parse a raw websocket message into a command
+     *  @param message: message bytes (JSON text does not need to be null terminated)
+     *  @param length: length of the message
+     *  @param command: the decoded command
+     *  @param scratch: empty document the message is parsed into, usually backed by an
+     *                  arena of the decoding task. Messages that do not fit are parsed into
+     *                  a heap document set as command.document instead.
+     *  @param encoding: wire encoding of the message
+     *  @return true if the message was valid with a data.type field (check payloadValid for the payload)
+     */
+    static bool decode(const char *message, size_t length, ApiCommand &command, JsonDocument &scratch, ApiEncoding encoding = API_ENCODING_JSON);
+
+    /*
+     *  Give a command parsed into the scratch document its own heap document,
+     *  needed before it is handed to another task or the scratch document is reused
+     *  @return false if there is not enough memory
+     */
+    static bool detach(ApiCommand &command, const JsonDocument &scratch);
+
+    /*
+     *  Parsed message of a decoded command, in its own document or in the scratch one
+     */
+    static JsonObjectConst payloadOf(const ApiCommand &command, const JsonDocument &scratch);
+
+    /*
+     *  Wrap a raw binary frame (a firmware chunk on JSON connections) into a
+     *  READER_FIRMWARE_STREAM_CHUNK command shaped like the MessagePack one, without chunkIndex
+     *  @return false if there is not enough memory
+     */
+    static bool wrapFirmwareChunk(const uint8_t *data, size_t length, ApiCommand &command);
+
+    /*
+     *  Free the resources held by a decoded command
+     */
+    static void release(ApiCommand &command);
+
+    static ApiCommandType typeFromName(const char *name, size_t length);
+    static const char *typeToName(ApiCommandType type);
+
+private:
+    ApiCommandDecoder() = delete;
+
+    static bool hexToBytes(const char *hex, uint8_t *bytes, size_t length);
+};
@@ -0,0 +1,100 @@
+#include "arenaAllocator.hpp"
+
+ArenaAllocator::ArenaAllocator(uint8_t *buffer, size_t size) : buffer(buffer), size(size)
+{
+    stats = {size, 0, 0, 0};
+}
+
+size_t ArenaAllocator::align(size_t size)
+{
+    const size_t alignment = alignof(max_align_t);
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+void *ArenaAllocator::allocate(size_t requested)
+{
+    size_t blockSize = align(sizeof(BlockHeader)) + align(requested);
+    if (offset + blockSize > size)
+    {
+        stats.failedAllocations++;
+        return nullptr;
+    }
+
+    BlockHeader *header = reinterpret_cast<BlockHeader *>(buffer + offset);
+    header->size = requested;
+
+    lastBlockOffset = offset;
+    offset += blockSize;
+
+    stats.allocations++;
+    if (offset > stats.highWater)
+    {
+        stats.highWater = offset;
+    }
+
+    return reinterpret_cast<uint8_t *>(header) + align(sizeof(BlockHeader));
+}
+
+void ArenaAllocator::deallocate(void *pointer)
+{
+    if (pointer == nullptr || lastBlockOffset == SIZE_MAX)
+    {
+        return;
+    }
+
+    // Only the most recent block can be given back without fragmenting the arena
+    uint8_t *lastBlock = buffer + lastBlockOffset + align(sizeof(BlockHeader));
+    if (pointer == lastBlock)
+    {
+        offset = lastBlockOffset;
+        lastBlockOffset = SIZE_MAX;
+    }
+}
+
+void *ArenaAllocator::reallocate(void *pointer, size_t newSize)
+{
+    if (pointer == nullptr)
+    {
+        return allocate(newSize);
+    }
+
+    BlockHeader *header = reinterpret_cast<BlockHeader *>(reinterpret_cast<uint8_t *>(pointer) - align(sizeof(BlockHeader)));
+
+    // The most recent block can grow or shrink in place
+    if (lastBlockOffset != SIZE_MAX && reinterpret_cast<uint8_t *>(header) == buffer + lastBlockOffset)
+    {
+        size_t blockSize = align(sizeof(BlockHeader)) + align(newSize);
+        if (lastBlockOffset + blockSize > size)
+        {
+            stats.failedAllocations++;
+            return nullptr;
+        }
+
+        header->size = newSize;
+        offset = lastBlockOffset + blockSize;
+        if (offset > stats.highWater)
+        {
+            stats.highWater = offset;
+        }
+        return pointer;
+    }
+
+    if (newSize <= header->size)
+    {
+        header->size = newSize;
+        return pointer;
+    }
+
+    void *moved = allocate(newSize);
+    if (moved != nullptr)
+    {
+        memcpy(moved, pointer, header->size);
+    }
+    return moved;
+}
+
+void ArenaAllocator::reset()
+{
+    offset = 0;
+    lastBlockOffset = SIZE_MAX;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Bump allocator over a caller-provided buffer for short-lived JsonDocuments.
+// Individual frees are ignored (except for the most recent block), all memory
+// is returned at once with reset(). Allocations beyond the buffer fail, which
+// ArduinoJson reports through JsonDocument::overflowed().
+class ArenaAllocator : public ArduinoJson::Allocator
+{
+public:
+    struct Stats
+    {
+        size_t capacity;
+        size_t highWater;
+        uint32_t allocations;
+        uint32_t failedAllocations;
+    };
+
+    ArenaAllocator(uint8_t *buffer, size_t size);
+
+    void *allocate(size_t size) override;
+    void deallocate(void *pointer) override;
+    void *reallocate(void *pointer, size_t newSize) override;
+
+    // Release all blocks; documents using the arena must be cleared first
+    void reset();
+
+    size_t used() const { return offset; }
+    Stats getStats() const { return stats; }
+
+private:
+    // Each block is preceded by its size so reallocate() can copy it
+    struct BlockHeader
+    {
+        size_t size;
+    };
+
+    static size_t align(size_t size);
+
+    uint8_t *buffer;
+    size_t size;
+    size_t offset = 0;
+    size_t lastBlockOffset = SIZE_MAX;
+
+    Stats stats;
+};
@@ -38,6 +38,7 @@ static const char *displayStateToString(IDisplay::DisplayState state)
 void DisplayManager::setup()
 {
     this->display->setup();
+    this->stateSubscription = State::subscribe(State::STATE_CHANGE_ALL);
 
     this->logger.infof("Creating DisplayManager task with stack %u bytes", 4096u);
     xTaskCreate(DisplayManager::taskFn, "DisplayManager", 4096, this, TASK_PRIORITY_DISPLAY_MANAGER, NULL);
@@ -58,7 +59,7 @@ void DisplayManager::taskFn(void *parameter)
     while (true)
     {
         displayManager->loop();
-        vTaskDelay(updateIntervalMs / portTICK_PERIOD_MS);
+        displayManager->pendingStateChanges |= State::waitForChanges(displayManager->stateSubscription, updateIntervalMs);
     }
 }
 
@@ -79,29 +80,30 @@ void DisplayManager::loop()
 
 void DisplayManager::checkForAppStateChange()
 {
-    uint32_t lastAppStateChangeTime = State::getLastStateChangeTime();
+    const uint32_t appStateDomains = State::STATE_CHANGE_NETWORK | State::STATE_CHANGE_WEBSOCKET | State::STATE_CHANGE_API | State::STATE_CHANGE_KEYPAD;
 
-    // Pull latest global states
-    State::NetworkState networkState = State::getNetworkState();
-    State::WebsocketState webSocketState = State::getWebsocketState();
-    State::ApiState apiState = State::getApiState();
-
-    if (this->lastKnownAppStateChangeTime < lastAppStateChangeTime)
+    if (this->pendingStateChanges & appStateDomains)
     {
-        this->lastKnownAppStateChangeTime = lastAppStateChangeTime;
-        this->cachedNetworkState = networkState;
-        this->cachedWebsocketState = webSocketState;
-        this->cachedApiState = apiState;
+        this->pendingStateChanges &= ~appStateDomains;
+
+        // Pull latest global states only when one of them changed
+        this->cachedNetworkState = State::getNetworkState();
+        this->cachedWebsocketState = State::getWebsocketState();
+        this->cachedApiState = State::getApiState();
 
         this->logger.debugf("App state changed: wifi=%d eth=%d ws=%d apiAuth=%d",
-                            networkState.wifi_connected,
-                            networkState.ethernet_connected,
-                            webSocketState.connected,
-                            apiState.authenticated);
+                            this->cachedNetworkState.wifi_connected,
+                            this->cachedNetworkState.ethernet_connected,
+                            this->cachedWebsocketState.connected,
+                            this->cachedApiState.authenticated);
 
         this->needsUpdate = true;
     }
 
+    const State::NetworkState &networkState = this->cachedNetworkState;
+    const State::WebsocketState &webSocketState = this->cachedWebsocketState;
+    const State::ApiState &apiState = this->cachedApiState;
+
     // Manager no longer decides instant redraw or transitions; display computes state
     // We still keep a computed state for potential future usage/logging
     if (millis() < this->_bootTime + this->BOOT_DURATION_MS)
@@ -128,20 +130,23 @@ void DisplayManager::checkForAppStateChange()
 
 void DisplayManager::checkForApiEvent()
 {
-    State::NetworkState networkState = State::getNetworkState();
-    State::WebsocketState webSocketState = State::getWebsocketState();
-    State::ApiState apiState = State::getApiState();
-    if (!(webSocketState.connected && apiState.authenticated &&
-          (networkState.wifi_connected || networkState.ethernet_connected)))
-    {
-        return;
-    }
+    const State::NetworkState &networkState = this->cachedNetworkState;
+    const State::WebsocketState &webSocketState = this->cachedWebsocketState;
+    const State::ApiState &apiState = this->cachedApiState;
+    bool online = webSocketState.connected && apiState.authenticated &&
+                  (networkState.wifi_connected || networkState.ethernet_connected);
 
-    uint32_t lastApiEventTime = State::getLastApiEventTime();
-    if (this->lastKnownApiEventTime < lastApiEventTime)
+    if (this->pendingStateChanges & State::STATE_CHANGE_API_EVENT)
     {
-        this->lastKnownApiEventTime = lastApiEventTime;
-        this->apiEventData = State::getApiEventData();
+        // Offline only decisions of the reader itself (and their removal) get through
+        State::ApiEventData apiEventData = State::getApiEventData();
+        if (!online && !State::isOfflineDecision(apiEventData) && !State::isOfflineDecision(this->apiEventData))
+        {
+            return;
+        }
+
+        this->pendingStateChanges &= ~State::STATE_CHANGE_API_EVENT;
+        this->apiEventData = apiEventData;
         const char *typeStr = this->apiEventData.payload["type"].is<const char *>() ? this->apiEventData.payload["type"].as<const char *>() : "";
         this->logger.infof("New API event: state=%d type=%s", this->apiEventData.state, typeStr);
         this->needsUpdate = true;
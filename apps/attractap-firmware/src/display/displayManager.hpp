@@ -14,8 +14,6 @@ public:
           _bootTime(millis()),
           _state(IDisplay::DisplayState::DISPLAY_STATE_BOOTING),
           _nextState(IDisplay::DisplayState::DISPLAY_STATE_BOOTING),
-          lastKnownAppStateChangeTime(0),
-          lastKnownApiEventTime(0),
           needsUpdate(true),
           cachedNetworkState({}),
           cachedWebsocketState({}),
@@ -38,11 +36,12 @@ private:
     IDisplay::DisplayState _state;
     IDisplay::DisplayState _nextState;
 
-    uint32_t lastKnownAppStateChangeTime;
+    EventGroupHandle_t stateSubscription = nullptr;
+    uint32_t pendingStateChanges = 0;
+
     void checkForAppStateChange();
 
     State::ApiEventData apiEventData;
-    uint32_t lastKnownApiEventTime;
     void checkForApiEvent();
 
     bool needsUpdate;
@@ -124,6 +124,11 @@ IDisplay::DisplayState OLED::computeDesiredState() const
         return DISPLAY_STATE_BOOTING;
     }
 
+    if (State::isOfflineDecision(this->apiEventData))
+    {
+        return this->apiEventData.state == State::ApiEventState::API_EVENT_STATE_DISPLAY_SUCCESS ? DISPLAY_STATE_SUCCESS : DISPLAY_STATE_ERROR;
+    }
+
     if (!networkState.wifi_connected && !networkState.ethernet_connected)
     {
         return DISPLAY_STATE_WAITING_FOR_NETWORK;
@@ -437,6 +442,13 @@ void OLED::draw_confirm_action_ui()
 
 void OLED::draw_firmware_update_ui()
 {
+    JsonObject payload = this->apiEventData.payload;
+    if (payload["progress"].is<uint8_t>())
+    {
+        this->draw_two_line_message("Updating Firmware", String(payload["progress"].as<uint8_t>()) + "%");
+        return;
+    }
+
     this->draw_two_line_message("Updating Firmware", "Please wait...");
 }
 
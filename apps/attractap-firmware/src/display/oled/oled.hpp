@@ -23,7 +23,8 @@ public:
 #ifdef SCREEN_DRIVER_SH1106
     OLED() : logger("OLED"), screen(SCREEN_RESET) {}
 #elif defined(SCREEN_DRIVER_SSD1306)
-    OLED() : logger("OLED"), screen(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, SCREEN_RESET) {}
+    // Keep the bus clock, the driver drops to 100 kHz after every update by default
+    OLED() : logger("OLED"), screen(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, SCREEN_RESET, I2C_FREQ, I2C_FREQ) {}
 #endif
 
     void setup() override;
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Flash slot below the FirmwareUpdate that a new application image is
+// streamed into, written strictly in order from its start
+class FirmwareSlot
+{
+public:
+    virtual ~FirmwareSlot() {}
+
+    /*
+     *  Prepare the slot (erasing what is needed) for a new image
+     *  @param imageSize: size of the whole image in bytes
+     */
+    virtual bool begin(size_t imageSize) = 0;
+
+    // Append the next part of the image
+    virtual bool write(const uint8_t *data, size_t length) = 0;
+
+    // Validate the complete image and boot it on the next restart
+    virtual bool finish() = 0;
+
+    // Give up on the image, the slot is left unbootable
+    virtual void abort() = 0;
+
+    // Reason of the last failed call, for logging
+    virtual const char *lastError() const = 0;
+};
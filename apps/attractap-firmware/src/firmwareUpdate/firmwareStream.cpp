@@ -0,0 +1,198 @@
+#include "firmwareStream.hpp"
+
+#include <string.h>
+
+FirmwareStream::~FirmwareStream()
+{
+    this->releaseHash();
+}
+
+bool FirmwareStream::start(size_t totalSize, uint32_t chunks, const uint8_t *sha256)
+{
+    if (this->status == STREAM_RECEIVING)
+    {
+        this->abort("replaced by a new image");
+    }
+
+    this->status = STREAM_IDLE;
+    this->error = nullptr;
+    this->totalSize = totalSize;
+    this->chunks = chunks;
+    this->nextChunk = 0;
+    this->bytesWritten = 0;
+
+    this->verifyHash = sha256 != nullptr;
+    if (this->verifyHash)
+    {
+        memcpy(this->expectedHash, sha256, SHA256_LENGTH);
+    }
+
+    if (totalSize == 0 || chunks == 0)
+    {
+        this->fail("empty image");
+        return false;
+    }
+
+    if (!this->slot.begin(totalSize))
+    {
+        this->fail(this->slot.lastError());
+        return false;
+    }
+
+    mbedtls_sha256_init(&this->hash);
+    this->hashActive = true;
+    mbedtls_sha256_starts_ret(&this->hash, 0);
+
+    this->status = STREAM_RECEIVING;
+    return true;
+}
+
+bool FirmwareStream::isReceiving(size_t totalSize, const uint8_t *sha256) const
+{
+    return this->status == STREAM_RECEIVING &&
+           this->totalSize == totalSize &&
+           this->verifyHash && sha256 != nullptr &&
+           memcmp(this->expectedHash, sha256, SHA256_LENGTH) == 0;
+}
+
+FirmwareStream::ChunkResult FirmwareStream::processChunk(int32_t chunkIndex, const uint8_t *data, size_t length)
+{
+    if (this->status != STREAM_RECEIVING)
+    {
+        return CHUNK_IGNORED;
+    }
+
+    if (chunkIndex >= 0 && (uint32_t)chunkIndex != this->nextChunk)
+    {
+        return CHUNK_IGNORED;
+    }
+
+    if (length == 0 || length > this->totalSize - this->bytesWritten)
+    {
+        return this->fail("chunk exceeds the announced image size");
+    }
+
+    if (this->nextChunk == 0 && data[0] != IMAGE_MAGIC)
+    {
+        return this->fail("not an application image");
+    }
+
+    if (!this->slot.write(data, length))
+    {
+        return this->fail(this->slot.lastError());
+    }
+
+    mbedtls_sha256_update_ret(&this->hash, data, length);
+    this->bytesWritten += length;
+    this->nextChunk++;
+
+    if (this->bytesWritten == this->totalSize)
+    {
+        return this->complete();
+    }
+
+    if (this->nextChunk >= this->chunks)
+    {
+        return this->fail("image ended early");
+    }
+
+    return CHUNK_WRITTEN;
+}
+
+FirmwareStream::ChunkResult FirmwareStream::complete()
+{
+    uint8_t actualHash[SHA256_LENGTH];
+    mbedtls_sha256_finish_ret(&this->hash, actualHash);
+    this->releaseHash();
+
+    if (this->verifyHash && memcmp(actualHash, this->expectedHash, SHA256_LENGTH) != 0)
+    {
+        return this->fail("SHA-256 mismatch");
+    }
+
+    if (!this->slot.finish())
+    {
+        return this->fail(this->slot.lastError());
+    }
+
+    this->status = STREAM_COMPLETE;
+    return CHUNK_COMPLETE;
+}
+
+void FirmwareStream::abort(const char *reason)
+{
+    if (this->status == STREAM_RECEIVING)
+    {
+        this->fail(reason);
+    }
+}
+
+FirmwareStream::ChunkResult FirmwareStream::fail(const char *reason)
+{
+    this->slot.abort();
+    this->releaseHash();
+    this->status = STREAM_FAILED;
+    this->error = reason;
+    return CHUNK_FAILED;
+}
+
+void FirmwareStream::releaseHash()
+{
+    if (this->hashActive)
+    {
+        mbedtls_sha256_free(&this->hash);
+        this->hashActive = false;
+    }
+}
+
+FirmwareStream::Progress FirmwareStream::getProgress() const
+{
+    Progress progress;
+    progress.status = this->status;
+    progress.nextChunk = this->nextChunk;
+    progress.chunks = this->chunks;
+    progress.bytesWritten = this->bytesWritten;
+    progress.totalSize = this->totalSize;
+    progress.error = this->error;
+    return progress;
+}
+
+bool FirmwareStream::parseSha256(const char *hex, uint8_t sha256[SHA256_LENGTH])
+{
+    if (hex == nullptr || strlen(hex) != SHA256_LENGTH * 2)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < SHA256_LENGTH * 2; i++)
+    {
+        char c = hex[i];
+        uint8_t nibble;
+        if (c >= '0' && c <= '9')
+        {
+            nibble = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            nibble = c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            nibble = c - 'A' + 10;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (i % 2 == 0)
+        {
+            sha256[i / 2] = nibble << 4;
+        }
+        else
+        {
+            sha256[i / 2] |= nibble;
+        }
+    }
+    return true;
+}
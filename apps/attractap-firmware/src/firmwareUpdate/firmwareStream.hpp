@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mbedtls/sha256.h"
+#include "firmwareSlot.hpp"
+
+// Receives an application image chunk by chunk and writes every chunk
+// straight to a FirmwareSlot, hashing it on the way. Neither the image nor
+// more than the chunk at hand is ever held in RAM. Chunks are requested one
+// at a time, so they must arrive in order; a chunk that is not the next one
+// (a late duplicate after a retry) is ignored.
+//
+// The image only becomes bootable once all of it was written, its SHA-256
+// matched the one the server announced and the slot accepted it.
+//
+// Plain logic on top of FirmwareSlot without ESP-IDF/Arduino dependencies.
+class FirmwareStream
+{
+public:
+    static const size_t SHA256_LENGTH = 32;
+
+    enum Status
+    {
+        STREAM_IDLE,
+        STREAM_RECEIVING,
+        // Verified and set as boot image, active after the next restart
+        STREAM_COMPLETE,
+        STREAM_FAILED,
+    };
+
+    enum ChunkResult
+    {
+        CHUNK_WRITTEN,
+        CHUNK_IGNORED,
+        CHUNK_COMPLETE,
+        CHUNK_FAILED,
+    };
+
+    struct Progress
+    {
+        Status status;
+        uint32_t nextChunk;
+        uint32_t chunks;
+        uint32_t bytesWritten;
+        uint32_t totalSize;
+        // Why the stream failed, nullptr otherwise
+        const char *error;
+    };
+
+    explicit FirmwareStream(FirmwareSlot &slot) : slot(slot) {}
+    ~FirmwareStream();
+
+    /*
+     *  Start receiving a new image, abandoning an unfinished one
+     *  @param totalSize: image size in bytes
+     *  @param chunks: number of chunks the server split the image into
+     *  @param sha256: expected hash of the image, nullptr to only rely on the slot's own check
+     *  @return false if the slot could not be prepared
+     */
+    bool start(size_t totalSize, uint32_t chunks, const uint8_t *sha256);
+
+    // True if the image being received is this one, so it can be continued
+    bool isReceiving(size_t totalSize, const uint8_t *sha256) const;
+
+    /*
+     *  Write the next chunk
+     *  @param chunkIndex: index sent along with the chunk, -1 if unknown
+     */
+    ChunkResult processChunk(int32_t chunkIndex, const uint8_t *data, size_t length);
+
+    void abort(const char *reason);
+
+    Progress getProgress() const;
+
+    // Parse a hex encoded SHA-256 as sent by the server
+    static bool parseSha256(const char *hex, uint8_t sha256[SHA256_LENGTH]);
+
+private:
+    // First byte of every ESP application image
+    static const uint8_t IMAGE_MAGIC = 0xE9;
+
+    FirmwareSlot &slot;
+    Status status = STREAM_IDLE;
+    const char *error = nullptr;
+
+    size_t totalSize = 0;
+    uint32_t chunks = 0;
+    uint32_t nextChunk = 0;
+    size_t bytesWritten = 0;
+
+    bool verifyHash = false;
+    uint8_t expectedHash[SHA256_LENGTH] = {};
+    mbedtls_sha256_context hash;
+    bool hashActive = false;
+
+    ChunkResult fail(const char *reason);
+    ChunkResult complete();
+    void releaseHash();
+};
@@ -1,22 +1,156 @@
 #include "firmwareUpdate.hpp"
 
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "../settings/settings.hpp"
+
+namespace
+{
+    // Restarts the image caused itself; power cycles, the reset button and
+    // intended restarts say nothing about its health
+    bool isCrashRestart(esp_reset_reason_t reason)
+    {
+        switch (reason)
+        {
+        case ESP_RST_PANIC:
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+            return true;
+        default:
+            return false;
+        }
+    }
+}
+
 void FirmwareUpdate::setup()
 {
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    logger.infof("Running firmware %s from partition %s", FIRMWARE_VERSION, running->label);
+
+    String previous;
+    uint8_t boots = 0;
+    if (!Settings::getFirmwareTrial(previous, boots))
+    {
+        return;
+    }
+
+    if (previous == running->label)
+    {
+        // Either the new image never started or the bootloader already went back
+        logger.error("Updated firmware did not boot, still on the previous one");
+        Settings::clearFirmwareTrial();
+        return;
+    }
+
+    this->onTrial = true;
+
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (!isCrashRestart(reason))
+    {
+        logger.infof("Updated firmware on trial, %u of %u crashes so far (reset reason %d)", boots, MAX_TRIAL_BOOTS, reason);
+        return;
+    }
+
+    boots++;
+    if (boots > MAX_TRIAL_BOOTS)
+    {
+        logger.errorf("Updated firmware crashed %u times without reaching the server, rolling back to %s", MAX_TRIAL_BOOTS, previous.c_str());
+        Settings::clearFirmwareTrial();
+
+        const esp_partition_t *fallback = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, previous.c_str());
+        if (fallback != nullptr && esp_ota_set_boot_partition(fallback) == ESP_OK)
+        {
+            esp_restart();
+        }
+        logger.error("Rollback failed, keeping the updated firmware");
+        this->onTrial = false;
+        return;
+    }
+
+    Settings::saveFirmwareTrial(previous, boots);
+    logger.errorf("Updated firmware on trial crashed (reset reason %d), crash %u of %u", reason, boots, MAX_TRIAL_BOOTS);
 }
 
-void FirmwareUpdate::loop()
+bool FirmwareUpdate::start(size_t totalSize, uint32_t chunks, const char *sha256Hex)
 {
+    uint8_t sha256[FirmwareStream::SHA256_LENGTH];
+    bool hasHash = FirmwareStream::parseSha256(sha256Hex, sha256);
+    if (!hasHash)
+    {
+        logger.error("No SHA-256 for the new firmware, relying on the image check only");
+    }
+
+    // Announced again after a reconnect
+    if (this->stream.isReceiving(totalSize, hasHash ? sha256 : nullptr))
+    {
+        logger.infof("Continuing firmware download at chunk %u of %u", this->stream.getProgress().nextChunk, chunks);
+        return true;
+    }
+
+    if (!this->stream.start(totalSize, chunks, hasHash ? sha256 : nullptr))
+    {
+        logger.errorf("Cannot start firmware update: %s", this->stream.getProgress().error);
+        return false;
+    }
+
+    logger.infof("Downloading firmware: %u bytes in %u chunks", totalSize, chunks);
+    return true;
 }
 
-void FirmwareUpdate::start()
+FirmwareStream::ChunkResult FirmwareUpdate::processChunk(int32_t chunkIndex, const uint8_t *data, size_t length)
 {
-    logger.info("Starting firmware update");
+    FirmwareStream::ChunkResult result = this->stream.processChunk(chunkIndex, data, length);
+    FirmwareStream::Progress progress = this->stream.getProgress();
+
+    switch (result)
+    {
+    case FirmwareStream::CHUNK_WRITTEN:
+        logger.debugf("Firmware chunk %u of %u written (%u bytes)", progress.nextChunk, progress.chunks, length);
+        break;
+
+    case FirmwareStream::CHUNK_IGNORED:
+        logger.debugf("Ignoring firmware chunk %d, waiting for %u", chunkIndex, progress.nextChunk);
+        break;
+
+    case FirmwareStream::CHUNK_COMPLETE:
+    {
+        // The new image runs on trial until it reached the server
+        const esp_partition_t *running = esp_ota_get_running_partition();
+        Settings::saveFirmwareTrial(running->label, 0);
+        logger.infof("Firmware update complete (%u bytes), active after restart", progress.bytesWritten);
+        break;
+    }
+
+    case FirmwareStream::CHUNK_FAILED:
+        logger.errorf("Firmware update failed at chunk %u: %s", progress.nextChunk, progress.error);
+        break;
+    }
 
-    // TODO: implement
+    return result;
 }
 
-void FirmwareUpdate::processChunk()
+void FirmwareUpdate::abort(const char *reason)
 {
-    logger.info("Processing firmware chunk");
-    // TODO: implement
-}
\ No newline at end of file
+    if (this->isDownloading())
+    {
+        logger.errorf("Aborting firmware update: %s", reason);
+        this->stream.abort(reason);
+    }
+}
+
+void FirmwareUpdate::confirmRunningImage()
+{
+    if (this->confirmed)
+    {
+        return;
+    }
+    this->confirmed = true;
+
+    if (this->onTrial)
+    {
+        this->onTrial = false;
+        Settings::clearFirmwareTrial();
+        logger.info("Updated firmware confirmed");
+    }
+}
@@ -2,18 +2,58 @@
 
 #include <Arduino.h>
 #include "../logger/logger.hpp"
+#include "firmwareStream.hpp"
+#include "otaPartitionSlot.hpp"
 
+// Over the air update of the reader firmware into the OTA slot that is not
+// running (see FirmwareStream), driven by the API task.
+//
+// A freshly installed image runs on trial until it reached the server
+// (confirmRunningImage). If it crashes or trips a watchdog MAX_TRIAL_BOOTS
+// times before that, setup() switches back to the previous image. Power
+// cycles and other resets do not count, so a reader that is switched off
+// while the server is unreachable keeps a healthy image. This does not rely
+// on rollback support in the bootloader, which would also go back after a
+// plain power cycle.
 class FirmwareUpdate
 {
 public:
-    FirmwareUpdate() : logger("FirmwareUpdate") {}
+    FirmwareUpdate() : stream(slot), logger("FirmwareUpdate") {}
 
+    // Confirm or roll back an image on trial, call early during boot
     void setup();
 
-    void start();
-    void processChunk();
+    /*
+     *  Start downloading a new image; continues the current download if it is the same image
+     *  @param totalSize: image size in bytes
+     *  @param chunks: number of chunks the server split the image into
+     *  @param sha256Hex: expected SHA-256 of the image as sent by the server
+     */
+    bool start(size_t totalSize, uint32_t chunks, const char *sha256Hex);
+
+    /*
+     *  Write the next chunk of the image
+     *  @param chunkIndex: index sent along with the chunk, -1 for raw binary frames
+     */
+    FirmwareStream::ChunkResult processChunk(int32_t chunkIndex, const uint8_t *data, size_t length);
+
+    void abort(const char *reason);
+
+    // The running image reached the server, stop treating it as a trial
+    void confirmRunningImage();
+
+    bool isDownloading() const { return this->stream.getProgress().status == FirmwareStream::STREAM_RECEIVING; }
+    uint32_t getNextChunk() const { return this->stream.getProgress().nextChunk; }
+    FirmwareStream::Progress getProgress() const { return this->stream.getProgress(); }
 
 private:
-    void loop();
+    // Crash or watchdog restarts of a new image without reaching the server before rolling back
+    static const uint8_t MAX_TRIAL_BOOTS = 3;
+
+    OtaPartitionSlot slot;
+    FirmwareStream stream;
     Logger logger;
-};
\ No newline at end of file
+
+    bool onTrial = false;
+    bool confirmed = false;
+};
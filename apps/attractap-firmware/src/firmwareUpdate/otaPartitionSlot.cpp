@@ -0,0 +1,75 @@
+#include "otaPartitionSlot.hpp"
+
+bool OtaPartitionSlot::begin(size_t imageSize)
+{
+    this->abort();
+
+    this->partition = esp_ota_get_next_update_partition(nullptr);
+    if (this->partition == nullptr)
+    {
+        this->error = ESP_ERR_NOT_FOUND;
+        return false;
+    }
+
+    if (imageSize > this->partition->size)
+    {
+        this->error = ESP_ERR_INVALID_SIZE;
+        return false;
+    }
+
+    // Sectors are erased as the writes reach them instead of all up front,
+    // which would block the API task for seconds
+    this->error = esp_ota_begin(this->partition, OTA_WITH_SEQUENTIAL_WRITES, &this->handle);
+    if (this->error != ESP_OK)
+    {
+        this->handle = 0;
+        return false;
+    }
+    return true;
+}
+
+bool OtaPartitionSlot::write(const uint8_t *data, size_t length)
+{
+    if (this->handle == 0)
+    {
+        this->error = ESP_ERR_INVALID_STATE;
+        return false;
+    }
+
+    this->error = esp_ota_write(this->handle, data, length);
+    return this->error == ESP_OK;
+}
+
+bool OtaPartitionSlot::finish()
+{
+    if (this->handle == 0)
+    {
+        this->error = ESP_ERR_INVALID_STATE;
+        return false;
+    }
+
+    // Checks the image header, segments and the hash esptool appended to it
+    this->error = esp_ota_end(this->handle);
+    this->handle = 0;
+    if (this->error != ESP_OK)
+    {
+        return false;
+    }
+
+    this->error = esp_ota_set_boot_partition(this->partition);
+    return this->error == ESP_OK;
+}
+
+void OtaPartitionSlot::abort()
+{
+    if (this->handle != 0)
+    {
+        esp_ota_abort(this->handle);
+        this->handle = 0;
+    }
+}
+
+const char *OtaPartitionSlot::lastError() const
+{
+    return esp_err_to_name(this->error);
+}
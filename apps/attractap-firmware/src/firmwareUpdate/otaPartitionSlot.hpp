@@ -0,0 +1,20 @@
+#pragma once
+
+#include "esp_ota_ops.h"
+#include "firmwareSlot.hpp"
+
+// The OTA app partition that is not running, written through esp_ota_*
+class OtaPartitionSlot : public FirmwareSlot
+{
+public:
+    bool begin(size_t imageSize) override;
+    bool write(const uint8_t *data, size_t length) override;
+    bool finish() override;
+    void abort() override;
+    const char *lastError() const override;
+
+private:
+    const esp_partition_t *partition = nullptr;
+    esp_ota_handle_t handle = 0;
+    esp_err_t error = ESP_OK;
+};
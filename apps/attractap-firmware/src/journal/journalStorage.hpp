@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sector erasable storage below the TapJournal. Writes may only clear bits
+// (NOR flash semantics), erasing a sector sets all of its bytes to 0xFF.
+class JournalStorage
+{
+public:
+    virtual ~JournalStorage() {}
+
+    virtual size_t sectorSize() const = 0;
+    virtual size_t sectorCount() const = 0;
+
+    virtual bool read(size_t offset, void *data, size_t length) = 0;
+    virtual bool write(size_t offset, const void *data, size_t length) = 0;
+    virtual bool eraseSector(size_t sector) = 0;
+};
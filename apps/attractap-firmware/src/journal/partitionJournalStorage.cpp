@@ -0,0 +1,45 @@
+#include "partitionJournalStorage.hpp"
+
+#include "esp_spi_flash.h"
+
+bool PartitionJournalStorage::begin(const char *label, size_t maxSectors)
+{
+    this->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (this->partition == nullptr)
+    {
+        this->sectors = 0;
+        return false;
+    }
+
+    this->sectors = this->partition->size / SPI_FLASH_SEC_SIZE;
+    if (this->sectors > maxSectors)
+    {
+        this->sectors = maxSectors;
+    }
+    return this->sectors > 0;
+}
+
+size_t PartitionJournalStorage::sectorSize() const
+{
+    return SPI_FLASH_SEC_SIZE;
+}
+
+size_t PartitionJournalStorage::sectorCount() const
+{
+    return this->sectors;
+}
+
+bool PartitionJournalStorage::read(size_t offset, void *data, size_t length)
+{
+    return esp_partition_read(this->partition, offset, data, length) == ESP_OK;
+}
+
+bool PartitionJournalStorage::write(size_t offset, const void *data, size_t length)
+{
+    return esp_partition_write(this->partition, offset, data, length) == ESP_OK;
+}
+
+bool PartitionJournalStorage::eraseSector(size_t sector)
+{
+    return esp_partition_erase_range(this->partition, sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE) == ESP_OK;
+}
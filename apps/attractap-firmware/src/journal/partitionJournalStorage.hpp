@@ -0,0 +1,28 @@
+#pragma once
+
+#include "esp_partition.h"
+#include "journalStorage.hpp"
+
+// Journal storage on the first sectors of a raw data partition
+class PartitionJournalStorage : public JournalStorage
+{
+public:
+    /*
+     *  Attach to a data partition
+     *  @param label: partition label from the partition table
+     *  @param maxSectors: number of sectors to use at most, from the start of the partition
+     *  @return false if the partition does not exist
+     */
+    bool begin(const char *label, size_t maxSectors);
+
+    size_t sectorSize() const override;
+    size_t sectorCount() const override;
+
+    bool read(size_t offset, void *data, size_t length) override;
+    bool write(size_t offset, const void *data, size_t length) override;
+    bool eraseSector(size_t sector) override;
+
+private:
+    const esp_partition_t *partition = nullptr;
+    size_t sectors = 0;
+};
@@ -0,0 +1,363 @@
+#include "tapJournal.hpp"
+
+#include <stddef.h>
+#include <string.h>
+
+bool TapJournal::begin(uint32_t bootId, uint32_t seedId)
+{
+    static_assert(sizeof(Record) == SLOT_SIZE, "journal record must fill exactly one slot");
+    static_assert(sizeof(SectorHeader) == SLOT_SIZE, "journal sector header must fill exactly one slot");
+
+    this->ready = false;
+    this->bootId = bootId;
+    this->stats = {};
+
+    this->sectors = this->storage.sectorCount();
+    if (this->sectors > MAX_SECTORS)
+    {
+        this->sectors = MAX_SECTORS;
+    }
+    size_t slotsPerSectorWithHeader = this->storage.sectorSize() / SLOT_SIZE;
+    if (this->sectors < 2 || slotsPerSectorWithHeader < 2)
+    {
+        return false;
+    }
+    this->slotsPerSector = slotsPerSectorWithHeader - 1;
+    this->stats.capacity = this->sectors * this->slotsPerSector;
+
+    // Sectors in use carry a sequence number, the highest one is appended to
+    bool found = false;
+    size_t oldest = 0;
+    uint32_t oldestSequence = 0;
+    uint32_t newestSequence = 0;
+    for (size_t sector = 0; sector < this->sectors; sector++)
+    {
+        SectorHeader header;
+        this->sectorSequence[sector] = 0;
+        if (!this->readHeader(sector, header))
+        {
+            continue;
+        }
+
+        this->sectorSequence[sector] = header.sequence;
+        if (!found || header.sequence > newestSequence)
+        {
+            newestSequence = header.sequence;
+            this->head.sector = sector;
+        }
+        if (!found || header.sequence < oldestSequence)
+        {
+            oldestSequence = header.sequence;
+            oldest = sector;
+        }
+        found = true;
+    }
+
+    this->hasHead = found;
+    this->nextSequence = found ? newestSequence + 1 : 1;
+    this->nextId = seedId;
+
+    if (!found)
+    {
+        this->head = {0, 0};
+        this->tail = {0, 0};
+        this->ready = true;
+        return true;
+    }
+
+    // Records are appended in order, so the head sector is used up to its
+    // last non-erased slot (a torn write still occupies its slot)
+    this->head.slot = 0;
+    for (size_t slot = 0; slot < this->slotsPerSector; slot++)
+    {
+        Record record;
+        if (this->readRecord({this->head.sector, slot}, record) && !this->isErased(record))
+        {
+            this->head.slot = slot + 1;
+        }
+    }
+
+    // Walk from the oldest sector to the head to find the replay position
+    bool hasRecords = false;
+    bool hasPending = false;
+    uint32_t maxId = 0;
+    for (size_t step = 0; step < this->sectors; step++)
+    {
+        size_t sector = (oldest + step) % this->sectors;
+        if (this->sectorSequence[sector] == 0)
+        {
+            continue;
+        }
+
+        size_t used = sector == this->head.sector ? this->head.slot : this->slotsPerSector;
+        for (size_t slot = 0; slot < used; slot++)
+        {
+            Record record;
+            if (!this->readRecord({sector, slot}, record) || this->isErased(record))
+            {
+                continue;
+            }
+            if (!this->isValid(record))
+            {
+                this->stats.corrupt++;
+                continue;
+            }
+
+            if (!hasRecords || (int32_t)(record.id - maxId) > 0)
+            {
+                maxId = record.id;
+            }
+            hasRecords = true;
+
+            if (record.ack == ERASED_WORD)
+            {
+                if (!hasPending)
+                {
+                    this->tail = {sector, slot};
+                    hasPending = true;
+                }
+                this->stats.pending++;
+            }
+        }
+
+        if (sector == this->head.sector)
+        {
+            break;
+        }
+    }
+
+    if (!hasPending)
+    {
+        this->tail = this->head;
+    }
+    if (hasRecords)
+    {
+        this->nextId = maxId + 1;
+    }
+
+    this->ready = true;
+    return true;
+}
+
+bool TapJournal::append(EntryKind kind, const uint8_t *data, size_t length, uint32_t uptimeMs)
+{
+    if (!this->ready)
+    {
+        return false;
+    }
+
+    if ((!this->hasHead || this->head.slot >= this->slotsPerSector) && !this->openNextSector())
+    {
+        return false;
+    }
+
+    if (length > MAX_DATA_LENGTH)
+    {
+        length = MAX_DATA_LENGTH;
+    }
+
+    Record record;
+    memset(&record, 0, sizeof(record));
+    record.id = this->nextId;
+    record.bootId = this->bootId;
+    record.uptimeMs = uptimeMs;
+    record.kind = kind;
+    record.length = (uint8_t)length;
+    if (length > 0)
+    {
+        memcpy(record.data, data, length);
+    }
+    record.crc = crc32(&record, offsetof(Record, crc));
+    record.ack = ERASED_WORD;
+
+    Position position = this->head;
+    // The slot is used up even if the write fails half way
+    this->head.slot++;
+    if (!this->storage.write(this->slotOffset(position), &record, sizeof(record)))
+    {
+        return false;
+    }
+
+    if (this->stats.pending == 0)
+    {
+        this->tail = position;
+    }
+    this->stats.pending++;
+    this->stats.appended++;
+    this->nextId++;
+    return true;
+}
+
+bool TapJournal::peek(Entry &entry)
+{
+    if (!this->ready || this->stats.pending == 0)
+    {
+        return false;
+    }
+
+    // Skip acknowledged and corrupt slots; bounded in case the count is off
+    for (size_t i = 0; i < this->stats.capacity; i++)
+    {
+        Record record;
+        if (this->readRecord(this->tail, record) && this->isValid(record) && record.ack == ERASED_WORD)
+        {
+            entry.id = record.id;
+            entry.bootId = record.bootId;
+            entry.uptimeMs = record.uptimeMs;
+            entry.kind = (EntryKind)record.kind;
+            entry.length = record.length <= MAX_DATA_LENGTH ? record.length : MAX_DATA_LENGTH;
+            memcpy(entry.data, record.data, MAX_DATA_LENGTH);
+            return true;
+        }
+
+        this->advance(this->tail);
+    }
+
+    this->stats.pending = 0;
+    this->tail = this->head;
+    return false;
+}
+
+bool TapJournal::acknowledge(uint32_t id)
+{
+    Entry entry;
+    if (!this->peek(entry) || entry.id != id)
+    {
+        return false;
+    }
+
+    // A failed write only means the entry is sent again after a reboot,
+    // which the server filters by id
+    uint32_t acked = 0;
+    this->storage.write(this->slotOffset(this->tail) + offsetof(Record, ack), &acked, sizeof(acked));
+
+    this->stats.pending--;
+    this->stats.acknowledged++;
+    this->advance(this->tail);
+    return true;
+}
+
+TapJournal::Stats TapJournal::getStats() const
+{
+    return this->stats;
+}
+
+size_t TapJournal::slotOffset(const Position &position) const
+{
+    // Slot 0 of every sector holds the header
+    return position.sector * this->storage.sectorSize() + (position.slot + 1) * SLOT_SIZE;
+}
+
+void TapJournal::advance(Position &position) const
+{
+    position.slot++;
+    if (position.slot >= this->slotsPerSector)
+    {
+        position.sector = (position.sector + 1) % this->sectors;
+        position.slot = 0;
+    }
+}
+
+bool TapJournal::readHeader(size_t sector, SectorHeader &header)
+{
+    if (!this->storage.read(sector * this->storage.sectorSize(), &header, sizeof(header)))
+    {
+        return false;
+    }
+
+    return header.magic == SECTOR_MAGIC && header.crc == crc32(&header, offsetof(SectorHeader, crc)) && header.sequence != 0;
+}
+
+bool TapJournal::readRecord(const Position &position, Record &record)
+{
+    return this->storage.read(this->slotOffset(position), &record, sizeof(record));
+}
+
+bool TapJournal::isErased(const Record &record) const
+{
+    const uint8_t *bytes = (const uint8_t *)&record;
+    for (size_t i = 0; i < offsetof(Record, ack); i++)
+    {
+        if (bytes[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TapJournal::isValid(const Record &record) const
+{
+    return record.crc == crc32(&record, offsetof(Record, crc));
+}
+
+bool TapJournal::openNextSector()
+{
+    size_t sector = this->hasHead ? (this->head.sector + 1) % this->sectors : 0;
+
+    // The ring is full: recycle the oldest sector and lose what it still held
+    if (this->sectorSequence[sector] != 0)
+    {
+        uint32_t lost = this->countPending(sector);
+        if (lost > 0)
+        {
+            this->stats.dropped += lost;
+            this->stats.pending -= lost;
+            if (this->tail.sector == sector)
+            {
+                this->tail = {(sector + 1) % this->sectors, 0};
+            }
+        }
+    }
+
+    this->sectorSequence[sector] = 0;
+    if (!this->storage.eraseSector(sector))
+    {
+        return false;
+    }
+    this->stats.sectorErases++;
+
+    SectorHeader header;
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = SECTOR_MAGIC;
+    header.sequence = this->nextSequence;
+    header.crc = crc32(&header, offsetof(SectorHeader, crc));
+    if (!this->storage.write(sector * this->storage.sectorSize(), &header, sizeof(header)))
+    {
+        return false;
+    }
+
+    this->sectorSequence[sector] = this->nextSequence++;
+    this->head = {sector, 0};
+    this->hasHead = true;
+    return true;
+}
+
+uint32_t TapJournal::countPending(size_t sector)
+{
+    uint32_t pending = 0;
+    for (size_t slot = 0; slot < this->slotsPerSector; slot++)
+    {
+        Record record;
+        if (this->readRecord({sector, slot}, record) && !this->isErased(record) && this->isValid(record) && record.ack == ERASED_WORD)
+        {
+            pending++;
+        }
+    }
+    return pending;
+}
+
+uint32_t TapJournal::crc32(const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= bytes[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "journalStorage.hpp"
+
+// Append-only on-flash log of NFC taps and keypad input that happened while
+// the server was unreachable, replayed in order once it is back. Sectors are used as a ring
+// and only erased right before reuse; when the ring is full the oldest sector
+// is recycled and its unsent entries are counted as dropped.
+//
+// Layout: every sector starts with a header slot (magic, sequence number),
+// followed by fixed size record slots. A record is written once and carries
+// a CRC, so a write torn by a reset is detected and skipped on the next scan.
+// Acknowledging only clears the record's ack word, which NOR flash allows
+// without an erase.
+//
+// Plain logic on top of JournalStorage without ESP-IDF/Arduino dependencies.
+class TapJournal
+{
+public:
+    enum EntryKind : uint8_t
+    {
+        ENTRY_NFC_TAP = 1,
+        // data holds the entered value (ASCII, without terminator)
+        ENTRY_KEYPAD_CONFIRM = 2,
+        ENTRY_KEYPAD_CANCEL = 3,
+    };
+
+    static const size_t MAX_DATA_LENGTH = 10;
+
+    struct Entry
+    {
+        // Increases across reboots, the server uses it to drop replayed duplicates
+        uint32_t id;
+        // Random per boot; uptimeMs is only comparable within the same boot
+        uint32_t bootId;
+        uint32_t uptimeMs;
+        EntryKind kind;
+        uint8_t length;
+        uint8_t data[MAX_DATA_LENGTH];
+    };
+
+    struct Stats
+    {
+        uint32_t capacity;
+        uint32_t pending;
+        uint32_t appended;
+        uint32_t acknowledged;
+        uint32_t dropped;
+        uint32_t corrupt;
+        uint32_t sectorErases;
+    };
+
+    explicit TapJournal(JournalStorage &storage) : storage(storage) {}
+
+    /*
+     *  Scan the storage and restore the write and replay positions
+     *  @param bootId: random id of this boot
+     *  @param seedId: first entry id if the journal is empty
+     *  @return false if the storage is unusable
+     */
+    bool begin(uint32_t bootId, uint32_t seedId);
+
+    /*
+     *  Append an entry
+     *  @param data: up to MAX_DATA_LENGTH bytes (longer data is truncated), may be null if length is 0
+     *  @return false if it could not be written
+     */
+    bool append(EntryKind kind, const uint8_t *data, size_t length, uint32_t uptimeMs);
+
+    /*
+     *  Oldest entry that was not acknowledged yet
+     *  @return false if there is none
+     */
+    bool peek(Entry &entry);
+
+    /*
+     *  Mark the oldest pending entry as delivered
+     *  @param id: id of that entry, anything else is ignored
+     *  @return true if the entry was acknowledged
+     */
+    bool acknowledge(uint32_t id);
+
+    uint32_t getBootId() const { return this->bootId; }
+    Stats getStats() const;
+
+private:
+    struct SectorHeader
+    {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t crc;
+        uint8_t reserved[20];
+    };
+
+    struct Record
+    {
+        uint32_t id;
+        uint32_t bootId;
+        uint32_t uptimeMs;
+        uint8_t kind;
+        uint8_t length;
+        uint8_t data[MAX_DATA_LENGTH];
+        uint32_t crc;
+        uint32_t ack;
+    };
+
+    static const uint32_t SECTOR_MAGIC = 0x314a5254; // "TRJ1"
+    static const size_t SLOT_SIZE = 32;
+    static const size_t MAX_SECTORS = 64;
+    static const uint32_t ERASED_WORD = 0xFFFFFFFF;
+
+    struct Position
+    {
+        size_t sector;
+        size_t slot;
+    };
+
+    JournalStorage &storage;
+    bool ready = false;
+    uint32_t bootId = 0;
+
+    size_t sectors = 0;
+    size_t slotsPerSector = 0;
+    uint32_t sectorSequence[MAX_SECTORS] = {};
+
+    // Sector currently appended to (none before the first append)
+    bool hasHead = false;
+    Position head = {0, 0};
+    // Oldest record that may still be pending
+    Position tail = {0, 0};
+
+    uint32_t nextId = 0;
+    uint32_t nextSequence = 1;
+    Stats stats = {};
+
+    size_t slotOffset(const Position &position) const;
+    void advance(Position &position) const;
+    bool readHeader(size_t sector, SectorHeader &header);
+    bool readRecord(const Position &position, Record &record);
+    bool isErased(const Record &record) const;
+    bool isValid(const Record &record) const;
+    bool openNextSector();
+    uint32_t countPending(size_t sector);
+
+    static uint32_t crc32(const void *data, size_t length);
+};
@@ -42,10 +42,12 @@ void Keypad::taskFn(void *parameter)
         return; // not reached
     }
 
+    instance->stateSubscription = State::subscribe(State::STATE_CHANGE_API_EVENT);
+
     while (true)
     {
         instance->loop();
-        vTaskDelay(150 / portTICK_PERIOD_MS);
+        instance->pendingStateChanges |= State::waitForChanges(instance->stateSubscription, 150);
     }
 }
 
@@ -95,13 +97,12 @@ void Keypad::loop()
 
 void Keypad::updateState()
 {
-    uint32_t lastApiEventTime = State::getLastApiEventTime();
-    if (lastApiEventTime < this->lastApiStateCheckTime)
+    if (this->pendingStateChanges == 0)
     {
         return;
     }
 
-    this->lastApiStateCheckTime = lastApiEventTime;
+    this->pendingStateChanges = 0;
 
     State::ApiEventData apiEvent = State::getApiEventData();
 
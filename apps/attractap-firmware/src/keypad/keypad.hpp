@@ -22,6 +22,7 @@ private:
     String value;
 
     void updateState();
-    uint32_t lastApiStateCheckTime = 0;
+    EventGroupHandle_t stateSubscription = nullptr;
+    uint32_t pendingStateChanges = 0;
     bool enableKeyChecking = false;
 };
\ No newline at end of file
@@ -83,10 +83,12 @@ void Neopixel::taskFn(void *parameter)
     // const int LOOP_DELAY_MS = (MS_PER_SECOND / REFRESH_RATE_HZ);
     const int LOOP_DELAY_MS = 200;
 
+    instance->stateSubscription = State::subscribe(State::STATE_CHANGE_NETWORK | State::STATE_CHANGE_WEBSOCKET | State::STATE_CHANGE_API | State::STATE_CHANGE_API_EVENT);
+
     while (true)
     {
         instance->loop();
-        vTaskDelay(LOOP_DELAY_MS / portTICK_PERIOD_MS);
+        instance->pendingStateChanges |= State::waitForChanges(instance->stateSubscription, LOOP_DELAY_MS);
     }
 }
 
@@ -100,13 +102,13 @@ void Neopixel::loop()
 
 void Neopixel::updateAppStateData()
 {
-    uint32_t lastStateChangeTime = State::getLastStateChangeTime();
-    if (lastStateChangeTime <= this->lastKnownStateChangeTime)
+    const uint32_t appStateDomains = State::STATE_CHANGE_NETWORK | State::STATE_CHANGE_WEBSOCKET | State::STATE_CHANGE_API;
+    if ((this->pendingStateChanges & appStateDomains) == 0)
     {
         return;
     }
 
-    this->lastKnownStateChangeTime = lastStateChangeTime;
+    this->pendingStateChanges &= ~appStateDomains;
 
     this->networkState = State::getNetworkState();
     this->websocketState = State::getWebsocketState();
@@ -115,13 +117,12 @@ void Neopixel::updateAppStateData()
 
 void Neopixel::updateApiEventData()
 {
-    uint32_t lastApiEventTime = State::getLastApiEventTime();
-    if (lastApiEventTime <= this->lastApiEventTime)
+    if ((this->pendingStateChanges & State::STATE_CHANGE_API_EVENT) == 0)
     {
         return;
     }
 
-    this->lastApiEventTime = lastApiEventTime;
+    this->pendingStateChanges &= ~State::STATE_CHANGE_API_EVENT;
     this->apiEventData = State::getApiEventData();
 }
 
@@ -129,6 +130,16 @@ void Neopixel::runAnimation()
 {
     bool isNetworkConnected = this->networkState.wifi_connected || this->networkState.ethernet_connected;
 
+    if (State::isOfflineDecision(this->apiEventData))
+    {
+        this->nfcAnimationActivated = false;
+        if (this->apiEventData.state == State::API_EVENT_STATE_DISPLAY_SUCCESS)
+        {
+            return this->runDisplaySuccessAnimation();
+        }
+        return this->runDisplayErrorAnimation();
+    }
+
     if (!isNetworkConnected)
     {
         return this->runWaitingForNetworkAnimation();
@@ -47,8 +47,8 @@ private:
     State::WebsocketState websocketState;
     State::ApiState apiState;
     State::ApiEventData apiEventData;
-    uint32_t lastApiEventTime;
-    uint32_t lastKnownStateChangeTime;
+    EventGroupHandle_t stateSubscription = nullptr;
+    uint32_t pendingStateChanges = 0;
 
     // Logger instance
     Logger logger;
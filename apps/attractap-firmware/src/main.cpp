@@ -58,17 +58,18 @@ void setup()
     mainLogger.info("Attractap starting...");
 
     Settings::setup();
+    // Before anything that could crash, so an updated firmware that does can be rolled back
+    firmwareUpdate.setup();
 
-    Wire.begin(PIN_I2C_SDA, PIN_I2C_SCL);
+    Wire.begin(PIN_I2C_SDA, PIN_I2C_SCL, I2C_FREQ);
 
     displayManager.setup();
     Network::setup();
     websocket.setup();
     nfc.setup();
-    api.setup();
+    api.setup(&firmwareUpdate);
     cliService.setup();
-    // firmwareUpdate.setup();
-    SerialSetup::setup(&cliService, &api, &websocket);
+    SerialSetup::setup(&cliService, &api, &websocket, &nfc);
 
 #ifdef PIN_NEOPIXEL_LED
     leds.setup();
@@ -0,0 +1,79 @@
+#include "latencyHistogram.hpp"
+
+LatencyHistogram::LatencyHistogram() : mutex(portMUX_INITIALIZER_UNLOCKED)
+{
+    this->reset();
+}
+
+uint8_t LatencyHistogram::bucketFor(uint32_t latencyMs)
+{
+    uint8_t bucket = 0;
+    while (latencyMs > 0 && bucket < BUCKET_COUNT - 1)
+    {
+        latencyMs >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void LatencyHistogram::record(uint32_t latencyMs)
+{
+    uint8_t bucket = bucketFor(latencyMs);
+
+    taskENTER_CRITICAL(&this->mutex);
+    if (this->data.count == 0 || latencyMs < this->data.minMs)
+    {
+        this->data.minMs = latencyMs;
+    }
+    if (latencyMs > this->data.maxMs)
+    {
+        this->data.maxMs = latencyMs;
+    }
+    this->data.count++;
+    this->data.sumMs += latencyMs;
+    this->data.buckets[bucket]++;
+    taskEXIT_CRITICAL(&this->mutex);
+}
+
+void LatencyHistogram::reset()
+{
+    taskENTER_CRITICAL(&this->mutex);
+    memset(&this->data, 0, sizeof(this->data));
+    taskEXIT_CRITICAL(&this->mutex);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    taskENTER_CRITICAL(&this->mutex);
+    Snapshot copy = this->data;
+    taskEXIT_CRITICAL(&this->mutex);
+    return copy;
+}
+
+uint32_t LatencyHistogram::Snapshot::percentile(uint8_t percent) const
+{
+    if (this->count == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the requested sample, rounded up (1-based)
+    uint32_t rank = (uint32_t)(((uint64_t)this->count * percent + 99) / 100);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < BUCKET_COUNT; i++)
+    {
+        seen += this->buckets[i];
+        if (seen >= rank)
+        {
+            uint32_t upperBound = i == 0 ? 0 : ((1UL << i) - 1);
+            return upperBound < this->maxMs ? upperBound : this->maxMs;
+        }
+    }
+
+    return this->maxMs;
+}
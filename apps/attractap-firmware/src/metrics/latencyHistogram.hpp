@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Fixed-size log2 histogram for millisecond latencies. Bucket i holds samples
+// in [2^(i-1), 2^i) ms (bucket 0 holds 0 ms), so percentiles are reported as
+// the upper bound of the bucket they fall into. Safe to record from one task
+// while another task reads a snapshot.
+class LatencyHistogram
+{
+public:
+    static const uint8_t BUCKET_COUNT = 18; // up to ~131 s
+
+    struct Snapshot
+    {
+        uint32_t count;
+        uint32_t minMs;
+        uint32_t maxMs;
+        uint64_t sumMs;
+        uint32_t buckets[BUCKET_COUNT];
+
+        uint32_t percentile(uint8_t percent) const;
+        uint32_t meanMs() const { return count == 0 ? 0 : (uint32_t)(sumMs / count); }
+    };
+
+    LatencyHistogram();
+
+    void record(uint32_t latencyMs);
+    void reset();
+    Snapshot snapshot() const;
+
+private:
+    static uint8_t bucketFor(uint32_t latencyMs);
+
+    mutable portMUX_TYPE mutex;
+    Snapshot data;
+};
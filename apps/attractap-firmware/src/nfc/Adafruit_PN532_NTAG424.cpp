@@ -82,6 +82,9 @@ byte pn532response_firmwarevers[] = {
 byte pn532_packetbuffer[PN532_PACKBUFFSIZ]; ///< Packet buffer used in various
                                             ///< transactions
 
+#define PN532_WAITREADY_MIN_US 100   ///< First pause between ready checks
+#define PN532_WAITREADY_MAX_US 10000 ///< Longest pause between ready checks
+
 /**************************************************************************/
 /*!
     @brief  Instantiates a new PN532 class using software SPI.
@@ -96,8 +99,7 @@ Adafruit_PN532::Adafruit_PN532(uint8_t clk, uint8_t miso, uint8_t mosi,
                                uint8_t ss)
 {
   _cs = ss;
-  spi_dev = new Adafruit_SPIDevice(ss, clk, miso, mosi, 100000,
-                                   SPI_BITORDER_LSBFIRST, SPI_MODE0);
+  transport = new Adafruit_PN532_SPITransport(clk, miso, mosi, ss);
 }
 
 /**************************************************************************/
@@ -114,7 +116,7 @@ Adafruit_PN532::Adafruit_PN532(uint8_t irq, uint8_t reset, TwoWire *theWire)
 {
   pinMode(_irq, INPUT);
   pinMode(_reset, OUTPUT);
-  i2c_dev = new Adafruit_I2CDevice(PN532_I2C_ADDRESS, theWire);
+  transport = new Adafruit_PN532_I2CTransport(theWire);
 }
 
 /**************************************************************************/
@@ -128,8 +130,7 @@ Adafruit_PN532::Adafruit_PN532(uint8_t irq, uint8_t reset, TwoWire *theWire)
 Adafruit_PN532::Adafruit_PN532(uint8_t ss, SPIClass *theSPI)
 {
   _cs = ss;
-  spi_dev = new Adafruit_SPIDevice(ss, 1000000, SPI_BITORDER_LSBFIRST,
-                                   SPI_MODE0, theSPI);
+  transport = new Adafruit_PN532_SPITransport(ss, theSPI);
 }
 
 /**************************************************************************/
@@ -144,7 +145,27 @@ Adafruit_PN532::Adafruit_PN532(uint8_t reset, HardwareSerial *theSer)
     : _reset(reset)
 {
   pinMode(_reset, OUTPUT);
-  ser_dev = theSer;
+  transport = new Adafruit_PN532_UARTTransport(theSer);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new PN532 class on top of an existing transport.
+
+    @param  theTransport  transport used for all frame I/O, must outlive
+                          this instance
+    @param  irq           Location of the IRQ pin, -1 if not wired
+    @param  reset         Location of the RSTPD_N pin, -1 if not wired
+*/
+/**************************************************************************/
+Adafruit_PN532::Adafruit_PN532(Adafruit_PN532_Transport *theTransport,
+                               int8_t irq, int8_t reset)
+    : _irq(irq), _reset(reset), transport(theTransport)
+{
+  if (_irq != -1)
+    pinMode(_irq, INPUT);
+  if (_reset != -1)
+    pinMode(_reset, OUTPUT);
 }
 
 /**************************************************************************/
@@ -160,33 +181,9 @@ bool Adafruit_PN532::begin()
   Serial.println("NTAG424DEBUG: On");
   Serial.println("EncBuffer: 52");
 #endif
-  if (spi_dev)
-  {
-    // SPI initialization
-    if (!spi_dev->begin())
-    {
-      return false;
-    }
-  }
-  else if (i2c_dev)
-  {
-    // I2C initialization
-    // PN532 will fail address check since its asleep, so suppress
-    if (!i2c_dev->begin(false))
-    {
-      return false;
-    }
-  }
-  else if (ser_dev)
-  {
-    ser_dev->begin(115200);
-    // clear out anything in read buffer
-    while (ser_dev->available())
-      ser_dev->read();
-  }
-  else
+  if (transport == NULL || !transport->begin())
   {
-    // no interface specified
+    // no interface specified or bus init failed
     return false;
   }
   reset(); // HW reset - put in known state
@@ -220,20 +217,9 @@ void Adafruit_PN532::reset(void)
 void Adafruit_PN532::wakeup(void)
 {
   // interface specific wakeups - each one is unique!
-  if (spi_dev)
-  {
-    // hold CS low for 2ms
-    digitalWrite(_cs, LOW);
-    delay(2);
-  }
-  else if (ser_dev)
-  {
-    uint8_t w[3] = {0x55, 0x00, 0x00};
-    ser_dev->write(w, 3);
-    delay(2);
-  }
-
   // PN532 will clock stretch I2C during SAMConfig as a "wakeup"
+  if (transport)
+    transport->wakeup();
 
   // need to config SAM to stay in Normal Mode
   SAMConfig();
@@ -360,18 +346,47 @@ uint32_t Adafruit_PN532::getFirmwareVersion(void)
 bool Adafruit_PN532::sendCommandCheckAck(uint8_t *cmd, uint8_t cmdlen,
                                          uint16_t timeout)
 {
+  if (!writeCommandCheckAck(cmd, cmdlen, timeout))
+  {
+    return false;
+  }
+
+  // I2C TUNING
+  delayMicroseconds(transport ? transport->settleDelayUs() : 0);
+
+  // Wait for chip to say its ready!
+  if (!waitready(timeout))
+  {
+    return false;
+  }
+
+  return true; // ack'd command
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sends a command and waits for the ACK only, leaving the
+            response pending on the chip.
 
+    @param  cmd       Pointer to the command buffer
+    @param  cmdlen    The size of the command in bytes
+    @param  timeout   timeout before giving up
+
+    @returns  true if the command was ACKed, false otherwise
+*/
+/**************************************************************************/
+bool Adafruit_PN532::writeCommandCheckAck(uint8_t *cmd, uint8_t cmdlen,
+                                          uint16_t timeout)
+{
   // I2C works without using IRQ pin by polling for RDY byte
   // seems to work best with some delays between transactions
-  uint8_t SLOWDOWN = 0;
-  if (i2c_dev)
-    SLOWDOWN = 1;
+  uint16_t SLOWDOWN = transport ? transport->settleDelayUs() : 0;
 
   // write the command
   writecommand(cmd, cmdlen);
 
   // I2C TUNING
-  delay(SLOWDOWN);
+  delayMicroseconds(SLOWDOWN);
 
   // Wait for chip to say its ready!
   if (!waitready(timeout))
@@ -380,10 +395,7 @@ bool Adafruit_PN532::sendCommandCheckAck(uint8_t *cmd, uint8_t cmdlen,
   }
 
 #ifdef PN532DEBUG
-  if (spi_dev == NULL)
-  {
-    PN532DEBUGPRINT.println(F("IRQ received"));
-  }
+  PN532DEBUGPRINT.println(F("PN532 ready"));
 #endif
 
   // read acknowledgement
@@ -395,16 +407,7 @@ bool Adafruit_PN532::sendCommandCheckAck(uint8_t *cmd, uint8_t cmdlen,
     return false;
   }
 
-  // I2C TUNING
-  delay(SLOWDOWN);
-
-  // Wait for chip to say its ready!
-  if (!waitready(timeout))
-  {
-    return false;
-  }
-
-  return true; // ack'd command
+  return true;
 }
 
 /**************************************************************************/
@@ -593,20 +596,31 @@ bool Adafruit_PN532::setPassiveActivationRetries(uint8_t maxRetries)
 
     @param   cardbaudrate  Baud rate of the card
     @param   uid           Pointer to the array that will be populated
-                           with the card's UID (up to 7 bytes)
+                           with the card's UID, must hold
+                           PN532_MAX_UID_LENGTH bytes (NFCID1 is 4, 7 or
+                           10 bytes long)
     @param   uidLength     Pointer to the variable that will hold the
                            length of the card's UID.
     @param   timeout       Timeout in milliseconds.
+    @param   maxTargets    Cards to activate at once (1..PN532_MAX_TARGETS),
+                           see getTarget() for all of them
 
     @return  1 if everything executed properly, 0 for an error
 */
 /**************************************************************************/
 bool Adafruit_PN532::readPassiveTargetID(uint8_t cardbaudrate, uint8_t *uid,
-                                         uint8_t *uidLength, uint16_t timeout)
+                                         uint8_t *uidLength, uint16_t timeout,
+                                         uint8_t maxTargets)
 {
+  if (maxTargets < 1 || maxTargets > PN532_MAX_TARGETS)
+  {
+    return 0;
+  }
+
   pn532_packetbuffer[0] = PN532_COMMAND_INLISTPASSIVETARGET;
-  pn532_packetbuffer[1] = 1; // max 1 cards at once (we can set this to 2 later)
+  pn532_packetbuffer[1] = maxTargets;
   pn532_packetbuffer[2] = cardbaudrate;
+  _listMaxTargets = maxTargets;
 
   if (!sendCommandCheckAck(pn532_packetbuffer, 3, timeout))
   {
@@ -621,27 +635,70 @@ bool Adafruit_PN532::readPassiveTargetID(uint8_t cardbaudrate, uint8_t *uid,
 
 /**************************************************************************/
 /*!
-    @brief   Put the reader in detection mode, non blocking so interrupts
-             must be enabled.
+    @brief   Put the reader in detection mode. Returns as soon as the
+             command is ACKed; poll isResponseReady() or watch the IRQ line
+             and then call readDetectedPassiveTargetID().
     @param   cardbaudrate  Baud rate of the card
+    @param   maxTargets    Cards to activate at once (1..PN532_MAX_TARGETS)
     @return  1 if everything executed properly, 0 for an error
 */
 /**************************************************************************/
-bool Adafruit_PN532::startPassiveTargetIDDetection(uint8_t cardbaudrate)
+bool Adafruit_PN532::startPassiveTargetIDDetection(uint8_t cardbaudrate,
+                                                   uint8_t maxTargets)
 {
+  if (maxTargets < 1 || maxTargets > PN532_MAX_TARGETS)
+  {
+    return 0;
+  }
+
   pn532_packetbuffer[0] = PN532_COMMAND_INLISTPASSIVETARGET;
-  pn532_packetbuffer[1] = 1; // max 1 cards at once (we can set this to 2 later)
+  pn532_packetbuffer[1] = maxTargets;
   pn532_packetbuffer[2] = cardbaudrate;
+  _listMaxTargets = maxTargets;
 
-  return sendCommandCheckAck(pn532_packetbuffer, 3);
+  return writeCommandCheckAck(pn532_packetbuffer, 3, 100);
 }
 
 /**************************************************************************/
 /*!
-    Reads the ID of the passive target the reader has deteceted.
+    @brief   Single non-blocking check whether the pending command has a
+             response ready (one bus transaction).
+    @return  true if the response can be read
+*/
+/**************************************************************************/
+bool Adafruit_PN532::isResponseReady(void)
+{
+  return isready();
+}
+
+/**************************************************************************/
+/*!
+    @brief   Abort the command currently being processed by the PN532.
+             The chip treats an ACK frame from the host as an abort
+             request. Used to cancel a pending passive target detection.
+*/
+/**************************************************************************/
+void Adafruit_PN532::abortCommand(void)
+{
+  if (transport == NULL)
+  {
+    return;
+  }
+
+  _busTransactions++;
+  transport->writeFrame(pn532ack, sizeof(pn532ack));
+}
+
+/**************************************************************************/
+/*!
+    Reads the IDs of the passive targets the reader has deteceted. All of
+    them end up in the target table (getTarget()), the first one is
+    returned and selected for the following commands.
 
     @param  uid           Pointer to the array that will be populated
-                          with the card's UID (up to 7 bytes)
+                          with the card's UID, must hold
+                          PN532_MAX_UID_LENGTH bytes (NFCID1 is 4, 7 or
+                          10 bytes long)
     @param  uidLength     Pointer to the variable that will hold the
                           length of the card's UID.
 
@@ -651,8 +708,12 @@ bool Adafruit_PN532::startPassiveTargetIDDetection(uint8_t cardbaudrate)
 bool Adafruit_PN532::readDetectedPassiveTargetID(uint8_t *uid,
                                                  uint8_t *uidLength)
 {
-  // read data packet
-  readdata(pn532_packetbuffer, 20);
+  // a new activation starts without selected application or session
+  ntag424_ResetSession();
+  _targetCount = 0;
+
+  // read data packet, one target fits in 20 bytes up to its NFCID
+  readdata(pn532_packetbuffer, _listMaxTargets > 1 ? PN532_PACKBUFFSIZ : 20);
   // check some basic stuff
 
   /* ISO14443A card response should be in the following format:
@@ -661,48 +722,95 @@ bool Adafruit_PN532::readDetectedPassiveTargetID(uint8_t *uid,
     -------------   ------------------------------------------
     b0..6           Frame header and preamble
     b7              Tags Found
-    b8              Tag Number (only one used in this example)
+    b8              Tag Number
     b9..10          SENS_RES
     b11             SEL_RES
     b12             NFCID Length
-    b13..NFCIDLen   NFCID                                      */
+    b13..NFCIDLen   NFCID
+    ...             ATS (only if SEL_RES says ISO14443-4, first byte is
+                    its length), then the next target from Tag Number on */
 
 #ifdef MIFAREDEBUG
   PN532DEBUGPRINT.print(F("Found "));
   PN532DEBUGPRINT.print(pn532_packetbuffer[7], DEC);
   PN532DEBUGPRINT.println(F(" tags"));
 #endif
-  if (pn532_packetbuffer[7] != 1)
+  uint8_t found = pn532_packetbuffer[7];
+  if (found < 1 || found > _listMaxTargets)
     return 0;
 
-  uint16_t sens_res = pn532_packetbuffer[9];
-  sens_res <<= 8;
-  sens_res |= pn532_packetbuffer[10];
+  uint16_t offset = 8;
+  for (uint8_t t = 0; t < found; t++)
+  {
+    Adafruit_PN532_Target &target = _targets[t];
+    if (offset + 5 > PN532_PACKBUFFSIZ)
+      return 0;
+    uint8_t nfcidLength = pn532_packetbuffer[offset + 4];
+    if (nfcidLength > sizeof(target.uid) ||
+        offset + 5 + nfcidLength > PN532_PACKBUFFSIZ)
+      return 0;
+
+    target.tg = pn532_packetbuffer[offset];
+    target.sens_res = pn532_packetbuffer[offset + 1];
+    target.sens_res <<= 8;
+    target.sens_res |= pn532_packetbuffer[offset + 2];
+    target.sel_res = pn532_packetbuffer[offset + 3];
+    target.uidLength = nfcidLength;
+    memcpy(target.uid, pn532_packetbuffer + offset + 5, nfcidLength);
+    offset += 5 + nfcidLength;
+
 #ifdef MIFAREDEBUG
-  PN532DEBUGPRINT.print(F("ATQA: 0x"));
-  PN532DEBUGPRINT.println(sens_res, HEX);
-  PN532DEBUGPRINT.print(F("SAK: 0x"));
-  PN532DEBUGPRINT.println(pn532_packetbuffer[11], HEX);
-#endif
+    PN532DEBUGPRINT.print(F("Tg: "));
+    PN532DEBUGPRINT.println(target.tg);
+    PN532DEBUGPRINT.print(F("ATQA: 0x"));
+    PN532DEBUGPRINT.println(target.sens_res, HEX);
+    PN532DEBUGPRINT.print(F("SAK: 0x"));
+    PN532DEBUGPRINT.println(target.sel_res, HEX);
+    PN532DEBUGPRINT.print(F("UID:"));
+    Adafruit_PN532::PrintHex(target.uid, target.uidLength);
+#endif
+
+    // skip the ATS to get to the next target
+    if ((target.sel_res & PN532_SEL_RES_ISO14443_4) && t + 1 < found)
+    {
+      if (offset >= PN532_PACKBUFFSIZ)
+        return 0;
+      uint8_t atsLength = pn532_packetbuffer[offset];
+      offset += atsLength > 0 ? atsLength : 1;
+    }
+  }
+  _targetCount = found;
 
   /* Card appears to be Mifare Classic */
-  *uidLength = pn532_packetbuffer[12];
-#ifdef MIFAREDEBUG
-  PN532DEBUGPRINT.print(F("UID:"));
-#endif
-  for (uint8_t i = 0; i < pn532_packetbuffer[12]; i++)
+  *uidLength = _targets[0].uidLength;
+  memcpy(uid, _targets[0].uid, _targets[0].uidLength);
+  _inListedTag = _targets[0].tg;
+
+  return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief   Direct the following commands to another target of the last
+             detection. Switching targets drops the NTAG424 session.
+
+    @param   index  index into the target table, < getTargetCount()
+    @return  true on success, false if there is no such target
+*/
+/**************************************************************************/
+bool Adafruit_PN532::selectTarget(uint8_t index)
+{
+  if (index >= _targetCount)
   {
-    uid[i] = pn532_packetbuffer[13 + i];
-#ifdef MIFAREDEBUG
-    PN532DEBUGPRINT.print(F(" 0x"));
-    PN532DEBUGPRINT.print(uid[i], HEX);
-#endif
+    return false;
   }
-#ifdef MIFAREDEBUG
-  PN532DEBUGPRINT.println();
-#endif
 
-  return 1;
+  if (_inListedTag != _targets[index].tg)
+  {
+    ntag424_ResetSession();
+    _inListedTag = _targets[index].tg;
+  }
+  return true;
 }
 
 /**************************************************************************/
@@ -971,7 +1079,7 @@ uint8_t Adafruit_PN532::mifareclassic_AuthenticateBlock(uint8_t *uid,
   // Prepare the authentication command //
   pn532_packetbuffer[0] =
       PN532_COMMAND_INDATAEXCHANGE; /* Data Exchange Header */
-  pn532_packetbuffer[1] = 1;        /* Max card numbers */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] = (keyNumber) ? MIFARE_CMD_AUTH_B : MIFARE_CMD_AUTH_A;
   pn532_packetbuffer[3] =
       blockNumber; /* Block Number (1K = 0..63, 4K = 0..255 */
@@ -1026,7 +1134,7 @@ uint8_t Adafruit_PN532::mifareclassic_ReadDataBlock(uint8_t blockNumber,
 
   /* Prepare the command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1;               /* Card number */
+  pn532_packetbuffer[1] = _inListedTag;    /* Card number */
   pn532_packetbuffer[2] = MIFARE_CMD_READ; /* Mifare Read command = 0x30 */
   pn532_packetbuffer[3] =
       blockNumber; /* Block Number (0..63 for 1K, 0..255 for 4K) */
@@ -1089,7 +1197,7 @@ uint8_t Adafruit_PN532::mifareclassic_WriteDataBlock(uint8_t blockNumber,
 
   /* Prepare the first command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1;                /* Card number */
+  pn532_packetbuffer[1] = _inListedTag;     /* Card number */
   pn532_packetbuffer[2] = MIFARE_CMD_WRITE; /* Mifare Write command = 0xA0 */
   pn532_packetbuffer[3] =
       blockNumber;                          /* Block Number (0..63 for 1K, 0..255 for 4K) */
@@ -1281,7 +1389,7 @@ uint8_t Adafruit_PN532::mifareultralight_ReadPage(uint8_t page,
 
   /* Prepare the command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1;               /* Card number */
+  pn532_packetbuffer[1] = _inListedTag;    /* Card number */
   pn532_packetbuffer[2] = MIFARE_CMD_READ; /* Mifare Read command = 0x30 */
   pn532_packetbuffer[3] = page;            /* Page Number (0..63 in most cases) */
 
@@ -1364,7 +1472,7 @@ uint8_t Adafruit_PN532::mifareultralight_WritePage(uint8_t page,
 
   /* Prepare the first command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; /* Card number */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] =
       MIFARE_ULTRALIGHT_CMD_WRITE;         /* Mifare Ultralight Write command = 0xA2 */
   pn532_packetbuffer[3] = page;            /* Page Number (0..63 for most cases) */
@@ -1433,13 +1541,16 @@ uint8_t Adafruit_PN532::ntag424_apdu_send(
     uint8_t cmd_header_length, uint8_t *cmd_data, uint8_t cmd_data_length,
     uint8_t le, uint8_t comm_mode, uint8_t *response, uint8_t response_le)
 {
-  Serial.print("cmd_counter: ");
-  Serial.println(ntag424_Session.cmd_counter);
-  uint8_t apdusize = 8 + (7 + cmd_header_length + cmd_data_length + 2) & 0xff;
+  NTAG424_TRACE(NTAG424_TRACE_DATA, "cmd_counter: ", ntag424_Session.cmd_counter);
+  // callers check the status word even when nothing came back, a missing
+  // ACK or a PN532 error must not leave them the previous stack contents
+  memset(response, 0, response_le);
+  // header and data, up to a block of padding and the MAC in FULL mode, Le
+  uint8_t apdusize = 7 + cmd_header_length + cmd_data_length + 16 + 8 + 1;
   uint8_t apdu[apdusize];
   uint8_t offset = 0;
   apdu[0] = PN532_COMMAND_INDATAEXCHANGE;
-  apdu[1] = 0x01;
+  apdu[1] = _inListedTag;
   apdu[2] = cla[0];
   apdu[3] = ins[0];
   apdu[4] = p1[0];
@@ -1496,15 +1607,15 @@ uint8_t Adafruit_PN532::ntag424_apdu_send(
       Serial.println(padded_payload_length);
       Adafruit_PN532::PrintHexChar(payload_padded, padded_payload_length);
 #endif
-      // assemble iv
-      uint8_t iv[32];
+      // IVc = E(SesAuthENCKey, A5 5A || TI || CmdCtr || 00 * 8)
+      uint8_t iv[16];
       uint8_t ive[16];
       iv[0] = 0xA5;
       iv[1] = 0x5A;
       memcpy(iv + 2, ntag424_authresponse_TI, 4);
       iv[6] = ntag424_Session.cmd_counter & 0xff;
       iv[7] = (ntag424_Session.cmd_counter >> 8) & 0xff;
-      memset(iv + 7, 0, 24); // was 25
+      memset(iv + 8, 0, 8);
 #ifdef NTAG424DEBUG
       Serial.println("IV-init:");
       Adafruit_PN532::PrintHex(iv, 16);
@@ -1570,26 +1681,25 @@ uint8_t Adafruit_PN532::ntag424_apdu_send(
     offset++;
   }
   apdusize = offset;
-  // #ifdef NTAG424DEBUG
-  PN532DEBUGPRINT.print(F("PCD->PICC:"));
-  Adafruit_PN532::PrintHexChar(apdu + 2, apdusize - 2);
-  // #endif
+  // the command data can hold key material, frame level only shows the header
+  NTAG424_TRACE_HEX(NTAG424_TRACE_FRAMES, "PCD->PICC: ", apdu + 2,
+                    ntag424_trace_level >= NTAG424_TRACE_DATA ? apdusize - 2
+                                                              : 4);
+  uint32_t started_us = micros();
   if (!sendCommandCheckAck((uint8_t *)apdu, apdusize))
   {
 #ifdef NTAG424DEBUG
     PN532DEBUGPRINT.println(F("Failed to receive ACK for write command"));
 #endif
+    ntag424_TraceApdu(apdu, started_us, false);
     return 0;
   }
   /* Read the response packet */
   // readdata(pn532_packetbuffer, 41);
   readdata(pn532_packetbuffer, response_le);
-  // #ifdef NTAG424DEBUG
-  PN532DEBUGPRINT.print(F("PCD<-PICC: "));
-  // Adafruit_PN532::PrintHexChar(pn532_packetbuffer + 8, 5 +
-  // pn532_packetbuffer[3] - 8);
-  Adafruit_PN532::PrintHexChar(pn532_packetbuffer, 5 + pn532_packetbuffer[3]);
-  // #endif
+  ntag424_TraceApdu(apdu, started_us, true);
+  NTAG424_TRACE_HEX(NTAG424_TRACE_DATA, "PCD<-PICC: ", pn532_packetbuffer,
+                    5 + pn532_packetbuffer[3]);
   //  increase cmd_counter
   ntag424_Session.cmd_counter += 1;
 
@@ -1658,19 +1768,22 @@ uint8_t Adafruit_PN532::ntag424_apdu_send(
         return 0;
       }
     }
+#ifdef NTAG424DEBUG
     PN532DEBUGPRINT.println(F("Response CMAC ok! (picc == pcd)"));
+#endif
   }
   // decrypt the response in mode.full
   if ((response_length >= 10) && (comm_mode == NTAG424_COMM_MODE_FULL))
   {
-    uint8_t ivd[32];
+    // IVr = E(SesAuthENCKey, 5A A5 || TI || CmdCtr || 00 * 8)
+    uint8_t ivd[16];
     uint8_t ivde[16];
     ivd[0] = 0x5A;
     ivd[1] = 0xA5;
     memcpy(ivd + 2, ntag424_authresponse_TI, 4);
     ivd[6] = ntag424_Session.cmd_counter & 0xff;
     ivd[7] = (ntag424_Session.cmd_counter >> 8) & 0xff;
-    memset(ivd + 7, 0, 25);
+    memset(ivd + 8, 0, 8);
     // Serial.println("IV-init:");
     // Adafruit_PN532::PrintHex(iv, 16);
     Adafruit_PN532::ntag424_encrypt(ntag424_Session.session_key_enc,
@@ -1786,10 +1899,17 @@ uint8_t Adafruit_PN532::ntag424_encrypt(uint8_t *key, uint8_t *iv,
                                         uint8_t length, uint8_t *input,
                                         uint8_t *output)
 {
+  // the session key schedule was expanded once in derive_session_keys
+  if (key == ntag424_Session.session_key_enc &&
+      ntag424_SessionCrypto.isReady())
+  {
+    return ntag424_SessionCrypto.encrypt(iv, length, input, output) ? 1 : 0;
+  }
+
   mbedtls_aes_context ctx;
   mbedtls_aes_init(&ctx);
   // Set the key for the AES context
-  if (mbedtls_aes_setkey_dec(&ctx, key, 128) != 0)
+  if (mbedtls_aes_setkey_enc(&ctx, key, 128) != 0)
   {
     // Error setting key
     mbedtls_aes_free(&ctx);
@@ -1838,6 +1958,12 @@ uint8_t Adafruit_PN532::ntag424_decrypt(uint8_t *key, uint8_t *iv,
                                         uint8_t length, uint8_t *input,
                                         uint8_t *output)
 {
+  if (key == ntag424_Session.session_key_enc &&
+      ntag424_SessionCrypto.isReady())
+  {
+    return ntag424_SessionCrypto.decrypt(iv, length, input, output) ? 1 : 0;
+  }
+
   mbedtls_aes_context ctx;
   mbedtls_aes_init(&ctx);
   // Set the key for the AES context
@@ -1850,6 +1976,7 @@ uint8_t Adafruit_PN532::ntag424_decrypt(uint8_t *key, uint8_t *iv,
   if (mbedtls_aes_crypt_cbc(&ctx, MBEDTLS_AES_DECRYPT, length, iv,
                             (uint8_t *)input, (uint8_t *)output) != 0)
   {
+    mbedtls_aes_free(&ctx);
     return 0;
   }
   mbedtls_aes_free(&ctx);
@@ -1906,6 +2033,12 @@ uint8_t Adafruit_PN532::ntag424_cmac_short(uint8_t *key, uint8_t *input,
 uint8_t Adafruit_PN532::ntag424_cmac(uint8_t *key, uint8_t *input,
                                      uint8_t length, uint8_t *cmac)
 {
+  if (key == ntag424_Session.session_key_mac &&
+      ntag424_SessionCrypto.isReady())
+  {
+    return ntag424_SessionCrypto.cmac(input, length, cmac) ? 1 : 0;
+  }
+
   int ret = 0;
   const mbedtls_cipher_info_t *cipher_info;
   cipher_info = mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB);
@@ -1943,10 +2076,9 @@ uint8_t Adafruit_PN532::ntag424_cmac(uint8_t *key, uint8_t *input,
   PN532DEBUGPRINT.print(F("cmac output: "));
   Adafruit_PN532::PrintHexChar(cmac, 16);
 #endif
-  return 1;
 exit:
   mbedtls_cipher_free(&ctx);
-  return 0;
+  return ret == 0 ? 1 : 0;
 }
 
 /**************************************************************************/
@@ -2096,6 +2228,11 @@ void Adafruit_PN532::ntag424_derive_session_keys(uint8_t *key, uint8_t *RndA,
   Adafruit_PN532::ntag424_cmac(key, sv1, 32, ntag424_Session.session_key_enc);
   Adafruit_PN532::ntag424_cmac(key, sv2, 32, ntag424_Session.session_key_mac);
 
+  // every APDU of the session reuses these instead of expanding the keys,
+  // on failure encrypt/decrypt/cmac fall back to one-shot contexts
+  ntag424_SessionCrypto.begin(ntag424_Session.session_key_enc,
+                              ntag424_Session.session_key_mac);
+
 #ifdef NTAG424DEBUG
   PN532DEBUGPRINT.print(F("session_key_mac: "));
   Adafruit_PN532::PrintHexChar(ntag424_Session.session_key_mac,
@@ -2119,9 +2256,9 @@ void Adafruit_PN532::ntag424_derive_session_keys(uint8_t *key, uint8_t *RndA,
 
 uint32_t Adafruit_PN532::ntag424_crc32(uint8_t *data, uint8_t datalength)
 {
-  Adafruit_PN532::PrintHexChar((uint8_t const *)data, datalength);
+  NTAG424_TRACE_HEX(NTAG424_TRACE_DATA, "crc32 input: ", data, datalength);
   uint32_t const crc32_res = crc32.calc((uint8_t const *)data, datalength);
-  Serial.println(crc32_res, HEX);
+  NTAG424_TRACE(NTAG424_TRACE_DATA, "crc32: ", crc32_res, HEX);
   return crc32_res;
 }
 
@@ -2172,32 +2309,17 @@ uint8_t Adafruit_PN532::ntag424_rotl(uint8_t *input, uint8_t *output,
 }
 
 /*!
-    @brief   Authenticate to start encrypted or signed communication.
+    @brief   Select the NTAG424 application (DF name D2760000850101) on the
+             inlisted target and remember it for the session.
 
-    @param   key      encryption key
-    @param   keyno   number of key to authenticate against (0-4)
-    @param   cmd      0x71 or 0x77
-
-    @return  1 = success; 0 = failed
+    @return  false on fail|true on success
 */
 /**************************************************************************/
-
-uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
-                                             uint8_t cmd)
+bool Adafruit_PN532::ntag424_SelectApplication()
 {
-
-#ifdef NTAG424DEBUG
-  PN532DEBUGPRINT.print(F("Authenticating with key: "));
-  PN532DEBUGPRINT.println((char *)key);
-#endif
-
-// 1.) IsoSelectFile
-#ifdef NTAG424DEBUG
-  PN532DEBUGPRINT.println(F("1.) ISOSelectFile"));
-#endif
-  int cmd_len = 15;
+  const int cmd_len = 15;
   uint8_t cmd_select[cmd_len] = {PN532_COMMAND_INDATAEXCHANGE,
-                                 0x01,
+                                 _inListedTag,
                                  0x00,
                                  0xA4,
                                  0x04,
@@ -2218,7 +2340,7 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
 #ifdef NTAG424DEBUG
     PN532DEBUGPRINT.println(F("Failed to receive ACK for write command"));
 #endif
-    return 0;
+    return false;
   }
   /* Read the response packet */
   readdata(pn532_packetbuffer, 26);
@@ -2238,6 +2360,130 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
 #ifdef NTAG424DEBUG
     PN532DEBUGPRINT.println(F("ISOSelectFile ResultError"));
 #endif
+    return false;
+  }
+
+  ntag424_Session.app_selected = true;
+  return true;
+}
+
+/*!
+    @brief   Forget the selected application and EV2 session, e.g. after
+             a new target was inlisted or the target stopped responding.
+*/
+/**************************************************************************/
+void Adafruit_PN532::ntag424_ResetSession()
+{
+  ntag424_Session.app_selected = false;
+  ntag424_Session.authenticated = false;
+  ntag424_Session.cmd_counter = 0;
+  ntag424_SessionCrypto.end();
+}
+
+/**************************************************************************/
+/*!
+    @brief   Record an APDU in the trace ring and print its status at
+             NTAG424_TRACE_FRAMES. Call before cmd_counter is increased.
+
+    @param   apdu        InDataExchange command as sent (CLA at apdu[2])
+    @param   started_us  micros() right before the command was sent
+    @param   responded   false if the PN532 did not ACK the command; the
+                         response is expected in pn532_packetbuffer otherwise
+*/
+/**************************************************************************/
+void Adafruit_PN532::ntag424_TraceApdu(const uint8_t *apdu,
+                                       uint32_t started_us, bool responded)
+{
+  Adafruit_PN532_TraceEntry entry;
+  entry.duration_us = micros() - started_us;
+  entry.started_ms = millis() - entry.duration_us / 1000;
+  entry.cmd_counter = ntag424_Session.cmd_counter;
+  entry.cla = apdu[2];
+  entry.ins = apdu[3];
+  entry.p1 = apdu[4];
+  entry.p2 = apdu[5];
+  entry.lc = apdu[6];
+  entry.status = 0xFF;
+  entry.sw1 = 0;
+  entry.sw2 = 0;
+  entry.response_length = 0;
+
+  if (responded)
+  {
+    // LEN covers TFI, command code and status ahead of the response data
+    uint8_t length = pn532_packetbuffer[3] > 3 ? pn532_packetbuffer[3] - 3 : 0;
+    if (length > PN532_PACKBUFFSIZ - 8)
+      length = PN532_PACKBUFFSIZ - 8;
+    entry.status = pn532_packetbuffer[7];
+    entry.response_length = length;
+    if (length >= 2)
+    {
+      entry.sw1 = pn532_packetbuffer[8 + length - 2];
+      entry.sw2 = pn532_packetbuffer[8 + length - 1];
+    }
+  }
+
+#if NTAG424_TRACE_RING_SIZE > 0
+  ntag424_TraceRing.record(entry);
+#endif
+
+  uint8_t sw[2] = {entry.sw1, entry.sw2};
+  NTAG424_TRACE_HEX(NTAG424_TRACE_FRAMES, "PCD<-PICC SW: ", sw, sizeof(sw));
+  NTAG424_TRACE(NTAG424_TRACE_FRAMES, "APDU us: ", entry.duration_us);
+}
+
+/**************************************************************************/
+/*!
+    @brief   Copy the last APDUs from the trace ring, oldest first.
+
+    @param   entries   output buffer
+    @param   max       capacity of entries
+    @param   recorded  optional, set to the number of APDUs traced since boot
+
+    @return  number of entries copied, 0 if the ring is compiled out
+*/
+/**************************************************************************/
+uint16_t Adafruit_PN532::ntag424_TraceSnapshot(
+    Adafruit_PN532_TraceEntry *entries, uint16_t max, uint32_t *recorded) const
+{
+#if NTAG424_TRACE_RING_SIZE > 0
+  return ntag424_TraceRing.snapshot(entries, max, recorded);
+#else
+  if (recorded != NULL)
+    *recorded = 0;
+  return 0;
+#endif
+}
+
+/*!
+    @brief   Authenticate to start encrypted or signed communication.
+
+    @param   key      encryption key
+    @param   keyno   number of key to authenticate against (0-4)
+    @param   cmd      0x71 or 0x77
+
+    @return  1 = success; 0 = failed
+*/
+/**************************************************************************/
+
+uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
+                                             uint8_t cmd)
+{
+
+#ifdef NTAG424DEBUG
+  PN532DEBUGPRINT.print(F("Authenticating with key: "));
+  PN532DEBUGPRINT.println((char *)key);
+#endif
+
+  // a failed or new authentication always ends the previous session
+  ntag424_Session.authenticated = false;
+
+// 1.) IsoSelectFile, once per inlisted target
+#ifdef NTAG424DEBUG
+  PN532DEBUGPRINT.println(F("1.) ISOSelectFile"));
+#endif
+  if (!ntag424_Session.app_selected && !ntag424_SelectApplication())
+  {
     return 0;
   }
 
@@ -2245,9 +2491,9 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
 #ifdef NTAG424DEBUG
   PN532DEBUGPRINT.println(F("2.) AuthenticateFirst part 1"));
 #endif
-  cmd_len = 13;
+  int cmd_len = 13;
   uint8_t cmd_auth1[cmd_len] = {PN532_COMMAND_INDATAEXCHANGE,
-                                0x01,
+                                _inListedTag,
                                 0x90,
                                 cmd,
                                 0x00,
@@ -2261,15 +2507,19 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
                                 0x00};
   /* Prepare the command */
   /* Send the command */
+  uint32_t started_us = micros();
   if (!sendCommandCheckAck((uint8_t *)cmd_auth1, cmd_len))
   {
 #ifdef NTAG424DEBUG
     PN532DEBUGPRINT.println(F("Failed to receive ACK for write command"));
 #endif
+    ntag424_TraceApdu(cmd_auth1, started_us, false);
+    ntag424_ResetSession();
     return 0;
   }
   /* Read the response packet */
   readdata(pn532_packetbuffer, 26);
+  ntag424_TraceApdu(cmd_auth1, started_us, true);
 #ifdef NTAG424DEBUG
   PN532DEBUGPRINT.print(F("> AUTH 1: "));
   Adafruit_PN532::PrintHexChar(cmd_auth1, cmd_len);
@@ -2285,6 +2535,9 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
 #ifdef NTAG424DEBUG
     PN532DEBUGPRINT.println(F("AuthenticateFirst part 1 ResultError"));
 #endif
+    // a PN532 status error means the target is gone, not a wrong key
+    if (pn532_packetbuffer[7] != 0x00)
+      ntag424_ResetSession();
     return 0;
   }
 
@@ -2309,8 +2562,8 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
   {
 #ifdef NTAG424DEBUG
     PN532DEBUGPRINT.println(F("Decryption error"));
-    return 0;
 #endif
+    return 0;
   }
   memset(RndBRotl, 0, sizeof(RndBRotl));
   ntag424_rotl(RndB, RndBRotl, blocklength, 1);
@@ -2340,29 +2593,30 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
   /*
    * send the answer
    */
-  uint8_t prefix[7] = {
-      PN532_COMMAND_INDATAEXCHANGE, 0x01, 0x90, 0xaf, 0x00, 0x00, 0x20};
+  uint8_t prefix[7] = {PN532_COMMAND_INDATAEXCHANGE, _inListedTag, 0x90, 0xaf,
+                       0x00, 0x00, 0x20};
   uint8_t postfix[1] = {0x00};
   int apdusize = sizeof(prefix) + sizeof(answer_enc) + sizeof(postfix);
   uint8_t apdu[apdusize];
   memcpy(&apdu[0], prefix, sizeof(prefix));
   memcpy(&apdu[sizeof(prefix)], answer_enc, sizeof(answer_enc));
   memcpy(&apdu[sizeof(prefix) + sizeof(answer_enc)], postfix, sizeof(postfix));
+  started_us = micros();
   if (!sendCommandCheckAck((uint8_t *)apdu, apdusize))
   {
 #ifdef NTAG424DEBUG
     PN532DEBUGPRINT.println(F("Failed to receive ACK for write command"));
 #endif
+    ntag424_TraceApdu(apdu, started_us, false);
+    ntag424_ResetSession();
     return 0;
   }
   /* Read the response packet */
   readdata(pn532_packetbuffer, 42);
-  // #ifdef NTAG424DEBUG
-  PN532DEBUGPRINT.println(F("> AUTH 2 - PCD encrypted answer: "));
-  Adafruit_PN532::PrintHexChar(apdu, apdusize);
-  PN532DEBUGPRINT.print(F("Received: "));
-  Adafruit_PN532::PrintHexChar(pn532_packetbuffer, 42);
-  // #endif
+  ntag424_TraceApdu(apdu, started_us, true);
+  NTAG424_TRACE_HEX(NTAG424_TRACE_DATA, "> AUTH 2 - PCD encrypted answer: ",
+                    apdu, apdusize);
+  NTAG424_TRACE_HEX(NTAG424_TRACE_DATA, "Received: ", pn532_packetbuffer, 42);
   if (pn532_packetbuffer[7] != 0x00 || pn532_packetbuffer[40] != 0x91 ||
       pn532_packetbuffer[41] != 0x00)
   {
@@ -2370,6 +2624,8 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
     PN532DEBUGPRINT.println(F("AuthenticateFirst part 2 ResultError"));
     Adafruit_PN532::PrintHexChar(&pn532_packetbuffer[8], 2);
 #endif
+    if (pn532_packetbuffer[7] != 0x00)
+      ntag424_ResetSession();
     return 0;
   }
 
@@ -2435,6 +2691,8 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
   uint8_t TestTI[4] = {0x7A,0x21,0x08,0x5E} ;
   */
   Adafruit_PN532::ntag424_derive_session_keys(key, RndA, RndB);
+  ntag424_Session.authenticated = true;
+  ntag424_Session.keyno = keyno;
   // Return OK signal
   return 1;
 }
@@ -2576,7 +2834,14 @@ uint8_t Adafruit_PN532::ntag424_ChangeKey(uint8_t *oldkey, uint8_t *newkey,
       NTAG424_COMM_MODE_FULL, result, sizeof(result)
 
   );
-  Adafruit_PN532::PrintHex(result, response_length);
+  NTAG424_TRACE_HEX(NTAG424_TRACE_DATA, "ChangeKey response: ", result,
+                    response_length);
+
+  // changing the key the session was opened with invalidates the session
+  if (keynumber == ntag424_Session.keyno)
+  {
+    ntag424_Session.authenticated = false;
+  }
 
   if ((result[0] != 0x91) || (result[1] != 0x00))
   {
@@ -2705,7 +2970,7 @@ uint8_t Adafruit_PN532::ntag424_ReadData(uint8_t *buffer, int fileno,
   */
   /* Prepare the command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; /* Card number */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] = NTAG424_COM_CLA;
   pn532_packetbuffer[3] = NTAG424_CMD_READDATA;
   pn532_packetbuffer[4] = 0;
@@ -2762,6 +3027,9 @@ uint8_t Adafruit_PN532::ntag424_ReadData(uint8_t *buffer, int fileno,
     Serial.println(datasize);
 #endif
     memcpy(buffer, pn532_packetbuffer + 17, datasize);
+    // plain commands count in an authenticated session as well
+    if (ntag424_Session.authenticated)
+      ntag424_Session.cmd_counter += 1;
   }
   else
   {
@@ -2819,7 +3087,7 @@ uint8_t Adafruit_PN532::ntag424_WriteData(const uint8_t *data,
   uint8_t Lc = 7 + size + 8;
 
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; // target card #
+  pn532_packetbuffer[1] = _inListedTag; // target card #
   pn532_packetbuffer[2] = NTAG424_COM_CLA;
   pn532_packetbuffer[3] = NTAG424_CMD_WRITEDATA;
   pn532_packetbuffer[4] = 0x00; // P1
@@ -2899,7 +3167,7 @@ uint8_t Adafruit_PN532::ntag424_GetVersion()
 {
   /* Prepare the command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; /* Card number */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] = NTAG424_COM_CLA;
   pn532_packetbuffer[3] = NTAG424_CMD_GETVERSION;
   pn532_packetbuffer[4] = 0x0;
@@ -2931,7 +3199,7 @@ uint8_t Adafruit_PN532::ntag424_GetVersion()
     return 0;
   }
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; /* Card number */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] = NTAG424_COM_CLA;
   pn532_packetbuffer[3] = NTAG424_CMD_NEXTFRAME;
   pn532_packetbuffer[4] = 0x0;
@@ -2962,7 +3230,7 @@ uint8_t Adafruit_PN532::ntag424_GetVersion()
     return 0;
   }
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; /* Card number */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] = NTAG424_COM_CLA;
   pn532_packetbuffer[3] = NTAG424_CMD_NEXTFRAME;
   pn532_packetbuffer[4] = 0x0;
@@ -3030,9 +3298,7 @@ bool Adafruit_PN532::ntag424_FormatNDEF()
   uint8_t datalen = sizeof(ndefdata);
   for (int i = 0; i < memsize; i += sizeof(ndefdata))
   {
-    Serial.print(i);
-    Serial.print(": ");
-    Serial.println(offset);
+    NTAG424_TRACE(NTAG424_TRACE_DATA, "UpdateBinary offset: ", offset);
     p2[0] = offset;
     if ((offset + datalen) > memsize)
     {
@@ -3049,7 +3315,7 @@ bool Adafruit_PN532::ntag424_FormatNDEF()
     }
     offset += datalen;
 
-    Serial.println(bytesread);
+    NTAG424_TRACE(NTAG424_TRACE_DATA, "UpdateBinary bytes: ", bytesread);
   }
   return ret;
 }
@@ -3079,9 +3345,7 @@ bool Adafruit_PN532::ntag424_ISOUpdateBinary(uint8_t *data_to_write,
   uint8_t datalen = PN532_PACKBUFFSIZ - 10;
   for (int i = 0; i < length; i += datalen)
   {
-    Serial.print(i);
-    Serial.print(": ");
-    Serial.println(offset);
+    NTAG424_TRACE(NTAG424_TRACE_DATA, "UpdateBinary offset: ", offset);
     p2[0] = offset;
     if ((offset + datalen) > length)
     {
@@ -3135,6 +3399,11 @@ bool Adafruit_PN532::ntag424_ISOSelectFileById(int fileid)
   {
     return false;
   }
+  // selecting the MF leaves the NTAG424 application
+  if (fileid == 0x3F00)
+  {
+    ntag424_Session.app_selected = false;
+  }
   return true;
 }
 
@@ -3162,10 +3431,16 @@ bool Adafruit_PN532::ntag424_ISOSelectFileByDFN(uint8_t *dfn)
   Adafruit_PN532::ntag424_apdu_send(cla, ins, p1, p2, cmd_header, 0, dfn, 7, 0,
                                     NTAG424_COMM_MODE_PLAIN, result,
                                     sizeof(result));
+  // any DF selection replaces the current one and ends the session
+  ntag424_Session.authenticated = false;
   if ((result[0] != 0x90) || (result[1] != 0x00))
   {
+    ntag424_Session.app_selected = false;
     return false;
   }
+  static const uint8_t ntag424_dfn[7] = {0xD2, 0x76, 0x00, 0x00,
+                                         0x85, 0x01, 0x01};
+  ntag424_Session.app_selected = memcmp(dfn, ntag424_dfn, 7) == 0;
   return true;
 }
 
@@ -3187,7 +3462,7 @@ uint8_t Adafruit_PN532::ntag424_ISOReadFile(uint8_t *buffer)
   // call getfilesettings
   /* Prepare the command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; /* Card number */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] = NTAG424_COM_CLA;
   pn532_packetbuffer[3] = NTAG424_CMD_GETFILESETTINGS;
   pn532_packetbuffer[4] = 0x0;
@@ -3212,7 +3487,7 @@ uint8_t Adafruit_PN532::ntag424_ISOReadFile(uint8_t *buffer)
   // Select the default ISO-7816-4 DF name of the application file
   /* Prepare the command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; /* Card number */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] = NTAG424_COM_ISOCLA;
   pn532_packetbuffer[3] = NTAG424_CMD_ISOSELECTFILE;
   pn532_packetbuffer[4] = 0x4;
@@ -3258,7 +3533,7 @@ uint8_t Adafruit_PN532::ntag424_ISOReadFile(uint8_t *buffer)
   // Select the default ISO-7816-4 DF name of the application file
   /* Prepare the command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; /* Card number */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] = NTAG424_COM_ISOCLA;
   pn532_packetbuffer[3] = NTAG424_CMD_ISOSELECTFILE;
   pn532_packetbuffer[4] = 0x0;
@@ -3298,7 +3573,7 @@ uint8_t Adafruit_PN532::ntag424_ISOReadFile(uint8_t *buffer)
   // Select the default ISO-7816-4 DF name of the application file
   /* Prepare the command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; /* Card number */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] = NTAG424_COM_ISOCLA;
   pn532_packetbuffer[3] = NTAG424_CMD_ISOREADBINARY;
   pn532_packetbuffer[4] = 0x0;
@@ -3346,7 +3621,7 @@ uint8_t Adafruit_PN532::ntag424_ISOReadFile(uint8_t *buffer)
     // Select the default ISO-7816-4 DF name of the application file
     /* Prepare the command */
     pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-    pn532_packetbuffer[1] = 1; /* Card number */
+    pn532_packetbuffer[1] = _inListedTag; /* Card number */
     pn532_packetbuffer[2] = NTAG424_COM_ISOCLA;
     pn532_packetbuffer[3] = NTAG424_CMD_ISOREADBINARY;
     pn532_packetbuffer[4] = 0x0;
@@ -3423,7 +3698,7 @@ uint8_t Adafruit_PN532::ntag2xx_ReadPage(uint8_t page, uint8_t *buffer)
 
   /* Prepare the command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1;               /* Card number */
+  pn532_packetbuffer[1] = _inListedTag;    /* Card number */
   pn532_packetbuffer[2] = MIFARE_CMD_READ; /* Mifare Read command = 0x30 */
   pn532_packetbuffer[3] = page;            /* Page Number (0..63 in most cases) */
 
@@ -3511,7 +3786,7 @@ uint8_t Adafruit_PN532::ntag2xx_WritePage(uint8_t page, uint8_t *data)
 
   /* Prepare the first command */
   pn532_packetbuffer[0] = PN532_COMMAND_INDATAEXCHANGE;
-  pn532_packetbuffer[1] = 1; /* Card number */
+  pn532_packetbuffer[1] = _inListedTag; /* Card number */
   pn532_packetbuffer[2] =
       MIFARE_ULTRALIGHT_CMD_WRITE;         /* Mifare Ultralight Write command = 0xA2 */
   pn532_packetbuffer[3] = page;            /* Page Number (0..63 for most cases) */
@@ -3653,15 +3928,7 @@ bool Adafruit_PN532::readack()
 {
   uint8_t ackbuff[6];
 
-  if (spi_dev)
-  {
-    uint8_t cmd = PN532_SPI_DATAREAD;
-    spi_dev->write_then_read(&cmd, 1, ackbuff, 6);
-  }
-  else if (i2c_dev || ser_dev)
-  {
-    readdata(ackbuff, 6);
-  }
+  readdata(ackbuff, 6);
 
   return (0 == memcmp((char *)ackbuff, (char *)pn532ack, 6));
 }
@@ -3673,25 +3940,11 @@ bool Adafruit_PN532::readack()
 /**************************************************************************/
 bool Adafruit_PN532::isready()
 {
-  if (spi_dev)
-  {
-    // SPI ready check via Status Request
-    uint8_t cmd = PN532_SPI_STATREAD;
-    uint8_t reply;
-    spi_dev->write_then_read(&cmd, 1, &reply, 1);
-    return reply == PN532_SPI_READY;
-  }
-  else if (i2c_dev)
+  if (transport)
   {
-    // I2C ready check via reading RDY byte
-    uint8_t rdy[1];
-    i2c_dev->read(rdy, 1);
-    return rdy[0] == PN532_I2C_READY;
-  }
-  else if (ser_dev)
-  {
-    // Serial ready check based on non-zero read buffer
-    return (ser_dev->available() != 0);
+    // bus specific: SPI status read, I2C RDY byte, or UART rx buffer
+    _busTransactions++;
+    return transport->isReady();
   }
   else if (_irq != -1)
   {
@@ -3703,35 +3956,41 @@ bool Adafruit_PN532::isready()
 
 /**************************************************************************/
 /*!
-    @brief  Waits until the PN532 is ready.
+    @brief  Waits until the PN532 is ready. The pause between ready checks
+            starts below a millisecond, as ACKs and most APDU responses are
+            ready within one or two, and doubles up to 10 ms for slow
+            commands such as a pending target detection.
 
-    @param  timeout   Timeout before giving up
+    @param  timeout   Timeout in ms before giving up, 0 waits forever
 */
 /**************************************************************************/
 bool Adafruit_PN532::waitready(uint16_t timeout)
 {
-  uint16_t timer = 0;
+  uint32_t started = millis();
+  uint32_t pause_us = PN532_WAITREADY_MIN_US;
   while (!isready())
   {
-    if (timeout != 0)
+    if (timeout != 0 && millis() - started > timeout)
     {
-      timer += 10;
-      if (timer > timeout)
-      {
 #ifdef PN532DEBUG
-        PN532DEBUGPRINT.println("TIMEOUT!");
+      PN532DEBUGPRINT.println("TIMEOUT!");
 #endif
-        return false;
-      }
+      return false;
     }
-    delay(10);
+    if (pause_us < 1000)
+      delayMicroseconds(pause_us);
+    else
+      delay(pause_us / 1000);
+    pause_us *= 2;
+    if (pause_us > PN532_WAITREADY_MAX_US)
+      pause_us = PN532_WAITREADY_MAX_US;
   }
   return true;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Reads n bytes of data from the PN532 via SPI or I2C.
+    @brief  Reads n bytes of data from the PN532 via the transport.
 
     @param  buff      Pointer to the buffer where data will be written
     @param  n         Number of bytes to be read
@@ -3739,27 +3998,14 @@ bool Adafruit_PN532::waitready(uint16_t timeout)
 /**************************************************************************/
 void Adafruit_PN532::readdata(uint8_t *buff, uint8_t n)
 {
-  if (spi_dev)
+  if (transport == NULL)
   {
-    // SPI read
-    uint8_t cmd = PN532_SPI_DATAREAD;
-    spi_dev->write_then_read(&cmd, 1, buff, n);
-  }
-  else if (i2c_dev)
-  {
-    // I2C read
-    uint8_t rbuff[n + 1]; // +1 for leading RDY byte
-    i2c_dev->read(rbuff, n + 1);
-    for (uint8_t i = 0; i < n; i++)
-    {
-      buff[i] = rbuff[i + 1];
-    }
-  }
-  else if (ser_dev)
-  {
-    // Serial read
-    ser_dev->readBytes(buff, n);
+    memset(buff, 0, n);
+    return;
   }
+
+  _busTransactions++;
+  transport->read(buff, n);
 #ifdef PN532DEBUG
   PN532DEBUGPRINT.print(F("Reading: "));
   for (uint8_t i = 0; i < n; i++)
@@ -3886,98 +4132,42 @@ uint8_t Adafruit_PN532::setDataTarget(uint8_t *cmd, uint8_t cmdlen)
 /**************************************************************************/
 void Adafruit_PN532::writecommand(uint8_t *cmd, uint8_t cmdlen)
 {
-  if (spi_dev)
+  if (transport == NULL)
   {
-    // SPI command write.
-    uint8_t checksum;
-    uint8_t packet[9 + cmdlen];
-    uint8_t *p = packet;
-    cmdlen++;
-
-    p[0] = PN532_SPI_DATAWRITE;
-    p++;
-
-    p[0] = PN532_PREAMBLE;
-    p++;
-    p[0] = PN532_STARTCODE1;
-    p++;
-    p[0] = PN532_STARTCODE2;
-    p++;
-    checksum = PN532_PREAMBLE + PN532_STARTCODE1 + PN532_STARTCODE2;
-
-    p[0] = cmdlen;
-    p++;
-    p[0] = ~cmdlen + 1;
-    p++;
-
-    p[0] = PN532_HOSTTOPN532;
-    p++;
-    checksum += PN532_HOSTTOPN532;
-
-    for (uint8_t i = 0; i < cmdlen - 1; i++)
-    {
-      p[0] = cmd[i];
-      p++;
-      checksum += cmd[i];
-    }
-
-    p[0] = ~checksum;
-    p++;
-    p[0] = PN532_POSTAMBLE;
-    p++;
+    return;
+  }
 
-#ifdef PN532DEBUG
-    PN532DEBUGPRINT.print("Sending : ");
-    for (int i = 1; i < 8 + cmdlen; i++)
-    {
-      PN532DEBUGPRINT.print("0x");
-      PN532DEBUGPRINT.print(packet[i], HEX);
-      PN532DEBUGPRINT.print(", ");
-    }
-    PN532DEBUGPRINT.println();
-#endif
+  // Bus independent normal information frame; SPI adds its DATAWRITE
+  // prefix inside the transport.
+  uint8_t packet[8 + cmdlen];
+  uint8_t LEN = cmdlen + 1;
 
-    spi_dev->write(packet, 8 + cmdlen);
-  }
-  else if (i2c_dev || ser_dev)
+  packet[0] = PN532_PREAMBLE;
+  packet[1] = PN532_STARTCODE1;
+  packet[2] = PN532_STARTCODE2;
+  packet[3] = LEN;
+  packet[4] = ~LEN + 1;
+  packet[5] = PN532_HOSTTOPN532;
+  uint8_t sum = 0;
+  for (uint8_t i = 0; i < cmdlen; i++)
   {
-    // I2C or Serial command write.
-    uint8_t packet[8 + cmdlen];
-    uint8_t LEN = cmdlen + 1;
-
-    packet[0] = PN532_PREAMBLE;
-    packet[1] = PN532_STARTCODE1;
-    packet[2] = PN532_STARTCODE2;
-    packet[3] = LEN;
-    packet[4] = ~LEN + 1;
-    packet[5] = PN532_HOSTTOPN532;
-    uint8_t sum = 0;
-    for (uint8_t i = 0; i < cmdlen; i++)
-    {
-      packet[6 + i] = cmd[i];
-      sum += cmd[i];
-    }
-    packet[6 + cmdlen] = ~(PN532_HOSTTOPN532 + sum) + 1;
-    packet[7 + cmdlen] = PN532_POSTAMBLE;
+    packet[6 + i] = cmd[i];
+    sum += cmd[i];
+  }
+  packet[6 + cmdlen] = ~(PN532_HOSTTOPN532 + sum) + 1;
+  packet[7 + cmdlen] = PN532_POSTAMBLE;
 
 #ifdef PN532DEBUG
-    Serial.print("Sending : ");
-    for (int i = 1; i < 8 + cmdlen; i++)
-    {
-      Serial.print("0x");
-      Serial.print(packet[i], HEX);
-      Serial.print(", ");
-    }
-    Serial.println();
+  PN532DEBUGPRINT.print("Sending : ");
+  for (int i = 1; i < 8 + cmdlen; i++)
+  {
+    PN532DEBUGPRINT.print("0x");
+    PN532DEBUGPRINT.print(packet[i], HEX);
+    PN532DEBUGPRINT.print(", ");
+  }
+  PN532DEBUGPRINT.println();
 #endif
 
-    if (i2c_dev)
-    {
-      i2c_dev->write(packet, 8 + cmdlen);
-    }
-    else
-    {
-      ser_dev->write(packet, 8 + cmdlen);
-    }
-  }
-}
+  _busTransactions++;
+  transport->writeFrame(packet, 8 + cmdlen);
+}
\ No newline at end of file
@@ -15,8 +15,9 @@
 
 #include "Arduino.h"
 
-#include <Adafruit_I2CDevice.h>
-#include <Adafruit_SPIDevice.h>
+#include "Adafruit_PN532_SessionCrypto.h"
+#include "Adafruit_PN532_Trace.h"
+#include "Adafruit_PN532_Transport.h"
 #include "mbedtls/aes.h"
 #include "mbedtlscmac.h"
 #include <Arduino_CRC32.h>
@@ -68,19 +69,12 @@
 
 #define PN532_WAKEUP (0x55) ///< Wake
 
-#define PN532_SPI_STATREAD (0x02)  ///< Stat read
-#define PN532_SPI_DATAWRITE (0x01) ///< Data write
-#define PN532_SPI_DATAREAD (0x03)  ///< Data read
-#define PN532_SPI_READY (0x01)     ///< Ready
-
-#define PN532_I2C_ADDRESS (0x48 >> 1) ///< Default I2C address
-#define PN532_I2C_READBIT (0x01)      ///< Read bit
-#define PN532_I2C_BUSY (0x00)         ///< Busy
-#define PN532_I2C_READY (0x01)        ///< Ready
-#define PN532_I2C_READYTIMEOUT (20)   ///< Ready timeout
-
 #define PN532_MIFARE_ISO14443A (0x00) ///< MiFare
 
+#define PN532_MAX_TARGETS (2) ///< Targets one InListPassiveTarget can activate
+#define PN532_MAX_UID_LENGTH (10) ///< NFCID1 triple size, size of uid buffers
+#define PN532_SEL_RES_ISO14443_4 (0x20) ///< SAK bit: target speaks ISO14443-4
+
 // NTAG242 Commands
 #define NTAG424_COMM_MODE_PLAIN (0x00)        ///< Commmode plain
 #define NTAG424_COMM_MODE_MAC (0x01)          ///< Commmode mac
@@ -162,6 +156,18 @@
 #define PN532_GPIO_P34 (4)              ///< GPIO 34
 #define PN532_GPIO_P35 (5)              ///< GPIO 35
 
+/**
+ * @brief An ISO14443A target activated by the last InListPassiveTarget.
+ */
+struct Adafruit_PN532_Target
+{
+  uint8_t tg;        ///< logical target number for InDataExchange
+  uint16_t sens_res; ///< SENS_RES (ATQA)
+  uint8_t sel_res;   ///< SEL_RES (SAK)
+  uint8_t uidLength; ///< length of uid
+  uint8_t uid[PN532_MAX_UID_LENGTH]; ///< NFCID1, up to triple size
+};
+
 /**
  * @brief Class for working with Adafruit PN532 NFC/RFID breakout boards.
  */
@@ -174,6 +180,8 @@ public:
   Adafruit_PN532(uint8_t irq, uint8_t reset,
                  TwoWire *theWire = &Wire);              // Hardware I2C
   Adafruit_PN532(uint8_t reset, HardwareSerial *theSer); // Hardware UART
+  Adafruit_PN532(Adafruit_PN532_Transport *theTransport, int8_t irq = -1,
+                 int8_t reset = -1); // Caller owned transport
   bool begin(void);
 
   void reset(void);
@@ -191,9 +199,26 @@ public:
   // ISO14443A functions
   bool readPassiveTargetID(
       uint8_t cardbaudrate, uint8_t *uid, uint8_t *uidLength,
-      uint16_t timeout = 0); // timeout 0 means no timeout - will block forever.
-  bool startPassiveTargetIDDetection(uint8_t cardbaudrate);
+      uint16_t timeout = 0, // timeout 0 means no timeout - will block forever.
+      uint8_t maxTargets = 1);
+  bool startPassiveTargetIDDetection(uint8_t cardbaudrate,
+                                     uint8_t maxTargets = 1);
   bool readDetectedPassiveTargetID(uint8_t *uid, uint8_t *uidLength);
+  /*!
+      @brief  Return the number of targets the last detection activated.
+  */
+  uint8_t getTargetCount(void) const { return _targetCount; }
+  /*!
+      @brief  Return an activated target, index < getTargetCount().
+  */
+  const Adafruit_PN532_Target &getTarget(uint8_t index) const
+  {
+    return _targets[index];
+  }
+  bool selectTarget(uint8_t index);
+  bool isResponseReady(void);
+  void abortCommand(void);
+  uint32_t getBusTransactionCount(void) const { return _busTransactions; }
   bool inDataExchange(uint8_t *send, uint8_t sendLength, uint8_t *response,
                       uint8_t *responseLength);
   bool inListPassiveTarget();
@@ -267,8 +292,11 @@ public:
   bool ntag424_ISOUpdateBinary(uint8_t *buffer, uint8_t length);
   bool ntag424_ISOSelectFileById(int fileid);
   bool ntag424_ISOSelectFileByDFN(uint8_t *dfn);
+  void ntag424_ResetSession();
   uint8_t ntag424_isNTAG424();
   uint8_t ntag424_GetVersion();
+  uint16_t ntag424_TraceSnapshot(Adafruit_PN532_TraceEntry *entries,
+                                 uint16_t max, uint32_t *recorded = NULL) const;
 
 // NTAG424 authresponse data
 #define NTAG424_AUTHRESPONSE_ENC_SIZE 32    ///< Size of encoded Auth-Response
@@ -300,7 +328,9 @@ public:
 
   struct ntag424_SessionType
   {
+    bool app_selected;  ///< NTAG424 application selected on inlisted target
     bool authenticated; ///< true = authenticated
+    uint8_t keyno;      ///< key number of the current EV2 session
     int cmd_counter;    ///< command counter
     uint8_t
         session_key_enc[NTAG424_SESSION_KEYSIZE];     ///< session encryption key
@@ -370,18 +400,28 @@ private:
   int8_t _uid[7];      // ISO14443A uid
   int8_t _uidLen;      // uid len
   int8_t _key[6];      // Mifare Classic key
-  int8_t _inListedTag; // Tg number of inlisted tag.
+  uint8_t _inListedTag = 1; // Tg number of inlisted tag.
+  uint8_t _listMaxTargets = 1; // MaxTg of the pending InListPassiveTarget
+  uint8_t _targetCount = 0;    // targets activated by the last detection
+  Adafruit_PN532_Target _targets[PN532_MAX_TARGETS];
+  uint32_t _busTransactions = 0; // transport reads/writes/ready probes
 
-  // Low level communication functions that handle both SPI and I2C.
+  // Low level communication functions, routed through the transport.
   void readdata(uint8_t *buff, uint8_t n);
   void writecommand(uint8_t *cmd, uint8_t cmdlen);
   bool isready();
   bool waitready(uint16_t timeout);
   bool readack();
+  bool writeCommandCheckAck(uint8_t *cmd, uint8_t cmdlen, uint16_t timeout);
+  bool ntag424_SelectApplication();
 
-  Adafruit_SPIDevice *spi_dev = NULL;
-  Adafruit_I2CDevice *i2c_dev = NULL;
-  HardwareSerial *ser_dev = NULL;
+  Adafruit_PN532_Transport *transport = NULL;
+  Adafruit_PN532_SessionCrypto ntag424_SessionCrypto; // current EV2 session
+#if NTAG424_TRACE_RING_SIZE > 0
+  Adafruit_PN532_TraceRing ntag424_TraceRing; // last APDUs, see Trace.h
+#endif
+  void ntag424_TraceApdu(const uint8_t *apdu, uint32_t started_us,
+                         bool responded);
 };
 
 #endif
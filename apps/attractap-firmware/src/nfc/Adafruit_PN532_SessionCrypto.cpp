@@ -0,0 +1,145 @@
+/**************************************************************************/
+/*!
+    @file Adafruit_PN532_SessionCrypto.cpp
+
+    Session cipher contexts for the NTAG424 functions of Adafruit_PN532.
+*/
+/**************************************************************************/
+
+#include "Adafruit_PN532_SessionCrypto.h"
+
+#include "mbedtls/platform_util.h"
+
+Adafruit_PN532_SessionCrypto::Adafruit_PN532_SessionCrypto() {}
+
+Adafruit_PN532_SessionCrypto::~Adafruit_PN532_SessionCrypto() { end(); }
+
+/**************************************************************************/
+/*!
+    @brief  Expand the key schedules of a new session, replacing the
+            previous one.
+
+    @param  key_enc   16 byte session encryption key
+    @param  key_mac   16 byte session mac key
+
+    @returns  true if all contexts are ready, otherwise false
+*/
+/**************************************************************************/
+bool Adafruit_PN532_SessionCrypto::begin(const uint8_t *key_enc,
+                                         const uint8_t *key_mac)
+{
+  end();
+
+  mbedtls_aes_init(&_enc);
+  mbedtls_aes_init(&_dec);
+  mbedtls_cipher_init(&_mac);
+
+  const mbedtls_cipher_info_t *cipher_info =
+      mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB);
+
+  if (mbedtls_aes_setkey_enc(&_enc, key_enc, 128) != 0 ||
+      mbedtls_aes_setkey_dec(&_dec, key_enc, 128) != 0 ||
+      mbedtls_cipher_setup(&_mac, cipher_info) != 0 ||
+      mbedtls_cipher_setkey(&_mac, key_mac, 128, MBEDTLS_ENCRYPT) != 0)
+  {
+    mbedtls_aes_free(&_enc);
+    mbedtls_aes_free(&_dec);
+    mbedtls_cipher_free(&_mac);
+    return false;
+  }
+
+  _ready = true;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Release the contexts and wipe the expanded keys.
+*/
+/**************************************************************************/
+void Adafruit_PN532_SessionCrypto::end(void)
+{
+  if (!_ready)
+  {
+    return;
+  }
+
+  mbedtls_aes_free(&_enc);
+  mbedtls_aes_free(&_dec);
+  mbedtls_cipher_free(&_mac);
+  mbedtls_platform_zeroize(&_macState, sizeof(_macState));
+  _ready = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  AES-128 CBC encrypt with the session encryption key.
+
+    @param  iv      initialization vector, updated in place
+    @param  length  sizeof input, a multiple of 16
+    @param  input   inputbuffer
+    @param  output  outputbuffer
+
+    @returns  true if successful, otherwise false
+*/
+/**************************************************************************/
+bool Adafruit_PN532_SessionCrypto::encrypt(uint8_t *iv, uint8_t length,
+                                           const uint8_t *input,
+                                           uint8_t *output)
+{
+  if (!_ready)
+  {
+    return false;
+  }
+  return mbedtls_aes_crypt_cbc(&_enc, MBEDTLS_AES_ENCRYPT, length, iv, input,
+                               output) == 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  AES-128 CBC decrypt with the session encryption key.
+
+    @param  iv      initialization vector, updated in place
+    @param  length  sizeof input, a multiple of 16
+    @param  input   inputbuffer
+    @param  output  outputbuffer
+
+    @returns  true if successful, otherwise false
+*/
+/**************************************************************************/
+bool Adafruit_PN532_SessionCrypto::decrypt(uint8_t *iv, uint8_t length,
+                                           const uint8_t *input,
+                                           uint8_t *output)
+{
+  if (!_ready)
+  {
+    return false;
+  }
+  return mbedtls_aes_crypt_cbc(&_dec, MBEDTLS_AES_DECRYPT, length, iv, input,
+                               output) == 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  AES-128 CMAC with the session mac key.
+
+    @param  input   inputbuffer
+    @param  length  length of inputbuffer
+    @param  cmac    outputbuffer (>=16 bytes)
+
+    @returns  true if successful, otherwise false
+*/
+/**************************************************************************/
+bool Adafruit_PN532_SessionCrypto::cmac(const uint8_t *input, uint8_t length,
+                                        uint8_t *cmac)
+{
+  if (!_ready)
+  {
+    return false;
+  }
+
+  // the key stays set up, only the chaining state starts over. It is our
+  // own, so a one-shot ntag424_cmac() in between cannot clobber it
+  return mbedtls_cipher_cmac_with_state(&_mac, &_macState, input, length,
+                                        cmac) == 0;
+}
@@ -0,0 +1,56 @@
+/**************************************************************************/
+/*!
+    @file Adafruit_PN532_SessionCrypto.h
+
+    Cipher contexts of an NTAG424 EV2 session. The AES key schedules and
+    the CMAC cipher are set up once when the session keys are derived and
+    reused for every APDU of the session.
+*/
+/**************************************************************************/
+
+#ifndef ADAFRUIT_PN532_SESSIONCRYPTO_H
+#define ADAFRUIT_PN532_SESSIONCRYPTO_H
+
+#include "Arduino.h"
+
+#include "mbedtls/aes.h"
+#include "mbedtlscmac.h"
+
+/**
+ * @brief AES-128 CBC and CMAC with fixed session keys.
+ *
+ * mbedtls_aes maps to the AES accelerator on ESP32 targets, so both the
+ * CBC operations and the CMAC blocks run in hardware there.
+ */
+class Adafruit_PN532_SessionCrypto
+{
+public:
+  Adafruit_PN532_SessionCrypto();
+  ~Adafruit_PN532_SessionCrypto();
+
+  bool begin(const uint8_t *key_enc, const uint8_t *key_mac);
+  void end(void);
+
+  /*!
+      @brief  Return true if begin() set up the contexts for a session.
+  */
+  bool isReady(void) const { return _ready; }
+
+  bool encrypt(uint8_t *iv, uint8_t length, const uint8_t *input,
+               uint8_t *output);
+  bool decrypt(uint8_t *iv, uint8_t length, const uint8_t *input,
+               uint8_t *output);
+  bool cmac(const uint8_t *input, uint8_t length, uint8_t *cmac);
+
+private:
+  Adafruit_PN532_SessionCrypto(const Adafruit_PN532_SessionCrypto &);
+  Adafruit_PN532_SessionCrypto &operator=(const Adafruit_PN532_SessionCrypto &);
+
+  bool _ready = false;
+  mbedtls_aes_context _enc; // session_key_enc, encryption schedule
+  mbedtls_aes_context _dec; // session_key_enc, decryption schedule
+  mbedtls_cipher_context_t _mac; // session_key_mac, AES-128-ECB for CMAC
+  mbedtls_cmac_context_t _macState; // CMAC chaining state of _mac
+};
+
+#endif
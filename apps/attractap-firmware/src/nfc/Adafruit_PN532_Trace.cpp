@@ -0,0 +1,70 @@
+/**************************************************************************/
+/*!
+    @file Adafruit_PN532_Trace.cpp
+
+    APDU trace ring for the NTAG424 functions of Adafruit_PN532.
+*/
+/**************************************************************************/
+
+#include "Adafruit_PN532_Trace.h"
+
+#if NTAG424_TRACE_RING_SIZE > 0
+
+Adafruit_PN532_TraceRing::Adafruit_PN532_TraceRing()
+    : _mutex(portMUX_INITIALIZER_UNLOCKED)
+{
+  memset(_entries, 0, sizeof(_entries));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Keep an APDU, replacing the oldest one once the ring is full.
+
+    @param  entry     the APDU to keep
+*/
+/**************************************************************************/
+void Adafruit_PN532_TraceRing::record(const Adafruit_PN532_TraceEntry &entry)
+{
+  taskENTER_CRITICAL(&_mutex);
+  _entries[_recorded % NTAG424_TRACE_RING_SIZE] = entry;
+  _recorded++;
+  taskEXIT_CRITICAL(&_mutex);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Copy the kept APDUs, oldest first.
+
+    @param  entries   output buffer
+    @param  max       capacity of entries
+    @param  recorded  optional, set to the number of APDUs recorded since
+                      boot (including the ones the ring dropped)
+
+    @returns  number of entries copied
+*/
+/**************************************************************************/
+uint16_t Adafruit_PN532_TraceRing::snapshot(Adafruit_PN532_TraceEntry *entries,
+                                            uint16_t max,
+                                            uint32_t *recorded) const
+{
+  taskENTER_CRITICAL(&_mutex);
+  uint32_t total = _recorded;
+  uint16_t kept = total < NTAG424_TRACE_RING_SIZE ? total
+                                                  : NTAG424_TRACE_RING_SIZE;
+  uint16_t count = kept < max ? kept : max;
+  // the newest count entries
+  uint32_t first = total - count;
+  for (uint16_t i = 0; i < count; i++)
+  {
+    entries[i] = _entries[(first + i) % NTAG424_TRACE_RING_SIZE];
+  }
+  taskEXIT_CRITICAL(&_mutex);
+
+  if (recorded != NULL)
+  {
+    *recorded = total;
+  }
+  return count;
+}
+
+#endif
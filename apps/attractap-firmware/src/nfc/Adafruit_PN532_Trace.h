@@ -0,0 +1,113 @@
+/**************************************************************************/
+/*!
+    @file Adafruit_PN532_Trace.h
+
+    Compile time trace facility for the NTAG424 functions of Adafruit_PN532,
+    plus a small in-RAM ring of the last APDUs (headers, status words and
+    timings, never payloads) that can be read back at runtime.
+
+    NTAG424_TRACE_LEVEL selects what is printed over Serial:
+      NTAG424_TRACE_OFF     nothing (default)
+      NTAG424_TRACE_FRAMES  APDU headers and status words
+      NTAG424_TRACE_DATA    full frames; these contain key material during
+                            authentication (default if NTAG424DEBUG is set)
+*/
+/**************************************************************************/
+
+#ifndef ADAFRUIT_PN532_TRACE_H
+#define ADAFRUIT_PN532_TRACE_H
+
+#include "Arduino.h"
+
+#define NTAG424_TRACE_OFF (0)    ///< No trace output
+#define NTAG424_TRACE_FRAMES (1) ///< APDU headers and status words
+#define NTAG424_TRACE_DATA (2)   ///< Full frames and buffers
+
+#ifndef NTAG424_TRACE_LEVEL
+#ifdef NTAG424DEBUG
+#define NTAG424_TRACE_LEVEL NTAG424_TRACE_DATA ///< Selected trace level
+#else
+#define NTAG424_TRACE_LEVEL NTAG424_TRACE_OFF ///< Selected trace level
+#endif
+#endif
+
+#ifndef NTAG424_TRACE_RING_SIZE
+#define NTAG424_TRACE_RING_SIZE (32) ///< APDUs kept in the ring, 0 disables
+#endif
+
+/*!
+    The trace macros test this constant in a plain if: statements above the
+    selected level are still type checked but dropped as dead code, so
+    neither their arguments nor the Serial calls cost anything at runtime.
+*/
+static constexpr uint8_t ntag424_trace_level = NTAG424_TRACE_LEVEL;
+
+/*!
+    @brief  Print a label followed by a value, the value arguments are
+            passed to println (e.g. value, HEX). For use in
+            Adafruit_PN532_NTAG424.cpp (PN532DEBUGPRINT).
+*/
+#define NTAG424_TRACE(level, label, ...)                                       \
+  do                                                                           \
+  {                                                                            \
+    if (ntag424_trace_level >= (level))                                        \
+    {                                                                          \
+      PN532DEBUGPRINT.print(F(label));                                         \
+      PN532DEBUGPRINT.println(__VA_ARGS__);                                    \
+    }                                                                          \
+  } while (0)
+
+/*!
+    @brief  Print a label followed by a hex/char dump of a buffer.
+*/
+#define NTAG424_TRACE_HEX(level, label, data, length)                          \
+  do                                                                           \
+  {                                                                            \
+    if (ntag424_trace_level >= (level))                                        \
+    {                                                                          \
+      PN532DEBUGPRINT.print(F(label));                                         \
+      Adafruit_PN532::PrintHexChar(data, length);                              \
+    }                                                                          \
+  } while (0)
+
+/**
+ * @brief One APDU exchanged with an NTAG424, as kept in the trace ring.
+ */
+struct Adafruit_PN532_TraceEntry
+{
+  uint32_t started_ms;     ///< millis() when the APDU was sent
+  uint32_t duration_us;    ///< send until the response was read
+  uint16_t cmd_counter;    ///< EV2 command counter of the APDU
+  uint8_t cla;             ///< CLA
+  uint8_t ins;             ///< INS
+  uint8_t p1;              ///< P1
+  uint8_t p2;              ///< P2
+  uint8_t lc;              ///< length of the command data
+  uint8_t status;          ///< PN532 InDataExchange status, 0xFF if no ACK
+  uint8_t sw1;             ///< SW1 of the response
+  uint8_t sw2;             ///< SW2 of the response
+  uint8_t response_length; ///< response data length including SW1/SW2
+};
+
+#if NTAG424_TRACE_RING_SIZE > 0
+/**
+ * @brief Ring of the last NTAG424_TRACE_RING_SIZE APDUs. Recording from the
+ *        NFC task while another task takes a snapshot is safe.
+ */
+class Adafruit_PN532_TraceRing
+{
+public:
+  Adafruit_PN532_TraceRing();
+
+  void record(const Adafruit_PN532_TraceEntry &entry);
+  uint16_t snapshot(Adafruit_PN532_TraceEntry *entries, uint16_t max,
+                    uint32_t *recorded = NULL) const;
+
+private:
+  mutable portMUX_TYPE _mutex;
+  Adafruit_PN532_TraceEntry _entries[NTAG424_TRACE_RING_SIZE];
+  uint32_t _recorded = 0;
+};
+#endif
+
+#endif
@@ -0,0 +1,194 @@
+/**************************************************************************/
+/*!
+    @file Adafruit_PN532_Transport.cpp
+
+    I2C, SPI and HSU transports for Adafruit_PN532. The bus handling was
+    lifted out of the driver's readdata/writecommand/isready; I2C reads
+    go through TwoWire directly to avoid an extra copy of every frame.
+*/
+/**************************************************************************/
+
+#include "Adafruit_PN532_Transport.h"
+
+/************************************************************ I2C transport */
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates an I2C transport.
+
+    @param  theWire   pointer to I2C bus to use
+*/
+/**************************************************************************/
+Adafruit_PN532_I2CTransport::Adafruit_PN532_I2CTransport(TwoWire *theWire)
+    : _wire(theWire)
+{
+  i2c_dev = new Adafruit_I2CDevice(PN532_I2C_ADDRESS, theWire);
+}
+
+Adafruit_PN532_I2CTransport::~Adafruit_PN532_I2CTransport()
+{
+  delete i2c_dev;
+}
+
+bool Adafruit_PN532_I2CTransport::begin(void)
+{
+  // PN532 will fail address check since its asleep, so suppress
+  return i2c_dev->begin(false);
+}
+
+void Adafruit_PN532_I2CTransport::writeFrame(const uint8_t *frame,
+                                             uint8_t len)
+{
+  i2c_dev->write(frame, len);
+}
+
+void Adafruit_PN532_I2CTransport::read(uint8_t *buff, uint8_t n)
+{
+  // A single transaction of RDY byte + n frame bytes, the frame goes from
+  // the Wire receive buffer straight into buff. Reading in parts is not an
+  // option: the PN532 only repeats a frame after a NACK, so probing LEN
+  // first would cost another write and read.
+  size_t length = (size_t)n + 1;
+  if (_wire->requestFrom((uint8_t)PN532_I2C_ADDRESS, length, true) != length)
+  {
+    while (_wire->available())
+      _wire->read();
+    memset(buff, 0, n);
+    return;
+  }
+  _wire->read(); // RDY
+  _wire->readBytes(buff, n);
+}
+
+bool Adafruit_PN532_I2CTransport::isReady(void)
+{
+  // I2C ready check via reading RDY byte
+  if (_wire->requestFrom((uint8_t)PN532_I2C_ADDRESS, (size_t)1, true) != 1)
+    return false;
+  return _wire->read() == PN532_I2C_READY;
+}
+
+/************************************************************ SPI transport */
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a software SPI transport.
+
+    @param  clk       SPI clock pin (SCK)
+    @param  miso      SPI MISO pin
+    @param  mosi      SPI MOSI pin
+    @param  ss        SPI chip select pin (CS/SSEL)
+*/
+/**************************************************************************/
+Adafruit_PN532_SPITransport::Adafruit_PN532_SPITransport(uint8_t clk,
+                                                         uint8_t miso,
+                                                         uint8_t mosi,
+                                                         uint8_t ss)
+    : _cs(ss)
+{
+  spi_dev = new Adafruit_SPIDevice(ss, clk, miso, mosi, 100000,
+                                   SPI_BITORDER_LSBFIRST, SPI_MODE0);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a hardware SPI transport.
+
+    @param  ss        SPI chip select pin (CS/SSEL)
+    @param  theSPI    pointer to the SPI bus to use
+*/
+/**************************************************************************/
+Adafruit_PN532_SPITransport::Adafruit_PN532_SPITransport(uint8_t ss,
+                                                         SPIClass *theSPI)
+    : _cs(ss)
+{
+  spi_dev = new Adafruit_SPIDevice(ss, 1000000, SPI_BITORDER_LSBFIRST,
+                                   SPI_MODE0, theSPI);
+}
+
+Adafruit_PN532_SPITransport::~Adafruit_PN532_SPITransport()
+{
+  delete spi_dev;
+}
+
+bool Adafruit_PN532_SPITransport::begin(void)
+{
+  return spi_dev->begin();
+}
+
+void Adafruit_PN532_SPITransport::wakeup(void)
+{
+  // hold CS low for 2ms
+  digitalWrite(_cs, LOW);
+  delay(2);
+}
+
+void Adafruit_PN532_SPITransport::writeFrame(const uint8_t *frame,
+                                             uint8_t len)
+{
+  uint8_t cmd = PN532_SPI_DATAWRITE;
+  spi_dev->write(frame, len, &cmd, 1);
+}
+
+void Adafruit_PN532_SPITransport::read(uint8_t *buff, uint8_t n)
+{
+  uint8_t cmd = PN532_SPI_DATAREAD;
+  spi_dev->write_then_read(&cmd, 1, buff, n);
+}
+
+bool Adafruit_PN532_SPITransport::isReady(void)
+{
+  // SPI ready check via Status Request
+  uint8_t cmd = PN532_SPI_STATREAD;
+  uint8_t reply;
+  spi_dev->write_then_read(&cmd, 1, &reply, 1);
+  return reply == PN532_SPI_READY;
+}
+
+/*********************************************************** UART transport */
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a hardware UART (HSU) transport.
+
+    @param  theSer    pointer to HardWare Serial bus to use
+*/
+/**************************************************************************/
+Adafruit_PN532_UARTTransport::Adafruit_PN532_UARTTransport(
+    HardwareSerial *theSer)
+    : ser_dev(theSer)
+{
+}
+
+bool Adafruit_PN532_UARTTransport::begin(void)
+{
+  ser_dev->begin(115200);
+  // clear out anything in read buffer
+  while (ser_dev->available())
+    ser_dev->read();
+  return true;
+}
+
+void Adafruit_PN532_UARTTransport::wakeup(void)
+{
+  uint8_t w[3] = {0x55, 0x00, 0x00};
+  ser_dev->write(w, 3);
+  delay(2);
+}
+
+void Adafruit_PN532_UARTTransport::writeFrame(const uint8_t *frame,
+                                              uint8_t len)
+{
+  ser_dev->write(frame, len);
+}
+
+void Adafruit_PN532_UARTTransport::read(uint8_t *buff, uint8_t n)
+{
+  ser_dev->readBytes(buff, n);
+}
+
+bool Adafruit_PN532_UARTTransport::isReady(void)
+{
+  // Serial ready check based on non-zero read buffer
+  return (ser_dev->available() != 0);
+}
@@ -0,0 +1,137 @@
+/**************************************************************************/
+/*!
+    @file Adafruit_PN532_Transport.h
+
+    Bus transports used by Adafruit_PN532. The driver builds and parses
+    PN532 frames; a transport only moves raw frame bytes over I2C, SPI or
+    HSU and answers the bus specific ready check.
+*/
+/**************************************************************************/
+
+#ifndef ADAFRUIT_PN532_TRANSPORT_H
+#define ADAFRUIT_PN532_TRANSPORT_H
+
+#include "Arduino.h"
+
+#include <Adafruit_I2CDevice.h>
+#include <Adafruit_SPIDevice.h>
+
+#define PN532_SPI_STATREAD (0x02)  ///< Stat Read
+#define PN532_SPI_DATAWRITE (0x01) ///< Data write
+#define PN532_SPI_DATAREAD (0x03)  ///< Data read
+#define PN532_SPI_READY (0x01)     ///< Ready
+
+#define PN532_I2C_ADDRESS (0x48 >> 1) ///< Default I2C address
+#define PN532_I2C_READBIT (0x01)      ///< Read bit
+#define PN532_I2C_BUSY (0x00)         ///< Busy
+#define PN532_I2C_READY (0x01)        ///< Ready
+#define PN532_I2C_READYTIMEOUT (20)   ///< Ready timeout
+
+/**
+ * @brief Byte level link between the host and a PN532.
+ */
+class Adafruit_PN532_Transport
+{
+public:
+  virtual ~Adafruit_PN532_Transport() {}
+
+  /*!
+      @brief  Initialise the underlying bus.
+      @returns  true if successful, otherwise false
+  */
+  virtual bool begin(void) = 0;
+
+  /*!
+      @brief  Perform the bus specific part of the LowVbat wakeup. The
+              driver sends SAMConfiguration afterwards.
+  */
+  virtual void wakeup(void) {}
+
+  /*!
+      @brief  Send a complete PN532 frame (preamble through postamble).
+      @param  frame     Pointer to the frame bytes
+      @param  len       Frame length in bytes
+  */
+  virtual void writeFrame(const uint8_t *frame, uint8_t len) = 0;
+
+  /*!
+      @brief  Read n bytes of the pending PN532 response, without any bus
+              specific status prefix.
+      @param  buff      Pointer to the buffer where data will be written
+      @param  n         Number of bytes to be read
+  */
+  virtual void read(uint8_t *buff, uint8_t n) = 0;
+
+  /*!
+      @brief  Return true if the PN532 has a response ready.
+  */
+  virtual bool isReady(void) = 0;
+
+  /*!
+      @brief  Pause in us between writing a command and polling for the
+              ACK / response. Only needed on buses that poll a RDY byte.
+  */
+  virtual uint16_t settleDelayUs(void) const { return 0; }
+};
+
+/**
+ * @brief PN532 transport over I2C, polling the leading RDY byte.
+ */
+class Adafruit_PN532_I2CTransport : public Adafruit_PN532_Transport
+{
+public:
+  Adafruit_PN532_I2CTransport(TwoWire *theWire = &Wire);
+  ~Adafruit_PN532_I2CTransport();
+
+  bool begin(void) override;
+  void writeFrame(const uint8_t *frame, uint8_t len) override;
+  void read(uint8_t *buff, uint8_t n) override;
+  bool isReady(void) override;
+  uint16_t settleDelayUs(void) const override { return 500; }
+
+private:
+  Adafruit_I2CDevice *i2c_dev;
+  TwoWire *_wire;
+};
+
+/**
+ * @brief PN532 transport over hardware or bit-banged SPI (LSB first).
+ */
+class Adafruit_PN532_SPITransport : public Adafruit_PN532_Transport
+{
+public:
+  Adafruit_PN532_SPITransport(uint8_t clk, uint8_t miso, uint8_t mosi,
+                              uint8_t ss);                     // Software SPI
+  Adafruit_PN532_SPITransport(uint8_t ss, SPIClass *theSPI = &SPI); // HW SPI
+  ~Adafruit_PN532_SPITransport();
+
+  bool begin(void) override;
+  void wakeup(void) override;
+  void writeFrame(const uint8_t *frame, uint8_t len) override;
+  void read(uint8_t *buff, uint8_t n) override;
+  bool isReady(void) override;
+
+private:
+  int8_t _cs;
+  Adafruit_SPIDevice *spi_dev;
+};
+
+/**
+ * @brief PN532 transport over a hardware UART (HSU).
+ */
+class Adafruit_PN532_UARTTransport : public Adafruit_PN532_Transport
+{
+public:
+  Adafruit_PN532_UARTTransport(HardwareSerial *theSer);
+
+  bool begin(void) override;
+  void wakeup(void) override;
+  void writeFrame(const uint8_t *frame, uint8_t len) override;
+  void read(uint8_t *buff, uint8_t n) override;
+  bool isReady(void) override;
+
+private:
+  HardwareSerial *ser_dev;
+};
+
+#endif
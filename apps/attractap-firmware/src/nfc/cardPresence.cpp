@@ -0,0 +1,98 @@
+#include "cardPresence.hpp"
+
+CardPresence::CardPresence(uint32_t holdOffMs, uint32_t rearmMs) : holdOffMs(holdOffMs), rearmMs(rearmMs)
+{
+    this->reset();
+}
+
+bool CardPresence::onCardSeen(const uint8_t *uid, uint8_t uidLength, uint32_t nowMs)
+{
+    if (!this->isPresent(uid, uidLength, nowMs))
+    {
+        // New presentation, possibly replacing another card
+        this->uidLength = uidLength < MAX_UID_LENGTH ? uidLength : MAX_UID_LENGTH;
+        memcpy(this->uid, uid, this->uidLength);
+        this->active = true;
+        this->tapped = false;
+    }
+    this->lastSeenAt = nowMs;
+    this->gone = false;
+
+    if (this->tapped)
+    {
+        return false;
+    }
+
+    // A presentation inside the hold-off is reported once it has passed,
+    // provided the card is still there
+    if (this->hasTapped && nowMs - this->lastTapAt < this->holdOffMs)
+    {
+        return false;
+    }
+
+    this->tapped = true;
+    this->hasTapped = true;
+    this->lastTapAt = nowMs;
+    return true;
+}
+
+void CardPresence::onCardGone()
+{
+    if (this->active)
+    {
+        this->gone = true;
+    }
+}
+
+void CardPresence::suspend(uint32_t nowMs)
+{
+    if (!this->suspended)
+    {
+        this->suspended = true;
+        this->suspendedAt = nowMs;
+    }
+}
+
+void CardPresence::resume(uint32_t nowMs)
+{
+    if (this->suspended)
+    {
+        // Move the last sighting forward by the time nobody polled
+        this->lastSeenAt += nowMs - this->suspendedAt;
+        this->suspended = false;
+    }
+}
+
+bool CardPresence::isPresent(const uint8_t *uid, uint8_t uidLength, uint32_t nowMs) const
+{
+    return this->getState(nowMs) != ABSENT && this->isSameCard(uid, uidLength);
+}
+
+CardPresence::State CardPresence::getState(uint32_t nowMs) const
+{
+    if (!this->active || this->unseenFor(nowMs) >= this->rearmMs)
+    {
+        return ABSENT;
+    }
+    return this->gone ? REMOVED : PRESENT;
+}
+
+void CardPresence::reset()
+{
+    this->active = false;
+    this->tapped = false;
+    this->gone = false;
+    this->uidLength = 0;
+    memset(this->uid, 0, sizeof(this->uid));
+    this->lastSeenAt = 0;
+}
+
+bool CardPresence::isSameCard(const uint8_t *uid, uint8_t uidLength) const
+{
+    return uidLength == this->uidLength && memcmp(uid, this->uid, uidLength) == 0;
+}
+
+uint32_t CardPresence::unseenFor(uint32_t nowMs) const
+{
+    return (this->suspended ? this->suspendedAt : nowMs) - this->lastSeenAt;
+}
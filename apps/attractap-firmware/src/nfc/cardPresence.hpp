@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Tracks whether the card that produced the last tap is still on the reader,
+// so a card left in the field yields one tap per presentation instead of one
+// per poll. An armed InListPassiveTarget never answers while the field is
+// empty, so a presentation ends once its card has not been seen for rearmMs
+// of polling. Time in which nobody polls (detection disabled) does not count.
+//
+//   ABSENT --seen--> PRESENT(uid) --poll without it--> REMOVED
+//                         ^                               |  |
+//                         '----- same uid within rearmMs -'  '-- rearmMs --> ABSENT
+class CardPresence
+{
+public:
+    static const uint8_t MAX_UID_LENGTH = 10;
+
+    enum State
+    {
+        ABSENT,
+        PRESENT,
+        REMOVED,
+    };
+
+    // holdOffMs: minimum time between two taps, whichever cards they are
+    // rearmMs: how long a card must stay unseen before it counts as removed
+    CardPresence(uint32_t holdOffMs, uint32_t rearmMs);
+
+    // A poll found the card; returns true if this presentation should be
+    // reported as a tap (exactly once per presentation)
+    bool onCardSeen(const uint8_t *uid, uint8_t uidLength, uint32_t nowMs);
+
+    // A poll answered without the card (no NTAG424 among the targets)
+    void onCardGone();
+
+    // Card detection stopped / started again. While suspended the current
+    // presentation keeps its age, a card that stays on the reader is not
+    // reported again once detection resumes. Both may be called repeatedly.
+    void suspend(uint32_t nowMs);
+    void resume(uint32_t nowMs);
+
+    // True if the card is the one of the current presentation and it has not
+    // been gone for rearmMs; no need to identify it again
+    bool isPresent(const uint8_t *uid, uint8_t uidLength, uint32_t nowMs) const;
+
+    State getState(uint32_t nowMs) const;
+    void reset();
+
+private:
+    bool isSameCard(const uint8_t *uid, uint8_t uidLength) const;
+    uint32_t unseenFor(uint32_t nowMs) const;
+
+    uint32_t holdOffMs;
+    uint32_t rearmMs;
+
+    bool active = false;
+    bool tapped = false;
+    bool gone = false;
+    uint8_t uid[MAX_UID_LENGTH];
+    uint8_t uidLength = 0;
+    uint32_t lastSeenAt = 0;
+
+    bool suspended = false;
+    uint32_t suspendedAt = 0;
+
+    bool hasTapped = false;
+    uint32_t lastTapAt = 0;
+};
@@ -251,25 +251,35 @@ int mbedtls_cipher_cmac_starts( mbedtls_cipher_context_t *ctx,
             return( MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA );
     }
 
-    /* Allocated and initialise in the cipher context memory for the CMAC
-     * context */
-    cmac_ctx = mbedtls_calloc( 1, sizeof( mbedtls_cmac_context_t ) );
+    /* The CMAC state lives outside the cipher context here and only holds
+     * transient data, so it is allocated once and reused by every start
+     * instead of leaking a new one each time */
     if( cmac_ctx == NULL )
-        return( MBEDTLS_ERR_CIPHER_ALLOC_FAILED );
+    {
+        cmac_ctx = mbedtls_calloc( 1, sizeof( mbedtls_cmac_context_t ) );
+        if( cmac_ctx == NULL )
+            return( MBEDTLS_ERR_CIPHER_ALLOC_FAILED );
+    }
 
-    mbedtls_platform_zeroize( cmac_ctx->state, sizeof( cmac_ctx->state ) );
+    mbedtls_platform_zeroize( cmac_ctx, sizeof( mbedtls_cmac_context_t ) );
 
     return 0;
 }
 
-int mbedtls_cipher_cmac_update( mbedtls_cipher_context_t *ctx,
-                                const unsigned char *input, size_t ilen )
+/*
+ * The chaining state is passed in explicitly so cipher contexts that keep
+ * their own (see mbedtls_cipher_cmac_with_state) do not share the global one
+ */
+static int cmac_update( mbedtls_cipher_context_t *ctx,
+                        mbedtls_cmac_context_t *cmac_ctx,
+                        const unsigned char *input, size_t ilen )
 {
     unsigned char *state;
     int ret = 0;
     size_t n, j, olen, block_size;
 
-    if( ctx == NULL || ctx->cipher_info == NULL || input == NULL )
+    if( ctx == NULL || ctx->cipher_info == NULL || cmac_ctx == NULL ||
+        input == NULL )
         return( MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA );
 
     block_size = ctx->cipher_info->block_size;
@@ -327,8 +337,9 @@ exit:
     return( ret );
 }
 
-int mbedtls_cipher_cmac_finish( mbedtls_cipher_context_t *ctx,
-                                unsigned char *output )
+static int cmac_finish( mbedtls_cipher_context_t *ctx,
+                        mbedtls_cmac_context_t *cmac_ctx,
+                        unsigned char *output )
 {
     unsigned char *state, *last_block;
     unsigned char K1[MBEDTLS_CIPHER_BLKSIZE_MAX];
@@ -386,28 +397,67 @@ exit:
     return( ret );
 }
 
-int mbedtls_cipher_cmac_reset( mbedtls_cipher_context_t *ctx )
+static void cmac_reset( mbedtls_cmac_context_t *cmac_ctx )
 {
-
-    if( ctx == NULL || ctx->cipher_info == NULL || cmac_ctx == NULL )
-        return( MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA );
-
     /* Reset the internal state */
     cmac_ctx->unprocessed_len = 0;
     mbedtls_platform_zeroize( cmac_ctx->unprocessed_block,
                               sizeof( cmac_ctx->unprocessed_block ) );
     mbedtls_platform_zeroize( cmac_ctx->state,
                               sizeof( cmac_ctx->state ) );
+}
+
+int mbedtls_cipher_cmac_update( mbedtls_cipher_context_t *ctx,
+                                const unsigned char *input, size_t ilen )
+{
+    return( cmac_update( ctx, cmac_ctx, input, ilen ) );
+}
+
+int mbedtls_cipher_cmac_finish( mbedtls_cipher_context_t *ctx,
+                                unsigned char *output )
+{
+    return( cmac_finish( ctx, cmac_ctx, output ) );
+}
+
+int mbedtls_cipher_cmac_reset( mbedtls_cipher_context_t *ctx )
+{
+
+    if( ctx == NULL || ctx->cipher_info == NULL || cmac_ctx == NULL )
+        return( MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA );
+
+    cmac_reset( cmac_ctx );
 
     return( 0 );
 }
 
+int mbedtls_cipher_cmac_with_state( mbedtls_cipher_context_t *ctx,
+                                    mbedtls_cmac_context_t *state,
+                                    const unsigned char *input, size_t ilen,
+                                    unsigned char *output )
+{
+    int ret;
+
+    if( state == NULL )
+        return( MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA );
+
+    cmac_reset( state );
+
+    if( ( ret = cmac_update( ctx, state, input, ilen ) ) != 0 )
+    {
+        cmac_reset( state );
+        return( ret );
+    }
+
+    return( cmac_finish( ctx, state, output ) );
+}
+
 int mbedtls_cipher_cmac( const mbedtls_cipher_info_t *cipher_info,
                          const unsigned char *key, size_t keylen,
                          const unsigned char *input, size_t ilen,
                          unsigned char *output )
 {
     mbedtls_cipher_context_t ctx;
+    mbedtls_cmac_context_t state;
     int ret;
 
     if( cipher_info == NULL || key == NULL || input == NULL || output == NULL )
@@ -418,15 +468,12 @@ int mbedtls_cipher_cmac( const mbedtls_cipher_info_t *cipher_info,
     if( ( ret = mbedtls_cipher_setup( &ctx, cipher_info ) ) != 0 )
         goto exit;
 
-    ret = mbedtls_cipher_cmac_starts( &ctx, key, keylen );
-    if( ret != 0 )
-        goto exit;
-
-    ret = mbedtls_cipher_cmac_update( &ctx, input, ilen );
+    /* Keyed directly, the chaining state lives on the stack */
+    ret = mbedtls_cipher_setkey( &ctx, key, (int)keylen, MBEDTLS_ENCRYPT );
     if( ret != 0 )
         goto exit;
 
-    ret = mbedtls_cipher_cmac_finish( &ctx, output );
+    ret = mbedtls_cipher_cmac_with_state( &ctx, &state, input, ilen, output );
 
 exit:
     mbedtls_cipher_free( &ctx );
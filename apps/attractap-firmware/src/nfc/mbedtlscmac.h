@@ -173,6 +173,35 @@ int mbedtls_cipher_cmac_finish( mbedtls_cipher_context_t *ctx,
  */
 int mbedtls_cipher_cmac_reset( mbedtls_cipher_context_t *ctx );
 
+/**
+ * \brief               This function calculates the CMAC of one message with
+ *                      a cipher context that already holds the key, keeping
+ *                      the chaining state in \p state instead of the state
+ *                      shared by mbedtls_cipher_cmac_starts(),
+ *                      mbedtls_cipher_cmac_update() and
+ *                      mbedtls_cipher_cmac_finish().
+ *
+ *                      Each context with its own state can be used while
+ *                      another CMAC operation is in progress.
+ *
+ * \param ctx           The cipher context, set up for AES or DES-EDE3 ECB
+ *                      and keyed with mbedtls_cipher_setkey() for
+ *                      #MBEDTLS_ENCRYPT.
+ * \param state         The chaining state owned by the caller. It does not
+ *                      need to be initialized and is wiped on return.
+ * \param input         The buffer holding the input data.
+ * \param ilen          The length of the input data.
+ * \param output        The output buffer for the CMAC checksum result.
+ *
+ * \return              \c 0 on success.
+ * \return              #MBEDTLS_ERR_MD_BAD_INPUT_DATA
+ *                      if parameter verification fails.
+ */
+int mbedtls_cipher_cmac_with_state( mbedtls_cipher_context_t *ctx,
+                                    mbedtls_cmac_context_t *state,
+                                    const unsigned char *input, size_t ilen,
+                                    unsigned char *output );
+
 /**
  * \brief               This function calculates the full generic CMAC
  *                      on the input buffer with the provided key.
@@ -1,27 +1,96 @@
 #include "nfc.hpp"
+#include "mbedtls/platform_util.h"
+
+// Tick based so timestamps taken in the IRQ handler compare with task time
+static inline uint32_t detectionNowMs()
+{
+    return pdTICKS_TO_MS(xTaskGetTickCount());
+}
 
 void NFC::setup()
 {
     // Avoid blocking NFC driver init; it configures internally
     this->pn532.begin();
+    this->stateSubscription = State::subscribe(State::STATE_CHANGE_NETWORK | State::STATE_CHANGE_API_EVENT);
+
+#if PIN_PN532_IRQ >= 0
+    this->irq_driven = true;
+#endif
 
     this->logger.info("Creating NFC task");
-    xTaskCreatePinnedToCore(NFC::task_function, "NFC", 8192, this, TASK_PRIORITY_NFC, NULL, 0);
+    xTaskCreatePinnedToCore(NFC::task_function, "NFC", 8192, this, TASK_PRIORITY_NFC, &this->taskHandle, 0);
+
+#if PIN_PN532_IRQ >= 0
+    attachInterruptArg(PIN_PN532_IRQ, NFC::onPn532Irq, this, FALLING);
+#endif
+}
+
+void IRAM_ATTR NFC::onPn532Irq(void *arg)
+{
+    NFC *nfc = (NFC *)arg;
+    if (nfc->taskHandle == nullptr)
+    {
+        return;
+    }
+
+    nfc->detection_irq_at = pdTICKS_TO_MS(xTaskGetTickCountFromISR());
+
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(nfc->taskHandle, &higherPriorityTaskWoken);
+    if (higherPriorityTaskWoken)
+    {
+        portYIELD_FROM_ISR();
+    }
 }
 
 void NFC::task_function(void *pvParameters)
 {
     NFC *nfc = (NFC *)pvParameters;
 
-    const int LOOP_DELAY_MS = 40; // faster loop to avoid long blocking sections
-
     while (true)
     {
         nfc->loop();
-        vTaskDelay(LOOP_DELAY_MS / portTICK_PERIOD_MS);
+
+        if (nfc->detection_armed && nfc->irq_driven)
+        {
+            // Sleep until the PN532 pulls IRQ low. The timeout only services
+            // the command queue and state changes; it does not touch the bus.
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOOP_DELAY_MS));
+            nfc->pendingStateChanges |= State::waitForChanges(nfc->stateSubscription, 0);
+        }
+        else
+        {
+            nfc->pendingStateChanges |= State::waitForChanges(nfc->stateSubscription, nfc->nextWaitMs());
+        }
     }
 }
 
+uint32_t NFC::nextWaitMs() const
+{
+    if (this->detection_armed && !this->irq_driven)
+    {
+        return this->detection_poll_interval_ms;
+    }
+
+    return LOOP_DELAY_MS;
+}
+
+NFC::DetectionStats NFC::getDetectionStats() const
+{
+    DetectionStats stats;
+    stats.irqDriven = this->irq_driven;
+    stats.busTransactions = this->pn532.getBusTransactionCount();
+    stats.detections = this->detections;
+    stats.presentPolls = this->presentPolls;
+    stats.latency = this->detectionLatency.snapshot();
+    return stats;
+}
+
+uint16_t NFC::getApduTrace(Adafruit_PN532_TraceEntry *entries, uint16_t max, uint32_t &recorded) const
+{
+    return this->pn532.ntag424_TraceSnapshot(entries, max, &recorded);
+}
+
 void NFC::loop()
 {
     if (!this->nfc_is_detected && !this->detectNfcModule())
@@ -39,8 +108,11 @@ void NFC::loop()
 
     if (!this->loop_card_detection_is_enabled)
     {
+        this->cardPresence.suspend(detectionNowMs());
+        this->cancelCardDetection();
         return;
     }
+    this->cardPresence.resume(detectionNowMs());
 
     // log every 1s that we are looking for cards
     static uint32_t lastCardDetectionLogTime = 0;
@@ -50,6 +122,30 @@ void NFC::loop()
         logger.info("loop: Looking for cards");
     }
 
+    if (!this->detection_armed)
+    {
+        if (detectionNowMs() - this->detection_done_at < this->detection_rearm_delay_ms)
+        {
+            return;
+        }
+        this->armCardDetection();
+        return;
+    }
+
+    if (!this->isCardDetectionReady())
+    {
+        return;
+    }
+
+    // Best estimate of when the response became available: the IRQ edge, or
+    // the last ready poll that still came back empty
+    uint32_t readySince = this->detection_last_poll_at;
+    if (this->irq_driven)
+    {
+        readySince = this->detection_irq_at != 0 ? this->detection_irq_at : this->detection_armed_at;
+    }
+    this->detection_armed = false;
+
     char dicoveredUuid[16];       // Buffer for UID
     uint8_t discoveredUuidLength; // Length of UID
 
@@ -57,22 +153,124 @@ void NFC::loop()
     memset(dicoveredUuid, 0, sizeof(dicoveredUuid));
     discoveredUuidLength = 0;
 
-    // Keep PN532 polling responsive to avoid blocking other time-sensitive tasks
-    if (this->discoverNfcCard(dicoveredUuid, &discoveredUuidLength, 1000))
+    uint32_t now = detectionNowMs();
+    this->detection_done_at = now;
+    this->detection_rearm_delay_ms = 0;
+
+    if (!this->readDetectedNfcCard(dicoveredUuid, &discoveredUuidLength))
+    {
+        this->cardPresence.onCardGone();
+        return;
+    }
+
+    if (!this->cardPresence.onCardSeen((const uint8_t *)dicoveredUuid, discoveredUuidLength, now))
+    {
+        // The card was reported already, or a new one waits out the hold-off
+        this->presentPolls++;
+        this->detection_rearm_delay_ms = PRESENT_REPOLL_MS;
+        return;
+    }
+
+    this->detections++;
+    this->detectionLatency.record(detectionNowMs() - readySince);
+
+    String uidHex = "";
+    for (uint8_t i = 0; i < discoveredUuidLength; i++)
     {
-        String uidHex = "";
-        for (uint8_t i = 0; i < discoveredUuidLength; i++)
+        // char is signed on the ESP32 (Xtensa), UID bytes are not
+        uint8_t uidByte = (uint8_t)dicoveredUuid[i];
+        if (uidByte < 0x10)
         {
-            if (dicoveredUuid[i] < 0x10)
-            {
-                uidHex += "0";
-            }
-            uidHex += String(dicoveredUuid[i], HEX);
+            uidHex += "0";
         }
-        logger.infof("loop: Detected card UID=%s", uidHex.c_str());
+        uidHex += String(uidByte, HEX);
+    }
+    logger.infof("loop: Detected card UID=%s", uidHex.c_str());
+
+    State::pushEventToApi(State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_DETECTED, uidHex);
+}
+
+bool NFC::armCardDetection()
+{
+    // Two targets, so a card next to the NTAG424 does not fail the poll
+    if (!this->pn532.startPassiveTargetIDDetection(PN532_MIFARE_ISO14443A, PN532_MAX_TARGETS))
+    {
+        logger.debug("armCardDetection PN532 did not acknowledge InListPassiveTarget");
+        return false;
+    }
+
+    uint32_t now = detectionNowMs();
+    this->detection_armed = true;
+    this->detection_armed_at = now;
+    this->detection_last_poll_at = now;
+    this->detection_poll_interval_ms = DETECTION_POLL_MIN_MS;
+
+    // Drop the notification raised by the ACK itself
+    this->detection_irq_at = 0;
+    if (this->irq_driven)
+    {
+        ulTaskNotifyTake(pdTRUE, 0);
+    }
+
+    return true;
+}
+
+bool NFC::isCardDetectionReady()
+{
+#if PIN_PN532_IRQ >= 0
+    // IRQ is held low while a response is pending; a GPIO read costs no bus time
+    return digitalRead(PIN_PN532_IRQ) == LOW;
+#else
+    uint32_t now = detectionNowMs();
+    if (now - this->detection_last_poll_at < this->detection_poll_interval_ms)
+    {
+        return false;
+    }
+
+    if (this->pn532.isResponseReady())
+    {
+        return true;
+    }
+
+    // Taps usually follow shortly after detection is armed; stretch the
+    // interval the longer nobody shows up
+    this->detection_last_poll_at = now;
+    uint32_t interval = DETECTION_POLL_MIN_MS + (now - this->detection_armed_at) / 100;
+    if (interval > DETECTION_POLL_MAX_MS)
+    {
+        interval = DETECTION_POLL_MAX_MS;
+    }
+    this->detection_poll_interval_ms = interval;
+    return false;
+#endif
+}
 
-        State::pushEventToApi(State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_DETECTED, uidHex);
+void NFC::cancelCardDetection()
+{
+    if (!this->detection_armed)
+    {
+        return;
     }
+    this->detection_armed = false;
+
+    bool responsePending;
+#if PIN_PN532_IRQ >= 0
+    responsePending = digitalRead(PIN_PN532_IRQ) == LOW;
+#else
+    responsePending = this->pn532.isResponseReady();
+#endif
+
+    if (responsePending)
+    {
+        // A card arrived in the meantime; drain the frame so the next
+        // command does not read it as its ACK
+        uint8_t uid[PN532_MAX_UID_LENGTH];
+        uint8_t uidLength;
+        this->pn532.readDetectedPassiveTargetID(uid, &uidLength);
+        return;
+    }
+
+    this->pn532.abortCommand();
 }
 
 void NFC::processNfcCommands()
@@ -83,56 +281,25 @@ void NFC::processNfcCommands()
         return;
     }
 
+    // Commands run their own blocking InListPassiveTarget
+    this->cancelCardDetection();
+
     switch (command.type)
     {
     case State::NfcCommandType::NFC_COMMAND_TYPE_CHANGE_KEY:
     {
-        String payload(command.payload);
-
-        // Parse space-delimited values more efficiently
-        int firstSpace = payload.indexOf(' ');
-        int secondSpace = payload.indexOf(' ', firstSpace + 1);
-        int thirdSpace = payload.indexOf(' ', secondSpace + 1);
-
-        String keyNumberStr = payload.substring(0, firstSpace);
-        String authKeyHex = payload.substring(firstSpace + 1, secondSpace);
-        String oldKeyHex = payload.substring(secondSpace + 1, thirdSpace);
-        String newKeyHex = payload.substring(thirdSpace + 1);
+        ApiNfcChangeKeyCommand &changeKey = command.changeKey;
 
-        uint8_t keyNumber = keyNumberStr.toInt();
-        uint8_t authKey[16];
-        uint8_t oldKey[16];
-        uint8_t newKey[16];
-
-        this->hexStringToBytes(authKeyHex, authKey, 16);
-        this->hexStringToBytes(oldKeyHex, oldKey, 16);
-        this->hexStringToBytes(newKeyHex, newKey, 16);
-
-        bool success = this->changeKey(keyNumber, authKey, oldKey, newKey);
-        if (success)
-        {
-            State::pushEventToApi(State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_CHANGE_KEY_SUCCESS, command.payload);
-        }
-        else
-        {
-            State::pushEventToApi(State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_CHANGE_KEY_FAILED, command.payload);
-        }
+        bool success = this->changeKey(changeKey.keyNumber, changeKey.authKey, changeKey.oldKey, changeKey.newKey);
+        State::pushNfcResultToApi(success ? State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_CHANGE_KEY_SUCCESS
+                                          : State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_CHANGE_KEY_FAILED,
+                                  command.correlationId);
         break;
     }
 
     case State::NfcCommandType::NFC_COMMAND_TYPE_AUTHENTICATE:
     {
-        String payload(command.payload);
-
-        // Parse space-delimited values more efficiently
-        int firstSpace = payload.indexOf(' ');
-        String keyNumberStr = payload.substring(0, firstSpace);
-        String authKeyHex = payload.substring(firstSpace + 1);
-
-        uint8_t keyNumber = keyNumberStr.toInt();
-        uint8_t authKey[16];
-
-        this->hexStringToBytes(authKeyHex, authKey, 16);
+        ApiNfcAuthenticateCommand &authenticate = command.authenticate;
 
         char discoveredUuid[16];
         uint8_t discoveredUuidLength;
@@ -141,63 +308,42 @@ void NFC::processNfcCommands()
         if (!foundCard)
         {
             logger.error("authenticate Failed to find NFC card");
-            State::pushEventToApi(State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_FAILED, command.payload);
+            State::pushNfcResultToApi(State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_FAILED, command.correlationId);
             break;
         }
 
-        bool success = this->authenticate(keyNumber, authKey, true);
-        if (success)
-        {
-            State::pushEventToApi(State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_SUCCESS, command.payload);
-        }
-        else
-        {
-            State::pushEventToApi(State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_FAILED, command.payload);
-        }
-
+        bool success = this->authenticate(authenticate.keyNumber, authenticate.authKey, true);
+        State::pushNfcResultToApi(success ? State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_SUCCESS
+                                          : State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_FAILED,
+                                  command.correlationId);
         break;
     }
     }
+
+    // Keys must not linger on the task stack
+    mbedtls_platform_zeroize(&command, sizeof(command));
 }
 
-void NFC::hexStringToBytes(const String &hexString, uint8_t *byteArray, size_t byteArrayLength)
+void NFC::updateStateFromAppState()
 {
-    // Initialize array with zeros
-    memset(byteArray, 0, byteArrayLength);
-
-    // Process the hex string - 2 characters per byte
-    for (size_t i = 0; i < byteArrayLength && i * 2 + 1 < hexString.length(); i++)
+    uint32_t changes = this->pendingStateChanges;
+    if (changes == 0)
     {
-        String byteHex = hexString.substring(i * 2, i * 2 + 2);
-        byteArray[i] = strtol(byteHex.c_str(), NULL, 16);
+        return;
     }
-}
+    this->pendingStateChanges = 0;
 
-void NFC::updateStateFromAppState()
-{
-    bool stateChanged = false;
-    uint32_t lastAppStateChangeTime = State::getLastStateChangeTime();
-    if (this->lastKnownAppStateChangeTime < lastAppStateChangeTime)
+    if (changes & State::STATE_CHANGE_NETWORK)
     {
-        stateChanged = true;
-        this->lastKnownAppStateChangeTime = lastAppStateChangeTime;
         State::NetworkState networkState = State::getNetworkState();
         this->network_connected = networkState.wifi_connected || networkState.ethernet_connected;
     }
 
-    uint32_t lastApiEventTime = State::getLastApiEventTime();
-    if (this->lastKnownApiEventTime < lastApiEventTime)
+    if (changes & State::STATE_CHANGE_API_EVENT)
     {
-        stateChanged = true;
-        this->lastKnownApiEventTime = lastApiEventTime;
         this->nfc_detection_enabled_from_state = State::getApiEventData().state == State::ApiEventState::API_EVENT_STATE_WAIT_FOR_NFC_TAP;
     }
 
-    if (!stateChanged)
-    {
-        return;
-    }
-
     this->loop_card_detection_is_enabled = this->network_connected && this->nfc_detection_enabled_from_state;
 }
 
@@ -295,22 +441,26 @@ bool NFC::waitForNfcCard(char *detectedUid, uint8_t *detectedUidLength, const ui
 
 bool NFC::authenticate(uint8_t keyNumber, uint8_t *key, bool waitForRemovalAtEnd)
 {
-    // retry 3 times
+    // Retry with a short exponential backoff. The driver keeps the NTAG424
+    // application selected across attempts unless the target dropped out.
     bool success = false;
-    for (int i = 0; i < 3; i++)
+    uint32_t backoffMs = NFC::AUTH_RETRY_BACKOFF_MS;
+    for (uint8_t attempt = 1; attempt <= NFC::AUTH_ATTEMPTS; attempt++)
     {
         if (this->pn532.ntag424_Authenticate(key, keyNumber, NFC::AUTH_CMD))
         {
             success = true;
+            break;
         }
 
-        if (success)
+        if (attempt == NFC::AUTH_ATTEMPTS)
         {
             break;
         }
 
-        logger.debug("authenticate Failed to authenticate with NFC card, retrying in .5sec");
-        delay(500);
+        logger.debugf("authenticate Failed to authenticate with NFC card, retrying in %lums", (unsigned long)backoffMs);
+        vTaskDelay(pdMS_TO_TICKS(backoffMs));
+        backoffMs *= 2;
     }
 
     if (!success)
@@ -367,7 +517,7 @@ bool NFC::changeKey(const uint8_t keyNumber, uint8_t authKey[16], uint8_t *oldKe
 
 void NFC::waitForCardRemoval()
 {
-    uint8_t uid[7];
+    uint8_t uid[PN532_MAX_UID_LENGTH];
     uint8_t uidLength;
 
     logger.info("waitForCardRemoval Please remove the card.");
@@ -377,27 +527,66 @@ void NFC::waitForCardRemoval()
 
         if (!stillPresent)
             break;
-        // Wait indicator removed for logger
+
+        // Reading a present card is fast; don't hammer the bus with it
+        vTaskDelay(pdMS_TO_TICKS(REMOVAL_PROBE_INTERVAL_MS));
     }
 
+    // The last probe is still searching for a target on the chip
+    this->pn532.abortCommand();
+
     logger.info("Card removed.");
 }
 
 bool NFC::discoverNfcCard(char *dicoveredUuid, uint8_t *discoveredUuidLength, const uint32_t timeoutMs)
 {
-    uint8_t uid[7];
+    uint8_t uid[PN532_MAX_UID_LENGTH];
     uint8_t uidLength;
 
-    bool gotTarget = this->pn532.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLength, timeoutMs);
+    bool gotTarget = this->pn532.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLength, timeoutMs, PN532_MAX_TARGETS);
 
     if (!gotTarget)
     {
         return false;
     }
 
-    bool is424 = this->pn532.ntag424_isNTAG424();
+    if (!this->selectNtag424Target(uid, &uidLength))
+    {
+        return false;
+    }
+
+    this->uintArrayToCharArray(uid, uidLength, dicoveredUuid);
+    *discoveredUuidLength = uidLength;
+
+    return true;
+}
+
+bool NFC::readDetectedNfcCard(char *dicoveredUuid, uint8_t *discoveredUuidLength)
+{
+    uint8_t uid[PN532_MAX_UID_LENGTH];
+    uint8_t uidLength;
+
+    if (!this->pn532.readDetectedPassiveTargetID(uid, &uidLength))
+    {
+        return false;
+    }
+
+    // The card of the current presentation was identified before, skip GetVersion
+    bool present = false;
+    uint32_t now = detectionNowMs();
+    for (uint8_t i = 0; i < this->pn532.getTargetCount() && !present; i++)
+    {
+        const Adafruit_PN532_Target &target = this->pn532.getTarget(i);
+        if (this->cardPresence.isPresent(target.uid, target.uidLength, now) && target.uidLength <= sizeof(uid))
+        {
+            this->pn532.selectTarget(i);
+            memcpy(uid, target.uid, target.uidLength);
+            uidLength = target.uidLength;
+            present = true;
+        }
+    }
 
-    if (!is424)
+    if (!present && !this->selectNtag424Target(uid, &uidLength))
     {
         return false;
     }
@@ -408,6 +597,48 @@ bool NFC::discoverNfcCard(char *dicoveredUuid, uint8_t *discoveredUuidLength, co
     return true;
 }
 
+bool NFC::selectNtag424Target(uint8_t *uid, uint8_t *uidLength)
+{
+    uint8_t count = this->pn532.getTargetCount();
+    int8_t selected = -1;
+    for (uint8_t i = 0; i < count && selected < 0; i++)
+    {
+        // GetVersion needs ISO14443-4, skip anything else without an exchange
+        const Adafruit_PN532_Target &target = this->pn532.getTarget(i);
+        if ((target.sel_res & PN532_SEL_RES_ISO14443_4) && this->pn532.selectTarget(i) && this->pn532.ntag424_isNTAG424())
+        {
+            selected = i;
+        }
+    }
+
+    if (selected < 0)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (i == selected)
+        {
+            continue;
+        }
+
+        const Adafruit_PN532_Target &other = this->pn532.getTarget(i);
+        char otherHex[2 * sizeof(other.uid) + 1];
+        for (uint8_t j = 0; j < other.uidLength; j++)
+        {
+            snprintf(otherHex + 2 * j, 3, "%02x", other.uid[j]);
+        }
+        otherHex[2 * other.uidLength] = '\0';
+        logger.infof("Ignoring second card UID=%s SAK=0x%02x", otherHex, other.sel_res);
+    }
+
+    const Adafruit_PN532_Target &target = this->pn532.getTarget(selected);
+    memcpy(uid, target.uid, target.uidLength);
+    *uidLength = target.uidLength;
+    return true;
+}
+
 void NFC::uintArrayToCharArray(const uint8_t *uuid, const uint8_t length, char *charArray)
 {
     for (int i = 0; i < length; i++)
@@ -6,24 +6,66 @@
 #include "task_priorities.h"
 #include "../logger/logger.hpp"
 #include "../state/state.hpp"
+#include "../metrics/latencyHistogram.hpp"
+#include "cardPresence.hpp"
 
 class NFC
 {
 public:
-    NFC() : pn532(PIN_PN532_IRQ, PIN_PN532_RESET, &Wire), logger("NFC") {}
+    NFC() : pn532(PIN_PN532_IRQ, PIN_PN532_RESET, &Wire), cardPresence(TAP_HOLD_OFF_MS, CARD_REARM_MS), logger("NFC") {}
+    // PN532 behind a caller owned transport, e.g. an emulated one in the host tests
+    explicit NFC(Adafruit_PN532_Transport *transport) : pn532(transport, PIN_PN532_IRQ, PIN_PN532_RESET), cardPresence(TAP_HOLD_OFF_MS, CARD_REARM_MS), logger("NFC") {}
 
     void setup();
 
+    struct DetectionStats
+    {
+        bool irqDriven;
+        uint32_t busTransactions;
+        uint32_t detections;
+        uint32_t presentPolls;
+        LatencyHistogram::Snapshot latency;
+    };
+
+    DetectionStats getDetectionStats() const;
+
+    // Enough room for every APDU the trace ring keeps
+    static const uint16_t APDU_TRACE_CAPACITY = NTAG424_TRACE_RING_SIZE > 0 ? NTAG424_TRACE_RING_SIZE : 1;
+
+    // Last NTAG424 APDUs (headers, status words, timings), oldest first
+    uint16_t getApduTrace(Adafruit_PN532_TraceEntry *entries, uint16_t max, uint32_t &recorded) const;
+
 private:
     static const uint8_t AUTH_KEY_NO = 0;
     static const uint8_t AUTH_CMD = 0x71;
+    static const uint8_t AUTH_ATTEMPTS = 3;
+    static const uint32_t AUTH_RETRY_BACKOFF_MS = 20;
+
+    // Ready-check interval bounds when no IRQ line is wired. The interval
+    // starts short when detection is armed and stretches while idle.
+    static const uint32_t DETECTION_POLL_MIN_MS = 10;
+    static const uint32_t DETECTION_POLL_MAX_MS = 60;
+    static const uint32_t LOOP_DELAY_MS = 40;
+    static const uint32_t REMOVAL_PROBE_INTERVAL_MS = 100;
+
+    // One tap per presentation: a card left on the reader is re-polled every
+    // PRESENT_REPOLL_MS without identifying it again, and only counts as a
+    // new presentation after it was unseen for CARD_REARM_MS. Taps are at
+    // least TAP_HOLD_OFF_MS apart.
+    static const uint32_t TAP_HOLD_OFF_MS = 1000;
+    static const uint32_t CARD_REARM_MS = 300;
+    static const uint32_t PRESENT_REPOLL_MS = 100;
 
     static void task_function(void *pvParameters);
+    static void IRAM_ATTR onPn532Irq(void *arg);
     void loop();
 
+    TaskHandle_t taskHandle = nullptr;
+    bool irq_driven = false;
+
     void updateStateFromAppState();
-    uint32_t lastKnownAppStateChangeTime = 0;
-    uint32_t lastKnownApiEventTime = 0;
+    EventGroupHandle_t stateSubscription = nullptr;
+    uint32_t pendingStateChanges = 0;
     bool network_connected = false;
     bool nfc_detection_enabled_from_state = false;
 
@@ -35,7 +77,43 @@ private:
 
     void processNfcCommands();
 
-    void hexStringToBytes(const String &hexString, uint8_t *byteArray, size_t byteArrayLength);
+    /*
+     *  Async card detection: an InListPassiveTarget is left pending on the
+     *  PN532 and its response is picked up once the IRQ line drops (or the
+     *  ready poll says so), so the bus stays idle while no card is present.
+     */
+    bool detection_armed = false;
+    uint32_t detection_armed_at = 0;
+    uint32_t detection_last_poll_at = 0;
+    uint32_t detection_poll_interval_ms = DETECTION_POLL_MIN_MS;
+    volatile uint32_t detection_irq_at = 0;
+    uint32_t detections = 0;
+    LatencyHistogram detectionLatency;
+
+    CardPresence cardPresence;
+    uint32_t presentPolls = 0;
+    uint32_t detection_done_at = 0;
+    uint32_t detection_rearm_delay_ms = 0;
+
+    bool armCardDetection();
+    void cancelCardDetection();
+    bool isCardDetectionReady();
+    uint32_t nextWaitMs() const;
+
+    /*
+     *  Identify the card reported by the last InListPassiveTarget response,
+     *  a card that is still present from the last poll is not asked again
+     *  @return true if it is an NTAG424 and dicoveredUuid was filled
+     */
+    bool readDetectedNfcCard(char *dicoveredUuid, uint8_t *discoveredUuidLength);
+
+    /*
+     *  Pick the NTAG424 among the targets of the last InListPassiveTarget
+     *  and route the following commands to it, the other card is logged
+     *  @param uid: the NTAG424 uid, holds PN532_MAX_UID_LENGTH bytes
+     *  @return true if one of the targets is an NTAG424
+     */
+    bool selectNtag424Target(uint8_t *uid, uint8_t *uidLength);
 
     /*
      *  Detect the nfc module and set the nfc_is_detected flag if it is detected
@@ -20,13 +20,15 @@ static String ipToString(const esp_ip4_addr_t &ip)
 CLIService *SerialSetup::cliService = NULL;
 API *SerialSetup::api = NULL;
 Websocket *SerialSetup::websocket = NULL;
+NFC *SerialSetup::nfc = NULL;
 TaskHandle_t SerialSetup::taskHandle = nullptr;
 
-void SerialSetup::setup(CLIService *cliService, API *api, Websocket *websocket)
+void SerialSetup::setup(CLIService *cliService, API *api, Websocket *websocket, NFC *nfc)
 {
     SerialSetup::cliService = cliService;
     SerialSetup::api = api;
     SerialSetup::websocket = websocket;
+    SerialSetup::nfc = nfc;
 
     // Register firmware version handler
     cliService->registerCommandHandler(CLI_SERVICE::CLI_COMMAND_GET, "firmware.version", [](const String &payload)
@@ -51,6 +53,19 @@ void SerialSetup::setup(CLIService *cliService, API *api, Websocket *websocket)
     cliService->registerCommandHandler(CLI_SERVICE::CLI_COMMAND_GET, "network.status", [](const String &payload)
                                        { handleNetworkStatus(payload); });
 
+    cliService->registerCommandHandler(CLI_SERVICE::CLI_COMMAND_GET, "network.tls.stats", [](const String &payload)
+                                       { handleTlsStats(payload); });
+    cliService->registerCommandHandler(CLI_SERVICE::CLI_COMMAND_GET, "network.websocket.stats", [](const String &payload)
+                                       { handleWebsocketStats(payload); });
+
+    // Runtime counters (heap, message queues) for profiling on the device
+    cliService->registerCommandHandler(CLI_SERVICE::CLI_COMMAND_GET, "system.stats", [](const String &payload)
+                                       { handleSystemStats(payload); });
+
+    // Last NTAG424 APDUs with their timings
+    cliService->registerCommandHandler(CLI_SERVICE::CLI_COMMAND_GET, "nfc.trace", [](const String &payload)
+                                       { handleNfcTrace(payload); });
+
     // register reboot handler
     cliService->registerCommandHandler(CLI_SERVICE::CLI_COMMAND_SET, "system.reboot", [](const String &payload)
                                        {
@@ -473,4 +488,203 @@ void SerialSetup::handleNetworkStatus(const String &payload)
     String out;
     serializeJson(doc, out);
     cliService->sendResponse(CLI_SERVICE::CLI_COMMAND_GET, "network.status", out);
+}
+
+static void queueStatsToJson(JsonObject target, const State::WebsocketQueueStats &stats)
+{
+    target["pushed"] = stats.pushed;
+    target["dropped"] = stats.dropped;
+    target["droppedBytes"] = stats.droppedBytes;
+    target["maxMessageLength"] = stats.maxMessageLength;
+}
+
+static void latencyToJson(JsonObject target, const LatencyHistogram::Snapshot &latency)
+{
+    target["count"] = latency.count;
+    target["min"] = latency.minMs;
+    target["mean"] = latency.meanMs();
+    target["p50"] = latency.percentile(50);
+    target["p90"] = latency.percentile(90);
+    target["p99"] = latency.percentile(99);
+    target["max"] = latency.maxMs;
+}
+
+void SerialSetup::handleSystemStats(const String &payload)
+{
+    if (payload.length() > 0)
+    {
+        cliService->sendResponse(CLI_SERVICE::CLI_COMMAND_GET, "system.stats", "error unexpected_payload");
+        return;
+    }
+
+    JsonDocument doc;
+    doc["uptimeMs"] = millis();
+
+    JsonObject heap = doc["heap"].to<JsonObject>();
+    heap["free"] = ESP.getFreeHeap();
+    heap["minFree"] = ESP.getMinFreeHeap();
+    heap["maxAlloc"] = ESP.getMaxAllocHeap();
+
+    JsonObject websocketQueues = doc["websocketQueues"].to<JsonObject>();
+    queueStatsToJson(websocketQueues["incoming"].to<JsonObject>(), State::getIncomingWebsocketQueueStats());
+    queueStatsToJson(websocketQueues["outgoing"].to<JsonObject>(), State::getOutgoingWebsocketQueueStats());
+
+    ArenaAllocator::Stats arenaStats = api->getOutgoingArenaStats();
+    JsonObject arena = doc["outgoingArena"].to<JsonObject>();
+    arena["capacity"] = arenaStats.capacity;
+    arena["highWater"] = arenaStats.highWater;
+    arena["allocations"] = arenaStats.allocations;
+    arena["failedAllocations"] = arenaStats.failedAllocations;
+
+    latencyToJson(doc["tapLatencyMs"].to<JsonObject>(), api->getTapLatency());
+
+    NFC::DetectionStats detection = nfc->getDetectionStats();
+    JsonObject nfcStats = doc["nfc"].to<JsonObject>();
+    nfcStats["detectionMode"] = detection.irqDriven ? "irq" : "poll";
+    nfcStats["busTransactions"] = detection.busTransactions;
+    nfcStats["detections"] = detection.detections;
+    nfcStats["presentPolls"] = detection.presentPolls;
+    latencyToJson(nfcStats["detectionLatencyMs"].to<JsonObject>(), detection.latency);
+
+    TapJournal::Stats journalStats = api->getJournalStats();
+    JsonObject journal = doc["tapJournal"].to<JsonObject>();
+    journal["ready"] = api->isJournalReady();
+    journal["capacity"] = journalStats.capacity;
+    journal["pending"] = journalStats.pending;
+    journal["appended"] = journalStats.appended;
+    journal["acknowledged"] = journalStats.acknowledged;
+    journal["dropped"] = journalStats.dropped;
+    journal["corrupt"] = journalStats.corrupt;
+    journal["sectorErases"] = journalStats.sectorErases;
+
+    AccessList::Stats accessListStats = api->getAccessListStats();
+    JsonObject accessList = doc["accessList"].to<JsonObject>();
+    accessList["version"] = accessListStats.version;
+    accessList["entries"] = accessListStats.entries;
+    accessList["expiresAt"] = accessListStats.expiresAt;
+    accessList["updates"] = accessListStats.updates;
+    accessList["rejected"] = accessListStats.rejected;
+    accessList["lookups"] = accessListStats.lookups;
+    accessList["granted"] = accessListStats.granted;
+
+    String out;
+    serializeJson(doc, out);
+    cliService->sendResponse(CLI_SERVICE::CLI_COMMAND_GET, "system.stats", out);
+}
+
+void SerialSetup::handleTlsStats(const String &payload)
+{
+    if (payload.length() > 0)
+    {
+        cliService->sendResponse(CLI_SERVICE::CLI_COMMAND_GET, "network.tls.stats", "error unexpected_payload");
+        return;
+    }
+
+    Websocket::TlsStats stats = websocket->getTlsStats();
+
+    JsonDocument doc;
+    doc["attempts"] = stats.attempts;
+    doc["established"] = stats.established;
+    doc["failed"] = stats.failed;
+    doc["lastHandshakeMs"] = stats.lastHandshakeMs;
+    latencyToJson(doc["handshakeMs"].to<JsonObject>(), stats.handshake);
+    latencyToJson(doc["fullHandshakeMs"].to<JsonObject>(), stats.fullHandshake);
+    latencyToJson(doc["resumedHandshakeMs"].to<JsonObject>(), stats.resumedHandshake);
+
+    JsonObject sessions = doc["sessions"].to<JsonObject>();
+    sessions["offered"] = stats.sessions.offered;
+    sessions["resumed"] = stats.sessions.resumed;
+    sessions["full"] = stats.sessions.full;
+    sessions["stored"] = stats.sessions.stored;
+    sessions["persisted"] = stats.sessions.persisted;
+    sessions["dropped"] = stats.sessions.dropped;
+    sessions["hitRate"] = TlsSessionCache::hitRate(stats.sessions);
+    sessions["persistent"] = stats.sessionPersistence;
+
+    String out;
+    serializeJson(doc, out);
+    cliService->sendResponse(CLI_SERVICE::CLI_COMMAND_GET, "network.tls.stats", out);
+}
+
+void SerialSetup::handleNfcTrace(const String &payload)
+{
+    if (payload.length() > 0)
+    {
+        cliService->sendResponse(CLI_SERVICE::CLI_COMMAND_GET, "nfc.trace", "error unexpected_payload");
+        return;
+    }
+
+    Adafruit_PN532_TraceEntry entries[NFC::APDU_TRACE_CAPACITY];
+    uint32_t recorded = 0;
+    uint16_t count = nfc->getApduTrace(entries, NFC::APDU_TRACE_CAPACITY, recorded);
+
+    JsonDocument doc;
+    doc["recorded"] = recorded;
+    JsonArray apdus = doc["apdus"].to<JsonArray>();
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const Adafruit_PN532_TraceEntry &entry = entries[i];
+        char header[9];
+        char sw[5];
+        snprintf(header, sizeof(header), "%02X%02X%02X%02X", entry.cla, entry.ins, entry.p1, entry.p2);
+        snprintf(sw, sizeof(sw), "%02X%02X", entry.sw1, entry.sw2);
+
+        JsonObject apdu = apdus.add<JsonObject>();
+        apdu["atMs"] = entry.started_ms;
+        apdu["us"] = entry.duration_us;
+        apdu["counter"] = entry.cmd_counter;
+        apdu["header"] = header;
+        apdu["lc"] = entry.lc;
+        apdu["status"] = entry.status;
+        apdu["sw"] = sw;
+        apdu["length"] = entry.response_length;
+    }
+
+    String out;
+    serializeJson(doc, out);
+    cliService->sendResponse(CLI_SERVICE::CLI_COMMAND_GET, "nfc.trace", out);
+}
+
+void SerialSetup::handleWebsocketStats(const String &payload)
+{
+    if (payload.length() > 0)
+    {
+        cliService->sendResponse(CLI_SERVICE::CLI_COMMAND_GET, "network.websocket.stats", "error unexpected_payload");
+        return;
+    }
+
+    Websocket::ConnectionStats stats = websocket->getConnectionStats();
+
+    JsonDocument doc;
+    doc["connected"] = stats.connected;
+    doc["attempts"] = stats.backoff.attempts;
+    doc["failures"] = stats.backoff.failures;
+    doc["consecutiveFailures"] = stats.backoff.consecutiveFailures;
+    doc["lastDelayMs"] = stats.backoff.lastDelayMs;
+    doc["nextAttemptInMs"] = stats.nextAttemptInMs;
+    doc["connects"] = stats.backoff.connects;
+    doc["currentUptimeMs"] = stats.backoff.currentUptimeMs;
+    doc["longestUptimeMs"] = stats.backoff.longestUptimeMs;
+    doc["totalUptimeMs"] = stats.backoff.totalUptimeMs;
+
+    doc["batching"] = stats.batching;
+    JsonObject send = doc["send"].to<JsonObject>();
+    send["messages"] = stats.send.messages;
+    send["frames"] = stats.send.frames;
+    send["batches"] = stats.send.batches;
+    send["failures"] = stats.send.failures;
+    latencyToJson(send["latencyMs"].to<JsonObject>(), stats.send.latency);
+    latencyToJson(send["queueLatencyMs"].to<JsonObject>(), stats.send.queueLatency);
+
+    JsonObject heartbeat = doc["heartbeat"].to<JsonObject>();
+    heartbeat["sent"] = stats.heartbeat.sent;
+    heartbeat["suppressed"] = stats.heartbeat.suppressed;
+    heartbeat["lost"] = stats.heartbeat.lost;
+    heartbeat["halfOpenDrops"] = stats.heartbeat.halfOpenDrops;
+    heartbeat["echoSupported"] = stats.heartbeat.echoSupported;
+    latencyToJson(heartbeat["rttMs"].to<JsonObject>(), stats.heartbeat.rtt);
+
+    String out;
+    serializeJson(doc, out);
+    cliService->sendResponse(CLI_SERVICE::CLI_COMMAND_GET, "network.websocket.stats", out);
 }
\ No newline at end of file
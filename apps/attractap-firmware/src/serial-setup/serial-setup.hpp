@@ -8,6 +8,7 @@
 #include "../cli/CLIService.hpp"
 #include "../api/api.hpp"
 #include "../websocket/websocket.hpp"
+#include "../nfc/nfc.hpp"
 #include "../state/state.hpp"
 #include "task_priorities.h"
 
@@ -23,7 +24,7 @@ public:
         uint8_t channel;
     };
 
-    static void setup(CLIService *cliService, API *api, Websocket *websocket);
+    static void setup(CLIService *cliService, API *api, Websocket *websocket, NFC *nfc);
 
     static void onWifiScanDone(WifiNetwork *networks, uint8_t count);
 
@@ -35,6 +36,7 @@ private:
     static CLIService *cliService;
     static API *api;
     static Websocket *websocket;
+    static NFC *nfc;
 
     static void handleFirmwareVersion(const String &payload);
     static void handleAttraccessStatus(const String &payload);
@@ -46,4 +48,8 @@ private:
     static void handleWiFiScan(const String &payload);
     static void handleWiFiConnect(const String &payload);
     static void handleNetworkStatus(const String &payload);
+    static void handleSystemStats(const String &payload);
+    static void handleTlsStats(const String &payload);
+    static void handleWebsocketStats(const String &payload);
+    static void handleNfcTrace(const String &payload);
 };
\ No newline at end of file
@@ -138,4 +138,127 @@ void Settings::saveMpr121Thresholds(uint8_t touch, uint8_t release)
     preferences.putUChar("mpr121.touch", touch);
     preferences.putUChar("mpr121.release", release);
     preferences.end();
+}
+
+size_t Settings::loadAccessList(void *buffer, size_t maxLength)
+{
+    preferences.begin("accesslist", true);
+    size_t length = preferences.getBytesLength("table");
+    if (length > maxLength)
+    {
+        length = 0;
+    }
+    else if (length > 0)
+    {
+        length = preferences.getBytes("table", buffer, length);
+    }
+    preferences.end();
+    return length;
+}
+
+bool Settings::saveAccessList(const void *data, size_t length)
+{
+    preferences.begin("accesslist", false);
+    bool saved = preferences.putBytes("table", data, length) == length;
+    preferences.end();
+
+    if (!saved)
+    {
+        logger.errorf("Failed to save access list (%u bytes)", length);
+    }
+    return saved;
+}
+
+void Settings::clearAccessList()
+{
+    logger.info("Clearing access list...");
+    preferences.begin("accesslist", false);
+    preferences.clear();
+    preferences.end();
+}
+
+bool Settings::getAccessListAge(uint32_t &version, uint32_t &ageS)
+{
+    preferences.begin("accesslist", true);
+    bool has = preferences.isKey("age.version");
+    if (has)
+    {
+        version = preferences.getUInt("age.version", 0);
+        ageS = preferences.getUInt("age.s", 0);
+    }
+    preferences.end();
+    return has;
+}
+
+void Settings::saveAccessListAge(uint32_t version, uint32_t ageS)
+{
+    preferences.begin("accesslist", false);
+    preferences.putUInt("age.version", version);
+    preferences.putUInt("age.s", ageS);
+    preferences.end();
+}
+
+bool Settings::getFirmwareTrial(String &previousPartition, uint8_t &boots)
+{
+    preferences.begin("firmware", true);
+    bool has = preferences.isKey("trial.prev");
+    if (has)
+    {
+        previousPartition = preferences.getString("trial.prev", "");
+        boots = preferences.getUChar("trial.boots", 0);
+    }
+    preferences.end();
+    return has;
+}
+
+void Settings::saveFirmwareTrial(const String &previousPartition, uint8_t boots)
+{
+    preferences.begin("firmware", false);
+    preferences.putString("trial.prev", previousPartition);
+    preferences.putUChar("trial.boots", boots);
+    preferences.end();
+}
+
+void Settings::clearFirmwareTrial()
+{
+    preferences.begin("firmware", false);
+    preferences.clear();
+    preferences.end();
+}
+
+size_t Settings::loadTlsSession(String &server, void *buffer, size_t maxLength)
+{
+    preferences.begin("tlssession", true);
+    size_t length = preferences.getBytesLength("session");
+    if (length > maxLength)
+    {
+        length = 0;
+    }
+    else if (length > 0)
+    {
+        server = preferences.getString("server", "");
+        length = preferences.getBytes("session", buffer, length);
+    }
+    preferences.end();
+    return length;
+}
+
+bool Settings::saveTlsSession(const String &server, const void *data, size_t length)
+{
+    preferences.begin("tlssession", false);
+    bool saved = preferences.putString("server", server) > 0 && preferences.putBytes("session", data, length) == length;
+    preferences.end();
+
+    if (!saved)
+    {
+        logger.errorf("Failed to save TLS session (%u bytes)", length);
+    }
+    return saved;
+}
+
+void Settings::clearTlsSession()
+{
+    preferences.begin("tlssession", false);
+    preferences.clear();
+    preferences.end();
 }
\ No newline at end of file
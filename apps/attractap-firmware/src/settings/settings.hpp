@@ -44,6 +44,24 @@ public:
     static bool getMpr121Thresholds(uint8_t &touch, uint8_t &release);
     static void saveMpr121Thresholds(uint8_t touch, uint8_t release);
 
+    // Offline access list (see AccessList), kept as one blob in its own namespace
+    static size_t loadAccessList(void *buffer, size_t maxLength);
+    static bool saveAccessList(const void *data, size_t length);
+    static void clearAccessList();
+    // How long the reader has been running with a version of the list
+    static bool getAccessListAge(uint32_t &version, uint32_t &ageS);
+    static void saveAccessListAge(uint32_t version, uint32_t ageS);
+
+    // Freshly installed firmware that still has to prove it works (see FirmwareUpdate)
+    static bool getFirmwareTrial(String &previousPartition, uint8_t &boots);
+    static void saveFirmwareTrial(const String &previousPartition, uint8_t boots);
+    static void clearFirmwareTrial();
+
+    // Last TLS session (see TlsSessionCache) and the server it belongs to
+    static size_t loadTlsSession(String &server, void *buffer, size_t maxLength);
+    static bool saveTlsSession(const String &server, const void *data, size_t length);
+    static void clearTlsSession();
+
 private:
     static Preferences preferences;
     static Logger logger;
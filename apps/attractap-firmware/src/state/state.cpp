@@ -1,14 +1,20 @@
 #include "state.hpp"
 
-// Fixed-size buffer per queued message to avoid heap and keep stack small
-static constexpr size_t WEBSOCKET_MESSAGE_MAX_LEN = 1024; // bytes, including null terminator
-struct StateQueueMessage
-{
-    char data[WEBSOCKET_MESSAGE_MAX_LEN];
-};
+// Byte ring sizes for websocket traffic. A no-split ring can hold a single
+// record of up to roughly half its size; longer messages are dropped and counted.
+static constexpr size_t INCOMING_WEBSOCKET_RING_SIZE = 8192;
+static constexpr size_t OUTGOING_WEBSOCKET_RING_SIZE = 4096;
+static constexpr uint32_t WEBSOCKET_RING_MAX_WAIT_MS = 2000;
+// Incoming records are reserved from the websocket client's event handler, which
+// must not block: a full ring drops (and counts) the message right away.
+static constexpr uint32_t INCOMING_WEBSOCKET_RING_MAX_WAIT_MS = 0;
+// Outgoing records start with the micros() of their commit, for the time
+// messages wait until the websocket task sends them
+static constexpr size_t OUTGOING_WEBSOCKET_HEADER_LENGTH = sizeof(uint32_t);
 
 // Static member definitions
-uint32_t State::_lastStateChangeTime = 0;
+State::StateSubscription State::subscriptions[State::MAX_STATE_SUBSCRIPTIONS] = {};
+uint8_t State::subscriptionCount = 0;
 portMUX_TYPE State::stateMutex = portMUX_INITIALIZER_UNLOCKED;
 portMUX_TYPE State::apiEventMutex = portMUX_INITIALIZER_UNLOCKED;
 esp_ip4_addr_t State::wifi_ip = {};
@@ -20,28 +26,36 @@ String State::websocket_hostname = "";
 uint16_t State::websocket_port = 0;
 bool State::websocket_use_ssl = false;
 bool State::websocket_connected = false;
-QueueHandle_t State::incoming_websocket_messages_queue = nullptr;
-QueueHandle_t State::outgoing_websocket_messages_queue = nullptr;
+RingbufHandle_t State::incoming_websocket_messages_ring = nullptr;
+RingbufHandle_t State::outgoing_websocket_messages_ring = nullptr;
+State::WebsocketQueueStats State::incoming_websocket_stats = {};
+State::WebsocketQueueStats State::outgoing_websocket_stats = {};
 QueueHandle_t State::api_input_events_queue = nullptr;
+QueueHandle_t State::api_commands_queue = nullptr;
 QueueHandle_t State::nfc_commands_queue = nullptr;
 QueueHandle_t State::wifi_events_queue = nullptr;
 bool State::_queuesInitialized = false;
 bool State::api_authenticated = false;
 String State::api_device_name = "";
 State::ApiEventData State::api_event_data = {State::ApiEventState::API_EVENT_STATE_NONE, JsonObject()};
-uint32_t State::api_event_time = 0;
 DynamicJsonDocument State::api_event_doc(1024);
 String State::keypad_value = "";
 
 void State::initializeQueuesIfNeeded()
 {
-    if (State::incoming_websocket_messages_queue == nullptr)
+    if (State::incoming_websocket_messages_ring == nullptr)
+    {
+        State::incoming_websocket_messages_ring = xRingbufferCreate(INCOMING_WEBSOCKET_RING_SIZE, RINGBUF_TYPE_NOSPLIT);
+        State::incoming_websocket_stats.maxMessageLength = xRingbufferGetMaxItemSize(State::incoming_websocket_messages_ring);
+    }
+    if (State::outgoing_websocket_messages_ring == nullptr)
     {
-        State::incoming_websocket_messages_queue = xQueueCreate(15, sizeof(StateQueueMessage));
+        State::outgoing_websocket_messages_ring = xRingbufferCreate(OUTGOING_WEBSOCKET_RING_SIZE, RINGBUF_TYPE_NOSPLIT);
+        State::outgoing_websocket_stats.maxMessageLength = xRingbufferGetMaxItemSize(State::outgoing_websocket_messages_ring) - OUTGOING_WEBSOCKET_HEADER_LENGTH;
     }
-    if (State::outgoing_websocket_messages_queue == nullptr)
+    if (State::api_commands_queue == nullptr)
     {
-        State::outgoing_websocket_messages_queue = xQueueCreate(15, sizeof(StateQueueMessage));
+        State::api_commands_queue = xQueueCreate(10, sizeof(ApiCommand));
     }
     if (State::api_input_events_queue == nullptr)
     {
@@ -57,17 +71,63 @@ void State::initializeQueuesIfNeeded()
     }
 }
 
-void State::onStateChanged()
+EventGroupHandle_t State::subscribe(uint32_t domains)
+{
+    EventGroupHandle_t group = xEventGroupCreate();
+    if (group == nullptr)
+    {
+        return nullptr;
+    }
+
+    taskENTER_CRITICAL(&stateMutex);
+    bool registered = subscriptionCount < MAX_STATE_SUBSCRIPTIONS;
+    if (registered)
+    {
+        subscriptions[subscriptionCount].group = group;
+        subscriptions[subscriptionCount].domains = domains & STATE_CHANGE_ALL;
+        subscriptionCount++;
+    }
+    taskEXIT_CRITICAL(&stateMutex);
+
+    if (!registered)
+    {
+        vEventGroupDelete(group);
+        return nullptr;
+    }
+
+    // Let the subscriber pick up the current state on its first wait
+    xEventGroupSetBits(group, domains & STATE_CHANGE_ALL);
+    return group;
+}
+
+uint32_t State::waitForChanges(EventGroupHandle_t subscription, uint32_t timeoutMs)
 {
-    _lastStateChangeTime = millis();
+    if (subscription == nullptr)
+    {
+        vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+        return STATE_CHANGE_ALL;
+    }
+
+    EventBits_t bits = xEventGroupWaitBits(subscription, STATE_CHANGE_ALL, pdTRUE, pdFALSE, pdMS_TO_TICKS(timeoutMs));
+    return bits & STATE_CHANGE_ALL;
 }
 
-uint32_t State::getLastStateChangeTime()
+void State::notifySubscribers(uint32_t domains)
 {
+    // Event group bits accumulate until the subscriber waits again, so two
+    // changes landing in the same tick are never collapsed into "no change".
     taskENTER_CRITICAL(&stateMutex);
-    uint32_t lastStateChangeTime = _lastStateChangeTime;
+    uint8_t count = subscriptionCount;
     taskEXIT_CRITICAL(&stateMutex);
-    return lastStateChangeTime;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint32_t matching = subscriptions[i].domains & domains;
+        if (matching != 0)
+        {
+            xEventGroupSetBits(subscriptions[i].group, matching);
+        }
+    }
 }
 
 void State::setEthernetState(bool connected, esp_ip4_addr_t ip)
@@ -75,8 +135,9 @@ void State::setEthernetState(bool connected, esp_ip4_addr_t ip)
     taskENTER_CRITICAL(&stateMutex);
     ethernet_ip = ip;
     ethernet_connected = connected;
-    onStateChanged();
     taskEXIT_CRITICAL(&stateMutex);
+
+    notifySubscribers(STATE_CHANGE_NETWORK);
 }
 
 void State::setWifiState(bool connected, esp_ip4_addr_t ip, String ssid)
@@ -85,8 +146,9 @@ void State::setWifiState(bool connected, esp_ip4_addr_t ip, String ssid)
     wifi_connected = connected;
     wifi_ip = ip;
     wifi_ssid = ssid;
-    onStateChanged();
     taskEXIT_CRITICAL(&stateMutex);
+
+    notifySubscribers(STATE_CHANGE_NETWORK);
 }
 
 State::NetworkState State::getNetworkState()
@@ -111,8 +173,9 @@ void State::setWebsocketState(bool connected, String hostname, uint16_t port, bo
     websocket_hostname = hostname;
     websocket_port = port;
     websocket_use_ssl = useSSL;
-    onStateChanged();
     taskEXIT_CRITICAL(&stateMutex);
+
+    notifySubscribers(STATE_CHANGE_WEBSOCKET);
 }
 
 State::WebsocketState State::getWebsocketState()
@@ -133,8 +196,9 @@ void State::setApiState(bool authenticated, String deviceName)
     taskENTER_CRITICAL(&stateMutex);
     api_authenticated = authenticated;
     api_device_name = deviceName;
-    onStateChanged();
     taskEXIT_CRITICAL(&stateMutex);
+
+    notifySubscribers(STATE_CHANGE_API);
 }
 
 State::ApiState State::getApiState()
@@ -148,60 +212,133 @@ State::ApiState State::getApiState()
     return state;
 }
 
-void State::pushIncomingWebsocketMessageToQueue(const String &message)
+char *State::reserveWebsocketMessage(RingbufHandle_t ring, WebsocketQueueStats &stats, size_t length, size_t headerLength, uint32_t maxWaitMs)
 {
-    initializeQueuesIfNeeded();
-    static const uint32_t incoming_queue_max_wait_ms = 2000;
-    StateQueueMessage qmsg;
-    size_t copyLen = message.length();
-    if (copyLen >= WEBSOCKET_MESSAGE_MAX_LEN)
+    void *slot = nullptr;
+    bool fits = length > 0 && length <= stats.maxMessageLength;
+    if (fits && xRingbufferSendAcquire(ring, &slot, headerLength + length, pdMS_TO_TICKS(maxWaitMs)) == pdTRUE)
     {
-        copyLen = WEBSOCKET_MESSAGE_MAX_LEN - 1; // leave space for null terminator
+        taskENTER_CRITICAL(&stateMutex);
+        stats.pushed++;
+        taskEXIT_CRITICAL(&stateMutex);
+        return (char *)slot + headerLength;
     }
-    memcpy(qmsg.data, message.c_str(), copyLen);
-    qmsg.data[copyLen] = '\0';
 
-    xQueueSend(incoming_websocket_messages_queue, &qmsg, pdMS_TO_TICKS(incoming_queue_max_wait_ms));
+    // Never truncate: a partial JSON message is worse than a missing one
+    taskENTER_CRITICAL(&stateMutex);
+    stats.dropped++;
+    stats.droppedBytes += length;
+    taskEXIT_CRITICAL(&stateMutex);
+    return nullptr;
 }
 
-bool State::getNextIncomingWebsocketMessage(String &message)
+void State::commitWebsocketMessage(RingbufHandle_t ring, char *record)
 {
-    initializeQueuesIfNeeded();
-    StateQueueMessage qmsg;
-    if (xQueueReceive(incoming_websocket_messages_queue, &qmsg, 0) == pdPASS)
+    if (record != nullptr)
     {
-        message = String(qmsg.data);
-        return true;
+        xRingbufferSendComplete(ring, record);
     }
-    return false;
 }
 
-void State::pushOutgoingWebsocketMessageToQueue(const String &message)
+bool State::getNextWebsocketMessage(RingbufHandle_t ring, WebsocketMessage &message, size_t headerLength)
 {
-    initializeQueuesIfNeeded();
-    static const uint32_t outgoing_queue_max_wait_ms = 2000;
-    StateQueueMessage qmsg;
-    size_t copyLen = message.length();
-    if (copyLen >= WEBSOCKET_MESSAGE_MAX_LEN)
+    size_t length = 0;
+    void *item = xRingbufferReceive(ring, &length, 0);
+    if (item == nullptr)
+    {
+        return false;
+    }
+
+    message.data = (const char *)item + headerLength;
+    message.length = length - headerLength;
+    message.queuedAtUs = 0;
+    if (headerLength != 0)
     {
-        copyLen = WEBSOCKET_MESSAGE_MAX_LEN - 1;
+        memcpy(&message.queuedAtUs, item, sizeof(message.queuedAtUs));
     }
-    memcpy(qmsg.data, message.c_str(), copyLen);
-    qmsg.data[copyLen] = '\0';
+    return true;
+}
+
+char *State::reserveIncomingWebsocketMessage(size_t length)
+{
+    initializeQueuesIfNeeded();
+    return reserveWebsocketMessage(incoming_websocket_messages_ring, incoming_websocket_stats, length, 0, INCOMING_WEBSOCKET_RING_MAX_WAIT_MS);
+}
+
+void State::commitIncomingWebsocketMessage(char *message)
+{
+    commitWebsocketMessage(incoming_websocket_messages_ring, message);
+}
+
+bool State::getNextIncomingWebsocketMessage(WebsocketMessage &message)
+{
+    initializeQueuesIfNeeded();
+    return getNextWebsocketMessage(incoming_websocket_messages_ring, message, 0);
+}
+
+void State::releaseIncomingWebsocketMessage(const WebsocketMessage &message)
+{
+    vRingbufferReturnItem(incoming_websocket_messages_ring, (void *)message.data);
+}
 
-    xQueueSend(outgoing_websocket_messages_queue, &qmsg, pdMS_TO_TICKS(outgoing_queue_max_wait_ms));
+State::WebsocketQueueStats State::getIncomingWebsocketQueueStats()
+{
+    initializeQueuesIfNeeded();
+    taskENTER_CRITICAL(&stateMutex);
+    WebsocketQueueStats stats = incoming_websocket_stats;
+    taskEXIT_CRITICAL(&stateMutex);
+    return stats;
 }
 
-bool State::getNextOutgoingWebsocketMessage(String &message)
+char *State::reserveOutgoingWebsocketMessage(size_t length)
 {
     initializeQueuesIfNeeded();
-    StateQueueMessage qmsg;
-    if (xQueueReceive(outgoing_websocket_messages_queue, &qmsg, 0) == pdPASS)
+    return reserveWebsocketMessage(outgoing_websocket_messages_ring, outgoing_websocket_stats, length, OUTGOING_WEBSOCKET_HEADER_LENGTH, WEBSOCKET_RING_MAX_WAIT_MS);
+}
+
+void State::commitOutgoingWebsocketMessage(char *message)
+{
+    if (message == nullptr)
     {
-        message = String(qmsg.data);
-        return true;
+        return;
     }
-    return false;
+
+    char *record = message - OUTGOING_WEBSOCKET_HEADER_LENGTH;
+    uint32_t now = micros();
+    memcpy(record, &now, sizeof(now));
+    commitWebsocketMessage(outgoing_websocket_messages_ring, record);
+}
+
+bool State::getNextOutgoingWebsocketMessage(WebsocketMessage &message)
+{
+    initializeQueuesIfNeeded();
+    return getNextWebsocketMessage(outgoing_websocket_messages_ring, message, OUTGOING_WEBSOCKET_HEADER_LENGTH);
+}
+
+void State::releaseOutgoingWebsocketMessage(const WebsocketMessage &message)
+{
+    vRingbufferReturnItem(outgoing_websocket_messages_ring, (void *)(message.data - OUTGOING_WEBSOCKET_HEADER_LENGTH));
+}
+
+State::WebsocketQueueStats State::getOutgoingWebsocketQueueStats()
+{
+    initializeQueuesIfNeeded();
+    taskENTER_CRITICAL(&stateMutex);
+    WebsocketQueueStats stats = outgoing_websocket_stats;
+    taskEXIT_CRITICAL(&stateMutex);
+    return stats;
+}
+
+bool State::pushApiCommandToQueue(const ApiCommand &command)
+{
+    initializeQueuesIfNeeded();
+    return xQueueSend(api_commands_queue, &command, pdMS_TO_TICKS(WEBSOCKET_RING_MAX_WAIT_MS)) == pdPASS;
+}
+
+bool State::getNextApiCommand(ApiCommand &command)
+{
+    initializeQueuesIfNeeded();
+    return xQueueReceive(api_commands_queue, &command, 0) == pdPASS;
 }
 
 void State::setApiEventData(ApiEventState state, ArduinoJson::JsonObject payload)
@@ -217,8 +354,9 @@ void State::setApiEventData(ApiEventState state, ArduinoJson::JsonObject payload
         target[p.key()] = p.value();
     }
     api_event_data.payload = api_event_doc.as<JsonObject>();
-    api_event_time = millis();
     taskEXIT_CRITICAL(&apiEventMutex);
+
+    notifySubscribers(STATE_CHANGE_API_EVENT);
 }
 
 State::ApiEventData State::getApiEventData()
@@ -229,12 +367,10 @@ State::ApiEventData State::getApiEventData()
     return data;
 }
 
-uint32_t State::getLastApiEventTime()
+bool State::isOfflineDecision(const ApiEventData &data)
 {
-    taskENTER_CRITICAL(&apiEventMutex);
-    uint32_t time = api_event_time;
-    taskEXIT_CRITICAL(&apiEventMutex);
-    return time;
+    return (data.state == API_EVENT_STATE_DISPLAY_SUCCESS || data.state == API_EVENT_STATE_DISPLAY_ERROR) &&
+           data.payload["offline"].as<bool>();
 }
 
 void State::pushEventToApi(ApiInputEventType type)
@@ -248,6 +384,7 @@ void State::pushEventToApi(ApiInputEventType type, const String &payload)
 
     ApiInputEvent event;
     event.type = type;
+    event.correlationId = 0;
     // Deep copy payload into fixed buffer
     size_t copyLen = payload.length();
     if (copyLen >= sizeof(event.payload))
@@ -259,6 +396,17 @@ void State::pushEventToApi(ApiInputEventType type, const String &payload)
     xQueueSend(api_input_events_queue, &event, pdMS_TO_TICKS(1000));
 }
 
+void State::pushNfcResultToApi(ApiInputEventType type, uint32_t correlationId)
+{
+    initializeQueuesIfNeeded();
+
+    ApiInputEvent event;
+    event.type = type;
+    event.correlationId = correlationId;
+    event.payload[0] = '\0';
+    xQueueSend(api_input_events_queue, &event, pdMS_TO_TICKS(1000));
+}
+
 bool State::getNextApiInputEvent(ApiInputEvent &event)
 {
     initializeQueuesIfNeeded();
@@ -268,12 +416,17 @@ bool State::getNextApiInputEvent(ApiInputEvent &event)
 void State::setKeypadValue(String value)
 {
     taskENTER_CRITICAL(&stateMutex);
-    if (keypad_value != value)
+    bool changed = keypad_value != value;
+    if (changed)
     {
         keypad_value = value;
-        onStateChanged();
     }
     taskEXIT_CRITICAL(&stateMutex);
+
+    if (changed)
+    {
+        notifySubscribers(STATE_CHANGE_KEYPAD);
+    }
 }
 
 String State::getKeypadValue()
@@ -298,18 +451,9 @@ bool State::getNextWifiEvent(WifiEvent &event)
     return xQueueReceive(wifi_events_queue, &event, 0) == pdPASS;
 }
 
-void State::pushNfcCommandToQueue(NfcCommandType type, const String &payload)
+void State::pushNfcCommandToQueue(const NfcCommand &command)
 {
     initializeQueuesIfNeeded();
-    NfcCommand command;
-    command.type = type;
-    size_t copyLen = payload.length();
-    if (copyLen >= sizeof(command.payload))
-    {
-        copyLen = sizeof(command.payload) - 1; // leave room for null terminator
-    }
-    memcpy(command.payload, payload.c_str(), copyLen);
-    command.payload[copyLen] = '\0';
     xQueueSend(nfc_commands_queue, &command, pdMS_TO_TICKS(1000));
 }
 
@@ -3,10 +3,41 @@
 #include <esp_netif.h>
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include "freertos/event_groups.h"
+#include "freertos/ringbuf.h"
+#include "../api/apiCommand.hpp"
 
 class State
 {
 public:
+    // Change domains a task can subscribe to. Each setter raises the bit of the
+    // domain it touches on every subscription that includes it.
+    enum StateChangeDomain : uint32_t
+    {
+        STATE_CHANGE_NETWORK = (1 << 0),
+        STATE_CHANGE_WEBSOCKET = (1 << 1),
+        STATE_CHANGE_API = (1 << 2),
+        STATE_CHANGE_API_EVENT = (1 << 3),
+        STATE_CHANGE_KEYPAD = (1 << 4),
+        STATE_CHANGE_ALL = 0x1F,
+    };
+
+    /*
+     *  Create a subscription for the given change domains. All subscribed bits are
+     *  raised initially so the first wait returns immediately with a full refresh.
+     *  @param domains: bitmask of StateChangeDomain values
+     *  @return the subscription handle, or nullptr if no slot is left
+     */
+    static EventGroupHandle_t subscribe(uint32_t domains);
+
+    /*
+     *  Block until a subscribed domain changes or the timeout expires
+     *  @param subscription: handle returned by subscribe()
+     *  @param timeoutMs: maximum time to block
+     *  @return the changed domains (cleared on return), 0 on timeout
+     */
+    static uint32_t waitForChanges(EventGroupHandle_t subscription, uint32_t timeoutMs);
+
     static void setWifiState(bool connected, esp_ip4_addr_t ip, String ssid);
     static void setEthernetState(bool connected, esp_ip4_addr_t ip);
     struct NetworkState
@@ -37,13 +68,44 @@ public:
     };
     static ApiState getApiState();
 
-    static uint32_t getLastStateChangeTime();
-
-    static void pushIncomingWebsocketMessageToQueue(const String &message);
-    static bool getNextIncomingWebsocketMessage(String &message);
+    // Websocket messages travel through byte ring buffers holding variable-length
+    // records. Producers reserve a record and write into it in place, consumers get
+    // a view into the ring that stays valid until it is released.
+    struct WebsocketMessage
+    {
+        const char *data;
+        size_t length;
+        // micros() when the producer committed it, outgoing messages only
+        uint32_t queuedAtUs;
+    };
+    struct WebsocketQueueStats
+    {
+        uint32_t pushed;
+        uint32_t dropped;
+        uint32_t droppedBytes;
+        size_t maxMessageLength;
+    };
 
-    static void pushOutgoingWebsocketMessageToQueue(const String &message);
-    static bool getNextOutgoingWebsocketMessage(String &message);
+    /*
+     *  Reserve space for an incoming message of the given length, without blocking
+     *  @return pointer to write the message to, nullptr if it does not fit (counted as dropped)
+     */
+    static char *reserveIncomingWebsocketMessage(size_t length);
+    static void commitIncomingWebsocketMessage(char *message);
+    static bool getNextIncomingWebsocketMessage(WebsocketMessage &message);
+    static void releaseIncomingWebsocketMessage(const WebsocketMessage &message);
+    static WebsocketQueueStats getIncomingWebsocketQueueStats();
+
+    static char *reserveOutgoingWebsocketMessage(size_t length);
+    static void commitOutgoingWebsocketMessage(char *message);
+    static bool getNextOutgoingWebsocketMessage(WebsocketMessage &message);
+    static void releaseOutgoingWebsocketMessage(const WebsocketMessage &message);
+    static WebsocketQueueStats getOutgoingWebsocketQueueStats();
+
+    // Decoded server commands, handed from the websocket task to the api task.
+    // Ownership of command.document moves with the command.
+    static bool pushApiCommandToQueue(const ApiCommand &command);
+    static bool getNextApiCommand(ApiCommand &command);
 
     enum ApiInputEventType
     {
@@ -58,11 +120,14 @@ public:
     struct ApiInputEvent
     {
         ApiInputEventType type;
+        // Correlation id of the NfcCommand an NFC result belongs to, 0 otherwise
+        uint32_t correlationId;
         // Fixed-size buffer to avoid placing Arduino String in FreeRTOS queue
         char payload[64];
     };
     static void pushEventToApi(ApiInputEventType type);
     static void pushEventToApi(ApiInputEventType type, const String &payload);
+    static void pushNfcResultToApi(ApiInputEventType type, uint32_t correlationId);
     static bool getNextApiInputEvent(ApiInputEvent &event);
 
     enum ApiEventState
@@ -84,7 +149,9 @@ public:
     };
     static void setApiEventData(ApiEventState state, ArduinoJson::JsonObject payload);
     static ApiEventData getApiEventData();
-    static uint32_t getLastApiEventTime();
+    // Success/error the reader decided on its own (payload "offline"), shown
+    // even while there is no server connection
+    static bool isOfflineDecision(const ApiEventData &data);
 
     static void setKeypadValue(String value);
     static String getKeypadValue();
@@ -110,17 +177,31 @@ public:
     struct NfcCommand
     {
         NfcCommandType type;
-        // Fixed-size buffer to avoid placing Arduino String in FreeRTOS queue
-        char payload[1024];
+        // Echoed back in the ApiInputEvent carrying the result
+        uint32_t correlationId;
+        union
+        {
+            ApiNfcChangeKeyCommand changeKey;
+            ApiNfcAuthenticateCommand authenticate;
+        };
     };
-    static void pushNfcCommandToQueue(NfcCommandType type, const String &payload);
+    static void pushNfcCommandToQueue(const NfcCommand &command);
     static bool getNextNfcCommand(NfcCommand &command);
 
 private:
     State() = delete;
 
-    static void onStateChanged();
-    static uint32_t _lastStateChangeTime;
+    static const uint8_t MAX_STATE_SUBSCRIPTIONS = 8;
+    struct StateSubscription
+    {
+        EventGroupHandle_t group;
+        uint32_t domains;
+    };
+    static StateSubscription subscriptions[MAX_STATE_SUBSCRIPTIONS];
+    static uint8_t subscriptionCount;
+
+    // Must be called outside of the state critical sections
+    static void notifySubscribers(uint32_t domains);
 
     static portMUX_TYPE stateMutex;
     static portMUX_TYPE apiEventMutex;
@@ -136,9 +217,16 @@ private:
     static uint16_t websocket_port;
     static bool websocket_use_ssl;
     static bool websocket_connected;
-    static QueueHandle_t incoming_websocket_messages_queue;
-    static QueueHandle_t outgoing_websocket_messages_queue;
+    static RingbufHandle_t incoming_websocket_messages_ring;
+    static RingbufHandle_t outgoing_websocket_messages_ring;
+    static WebsocketQueueStats incoming_websocket_stats;
+    static WebsocketQueueStats outgoing_websocket_stats;
+
+    static char *reserveWebsocketMessage(RingbufHandle_t ring, WebsocketQueueStats &stats, size_t length, size_t headerLength, uint32_t maxWaitMs);
+    static void commitWebsocketMessage(RingbufHandle_t ring, char *record);
+    static bool getNextWebsocketMessage(RingbufHandle_t ring, WebsocketMessage &message, size_t headerLength);
 
+    static QueueHandle_t api_commands_queue;
     static QueueHandle_t nfc_commands_queue;
     static QueueHandle_t wifi_events_queue;
 
@@ -152,7 +240,6 @@ private:
     static String api_device_name;
 
     static ApiEventData api_event_data;
-    static uint32_t api_event_time;
 
     // Backing store for api_event_data.payload so it remains valid
     // after the source JsonDocument in the caller goes out of scope.
@@ -1,4 +1,9 @@
 #include "AdaptiveCertManager.hpp"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/sha256.h"
 
 // Preference keys
 const char *AdaptiveCertManager::PREF_NAMESPACE = "cert_mgr";
@@ -43,14 +48,14 @@ bool AdaptiveCertManager::begin()
     return success;
 }
 
-bool AdaptiveCertManager::getCertificate(const char **certData)
+bool AdaptiveCertManager::getCertificate(const uint8_t **certDer, size_t *certLength)
 {
-    return getCertificate(certData, nullptr);
+    return getCertificate(certDer, certLength, nullptr);
 }
 
-bool AdaptiveCertManager::getCertificate(const char **certData, const char **certName)
+bool AdaptiveCertManager::getCertificate(const uint8_t **certDer, size_t *certLength, const char **certName)
 {
-    if (!initialized || !certData)
+    if (!initialized || !certDer || !certLength)
     {
         logger.error("Invalid parameters");
         return false;
@@ -93,10 +98,7 @@ bool AdaptiveCertManager::getCertificate(const char **certData, const char **cer
 
     logger.debug("Writing cert data to pointer");
     // Configure WebSocket with current certificate
-    *certData = (const char *)pgm_read_ptr(&ca_certificates[currentCertIndex].data);
-
-    // Yield to prevent watchdog timeout when accessing PROGMEM
-    yield();
+    getCertificateDer(currentCertIndex, certDer, certLength);
 
     if (certName)
     {
@@ -112,6 +114,171 @@ bool AdaptiveCertManager::getCertificate(const char **certData, const char **cer
     return true;
 }
 
+bool AdaptiveCertManager::needsDiscovery(const String &hostname, uint16_t port) const
+{
+    if (!initialized)
+    {
+        return false;
+    }
+
+    bool rememberedUsable = successfulCertIndex >= 0 && isValidCertIndex(successfulCertIndex) && rememberedCertFailureCount < 5;
+    if (rememberedUsable)
+    {
+        return false;
+    }
+
+    return discoveredServer != hostname + ":" + String(port);
+}
+
+bool AdaptiveCertManager::discoverCertificate(const String &hostname, uint16_t port)
+{
+    if (!initialized)
+    {
+        return false;
+    }
+
+    // Probe at most once per server until the next reset, even if it fails
+    discoveredServer = hostname + ":" + String(port);
+
+    uint32_t issuerHashes[DISCOVERY_MAX_CHAIN];
+    uint8_t chainLength = fetchIssuerHashes(hostname.c_str(), port, issuerHashes, DISCOVERY_MAX_CHAIN);
+    if (chainLength == 0)
+    {
+        logger.error("Certificate discovery failed, falling back to iteration");
+        return false;
+    }
+
+    // The topmost certificate's issuer is the root we need; walk down in
+    // case the server also sends the root itself or a cross-signed path
+    for (int i = chainLength - 1; i >= 0; i--)
+    {
+        int index = findCertIndexBySubjectHash(issuerHashes[i]);
+        if (index >= 0)
+        {
+            currentCertIndex = index;
+            successfulCertIndex = -1;
+            rememberedCertFailureCount = 0;
+            logger.infof("Discovered certificate: %s (index %d)", getCurrentCertName(), currentCertIndex);
+            return true;
+        }
+    }
+
+    logger.error("No bundled root matches the server chain, falling back to iteration");
+    return false;
+}
+
+uint8_t AdaptiveCertManager::fetchIssuerHashes(const char *hostname, uint16_t port, uint32_t *hashes, uint8_t maxHashes)
+{
+    mbedtls_net_context server;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config config;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctrDrbg;
+
+    mbedtls_net_init(&server);
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&config);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&ctrDrbg);
+
+    uint8_t count = 0;
+    char portString[6];
+    snprintf(portString, sizeof(portString), "%u", port);
+
+    int ret = mbedtls_ctr_drbg_seed(&ctrDrbg, mbedtls_entropy_func, &entropy, nullptr, 0);
+    if (ret == 0)
+    {
+        ret = mbedtls_ssl_config_defaults(&config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (ret == 0)
+    {
+        // Only the presented chain is of interest here; the real connection
+        // verifies it against the root selected from it
+        mbedtls_ssl_conf_authmode(&config, MBEDTLS_SSL_VERIFY_NONE);
+        mbedtls_ssl_conf_rng(&config, mbedtls_ctr_drbg_random, &ctrDrbg);
+        mbedtls_ssl_conf_read_timeout(&config, DISCOVERY_TIMEOUT_MS);
+        ret = mbedtls_ssl_setup(&ssl, &config);
+    }
+    if (ret == 0)
+    {
+        ret = mbedtls_ssl_set_hostname(&ssl, hostname);
+    }
+    if (ret == 0)
+    {
+        ret = mbedtls_net_connect(&server, hostname, portString, MBEDTLS_NET_PROTO_TCP);
+    }
+    if (ret == 0)
+    {
+        mbedtls_ssl_set_bio(&ssl, &server, mbedtls_net_send, nullptr, mbedtls_net_recv_timeout);
+        while ((ret = mbedtls_ssl_handshake(&ssl)) == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            yield();
+        }
+    }
+
+    if (ret != 0)
+    {
+        logger.errorf("Discovery handshake with %s:%u failed: -0x%04x", hostname, port, (unsigned int)-ret);
+    }
+    else
+    {
+        for (const mbedtls_x509_crt *cert = mbedtls_ssl_get_peer_cert(&ssl); cert != nullptr && count < maxHashes; cert = cert->next)
+        {
+            uint8_t digest[32];
+            mbedtls_sha256_ret(cert->issuer_raw.p, cert->issuer_raw.len, digest, 0);
+            hashes[count++] = ((uint32_t)digest[0] << 24) | ((uint32_t)digest[1] << 16) | ((uint32_t)digest[2] << 8) | digest[3];
+        }
+        logger.infof("Discovery fetched %u certificate(s) from %s:%u", count, hostname, port);
+        mbedtls_ssl_close_notify(&ssl);
+    }
+
+    mbedtls_net_free(&server);
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_config_free(&config);
+    mbedtls_ctr_drbg_free(&ctrDrbg);
+    mbedtls_entropy_free(&entropy);
+
+    return count;
+}
+
+bool AdaptiveCertManager::getCertificateDer(int index, const uint8_t **certDer, size_t *certLength) const
+{
+    if (!isValidCertIndex(index) || !certDer || !certLength)
+    {
+        return false;
+    }
+
+    *certDer = ca_bundle_der + pgm_read_dword(&ca_certificates[index].derOffset);
+    *certLength = pgm_read_word(&ca_certificates[index].derLength);
+    return true;
+}
+
+int AdaptiveCertManager::findCertIndexBySubjectHash(uint32_t hash) const
+{
+    // ca_subject_hashes is sorted by hash (see build_individual_ca_certs.py)
+    int low = 0;
+    int high = CA_CERT_COUNT - 1;
+    while (low <= high)
+    {
+        int mid = low + (high - low) / 2;
+        uint32_t midHash = pgm_read_dword(&ca_subject_hashes[mid].hash);
+        if (midHash == hash)
+        {
+            return pgm_read_word(&ca_subject_hashes[mid].certIndex);
+        }
+        if (midHash < hash)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
 void AdaptiveCertManager::markSuccess()
 {
     if (!initialized)
@@ -188,6 +355,7 @@ void AdaptiveCertManager::reset()
     currentCertIndex = 0;
     successfulCertIndex = -1;
     rememberedCertFailureCount = 0;
+    discoveredServer = "";
     preferences.remove(PREF_SUCCESSFUL_CERT);
     logger.info("Reset to first certificate");
 }
@@ -15,9 +15,24 @@ public:
     // Initialize the certificate manager
     bool begin();
 
-    // Get certificate data and name
-    bool getCertificate(const char **certData);
-    bool getCertificate(const char **certData, const char **certName);
+    // Get the current certificate as DER (points into flash, no copy) and name
+    bool getCertificate(const uint8_t **certDer, size_t *certLength);
+    bool getCertificate(const uint8_t **certDer, size_t *certLength, const char **certName);
+
+    // Zero-copy access to any bundled root
+    bool getCertificateDer(int index, const uint8_t **certDer, size_t *certLength) const;
+
+    // Index of the bundled root whose DER subject hashes to hash, or -1
+    int findCertIndexBySubjectHash(uint32_t hash) const;
+
+    // Whether connecting to hostname:port should first discover the CA.
+    // True when there is no usable remembered certificate and this server
+    // has not been probed since the last reset.
+    bool needsDiscovery(const String &hostname, uint16_t port) const;
+
+    // Fetch the server's chain once (without verification) and select the
+    // root whose subject matches an issuer in that chain
+    bool discoverCertificate(const String &hostname, uint16_t port);
 
     // Mark current certificate as successful
     void markSuccess();
@@ -38,16 +53,21 @@ private:
     int successfulCertIndex;
     bool initialized;
     int rememberedCertFailureCount;
+    String discoveredServer;
     mutable Logger logger;
 
     // Preference keys
     static const char *PREF_NAMESPACE;
     static const char *PREF_SUCCESSFUL_CERT;
 
+    static const uint8_t DISCOVERY_MAX_CHAIN = 6;
+    static const uint32_t DISCOVERY_TIMEOUT_MS = 5000;
+
     // Internal methods
     void loadSuccessfulCertIndexFromPreferences();
     void saveSuccessfulCertIndexToPreferences(int certIndex);
     bool isValidCertIndex(int index) const;
+    uint8_t fetchIssuerHashes(const char *hostname, uint16_t port, uint32_t *hashes, uint8_t maxHashes);
 };
 
 // Global instance
@@ -0,0 +1,137 @@
+#include "outgoingBatcher.hpp"
+
+bool OutgoingBatcher::drain(uint8_t maxFrames)
+{
+    for (uint8_t frame = 0; frame < maxFrames; frame++)
+    {
+        State::WebsocketMessage message;
+        if (!this->takeMessage(message))
+        {
+            return true;
+        }
+
+        bool sent;
+        if (this->batching)
+        {
+            sent = this->sendBatch(message);
+        }
+        else
+        {
+            sent = this->sender.sendFrame(message.data, message.length, 1);
+            if (sent)
+            {
+                this->recordQueueLatency(message.queuedAtUs);
+            }
+            State::releaseOutgoingWebsocketMessage(message);
+        }
+
+        if (!sent)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OutgoingBatcher::takeMessage(State::WebsocketMessage &message)
+{
+    if (this->deferred.data != nullptr)
+    {
+        message = this->deferred;
+        this->deferred = {nullptr, 0, 0};
+        return true;
+    }
+
+    return State::getNextOutgoingWebsocketMessage(message);
+}
+
+bool OutgoingBatcher::sendBatch(const State::WebsocketMessage &first)
+{
+    // MessagePack needs no separators; its fixarray header (0x90 | count,
+    // MAX_BATCH_MESSAGES < 16) is the last prefix byte and patched at the end.
+    static const char jsonPrefix[] = "{\"event\":\"BATCH\",\"data\":[";
+    static const char jsonSuffix[] = "]}";
+    static const char msgPackPrefix[] = "\x82\xa5"
+                                        "event"
+                                        "\xa5"
+                                        "BATCH"
+                                        "\xa4"
+                                        "data"
+                                        "\x90";
+
+    bool json = isJsonMessage(first.data);
+    const char *prefix = json ? jsonPrefix : msgPackPrefix;
+    size_t prefixLength = json ? sizeof(jsonPrefix) - 1 : sizeof(msgPackPrefix) - 1;
+    size_t suffixLength = json ? sizeof(jsonSuffix) - 1 : 0;
+    size_t separatorLength = json ? 1 : 0;
+
+    // A lone message goes out as is, so the envelope only costs when it saves frames
+    State::WebsocketMessage next;
+    if (prefixLength + first.length + suffixLength > BATCH_BUFFER_SIZE || !this->takeMessage(next))
+    {
+        bool sent = this->sender.sendFrame(first.data, first.length, 1);
+        if (sent)
+        {
+            this->recordQueueLatency(first.queuedAtUs);
+        }
+        State::releaseOutgoingWebsocketMessage(first);
+        return sent;
+    }
+
+    uint32_t queuedAtUs[MAX_BATCH_MESSAGES];
+    size_t length = prefixLength;
+    memcpy(this->batchBuffer, prefix, length);
+    memcpy(this->batchBuffer + length, first.data, first.length);
+    length += first.length;
+    queuedAtUs[0] = first.queuedAtUs;
+    State::releaseOutgoingWebsocketMessage(first);
+    uint8_t count = 1;
+
+    do
+    {
+        bool sameEncoding = isJsonMessage(next.data) == json;
+        if (!sameEncoding || count == MAX_BATCH_MESSAGES || length + separatorLength + next.length + suffixLength > BATCH_BUFFER_SIZE)
+        {
+            // Goes first into the next frame
+            this->deferred = next;
+            break;
+        }
+
+        if (json)
+        {
+            this->batchBuffer[length++] = ',';
+        }
+        memcpy(this->batchBuffer + length, next.data, next.length);
+        length += next.length;
+        queuedAtUs[count] = next.queuedAtUs;
+        State::releaseOutgoingWebsocketMessage(next);
+        count++;
+    } while (this->takeMessage(next));
+
+    if (json)
+    {
+        memcpy(this->batchBuffer + length, jsonSuffix, suffixLength);
+        length += suffixLength;
+    }
+    else
+    {
+        this->batchBuffer[prefixLength - 1] = (char)(0x90 | count);
+    }
+
+    if (!this->sender.sendFrame(this->batchBuffer, length, count))
+    {
+        return false;
+    }
+
+    this->batchesSent++;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        this->recordQueueLatency(queuedAtUs[i]);
+    }
+    return true;
+}
+
+void OutgoingBatcher::recordQueueLatency(uint32_t queuedAtUs)
+{
+    this->queueLatency.record((micros() - queuedAtUs) / 1000);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../state/state.hpp"
+#include "../metrics/latencyHistogram.hpp"
+
+// Drains the outgoing State ring into websocket frames. Once the server
+// announced support for it, consecutive messages are coalesced into one
+// {"event":"BATCH","data":[...]} frame in the encoding of the batched
+// messages; a lone message still goes out as is.
+//
+// Owned by the websocket task; only the stats may be read from elsewhere.
+class OutgoingBatcher
+{
+public:
+    // Where the frames go, the websocket client on the reader
+    class FrameSender
+    {
+    public:
+        /*
+         *  Send one frame
+         *  @param messages: queued messages the frame carries
+         *  @return false if it was not sent
+         */
+        virtual bool sendFrame(const char *data, size_t length, uint8_t messages) = 0;
+
+    protected:
+        ~FrameSender() = default;
+    };
+
+    static const uint8_t MAX_BATCH_MESSAGES = 8;
+    static const size_t BATCH_BUFFER_SIZE = 1024;
+
+    explicit OutgoingBatcher(FrameSender &sender) : sender(sender) {}
+
+    void setBatching(bool enabled) { this->batching = enabled; }
+    bool isBatching() const { return this->batching; }
+
+    /*
+     *  Send what queued up since the last call
+     *  @param maxFrames: bound on the frames sent, so a long backlog does not starve the caller
+     *  @return false if a send failed
+     */
+    bool drain(uint8_t maxFrames);
+
+    uint32_t getBatchesSent() const { return this->batchesSent; }
+
+    // Commit of a message to the send of the frame carrying it
+    LatencyHistogram::Snapshot getQueueLatency() const { return this->queueLatency.snapshot(); }
+
+private:
+    FrameSender &sender;
+    bool batching = false;
+
+    // Taken from the ring but left for the next frame
+    State::WebsocketMessage deferred = {nullptr, 0, 0};
+    char batchBuffer[BATCH_BUFFER_SIZE];
+
+    uint32_t batchesSent = 0;
+    LatencyHistogram queueLatency;
+
+    bool takeMessage(State::WebsocketMessage &message);
+    bool sendBatch(const State::WebsocketMessage &first);
+    void recordQueueLatency(uint32_t queuedAtUs);
+
+    // Outgoing records are JSON objects or MessagePack maps (never '{')
+    static bool isJsonMessage(const char *data) { return data[0] == '{'; }
+};
@@ -0,0 +1,119 @@
+#include "reconnectBackoff.hpp"
+
+ReconnectBackoff::ReconnectBackoff(uint32_t initialDelayMs, uint32_t maxDelayMs, uint32_t stableAfterMs)
+    : initialDelayMs(initialDelayMs), maxDelayMs(maxDelayMs), stableAfterMs(stableAfterMs)
+{
+}
+
+bool ReconnectBackoff::isAttemptDue(uint32_t nowMs) const
+{
+    if (this->attemptInFlight || this->connected)
+    {
+        return false;
+    }
+
+    // Nothing scheduled yet; nextAttemptAt is only meaningful after a failure
+    if (this->stats.consecutiveFailures == 0)
+    {
+        return true;
+    }
+
+    // Wrap-safe comparison of millisecond timestamps
+    return (int32_t)(nowMs - this->nextAttemptAt) >= 0;
+}
+
+uint32_t ReconnectBackoff::msUntilNextAttempt(uint32_t nowMs) const
+{
+    if (this->attemptInFlight || this->connected || this->stats.consecutiveFailures == 0)
+    {
+        return 0;
+    }
+
+    int32_t remaining = (int32_t)(this->nextAttemptAt - nowMs);
+    return remaining > 0 ? (uint32_t)remaining : 0;
+}
+
+void ReconnectBackoff::beginAttempt()
+{
+    this->attemptInFlight = true;
+    this->connected = false;
+    this->stats.attempts++;
+}
+
+void ReconnectBackoff::onConnected(uint32_t nowMs)
+{
+    this->attemptInFlight = false;
+    this->connected = true;
+    this->connectedAt = nowMs;
+    this->stats.connects++;
+}
+
+uint32_t ReconnectBackoff::onConnectionLost(uint32_t nowMs, uint32_t randomValue)
+{
+    if (!this->attemptInFlight && !this->connected)
+    {
+        return this->msUntilNextAttempt(nowMs);
+    }
+
+    if (this->connected)
+    {
+        uint32_t uptime = nowMs - this->connectedAt;
+        this->stats.totalUptimeMs += uptime;
+        if (uptime > this->stats.longestUptimeMs)
+        {
+            this->stats.longestUptimeMs = uptime;
+        }
+
+        if (uptime >= this->stableAfterMs)
+        {
+            this->stats.consecutiveFailures = 0;
+        }
+    }
+
+    this->attemptInFlight = false;
+    this->connected = false;
+    this->stats.failures++;
+    this->stats.consecutiveFailures++;
+
+    uint32_t delay = delayForFailure(this->stats.consecutiveFailures, this->initialDelayMs, this->maxDelayMs, randomValue);
+    this->stats.lastDelayMs = delay;
+    this->nextAttemptAt = nowMs + delay;
+    return delay;
+}
+
+void ReconnectBackoff::reset()
+{
+    this->stats.consecutiveFailures = 0;
+    this->stats.lastDelayMs = 0;
+    this->attemptInFlight = false;
+    this->connected = false;
+    this->nextAttemptAt = 0;
+}
+
+ReconnectBackoff::Stats ReconnectBackoff::getStats(uint32_t nowMs) const
+{
+    Stats snapshot = this->stats;
+    snapshot.currentUptimeMs = this->connected ? nowMs - this->connectedAt : 0;
+    return snapshot;
+}
+
+uint32_t ReconnectBackoff::delayForFailure(uint32_t consecutiveFailures, uint32_t initialDelayMs, uint32_t maxDelayMs, uint32_t randomValue)
+{
+    if (consecutiveFailures <= 1)
+    {
+        return 0;
+    }
+
+    uint32_t cap = initialDelayMs;
+    for (uint32_t i = 2; i < consecutiveFailures && cap < maxDelayMs; i++)
+    {
+        cap *= 2;
+    }
+    if (cap > maxDelayMs)
+    {
+        cap = maxDelayMs;
+    }
+
+    uint32_t half = cap / 2;
+    return half + randomValue % (cap - half + 1);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+
+// Reconnect scheduler for the websocket connection. The first retry after a
+// failure is immediate; later ones wait a capped exponential delay with
+// "equal jitter" (half fixed, half random) so a fleet of readers does not
+// reconnect in lockstep after a server restart. A connection that stayed up
+// for stableAfterMs resets the schedule.
+//
+// Plain logic without FreeRTOS/Arduino dependencies; callers pass the time
+// and a random value and take care of locking.
+class ReconnectBackoff
+{
+public:
+    struct Stats
+    {
+        uint32_t attempts;
+        uint32_t failures;
+        uint32_t consecutiveFailures;
+        uint32_t lastDelayMs;
+        uint32_t connects;
+        uint32_t currentUptimeMs;
+        uint32_t longestUptimeMs;
+        uint64_t totalUptimeMs;
+    };
+
+    ReconnectBackoff(uint32_t initialDelayMs, uint32_t maxDelayMs, uint32_t stableAfterMs);
+
+    /*
+     *  Whether a new connection attempt may be started now
+     *  @param nowMs: current time in milliseconds
+     */
+    bool isAttemptDue(uint32_t nowMs) const;
+
+    /*
+     *  Milliseconds until the next attempt is due (0 if due or in flight)
+     */
+    uint32_t msUntilNextAttempt(uint32_t nowMs) const;
+
+    void beginAttempt();
+    void onConnected(uint32_t nowMs);
+
+    /*
+     *  Handle a failed attempt or a dropped connection. Repeated reports for
+     *  the same loss (error + disconnect events) are ignored.
+     *  @param nowMs: current time in milliseconds
+     *  @param randomValue: uniformly distributed random number for the jitter
+     *  @return the delay until the next attempt in milliseconds
+     */
+    uint32_t onConnectionLost(uint32_t nowMs, uint32_t randomValue);
+
+    // Forget the failure history, e.g. after the server changed
+    void reset();
+
+    Stats getStats(uint32_t nowMs) const;
+
+    /*
+     *  Delay before retry number consecutiveFailures (1 = first retry)
+     */
+    static uint32_t delayForFailure(uint32_t consecutiveFailures, uint32_t initialDelayMs, uint32_t maxDelayMs, uint32_t randomValue);
+
+private:
+    uint32_t initialDelayMs;
+    uint32_t maxDelayMs;
+    uint32_t stableAfterMs;
+
+    bool attemptInFlight = false;
+    bool connected = false;
+    uint32_t connectedAt = 0;
+    uint32_t nextAttemptAt = 0;
+    Stats stats = {};
+};
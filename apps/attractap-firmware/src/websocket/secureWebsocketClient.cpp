@@ -0,0 +1,423 @@
+#include "secureWebsocketClient.hpp"
+#include <strings.h>
+#include "mbedtls/base64.h"
+#include "mbedtls/sha1.h"
+
+SecureWebsocketClient::SecureWebsocketClient(TlsSessionCache &sessions)
+    : connection(sessions), logger("SecureWebsocketClient")
+{
+    this->lock = xSemaphoreCreateMutex();
+    this->taskDone = xSemaphoreCreateBinary();
+}
+
+SecureWebsocketClient::~SecureWebsocketClient()
+{
+    this->stop();
+    vSemaphoreDelete(this->lock);
+    vSemaphoreDelete(this->taskDone);
+}
+
+void SecureWebsocketClient::registerEvents(esp_event_handler_t handler, void *context)
+{
+    this->handler = handler;
+    this->handlerContext = context;
+}
+
+bool SecureWebsocketClient::start(const String &hostname, uint16_t port, const char *path, const uint8_t *caDer, size_t caLength)
+{
+    this->stop();
+
+    this->hostname = hostname;
+    this->port = port;
+    this->path = path;
+    this->caDer = caDer;
+    this->caLength = caLength;
+    this->stopRequested = false;
+
+    if (xTaskCreate(taskFn, "SecureWebsocket", TASK_STACK_SIZE, this, TASK_PRIORITY_WEBSOCKET_CLIENT, &this->task) != pdPASS)
+    {
+        this->task = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void SecureWebsocketClient::stop()
+{
+    if (this->task == nullptr)
+    {
+        return;
+    }
+
+    this->stopRequested = true;
+    xSemaphoreTake(this->taskDone, portMAX_DELAY);
+    this->task = nullptr;
+}
+
+int SecureWebsocketClient::sendText(const char *data, size_t length, uint32_t timeoutMs)
+{
+    if (!this->upgraded || !this->sendFrame(OPCODE_TEXT, (const uint8_t *)data, length, timeoutMs))
+    {
+        return -1;
+    }
+    return length;
+}
+
+int SecureWebsocketClient::sendBinary(const char *data, size_t length, uint32_t timeoutMs)
+{
+    if (!this->upgraded || !this->sendFrame(OPCODE_BINARY, (const uint8_t *)data, length, timeoutMs))
+    {
+        return -1;
+    }
+    return length;
+}
+
+void SecureWebsocketClient::taskFn(void *parameter)
+{
+    SecureWebsocketClient *client = (SecureWebsocketClient *)parameter;
+    client->run();
+    xSemaphoreGive(client->taskDone);
+    vTaskDelete(NULL);
+}
+
+void SecureWebsocketClient::run()
+{
+    this->rxStart = 0;
+    this->rxEnd = 0;
+
+    if (!this->connection.connect(this->hostname.c_str(), this->port, this->caDer, this->caLength, NETWORK_TIMEOUT_MS) || !this->upgrade())
+    {
+        this->connection.close();
+        if (!this->stopRequested)
+        {
+            this->dispatch(WEBSOCKET_EVENT_DISCONNECTED);
+        }
+        return;
+    }
+
+    this->upgraded = true;
+    this->dispatch(WEBSOCKET_EVENT_CONNECTED);
+
+    bool closed = false;
+    while (!this->stopRequested && !closed)
+    {
+        if (!this->receiveFrame(closed))
+        {
+            break;
+        }
+    }
+    this->upgraded = false;
+
+    if (this->stopRequested)
+    {
+        // 1000, normal closure
+        const uint8_t status[2] = {0x03, 0xE8};
+        this->sendFrame(OPCODE_CLOSE, status, sizeof(status), POLL_INTERVAL_MS);
+    }
+
+    xSemaphoreTake(this->lock, portMAX_DELAY);
+    this->connection.close();
+    xSemaphoreGive(this->lock);
+
+    if (!this->stopRequested)
+    {
+        this->dispatch(closed ? WEBSOCKET_EVENT_CLOSED : WEBSOCKET_EVENT_DISCONNECTED);
+    }
+}
+
+bool SecureWebsocketClient::upgrade()
+{
+    // Sec-WebSocket-Key: 16 random bytes, base64
+    uint8_t nonce[16];
+    for (size_t i = 0; i < sizeof(nonce); i += 4)
+    {
+        uint32_t random = esp_random();
+        memcpy(nonce + i, &random, 4);
+    }
+    unsigned char key[25];
+    size_t keyLength = 0;
+    mbedtls_base64_encode(key, sizeof(key), &keyLength, nonce, sizeof(nonce));
+
+    char request[384];
+    int requestLength = snprintf(request, sizeof(request),
+                                 "GET %s HTTP/1.1\r\n"
+                                 "Host: %s:%u\r\n"
+                                 "Upgrade: websocket\r\n"
+                                 "Connection: Upgrade\r\n"
+                                 "Sec-WebSocket-Key: %s\r\n"
+                                 "Sec-WebSocket-Version: 13\r\n"
+                                 "\r\n",
+                                 this->path.c_str(), this->hostname.c_str(), this->port, (const char *)key);
+    if (requestLength <= 0 || (size_t)requestLength >= sizeof(request))
+    {
+        logger.error("Upgrade request too long");
+        return false;
+    }
+
+    xSemaphoreTake(this->lock, portMAX_DELAY);
+    bool sent = this->connection.write((const uint8_t *)request, requestLength, NETWORK_TIMEOUT_MS);
+    xSemaphoreGive(this->lock);
+    if (!sent)
+    {
+        return false;
+    }
+
+    // The server's first frames may arrive in the same read as the headers
+    char response[UPGRADE_RESPONSE_SIZE];
+    size_t received = 0;
+    char *headersEnd = nullptr;
+    uint32_t startedAt = millis();
+    while (headersEnd == nullptr)
+    {
+        if (this->stopRequested || received == sizeof(response) - 1 || millis() - startedAt > NETWORK_TIMEOUT_MS)
+        {
+            logger.error("No upgrade response");
+            return false;
+        }
+
+        int length = this->readLocked((uint8_t *)response + received, sizeof(response) - 1 - received);
+        if (length < 0)
+        {
+            return false;
+        }
+        received += length;
+        response[received] = '\0';
+        headersEnd = strstr(response, "\r\n\r\n");
+    }
+
+    if (strncmp(response, "HTTP/1.1 101", 12) != 0)
+    {
+        logger.errorf("Upgrade refused: %.*s", (int)(strchr(response, '\r') - response), response);
+        return false;
+    }
+
+    // Sec-WebSocket-Accept: base64(SHA-1(key + GUID)), RFC 6455 4.2.2
+    char accepted[64];
+    int acceptedLength = snprintf(accepted, sizeof(accepted), "%s258EAFA5-E914-47DA-95CA-C5AB0DC85B11", (const char *)key);
+    uint8_t digest[20];
+    mbedtls_sha1_ret((const unsigned char *)accepted, acceptedLength, digest);
+    unsigned char expected[29];
+    size_t expectedLength = 0;
+    mbedtls_base64_encode(expected, sizeof(expected), &expectedLength, digest, sizeof(digest));
+
+    const char *accept = nullptr;
+    for (char *line = strstr(response, "\r\n"); line != nullptr && line < headersEnd; line = strstr(line + 2, "\r\n"))
+    {
+        if (strncasecmp(line + 2, "Sec-WebSocket-Accept:", 21) == 0)
+        {
+            accept = line + 2 + 21;
+            break;
+        }
+    }
+    while (accept != nullptr && *accept == ' ')
+    {
+        accept++;
+    }
+    if (accept == nullptr || strncmp(accept, (const char *)expected, expectedLength) != 0)
+    {
+        logger.error("Upgrade response without a matching Sec-WebSocket-Accept");
+        return false;
+    }
+
+    size_t headersLength = headersEnd + 4 - response;
+    this->rxEnd = received - headersLength;
+    memcpy(this->rxBuffer, response + headersLength, this->rxEnd);
+    this->rxStart = 0;
+    return true;
+}
+
+bool SecureWebsocketClient::receiveFrame(bool &closed)
+{
+    uint8_t header[2];
+    if (!this->readExactly(header, sizeof(header)))
+    {
+        return false;
+    }
+
+    uint8_t opcode = header[0] & 0x0F;
+    bool masked = header[1] & 0x80;
+    uint64_t payloadLength = header[1] & 0x7F;
+    if (payloadLength >= 126)
+    {
+        uint8_t extended[8];
+        size_t extendedLength = payloadLength == 126 ? 2 : 8;
+        if (!this->readExactly(extended, extendedLength))
+        {
+            return false;
+        }
+        payloadLength = 0;
+        for (size_t i = 0; i < extendedLength; i++)
+        {
+            payloadLength = (payloadLength << 8) | extended[i];
+        }
+    }
+
+    // Servers do not mask, but unmask if one does
+    uint8_t mask[4] = {};
+    if (masked && !this->readExactly(mask, sizeof(mask)))
+    {
+        return false;
+    }
+
+    // The event fields are ints
+    if (payloadLength > INT32_MAX)
+    {
+        logger.errorf("Dropping the connection, frame of %llu bytes", (unsigned long long)payloadLength);
+        return false;
+    }
+
+    // Handed to the handler in parts of up to RX_BUFFER_SIZE, at their offset
+    // in the payload, like esp_websocket_client does
+    size_t offset = 0;
+    do
+    {
+        size_t length = payloadLength - offset < sizeof(this->payload) ? payloadLength - offset : sizeof(this->payload);
+        if (!this->readExactly(this->payload, length))
+        {
+            return false;
+        }
+        if (masked)
+        {
+            for (size_t i = 0; i < length; i++)
+            {
+                this->payload[i] ^= mask[(offset + i) % 4];
+            }
+        }
+
+        if (opcode == OPCODE_PING)
+        {
+            // Control frames carry at most 125 bytes, so this is all of it
+            this->sendFrame(OPCODE_PONG, this->payload, length, NETWORK_TIMEOUT_MS);
+        }
+        else if (opcode == OPCODE_CLOSE)
+        {
+            // Echo the status code, the server then closes the connection
+            closed = true;
+            this->sendFrame(OPCODE_CLOSE, this->payload, length < 2 ? length : 2, POLL_INTERVAL_MS);
+        }
+
+        this->dispatch(WEBSOCKET_EVENT_DATA, opcode, this->payload, length, payloadLength, offset);
+        offset += length;
+    } while (offset < payloadLength);
+
+    return true;
+}
+
+bool SecureWebsocketClient::readExactly(uint8_t *data, size_t length)
+{
+    while (length > 0)
+    {
+        if (this->rxStart < this->rxEnd)
+        {
+            size_t available = this->rxEnd - this->rxStart;
+            size_t count = length < available ? length : available;
+            memcpy(data, this->rxBuffer + this->rxStart, count);
+            this->rxStart += count;
+            data += count;
+            length -= count;
+            continue;
+        }
+
+        if (this->stopRequested)
+        {
+            return false;
+        }
+
+        int received = this->readLocked(this->rxBuffer, sizeof(this->rxBuffer));
+        if (received < 0)
+        {
+            return false;
+        }
+        this->rxStart = 0;
+        this->rxEnd = received;
+    }
+    return true;
+}
+
+int SecureWebsocketClient::readLocked(uint8_t *data, size_t length)
+{
+    // Wait without the lock, so sends are not held up by an idle connection
+    if (!this->connection.waitReadable(POLL_INTERVAL_MS))
+    {
+        return 0;
+    }
+
+    xSemaphoreTake(this->lock, portMAX_DELAY);
+    int received = this->connection.read(data, length, POLL_INTERVAL_MS);
+    xSemaphoreGive(this->lock);
+    return received;
+}
+
+bool SecureWebsocketClient::sendFrame(uint8_t opcode, const uint8_t *data, size_t length, uint32_t timeoutMs)
+{
+    // Header and the start of the payload go out in one TLS record
+    uint8_t buffer[TX_BUFFER_SIZE];
+    size_t used = 0;
+    buffer[used++] = 0x80 | opcode; // FIN, never fragmented
+    if (length < 126)
+    {
+        buffer[used++] = 0x80 | length;
+    }
+    else if (length <= 0xFFFF)
+    {
+        buffer[used++] = 0x80 | 126;
+        buffer[used++] = length >> 8;
+        buffer[used++] = length & 0xFF;
+    }
+    else
+    {
+        buffer[used++] = 0x80 | 127;
+        for (int shift = 56; shift >= 0; shift -= 8)
+        {
+            buffer[used++] = ((uint64_t)length >> shift) & 0xFF;
+        }
+    }
+
+    // Client frames are masked, RFC 6455 5.3
+    uint8_t mask[4];
+    uint32_t random = esp_random();
+    memcpy(mask, &random, sizeof(mask));
+    memcpy(buffer + used, mask, sizeof(mask));
+    used += sizeof(mask);
+
+    if (xSemaphoreTake(this->lock, pdMS_TO_TICKS(timeoutMs)) != pdTRUE)
+    {
+        return false;
+    }
+
+    bool sent = true;
+    for (size_t offset = 0; sent && offset < length;)
+    {
+        size_t count = length - offset < sizeof(buffer) - used ? length - offset : sizeof(buffer) - used;
+        for (size_t i = 0; i < count; i++)
+        {
+            buffer[used + i] = data[offset + i] ^ mask[(offset + i) % 4];
+        }
+        sent = this->connection.write(buffer, used + count, timeoutMs);
+        offset += count;
+        used = 0;
+    }
+    if (length == 0)
+    {
+        sent = this->connection.write(buffer, used, timeoutMs);
+    }
+
+    xSemaphoreGive(this->lock);
+    return sent;
+}
+
+void SecureWebsocketClient::dispatch(int32_t event, uint8_t opcode, const uint8_t *data, size_t dataLength, size_t payloadLength, size_t payloadOffset)
+{
+    if (this->handler == nullptr)
+    {
+        return;
+    }
+
+    esp_websocket_event_data_t eventData = {};
+    eventData.data_ptr = (const char *)data;
+    eventData.data_len = dataLength;
+    eventData.op_code = opcode;
+    eventData.payload_len = payloadLength;
+    eventData.payload_offset = payloadOffset;
+    this->handler(this->handlerContext, WEBSOCKET_EVENTS, event, &eventData);
+}
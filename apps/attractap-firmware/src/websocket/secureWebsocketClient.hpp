@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Arduino.h>
+#include "esp_websocket_client.h"
+#include "freertos/semphr.h"
+#include "task_priorities.h"
+#include "tlsConnection.hpp"
+#include "../logger/logger.hpp"
+
+// wss:// client on TlsConnection, so reconnects can resume the last TLS
+// session: esp_websocket_client builds its esp-tls transport internally and
+// has no way to hand a saved session in.
+//
+// Like esp_websocket_client it runs the connection in a task of its own and
+// reports through the same events (WEBSOCKET_EVENT_*, with an
+// esp_websocket_event_data_t per frame or part of one), so Websocket handles
+// both clients alike. It sends no pings, the application heartbeat probes the
+// connection.
+class SecureWebsocketClient
+{
+public:
+    explicit SecureWebsocketClient(TlsSessionCache &sessions);
+    ~SecureWebsocketClient();
+
+    void registerEvents(esp_event_handler_t handler, void *context);
+
+    /*
+     *  Connect from the client task, WEBSOCKET_EVENT_CONNECTED follows once
+     *  the upgrade went through, WEBSOCKET_EVENT_DISCONNECTED if it did not
+     *  @param caDer: root the server is verified against, kept until the next start
+     */
+    bool start(const String &hostname, uint16_t port, const char *path, const uint8_t *caDer, size_t caLength);
+
+    // Close the connection and end the task, without an event. Waits for a
+    // connect in progress, so not from the event handler.
+    void stop();
+
+    // Bytes sent or -1, like esp_websocket_client_send_text/_bin
+    int sendText(const char *data, size_t length, uint32_t timeoutMs);
+    int sendBinary(const char *data, size_t length, uint32_t timeoutMs);
+
+    bool isConnected() const { return this->upgraded; }
+    // Whether the current connection resumed a TLS session
+    bool wasResumed() const { return this->connection.wasResumed(); }
+
+private:
+    static const uint32_t NETWORK_TIMEOUT_MS = 10000;
+    // How often the task looks for a stop while waiting for data
+    static const uint32_t POLL_INTERVAL_MS = 100;
+    static const uint32_t TASK_STACK_SIZE = 8192;
+    static const size_t RX_BUFFER_SIZE = 1024;
+    static const size_t TX_BUFFER_SIZE = 512;
+    static const size_t UPGRADE_RESPONSE_SIZE = 512;
+
+    static const uint8_t OPCODE_TEXT = 0x1;
+    static const uint8_t OPCODE_BINARY = 0x2;
+    static const uint8_t OPCODE_CLOSE = 0x8;
+    static const uint8_t OPCODE_PING = 0x9;
+    static const uint8_t OPCODE_PONG = 0xA;
+
+    TlsConnection connection;
+    Logger logger;
+
+    // Serializes reads of the client task and sends of the caller
+    SemaphoreHandle_t lock;
+    // Given by the task as it ends
+    SemaphoreHandle_t taskDone;
+    TaskHandle_t task = nullptr;
+    volatile bool stopRequested = false;
+    volatile bool upgraded = false;
+
+    esp_event_handler_t handler = nullptr;
+    void *handlerContext = nullptr;
+
+    String hostname;
+    uint16_t port = 0;
+    String path;
+    const uint8_t *caDer = nullptr;
+    size_t caLength = 0;
+
+    // Read ahead from the connection, and the payload handed to the handler
+    uint8_t rxBuffer[RX_BUFFER_SIZE];
+    size_t rxStart = 0;
+    size_t rxEnd = 0;
+    uint8_t payload[RX_BUFFER_SIZE];
+
+    static void taskFn(void *parameter);
+    void run();
+    bool upgrade();
+    bool receiveFrame(bool &closed);
+    bool readExactly(uint8_t *data, size_t length);
+    int readLocked(uint8_t *data, size_t length);
+    bool sendFrame(uint8_t opcode, const uint8_t *data, size_t length, uint32_t timeoutMs);
+    void dispatch(int32_t event, uint8_t opcode = 0, const uint8_t *data = nullptr, size_t dataLength = 0, size_t payloadLength = 0, size_t payloadOffset = 0);
+};
@@ -0,0 +1,203 @@
+#include "tlsConnection.hpp"
+#include <sys/socket.h>
+#include <sys/time.h>
+
+TlsConnection::TlsConnection(TlsSessionCache &sessions) : sessions(sessions), logger("TlsConnection")
+{
+    this->init();
+}
+
+TlsConnection::~TlsConnection()
+{
+    this->close();
+    this->release();
+}
+
+bool TlsConnection::connect(const char *hostname, uint16_t port, const uint8_t *caDer, size_t caLength, uint32_t timeoutMs)
+{
+    this->close();
+    this->resumed = false;
+    this->handshakeMs = 0;
+    this->lastError = 0;
+
+    char portString[6];
+    snprintf(portString, sizeof(portString), "%u", port);
+
+    int ret = mbedtls_ctr_drbg_seed(&this->ctrDrbg, mbedtls_entropy_func, &this->entropy, nullptr, 0);
+    if (ret != 0)
+    {
+        return this->fail("seed", hostname, port, ret);
+    }
+
+    ret = mbedtls_x509_crt_parse_der(&this->ca, caDer, caLength);
+    if (ret != 0)
+    {
+        return this->fail("CA", hostname, port, ret);
+    }
+
+    ret = mbedtls_ssl_config_defaults(&this->config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if (ret != 0)
+    {
+        return this->fail("config", hostname, port, ret);
+    }
+    mbedtls_ssl_conf_authmode(&this->config, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&this->config, &this->ca, nullptr);
+    mbedtls_ssl_conf_rng(&this->config, mbedtls_ctr_drbg_random, &this->ctrDrbg);
+    mbedtls_ssl_conf_read_timeout(&this->config, timeoutMs);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&this->config, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+    ret = mbedtls_ssl_setup(&this->ssl, &this->config);
+    if (ret == 0)
+    {
+        ret = mbedtls_ssl_set_hostname(&this->ssl, hostname);
+    }
+    if (ret != 0)
+    {
+        return this->fail("setup", hostname, port, ret);
+    }
+
+    ret = mbedtls_net_connect(&this->net, hostname, portString, MBEDTLS_NET_PROTO_TCP);
+    if (ret != 0)
+    {
+        return this->fail("connect", hostname, port, ret);
+    }
+    this->setSendTimeout(timeoutMs);
+    mbedtls_ssl_set_bio(&this->ssl, &this->net, mbedtls_net_send, nullptr, mbedtls_net_recv_timeout);
+
+    this->sessions.offer(&this->ssl, hostname, port);
+
+    uint32_t startedAt = millis();
+    while ((ret = mbedtls_ssl_handshake(&this->ssl)) != 0)
+    {
+        bool again = ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE;
+        if (!again || millis() - startedAt > timeoutMs)
+        {
+            this->sessions.onHandshakeFailed();
+            return this->fail("handshake", hostname, port, ret);
+        }
+        yield();
+    }
+
+    this->handshakeMs = millis() - startedAt;
+    this->resumed = this->sessions.onHandshakeDone(&this->ssl, hostname, port);
+    this->connected = true;
+    logger.infof("%s handshake with %s:%u in %lu ms", this->resumed ? "Resumed" : "Full", hostname, port, (unsigned long)this->handshakeMs);
+    return true;
+}
+
+bool TlsConnection::write(const uint8_t *data, size_t length, uint32_t timeoutMs)
+{
+    if (!this->connected)
+    {
+        return false;
+    }
+
+    this->setSendTimeout(timeoutMs);
+    uint32_t startedAt = millis();
+    while (length > 0)
+    {
+        int ret = mbedtls_ssl_write(&this->ssl, data, length);
+        if (ret > 0)
+        {
+            data += ret;
+            length -= ret;
+            continue;
+        }
+
+        bool again = ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE;
+        if (!again || millis() - startedAt > timeoutMs)
+        {
+            this->lastError = again ? MBEDTLS_ERR_SSL_TIMEOUT : ret;
+            this->connected = false;
+            return false;
+        }
+    }
+    return true;
+}
+
+int TlsConnection::read(uint8_t *data, size_t length, uint32_t timeoutMs)
+{
+    if (!this->connected)
+    {
+        return -1;
+    }
+
+    // 0 would wait forever
+    mbedtls_ssl_conf_read_timeout(&this->config, timeoutMs > 0 ? timeoutMs : 1);
+    int ret = mbedtls_ssl_read(&this->ssl, data, length);
+    if (ret > 0)
+    {
+        return ret;
+    }
+    if (ret == MBEDTLS_ERR_SSL_TIMEOUT || ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+    {
+        return 0;
+    }
+
+    // 0 or MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY when the server closed it
+    this->lastError = ret;
+    this->connected = false;
+    return -1;
+}
+
+bool TlsConnection::waitReadable(uint32_t timeoutMs)
+{
+    if (!this->connected || mbedtls_ssl_get_bytes_avail(&this->ssl) > 0)
+    {
+        return true;
+    }
+
+    // Errors count as readable, read() reports them
+    return mbedtls_net_poll(&this->net, MBEDTLS_NET_POLL_READ, timeoutMs) != 0;
+}
+
+void TlsConnection::close()
+{
+    if (this->connected)
+    {
+        mbedtls_ssl_close_notify(&this->ssl);
+        this->connected = false;
+    }
+
+    this->release();
+    this->init();
+}
+
+void TlsConnection::init()
+{
+    mbedtls_net_init(&this->net);
+    mbedtls_ssl_init(&this->ssl);
+    mbedtls_ssl_config_init(&this->config);
+    mbedtls_x509_crt_init(&this->ca);
+    mbedtls_entropy_init(&this->entropy);
+    mbedtls_ctr_drbg_init(&this->ctrDrbg);
+}
+
+void TlsConnection::release()
+{
+    mbedtls_net_free(&this->net);
+    mbedtls_ssl_free(&this->ssl);
+    mbedtls_ssl_config_free(&this->config);
+    mbedtls_x509_crt_free(&this->ca);
+    mbedtls_ctr_drbg_free(&this->ctrDrbg);
+    mbedtls_entropy_free(&this->entropy);
+}
+
+bool TlsConnection::fail(const char *step, const char *hostname, uint16_t port, int error)
+{
+    logger.errorf("TLS %s for %s:%u failed: -0x%04x", step, hostname, port, (unsigned int)-error);
+    this->lastError = error;
+    this->close();
+    return false;
+}
+
+void TlsConnection::setSendTimeout(uint32_t timeoutMs)
+{
+    // mbedtls_net_send blocks for as long as the server's window stays closed
+    struct timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    setsockopt(this->net.fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
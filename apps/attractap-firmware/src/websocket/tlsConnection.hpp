@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+#include "tlsSessionCache.hpp"
+#include "../logger/logger.hpp"
+
+// Client TLS connection on a plain socket, offering the session of the last
+// connection to the same server (see TlsSessionCache).
+//
+// Reads and writes may come from different tasks if the caller serializes
+// them; waitReadable() needs no lock.
+class TlsConnection
+{
+public:
+    explicit TlsConnection(TlsSessionCache &sessions);
+    ~TlsConnection();
+
+    /*
+     *  Connect and run the handshake, verifying the server against caDer
+     *  @param timeoutMs: bound on each read of the handshake, and on the handshake as a whole
+     *  @return false if either failed, see getLastError()
+     */
+    bool connect(const char *hostname, uint16_t port, const uint8_t *caDer, size_t caLength, uint32_t timeoutMs);
+
+    /*
+     *  Write all of data
+     *  @return false if that took longer than timeoutMs or failed. A record
+     *          may be half sent then, so the connection counts as closed.
+     */
+    bool write(const uint8_t *data, size_t length, uint32_t timeoutMs);
+
+    /*
+     *  Read what arrived, waiting up to timeoutMs for a record
+     *  @return bytes read, 0 on timeout, -1 once the connection is closed or failed
+     */
+    int read(uint8_t *data, size_t length, uint32_t timeoutMs);
+
+    // True once read() would not wait: data is buffered, the socket is
+    // readable or the connection is gone
+    bool waitReadable(uint32_t timeoutMs);
+
+    // Send close_notify if still connected and release the connection
+    void close();
+
+    bool isConnected() const { return this->connected; }
+    // The last handshake resumed a cached session
+    bool wasResumed() const { return this->resumed; }
+    uint32_t getHandshakeMs() const { return this->handshakeMs; }
+    // mbedtls error of the last failed call, 0 if none
+    int getLastError() const { return this->lastError; }
+
+private:
+    TlsSessionCache &sessions;
+    Logger logger;
+
+    mbedtls_net_context net;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config config;
+    mbedtls_x509_crt ca;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctrDrbg;
+
+    volatile bool connected = false;
+    bool resumed = false;
+    uint32_t handshakeMs = 0;
+    int lastError = 0;
+
+    void init();
+    void release();
+    bool fail(const char *step, const char *hostname, uint16_t port, int error);
+    void setSendTimeout(uint32_t timeoutMs);
+};
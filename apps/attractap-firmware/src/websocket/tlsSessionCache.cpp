@@ -0,0 +1,195 @@
+#include "tlsSessionCache.hpp"
+#include "mbedtls/platform_util.h"
+#include "../settings/settings.hpp"
+
+TlsSessionCache::TlsSessionCache(bool persist) : persist(persist), logger("TlsSessionCache")
+{
+    mbedtls_ssl_session_init(&this->session);
+}
+
+TlsSessionCache::~TlsSessionCache()
+{
+    mbedtls_ssl_session_free(&this->session);
+    mbedtls_platform_zeroize(this->offeredMaster, sizeof(this->offeredMaster));
+}
+
+void TlsSessionCache::begin()
+{
+    if (!this->persist)
+    {
+        return;
+    }
+
+    uint8_t *buffer = (uint8_t *)malloc(MAX_PERSISTED_SIZE);
+    if (buffer == nullptr)
+    {
+        return;
+    }
+
+    String server;
+    size_t length = Settings::loadTlsSession(server, buffer, MAX_PERSISTED_SIZE);
+    if (length > 0)
+    {
+        // Sessions saved by a firmware with another mbedtls configuration
+        // do not load
+        int ret = mbedtls_ssl_session_load(&this->session, buffer, length);
+        if (ret == 0)
+        {
+            this->valid = true;
+            this->server = server;
+            logger.infof("Loaded TLS session for %s (%u bytes)", server.c_str(), (unsigned)length);
+        }
+        else
+        {
+            logger.errorf("Discarding the persisted TLS session: -0x%04x", (unsigned int)-ret);
+            this->stats.dropped++;
+            mbedtls_ssl_session_free(&this->session);
+            mbedtls_ssl_session_init(&this->session);
+            Settings::clearTlsSession();
+        }
+    }
+
+    mbedtls_platform_zeroize(buffer, length);
+    free(buffer);
+}
+
+bool TlsSessionCache::offer(mbedtls_ssl_context *ssl, const char *hostname, uint16_t port)
+{
+    this->offerPending = false;
+    if (!this->valid || this->server != serverKey(hostname, port))
+    {
+        return false;
+    }
+
+    int ret = mbedtls_ssl_set_session(ssl, &this->session);
+    if (ret != 0)
+    {
+        logger.errorf("Failed to offer the TLS session: -0x%04x", (unsigned int)-ret);
+        this->dropSession();
+        return false;
+    }
+
+    memcpy(this->offeredMaster, this->session.master, sizeof(this->offeredMaster));
+    this->offerPending = true;
+    this->stats.offered++;
+    return true;
+}
+
+bool TlsSessionCache::onHandshakeDone(mbedtls_ssl_context *ssl, const char *hostname, uint16_t port)
+{
+    mbedtls_ssl_session fresh;
+    mbedtls_ssl_session_init(&fresh);
+    int ret = mbedtls_ssl_get_session(ssl, &fresh);
+
+    bool resumed = ret == 0 && this->offerPending && memcmp(fresh.master, this->offeredMaster, sizeof(this->offeredMaster)) == 0;
+    this->offerPending = false;
+    mbedtls_platform_zeroize(this->offeredMaster, sizeof(this->offeredMaster));
+    if (resumed)
+    {
+        this->stats.resumed++;
+    }
+    else
+    {
+        this->stats.full++;
+    }
+
+    // Without a session ID or a ticket there is nothing to resume from
+    bool resumable = ret == 0 && fresh.id_len > 0;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+    resumable = resumable || (ret == 0 && fresh.ticket_len > 0);
+#endif
+    if (!resumable)
+    {
+        mbedtls_ssl_session_free(&fresh);
+        this->dropSession();
+        return resumed;
+    }
+
+    // The cached session takes over fresh's certificate and ticket
+    mbedtls_ssl_session_free(&this->session);
+    this->session = fresh;
+    this->server = serverKey(hostname, port);
+    this->valid = true;
+
+    // A resumed session is the one in NVS already. The server may have sent a
+    // new ticket with it, the persisted one stays good until it expires.
+    if (!resumed)
+    {
+        this->stats.stored++;
+        if (this->persist)
+        {
+            this->persistSession();
+        }
+    }
+    return resumed;
+}
+
+void TlsSessionCache::onHandshakeFailed()
+{
+    if (!this->offerPending)
+    {
+        return;
+    }
+
+    this->offerPending = false;
+    mbedtls_platform_zeroize(this->offeredMaster, sizeof(this->offeredMaster));
+    this->stats.dropped++;
+    this->dropSession();
+}
+
+void TlsSessionCache::clear()
+{
+    this->offerPending = false;
+    this->dropSession();
+}
+
+float TlsSessionCache::hitRate(const Stats &stats)
+{
+    uint32_t handshakes = stats.resumed + stats.full;
+    return handshakes > 0 ? (float)stats.resumed / handshakes : 0.0f;
+}
+
+String TlsSessionCache::serverKey(const char *hostname, uint16_t port)
+{
+    return String(hostname) + ":" + String(port);
+}
+
+void TlsSessionCache::persistSession()
+{
+    // The first call only sizes the session
+    size_t length = 0;
+    mbedtls_ssl_session_save(&this->session, nullptr, 0, &length);
+    if (length == 0 || length > MAX_PERSISTED_SIZE)
+    {
+        logger.errorf("Not persisting a TLS session of %u bytes", (unsigned)length);
+        return;
+    }
+
+    uint8_t *buffer = (uint8_t *)malloc(length);
+    if (buffer == nullptr)
+    {
+        return;
+    }
+
+    if (mbedtls_ssl_session_save(&this->session, buffer, length, &length) == 0 && Settings::saveTlsSession(this->server, buffer, length))
+    {
+        this->stats.persisted++;
+    }
+
+    mbedtls_platform_zeroize(buffer, length);
+    free(buffer);
+}
+
+void TlsSessionCache::dropSession()
+{
+    bool hadSession = this->valid;
+    mbedtls_ssl_session_free(&this->session);
+    mbedtls_ssl_session_init(&this->session);
+    this->valid = false;
+    this->server = "";
+
+    if (this->persist && hadSession)
+    {
+        Settings::clearTlsSession();
+    }
+}
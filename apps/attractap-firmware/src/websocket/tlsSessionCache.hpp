@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include "mbedtls/ssl.h"
+#include "../logger/logger.hpp"
+
+// Keep the cached session in NVS as well, so the first connect after a
+// reboot resumes too. Off by default: unless NVS encryption is enabled the
+// session's master secret sits in flash in the clear.
+#ifndef TLS_SESSION_CACHE_NVS
+#define TLS_SESSION_CACHE_NVS 0
+#endif
+
+// The TLS session of the last secure connection, offered on the next connect
+// to the same server so it can be resumed: an abbreviated handshake without
+// the certificate chain and the key exchange. Works with session IDs and
+// session tickets, whichever the server supports.
+//
+// Used by the task that connects; the stats may be read from elsewhere.
+class TlsSessionCache
+{
+public:
+    struct Stats
+    {
+        uint32_t offered;   // handshakes started with a cached session
+        uint32_t resumed;   // of which the server resumed the session
+        uint32_t full;      // full handshakes, including declined offers
+        uint32_t stored;    // new sessions kept after a full handshake
+        uint32_t persisted; // of which written to NVS
+        uint32_t dropped;   // offered to a failed handshake, or unreadable in NVS
+    };
+
+    explicit TlsSessionCache(bool persist = TLS_SESSION_CACHE_NVS);
+    ~TlsSessionCache();
+
+    // Load the persisted session, if persistence is on
+    void begin();
+
+    /*
+     *  Offer the session cached for hostname:port to a handshake about to start
+     *  @param ssl: set up (mbedtls_ssl_setup), before mbedtls_ssl_handshake
+     *  @return true if a session was offered
+     */
+    bool offer(mbedtls_ssl_context *ssl, const char *hostname, uint16_t port);
+
+    /*
+     *  Count a completed handshake and keep its session for the next one
+     *  @return true if it resumed the offered session
+     */
+    bool onHandshakeDone(mbedtls_ssl_context *ssl, const char *hostname, uint16_t port);
+
+    // The handshake failed; an offered session is dropped, the next one is full
+    void onHandshakeFailed();
+
+    // Forget the session, in RAM and NVS
+    void clear();
+
+    bool isPersistent() const { return this->persist; }
+    Stats getStats() const { return this->stats; }
+
+    // Resumed share of the completed handshakes, 0 before the first one
+    static float hitRate(const Stats &stats);
+
+private:
+    bool persist;
+    Logger logger;
+
+    mbedtls_ssl_session session;
+    bool valid = false;
+    String server; // hostname:port the session belongs to
+
+    // A resumed handshake keeps the master secret, a full one derives a new one
+    bool offerPending = false;
+    uint8_t offeredMaster[48];
+
+    Stats stats = {};
+
+    // Sessions carry the server certificate, usually well below this
+    static const size_t MAX_PERSISTED_SIZE = 4096;
+
+    static String serverKey(const char *hostname, uint16_t port);
+    void persistSession();
+    void dropSession();
+};
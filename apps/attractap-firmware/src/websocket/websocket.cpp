@@ -1,10 +1,15 @@
 #include "websocket.hpp"
 
+static const char *WEBSOCKET_PATH = "/api/attractap/websocket";
+
 void Websocket::setup()
 {
     logger.info("Websocket setup");
 
     this->_certManager.begin();
+    this->tlsSessions.begin();
+    this->secureClient.registerEvents(websocket_event_handler, this);
+    this->stateSubscription = State::subscribe(State::STATE_CHANGE_NETWORK);
 
     xTaskCreate(
         taskFn,
@@ -21,13 +26,14 @@ void Websocket::taskFn(void *parameter)
     while (true)
     {
         websocket->loop();
-        vTaskDelay(20 / portTICK_PERIOD_MS);
+        websocket->pendingStateChanges |= State::waitForChanges(websocket->stateSubscription, 20);
     }
 }
 
 void Websocket::loop()
 {
     this->updateInfoFromAppState();
+    this->decodeIncomingMessages();
 
     if (!network_is_connected)
     {
@@ -38,6 +44,11 @@ void Websocket::loop()
     bool apiConfigChanged = _lastApiConfig.hostname != apiConfig.hostname || _lastApiConfig.port != apiConfig.port || _lastApiConfig.useSSL != apiConfig.useSSL;
     if (apiConfigChanged)
     {
+        // A different server starts with a fresh schedule
+        taskENTER_CRITICAL(&this->reconnectMutex);
+        this->reconnectBackoff.reset();
+        taskEXIT_CRITICAL(&this->reconnectMutex);
+
         connectWebSocket();
         return;
     }
@@ -45,26 +56,38 @@ void Websocket::loop()
     switch (_state)
     {
     case INIT:
-        connectWebSocket();
+    {
+        taskENTER_CRITICAL(&this->reconnectMutex);
+        bool attemptDue = this->reconnectBackoff.isAttemptDue(millis());
+        taskEXIT_CRITICAL(&this->reconnectMutex);
+
+        if (attemptDue)
+        {
+            connectWebSocket();
+        }
         break;
+    }
     case CONNECTING:
         break;
     case CONNECTED:
         // Try to send any pending outgoing messages
         this->processOutgoingMessages();
+        if (_state == CONNECTED)
+        {
+            this->serviceHeartbeat(millis());
+        }
         break;
     }
 }
 
 void Websocket::updateInfoFromAppState()
 {
-    uint32_t lastStateChangeTime = State::getLastStateChangeTime();
-    if (lastKnownAppStateChangeTime >= lastStateChangeTime)
+    if (this->pendingStateChanges == 0)
     {
         return;
     }
 
-    lastKnownAppStateChangeTime = lastStateChangeTime;
+    this->pendingStateChanges = 0;
 
     auto networkState = State::getNetworkState();
     this->network_is_connected = networkState.wifi_connected || networkState.ethernet_connected;
@@ -76,9 +99,9 @@ void Websocket::connectWebSocket()
 
     if (!network_is_connected)
     {
+        // The loop retries as soon as the network state changes
         logger.info("connectWebSocket: network is not connected");
         setState(INIT);
-        vTaskDelay(RECONNECT_INTERVAL_MS / portTICK_PERIOD_MS);
         return;
     }
 
@@ -86,57 +109,97 @@ void Websocket::connectWebSocket()
     _lastApiConfig = apiConfig;
     setState(CONNECTING);
 
+    taskENTER_CRITICAL(&this->reconnectMutex);
+    this->reconnectBackoff.beginAttempt();
+    taskEXIT_CRITICAL(&this->reconnectMutex);
+
+    // Features are announced again once the new connection is authenticated
+    this->outgoing.setBatching(false);
+    this->serverSendsMsgPack = false;
+    this->consecutiveSendFailures = 0;
+    this->heartbeatPending = false;
+    this->heartbeatEchoSupported = false;
+    this->lastHeartbeatAt = millis();
+    this->lastReceivedAt = millis();
+
     if (ws_client)
     {
         esp_websocket_client_destroy(ws_client);
         ws_client = nullptr;
     }
+    this->secureClient.stop();
+    this->secure = false;
 
     String serverHostname = apiConfig.hostname;
     uint16_t serverPort = apiConfig.port;
 
     if (serverHostname.isEmpty() || serverPort == 0)
     {
-        logger.error("connectWebSocket: serverHostname or serverPort is empty");
         setState(INIT);
-        vTaskDelay(RECONNECT_INTERVAL_MS / portTICK_PERIOD_MS);
+        scheduleReconnect("serverHostname or serverPort is empty");
         return;
     }
 
     String protocol = (serverPort == 443) ? "wss" : "ws";
-    String wsUrl = protocol + "://" + serverHostname + ":" + String(serverPort) + "/api/attractap/websocket";
+    String wsUrl = protocol + "://" + serverHostname + ":" + String(serverPort) + WEBSOCKET_PATH;
     logger.info(("Connecting to WebSocket: " + wsUrl).c_str());
 
-    esp_websocket_client_config_t websocket_cfg = {};
-    websocket_cfg.uri = wsUrl.c_str();
-    websocket_cfg.port = serverPort;
-
-    // Configure buffer sizes to prevent ENOBUFS errors
-    websocket_cfg.buffer_size = 4096; // Increase buffer size (default is typically 1024)
-    websocket_cfg.task_stack = 8192;  // Increase task stack size for stability
-    websocket_cfg.task_prio = 5;      // Set appropriate task priority
-
     if (apiConfig.useSSL)
     {
-        websocket_cfg.transport = WEBSOCKET_TRANSPORT_OVER_SSL;
+        // Pick the root from the server's own chain instead of trying the
+        // bundled CAs one reconnect at a time
+        if (this->_certManager.needsDiscovery(serverHostname, serverPort))
+        {
+            this->_certManager.discoverCertificate(serverHostname, serverPort);
+        }
 
-        if (!this->_certManager.getCertificate(&websocket_cfg.cert_pem))
+        // DER straight out of the flash bundle
+        const uint8_t *certDer = nullptr;
+        size_t certLength = 0;
+        if (!this->_certManager.getCertificate(&certDer, &certLength))
         {
-            logger.error("Failed to get certificate");
             setState(INIT);
-            vTaskDelay(RECONNECT_INTERVAL_MS / portTICK_PERIOD_MS);
+            scheduleReconnect("failed to get certificate");
             return;
         }
 
         yield();
+
+        // Our own client, so reconnects resume the last TLS session
+        this->secure = true;
+        this->tlsAttempts++;
+        this->tlsHandshakePending = true;
+        this->tlsHandshakeStartedAt = millis();
+
+        if (!this->secureClient.start(serverHostname, serverPort, WEBSOCKET_PATH, certDer, certLength))
+        {
+            this->finishTlsHandshake(false);
+            setState(INIT);
+            scheduleReconnect("failed to start secure WebSocket client");
+            return;
+        }
+
+        logger.info("connectWebSocket: secure WebSocket started");
+        return;
     }
 
+    esp_websocket_client_config_t websocket_cfg = {};
+    websocket_cfg.uri = wsUrl.c_str();
+    websocket_cfg.port = serverPort;
+
+    // Configure buffer sizes to prevent ENOBUFS errors
+    websocket_cfg.buffer_size = 4096; // Increase buffer size (default is typically 1024)
+    websocket_cfg.task_stack = 8192;  // Increase task stack size for stability
+    websocket_cfg.task_prio = 5;      // Set appropriate task priority
+
+    // Reconnects are scheduled by this task (see ReconnectBackoff)
+    websocket_cfg.disable_auto_reconnect = true;
+
     ws_client = esp_websocket_client_init(&websocket_cfg);
     if (!ws_client)
     {
-        logger.error("Failed to initialize WebSocket client");
         setState(INIT);
-        vTaskDelay(RECONNECT_INTERVAL_MS / portTICK_PERIOD_MS);
+        scheduleReconnect("failed to initialize WebSocket client");
         return;
     }
 
@@ -147,9 +210,8 @@ void Websocket::connectWebSocket()
     esp_err_t ret = esp_websocket_client_start(ws_client);
     if (ret != ESP_OK)
     {
-        logger.error((String("Failed to start WebSocket client: ") + esp_err_to_name(ret)).c_str());
         setState(INIT);
-        vTaskDelay(RECONNECT_INTERVAL_MS / portTICK_PERIOD_MS);
+        scheduleReconnect(esp_err_to_name(ret));
         return;
     }
 
@@ -172,49 +234,86 @@ void Websocket::processWebSocketEvent(esp_event_base_t base, int32_t event_id, v
     {
     case WEBSOCKET_EVENT_CONNECTED:
         logger.info("WebSocket connected");
+        this->finishTlsHandshake(true);
         {
             this->_certManager.markSuccess();
         }
+        taskENTER_CRITICAL(&this->reconnectMutex);
+        this->reconnectBackoff.onConnected(millis());
+        taskEXIT_CRITICAL(&this->reconnectMutex);
         setState(CONNECTED);
         break;
 
     case WEBSOCKET_EVENT_CLOSED:
         logger.info("WebSocket closed");
-        vTaskDelay(RECONNECT_INTERVAL_MS / portTICK_PERIOD_MS);
         setState(INIT);
+        scheduleReconnect("closed by server");
         break;
 
     case WEBSOCKET_EVENT_DISCONNECTED:
     {
         logger.info("WebSocket disconnected");
-        if (apiConfig.useSSL)
+        this->finishTlsHandshake(false);
+        this->abortIncomingMessage();
+        // Only a connection that never came up says something about the CA
+        if (apiConfig.useSSL && this->_state != CONNECTED)
         {
             this->_certManager.markFailure();
         }
         setState(INIT);
-        vTaskDelay(RECONNECT_INTERVAL_MS / portTICK_PERIOD_MS);
+        scheduleReconnect("disconnected");
         break;
     }
 
     case WEBSOCKET_EVENT_DATA:
-        if (data->op_code == 0x01)
-        { // Text frame
-            String message = String((char *)data->data_ptr, data->data_len);
-            logger.debug(("Pushing incoming message to queue: " + message).c_str());
-
-            State::pushIncomingWebsocketMessageToQueue(message);
-        }
-        else if (data->op_code == 0x02)
-        { // Binary frame
-            logger.debug(("Received binary data: " + String(data->data_len) + " bytes").c_str());
-
-            logger.error("No binary data handler");
+        // Any frame, including pongs, proves the connection is alive
+        this->lastReceivedAt = millis();
+
+        if (data->op_code == 0x01 || data->op_code == 0x02 || (data->op_code == 0x00 && this->incomingMessageSlot != nullptr))
+        { // Text or binary frame (or continuation of one), possibly split across several events
+            if (data->payload_offset == 0)
+            {
+                this->abortIncomingMessage();
+                // One leading byte records the frame type for decodeIncomingMessages
+                this->incomingMessageLength = data->payload_len + 1;
+                this->incomingMessageSlot = State::reserveIncomingWebsocketMessage(this->incomingMessageLength);
+                if (this->incomingMessageSlot == nullptr)
+                {
+                    logger.errorf("Dropping incoming message of %d bytes, queue full or message too large", data->payload_len);
+                    break;
+                }
+                this->incomingMessageSlot[0] = data->op_code == 0x02 ? INCOMING_FRAME_BINARY : INCOMING_FRAME_TEXT;
+            }
+
+            if (this->incomingMessageSlot == nullptr)
+            {
+                break;
+            }
+
+            if (1 + data->payload_offset + data->data_len > this->incomingMessageLength)
+            {
+                logger.error("Incoming message fragment exceeds announced length");
+                this->abortIncomingMessage();
+                break;
+            }
+
+            memcpy(this->incomingMessageSlot + 1 + data->payload_offset, data->data_ptr, data->data_len);
+
+            if (1 + data->payload_offset + data->data_len == this->incomingMessageLength)
+            {
+                logger.debugf("Pushing incoming message of %d bytes to queue", data->payload_len);
+                State::commitIncomingWebsocketMessage(this->incomingMessageSlot);
+                this->incomingMessageSlot = nullptr;
+                this->incomingMessageLength = 0;
+            }
         }
         break;
 
     case WEBSOCKET_EVENT_ERROR:
         logger.error("WebSocket error");
+        this->finishTlsHandshake(false);
         setState(INIT);
+        scheduleReconnect("error");
         break;
 
     default:
@@ -223,23 +322,330 @@ void Websocket::processWebSocketEvent(esp_event_base_t base, int32_t event_id, v
     }
 }
 
+void Websocket::decodeIncomingMessages()
+{
+    State::WebsocketMessage message;
+    while (State::getNextIncomingWebsocketMessage(message))
+    {
+        // Aborted (partially received) frames are handed over zeroed
+        char frameType = message.data[0];
+        if (frameType != INCOMING_FRAME_TEXT && frameType != INCOMING_FRAME_BINARY)
+        {
+            State::releaseIncomingWebsocketMessage(message);
+            continue;
+        }
+
+        this->decodeDoc.clear();
+        this->decodeArena.reset();
+
+        ApiCommand command;
+        bool decoded;
+        if (frameType == INCOMING_FRAME_BINARY && !this->serverSendsMsgPack)
+        {
+            // Without MessagePack, binary frames are raw firmware chunks
+            decoded = ApiCommandDecoder::wrapFirmwareChunk((const uint8_t *)message.data + 1, message.length - 1, command);
+        }
+        else
+        {
+            ApiEncoding encoding = frameType == INCOMING_FRAME_BINARY ? API_ENCODING_MSGPACK : API_ENCODING_JSON;
+            decoded = ApiCommandDecoder::decode(message.data + 1, message.length - 1, command, this->decodeDoc, encoding);
+        }
+        State::releaseIncomingWebsocketMessage(message);
+
+        if (!decoded)
+        {
+            logger.error("Failed to decode incoming message");
+            continue;
+        }
+
+        if (command.type == API_COMMAND_HEARTBEAT)
+        {
+            this->onHeartbeatEcho(ApiCommandDecoder::payloadOf(command, this->decodeDoc));
+            ApiCommandDecoder::release(command);
+            continue;
+        }
+
+        if (command.type == API_COMMAND_READER_AUTHENTICATED)
+        {
+            JsonObjectConst payload = ApiCommandDecoder::payloadOf(command, this->decodeDoc);
+            this->updateServerFeatures(payload["features"].as<JsonArrayConst>());
+
+            // Later server messages arrive in the encoding confirmed here
+            this->serverSendsMsgPack = payload["encoding"] == "MSGPACK";
+        }
+
+        if (!ApiCommandDecoder::detach(command, this->decodeDoc))
+        {
+            logger.errorf("Dropping command %s, out of memory", command.name);
+            continue;
+        }
+
+        if (!State::pushApiCommandToQueue(command))
+        {
+            logger.errorf("Dropping command %s, api queue full", command.name);
+            ApiCommandDecoder::release(command);
+        }
+    }
+}
+
+void Websocket::updateServerFeatures(JsonArrayConst features)
+{
+    bool acceptsBatches = false;
+    for (JsonVariantConst feature : features)
+    {
+        if (feature == "BATCH")
+        {
+            acceptsBatches = true;
+        }
+    }
+
+    if (acceptsBatches != this->outgoing.isBatching())
+    {
+        logger.infof("Server %s batched messages", acceptsBatches ? "accepts" : "does not accept");
+    }
+    this->outgoing.setBatching(acceptsBatches);
+}
+
 void Websocket::processOutgoingMessages()
 {
-    String message;
-    if (!State::getNextOutgoingWebsocketMessage(message))
+    // Drain what queued up since the last tick (an ACK, its response and a
+    // heartbeat usually arrive together), bounded so a long backlog does not
+    // starve incoming messages
+    this->outgoing.drain(MAX_FRAMES_PER_LOOP);
+}
+
+bool Websocket::sendFrame(const char *data, size_t length, uint8_t messages)
+{
+    bool json = isJsonMessage(data);
+    if (json)
+    {
+        logger.debugf("sendMessage: %.*s", (int)length, data);
+    }
+    else
+    {
+        logger.debugf("sendMessage: %u bytes MessagePack", (unsigned)length);
+    }
+
+    // After a failed send the link is suspect: give up sooner instead of
+    // blocking the task for the full timeout on every queued message
+    uint32_t timeoutMs = this->consecutiveSendFailures > 0 ? SEND_TIMEOUT_DEGRADED_MS : SEND_TIMEOUT_MS;
+
+    uint32_t startedAt = millis();
+    int ret;
+    if (this->secure)
+    {
+        ret = json ? this->secureClient.sendText(data, length, timeoutMs)
+                   : this->secureClient.sendBinary(data, length, timeoutMs);
+    }
+    else
+    {
+        ret = json ? esp_websocket_client_send_text(ws_client, data, length, pdMS_TO_TICKS(timeoutMs))
+                   : esp_websocket_client_send_bin(ws_client, data, length, pdMS_TO_TICKS(timeoutMs));
+    }
+    this->sendLatency.record(millis() - startedAt);
+
+    if (ret >= 0)
+    {
+        this->lastSentAt = millis();
+        this->consecutiveSendFailures = 0;
+        this->messagesSent += messages;
+        this->framesSent++;
+        return true;
+    }
+
+    this->sendFailures++;
+    this->consecutiveSendFailures++;
+    logger.errorf("sendMessage: failed (%u in a row)", this->consecutiveSendFailures);
+
+    if (this->consecutiveSendFailures >= SEND_FAILURES_BEFORE_RECONNECT)
+    {
+        this->consecutiveSendFailures = 0;
+        this->dropConnection("send timeout");
+    }
+
+    return false;
+}
+
+void Websocket::dropConnection(const char *reason)
+{
+    // The client task does not notice a stalled TCP connection by itself,
+    // so stop it here and let the backoff reconnect
+    if (this->secure)
+    {
+        this->secureClient.stop();
+    }
+    else
+    {
+        esp_websocket_client_stop(ws_client);
+    }
+    this->abortIncomingMessage();
+    setState(INIT);
+    scheduleReconnect(reason);
+}
+
+void Websocket::serviceHeartbeat(uint32_t now)
+{
+    if (this->heartbeatPending && now - this->heartbeatSentAt >= HEARTBEAT_TIMEOUT_MS)
+    {
+        this->heartbeatPending = false;
+        this->heartbeatsLost++;
+
+        // Nothing at all came back since the probe: the connection is
+        // half-open. Only trusted once the server proved it echoes.
+        bool receivedSince = (int32_t)(this->lastReceivedAt - this->heartbeatSentAt) >= 0;
+        if (this->heartbeatEchoSupported && !receivedSince)
+        {
+            this->halfOpenDrops++;
+            logger.errorf("No answer to heartbeat %lu within %lu ms", (unsigned long)this->heartbeatSeq, (unsigned long)HEARTBEAT_TIMEOUT_MS);
+            this->dropConnection("half-open connection");
+            return;
+        }
+    }
+
+    if (this->heartbeatPending || now - this->lastHeartbeatAt < HEARTBEAT_INTERVAL_MS)
+    {
+        return;
+    }
+    this->lastHeartbeatAt = now;
+
+    // Frames flowing both ways already keep the server's last-seen fresh and
+    // prove the link, a probe would only add load
+    if (now - this->lastSentAt < HEARTBEAT_INTERVAL_MS && now - this->lastReceivedAt < HEARTBEAT_INTERVAL_MS)
     {
+        this->heartbeatsSuppressed++;
         return;
     }
 
-    logger.debug(("sendMessage: " + message).c_str());
-    int ret = esp_websocket_client_send_text(ws_client, message.c_str(), message.length(), pdMS_TO_TICKS(5000));
+    char heartbeat[64];
+    this->heartbeatSeq++;
+    int length = snprintf(heartbeat, sizeof(heartbeat), "{\"event\":\"HEARTBEAT\",\"data\":{\"seq\":%lu,\"ts\":%lu}}",
+                          (unsigned long)this->heartbeatSeq, (unsigned long)now);
 
-    if (ret == -1)
+    this->heartbeatSentAt = now;
+    if (this->sendFrame(heartbeat, length))
     {
-        logger.error("sendMessage: failed");
+        this->heartbeatPending = true;
+        this->heartbeatsSent++;
     }
 }
 
+void Websocket::onHeartbeatEcho(JsonObjectConst payload)
+{
+    // The timestamp is our own millis() echoed back, so no clock sync is needed
+    uint32_t seq = payload["seq"] | 0UL;
+    uint32_t sentAt = payload["ts"] | 0UL;
+    if (!this->heartbeatPending || seq != this->heartbeatSeq)
+    {
+        return;
+    }
+
+    this->heartbeatPending = false;
+    this->heartbeatEchoSupported = true;
+    this->heartbeatRtt.record(millis() - sentAt);
+}
+
+void Websocket::abortIncomingMessage()
+{
+    if (this->incomingMessageSlot == nullptr)
+    {
+        return;
+    }
+
+    // A reserved ring record can't be given back, so hand over an empty
+    // (all zero) record that the consumer discards.
+    memset(this->incomingMessageSlot, 0, this->incomingMessageLength);
+    State::commitIncomingWebsocketMessage(this->incomingMessageSlot);
+    this->incomingMessageSlot = nullptr;
+    this->incomingMessageLength = 0;
+}
+
+void Websocket::finishTlsHandshake(bool established)
+{
+    if (!this->tlsHandshakePending)
+    {
+        return;
+    }
+    this->tlsHandshakePending = false;
+
+    if (!established)
+    {
+        this->tlsFailed++;
+        return;
+    }
+
+    this->tlsEstablished++;
+    this->tlsLastHandshakeMs = millis() - this->tlsHandshakeStartedAt;
+    this->tlsHandshakeLatency.record(this->tlsLastHandshakeMs);
+
+    bool resumed = this->secureClient.wasResumed();
+    if (resumed)
+    {
+        this->tlsResumedHandshakeLatency.record(this->tlsLastHandshakeMs);
+    }
+    else
+    {
+        this->tlsFullHandshakeLatency.record(this->tlsLastHandshakeMs);
+    }
+    logger.infof("Secure connection established in %lu ms (%s handshake)", (unsigned long)this->tlsLastHandshakeMs, resumed ? "resumed" : "full");
+}
+
+void Websocket::scheduleReconnect(const char *reason)
+{
+    taskENTER_CRITICAL(&this->reconnectMutex);
+    ReconnectBackoff::Stats before = this->reconnectBackoff.getStats(millis());
+    uint32_t delayMs = this->reconnectBackoff.onConnectionLost(millis(), esp_random());
+    ReconnectBackoff::Stats after = this->reconnectBackoff.getStats(millis());
+    taskEXIT_CRITICAL(&this->reconnectMutex);
+
+    // Error and disconnect events for the same loss are only reported once
+    if (after.failures != before.failures)
+    {
+        logger.infof("Connection lost (%s), retry %lu in %lu ms", reason, (unsigned long)after.consecutiveFailures, (unsigned long)delayMs);
+    }
+}
+
+Websocket::ConnectionStats Websocket::getConnectionStats()
+{
+    ConnectionStats stats;
+    stats.connected = this->_state == CONNECTED;
+    stats.batching = this->outgoing.isBatching();
+    stats.send.messages = this->messagesSent;
+    stats.send.frames = this->framesSent;
+    stats.send.batches = this->outgoing.getBatchesSent();
+    stats.send.failures = this->sendFailures;
+    stats.send.latency = this->sendLatency.snapshot();
+    stats.send.queueLatency = this->outgoing.getQueueLatency();
+    stats.heartbeat.sent = this->heartbeatsSent;
+    stats.heartbeat.suppressed = this->heartbeatsSuppressed;
+    stats.heartbeat.lost = this->heartbeatsLost;
+    stats.heartbeat.halfOpenDrops = this->halfOpenDrops;
+    stats.heartbeat.echoSupported = this->heartbeatEchoSupported;
+    stats.heartbeat.rtt = this->heartbeatRtt.snapshot();
+
+    taskENTER_CRITICAL(&this->reconnectMutex);
+    uint32_t now = millis();
+    stats.nextAttemptInMs = this->reconnectBackoff.msUntilNextAttempt(now);
+    stats.backoff = this->reconnectBackoff.getStats(now);
+    taskEXIT_CRITICAL(&this->reconnectMutex);
+
+    return stats;
+}
+
+Websocket::TlsStats Websocket::getTlsStats() const
+{
+    TlsStats stats;
+    stats.attempts = this->tlsAttempts;
+    stats.established = this->tlsEstablished;
+    stats.failed = this->tlsFailed;
+    stats.lastHandshakeMs = this->tlsLastHandshakeMs;
+    stats.handshake = this->tlsHandshakeLatency.snapshot();
+    stats.fullHandshake = this->tlsFullHandshakeLatency.snapshot();
+    stats.resumedHandshake = this->tlsResumedHandshakeLatency.snapshot();
+    stats.sessions = this->tlsSessions.getStats();
+    stats.sessionPersistence = this->tlsSessions.isPersistent();
+    return stats;
+}
+
 void Websocket::setState(ConnectionState state)
 {
     _state = state;
@@ -8,11 +8,22 @@
 #include "task_priorities.h"
 #include "../state/state.hpp"
 #include "../logger/logger.hpp"
+#include "../metrics/latencyHistogram.hpp"
+#include "../api/arenaAllocator.hpp"
+#include "reconnectBackoff.hpp"
+#include "outgoingBatcher.hpp"
+#include "tlsSessionCache.hpp"
+#include "secureWebsocketClient.hpp"
 
-class Websocket
+class Websocket : private OutgoingBatcher::FrameSender
 {
 public:
-    Websocket() : logger("Websocket"), lastKnownAppStateChangeTime(0) {}
+    Websocket() : decodeArena(decodeArenaBuffer, sizeof(decodeArenaBuffer)),
+                  decodeDoc(&decodeArena),
+                  reconnectBackoff(RECONNECT_INITIAL_DELAY_MS, RECONNECT_MAX_DELAY_MS, RECONNECT_STABLE_AFTER_MS),
+                  secureClient(tlsSessions),
+                  outgoing(*this),
+                  logger("Websocket") {}
 
     enum ConnectionState
     {
@@ -24,19 +35,88 @@ public:
 
     void connectWebSocket();
 
+    struct TlsStats
+    {
+        uint32_t attempts;
+        uint32_t established;
+        uint32_t failed;
+        uint32_t lastHandshakeMs;
+        LatencyHistogram::Snapshot handshake;
+        LatencyHistogram::Snapshot fullHandshake;
+        LatencyHistogram::Snapshot resumedHandshake;
+        TlsSessionCache::Stats sessions;
+        bool sessionPersistence;
+    };
+
+    // Secure connection setup (TCP + TLS + websocket upgrade) timings and
+    // TLS session resumption
+    TlsStats getTlsStats() const;
+
+    struct SendStats
+    {
+        uint32_t messages;
+        uint32_t frames;
+        uint32_t batches;
+        uint32_t failures;
+        LatencyHistogram::Snapshot latency;
+        // Queued by the API task until sent
+        LatencyHistogram::Snapshot queueLatency;
+    };
+
+    struct HeartbeatStats
+    {
+        uint32_t sent;
+        uint32_t suppressed;
+        uint32_t lost;
+        uint32_t halfOpenDrops;
+        bool echoSupported;
+        LatencyHistogram::Snapshot rtt;
+    };
+
+    struct ConnectionStats
+    {
+        bool connected;
+        bool batching;
+        uint32_t nextAttemptInMs;
+        ReconnectBackoff::Stats backoff;
+        SendStats send;
+        HeartbeatStats heartbeat;
+    };
+
+    // Reconnect schedule and connection uptime
+    ConnectionStats getConnectionStats();
+
 private:
     static void taskFn(void *parameter);
     void loop();
 
     void updateInfoFromAppState();
-    uint32_t lastKnownAppStateChangeTime;
+    EventGroupHandle_t stateSubscription = nullptr;
+    uint32_t pendingStateChanges = 0;
 
     void processOutgoingMessages();
+    void decodeIncomingMessages();
+
+    // Incoming messages are parsed into a document backed by a static arena.
+    // Heartbeats and the typed NFC commands never leave it, only commands
+    // handed to the API task are copied into a document of their own.
+    static const size_t DECODE_ARENA_SIZE = 3072;
+    alignas(max_align_t) uint8_t decodeArenaBuffer[DECODE_ARENA_SIZE];
+    ArenaAllocator decodeArena;
+    JsonDocument decodeDoc;
 
     AdaptiveCertManager _certManager;
 
     bool network_is_connected = false;
-    const uint32_t RECONNECT_INTERVAL_MS = 10000;
+
+    static const uint32_t RECONNECT_INITIAL_DELAY_MS = 1000;
+    static const uint32_t RECONNECT_MAX_DELAY_MS = 60000;
+    static const uint32_t RECONNECT_STABLE_AFTER_MS = 30000;
+
+    // Shared between this task and the esp_websocket_client event handler
+    ReconnectBackoff reconnectBackoff;
+    portMUX_TYPE reconnectMutex = portMUX_INITIALIZER_UNLOCKED;
+    void scheduleReconnect(const char *reason);
 
     AttraccessApiConfig _lastApiConfig;
 
@@ -45,7 +125,74 @@ private:
 
     void connectTCP();
 
-    esp_websocket_client_handle_t ws_client;
+    // ws:// goes through esp_websocket_client, wss:// through our own client
+    // that can resume TLS sessions
+    esp_websocket_client_handle_t ws_client = nullptr;
+    TlsSessionCache tlsSessions;
+    SecureWebsocketClient secureClient;
+    bool secure = false;
+
+    // Set while a secure connection attempt is in flight
+    uint32_t tlsHandshakeStartedAt = 0;
+    bool tlsHandshakePending = false;
+    uint32_t tlsAttempts = 0;
+    uint32_t tlsEstablished = 0;
+    uint32_t tlsFailed = 0;
+    uint32_t tlsLastHandshakeMs = 0;
+    LatencyHistogram tlsHandshakeLatency;
+    LatencyHistogram tlsFullHandshakeLatency;
+    LatencyHistogram tlsResumedHandshakeLatency;
+    void finishTlsHandshake(bool established);
+
+    // Outgoing queue draining, coalesced into BATCH frames once the server
+    // announced support for it
+    static const uint8_t MAX_FRAMES_PER_LOOP = 8;
+    static const uint32_t SEND_TIMEOUT_MS = 2000;
+    static const uint32_t SEND_TIMEOUT_DEGRADED_MS = 500;
+    static const uint8_t SEND_FAILURES_BEFORE_RECONNECT = 2;
+    OutgoingBatcher outgoing;
+    uint8_t consecutiveSendFailures = 0;
+    uint32_t messagesSent = 0;
+    uint32_t framesSent = 0;
+    uint32_t sendFailures = 0;
+    LatencyHistogram sendLatency;
+    void updateServerFeatures(JsonArrayConst features);
+    bool sendFrame(const char *data, size_t length, uint8_t messages = 1) override;
+
+    // Outgoing records are JSON objects or MessagePack maps (never '{')
+    static bool isJsonMessage(const char *data) { return data[0] == '{'; }
+
+    void dropConnection(const char *reason);
+
+    // Application heartbeats carry a sequence number and our timestamp, the
+    // server echoes both back. They are skipped while other frames flow in
+    // both directions; an unanswered one with no traffic at all in between
+    // means the connection is half-open.
+    static const uint32_t HEARTBEAT_INTERVAL_MS = 5000;
+    static const uint32_t HEARTBEAT_TIMEOUT_MS = 4000;
+    uint32_t heartbeatSeq = 0;
+    uint32_t heartbeatSentAt = 0;
+    bool heartbeatPending = false;
+    bool heartbeatEchoSupported = false;
+    uint32_t lastHeartbeatAt = 0;
+    uint32_t lastSentAt = 0;
+    volatile uint32_t lastReceivedAt = 0; // written by the client task
+    uint32_t heartbeatsSent = 0;
+    uint32_t heartbeatsSuppressed = 0;
+    uint32_t heartbeatsLost = 0;
+    uint32_t halfOpenDrops = 0;
+    LatencyHistogram heartbeatRtt;
+    void serviceHeartbeat(uint32_t now);
+    void onHeartbeatEcho(JsonObjectConst payload);
+
+    // Incoming frame being reassembled in place inside the State ring, behind
+    // a leading frame type byte (zeroed if the frame was aborted)
+    static const char INCOMING_FRAME_TEXT = 'T';
+    static const char INCOMING_FRAME_BINARY = 'B';
+    char *incomingMessageSlot = nullptr;
+    size_t incomingMessageLength = 0;
+    bool serverSendsMsgPack = false;
+    void abortIncomingMessage();
 
     static void websocket_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
     void processWebSocketEvent(esp_event_base_t base, int32_t event_id, void *event_data);
@@ -0,0 +1,54 @@
+#pragma once
+
+// Timing helper for the benchmark cases of the native suites. Results are
+// printed next to the GoogleTest output (pio test -e native -v shows them);
+// they are host numbers, useful to compare two implementations on the same
+// machine, not absolute ESP32 figures.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+
+struct BenchmarkResult
+{
+    uint32_t iterations;
+    double nsPerOp;
+};
+
+/*
+ *  Run `operation` `iterations` times after a short warm up, without printing
+ *  @return the measured cost per call
+ */
+template <typename Operation>
+BenchmarkResult measureBenchmark(uint32_t iterations, Operation operation)
+{
+    for (uint32_t i = 0; i < iterations / 10 + 1; i++)
+    {
+        operation();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+    {
+        operation();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    BenchmarkResult result;
+    result.iterations = iterations;
+    result.nsPerOp = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations;
+    return result;
+}
+
+/*
+ *  Run `operation` `iterations` times after a short warm up
+ *  @param name: label printed with the result
+ *  @return the measured cost per call
+ */
+template <typename Operation>
+BenchmarkResult runBenchmark(const char *name, uint32_t iterations, Operation operation)
+{
+    BenchmarkResult result = measureBenchmark(iterations, operation);
+    printf("[ BENCH    ] %-40s %10.1f ns/op (%u iterations)\n", name, result.nsPerOp, iterations);
+    return result;
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "nfc/Adafruit_PN532_Transport.h"
+#include "ntag424Card.hpp"
+
+// PN532 behind the driver's transport seam. Host frames are checked like the
+// chip does (preamble, LCS, TFI, DCS) and ACKed, the response frame follows.
+// Reads behave like I2C: each read takes the whole pending frame, bytes the
+// host did not ask for are lost. Up to two ISO14443-4 cards can be put in the
+// field, they become targets 1 and 2 of InListPassiveTarget. The NFC task
+// and the test may call in from different threads.
+class EmulatedPn532 : public Adafruit_PN532_Transport
+{
+public:
+    struct Stats
+    {
+        uint32_t frames;
+        uint32_t badFrames;
+        uint32_t aborts;
+        uint32_t reads;
+        uint32_t readyPolls;
+        uint32_t apdus;
+        // InListPassiveTarget answers with at least one card
+        uint32_t detections;
+    };
+
+    bool begin(void) override
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->frames.clear();
+        this->detectionPending = false;
+        return true;
+    }
+
+    void writeFrame(const uint8_t *frame, uint8_t len) override
+    {
+        static const uint8_t ACK[] = {0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00};
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        // An ACK from the host aborts the current command
+        if (len == sizeof(ACK) && memcmp(frame, ACK, sizeof(ACK)) == 0)
+        {
+            this->stats.aborts++;
+            this->frames.clear();
+            this->detectionPending = false;
+            return;
+        }
+
+        this->stats.frames++;
+        const uint8_t *data = nullptr;
+        uint8_t dataLength = 0;
+        if (!parseFrame(frame, len, &data, &dataLength))
+        {
+            // The chip stays silent on a broken frame, the host times out
+            this->stats.badFrames++;
+            return;
+        }
+
+        // A new command replaces whatever was pending
+        this->frames.clear();
+        this->detectionPending = false;
+        this->frames.push_back(std::vector<uint8_t>(ACK, ACK + sizeof(ACK)));
+        this->execute(data[0], data + 1, dataLength - 1);
+    }
+
+    void read(uint8_t *buff, uint8_t n) override
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stats.reads++;
+        memset(buff, 0, n);
+        if (this->frames.empty())
+        {
+            return;
+        }
+        const std::vector<uint8_t> &frame = this->frames.front();
+        memcpy(buff, frame.data(), frame.size() < n ? frame.size() : n);
+        this->frames.pop_front();
+    }
+
+    bool isReady(void) override
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stats.readyPolls++;
+        return !this->frames.empty();
+    }
+
+    // Put a card in the field (nullptr removes it), answers a pending detection
+    void setCard(Ntag424Card *card)
+    {
+        this->setCards(card, nullptr);
+    }
+
+    // Put two cards in the field at once, first comes first in the target list
+    void setCards(Ntag424Card *first, Ntag424Card *second)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->targets[0] = {first, 0};
+        this->targets[1] = {second, 0};
+        if ((first != nullptr || second != nullptr) && this->detectionPending)
+        {
+            this->detectionPending = false;
+            this->answerDetection();
+        }
+    }
+
+    // The next InDataExchanges time out as if the card left the field for a moment
+    void dropNextExchanges(uint32_t count)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->exchangesToDrop = count;
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->stats;
+    }
+
+private:
+    static constexpr uint8_t MAX_TARGETS = 2;
+
+    struct Target
+    {
+        Ntag424Card *card;
+        // Target number of the last detection, 0 while not activated
+        uint8_t tg;
+    };
+
+    std::mutex mutex;
+    Target targets[MAX_TARGETS] = {};
+    uint8_t listMaxTargets = 1;
+    bool detectionPending = false;
+    uint32_t exchangesToDrop = 0;
+    std::deque<std::vector<uint8_t>> frames;
+    Stats stats = {};
+
+    // Normal information frame, returns the command bytes after TFI
+    static bool parseFrame(const uint8_t *frame, uint8_t len, const uint8_t **data, uint8_t *dataLength)
+    {
+        if (len < 8 || frame[0] != 0x00 || frame[1] != 0x00 || frame[2] != 0xFF)
+        {
+            return false;
+        }
+        uint8_t length = frame[3];
+        if ((uint8_t)(length + frame[4]) != 0 || length < 2 || len < 7 + length || frame[5] != 0xD4)
+        {
+            return false;
+        }
+        uint8_t sum = 0;
+        for (uint8_t i = 0; i < length; i++)
+        {
+            sum += frame[5 + i];
+        }
+        if ((uint8_t)(sum + frame[5 + length]) != 0)
+        {
+            return false;
+        }
+        *data = frame + 6;
+        *dataLength = length - 1;
+        return true;
+    }
+
+    void respond(uint8_t command, const uint8_t *payload, uint8_t length)
+    {
+        std::vector<uint8_t> frame = {0x00, 0x00, 0xFF, (uint8_t)(length + 2), (uint8_t)(0 - (length + 2)), 0xD5,
+                                      (uint8_t)(command + 1)};
+        uint8_t sum = 0xD5 + command + 1;
+        for (uint8_t i = 0; i < length; i++)
+        {
+            frame.push_back(payload[i]);
+            sum += payload[i];
+        }
+        frame.push_back((uint8_t)(0 - sum));
+        frame.push_back(0x00);
+        this->frames.push_back(frame);
+    }
+
+    void execute(uint8_t command, const uint8_t *params, uint8_t length)
+    {
+        switch (command)
+        {
+        case 0x02:
+        {
+            // PN532, firmware 1.6, ISO14443A/B and ISO18092
+            static const uint8_t VERSION[] = {0x32, 0x01, 0x06, 0x07};
+            this->respond(command, VERSION, sizeof(VERSION));
+            break;
+        }
+        case 0x14: // SAMConfiguration
+        case 0x32: // RFConfiguration
+            this->respond(command, nullptr, 0);
+            break;
+        case 0x4A: // InListPassiveTarget
+            if (length < 2 || params[0] < 1 || params[0] > MAX_TARGETS || params[1] != 0x00)
+            {
+                this->syntaxError();
+                break;
+            }
+            this->listMaxTargets = params[0];
+            if (this->targets[0].card != nullptr || this->targets[1].card != nullptr)
+            {
+                this->answerDetection();
+            }
+            else
+            {
+                this->detectionPending = true;
+            }
+            break;
+        case 0x40: // InDataExchange
+            this->dataExchange(params, length);
+            break;
+        case 0x44: // InDeselect
+        case 0x52: // InRelease
+        {
+            // Tg 0 stands for all targets
+            for (uint8_t i = 0; i < MAX_TARGETS; i++)
+            {
+                if (length < 1 || params[0] == 0 || params[0] == this->targets[i].tg)
+                {
+                    this->targets[i].tg = 0;
+                }
+            }
+            uint8_t status = 0x00;
+            this->respond(command, &status, 1);
+            break;
+        }
+        default:
+            this->syntaxError();
+            break;
+        }
+    }
+
+    // Application level error frame
+    void syntaxError()
+    {
+        static const uint8_t ERROR_FRAME[] = {0x00, 0x00, 0xFF, 0x01, 0xFF, 0x7F, 0x81, 0x00};
+        this->frames.push_back(std::vector<uint8_t>(ERROR_FRAME, ERROR_FRAME + sizeof(ERROR_FRAME)));
+    }
+
+    // NbTg, then per target Tg, SENS_RES, SEL_RES, NFCIDLength, NFCID1, ATS.
+    // Targets are numbered in the order they were activated.
+    void answerDetection()
+    {
+        static const uint8_t ATS[] = {0x06, 0x75, 0x77, 0x81, 0x02, 0x80};
+        static const uint8_t TARGET_SIZE = 5 + Ntag424Card::UID_LENGTH + sizeof(ATS);
+
+        uint8_t payload[1 + MAX_TARGETS * TARGET_SIZE] = {0};
+        uint8_t length = 1;
+        for (uint8_t i = 0; i < MAX_TARGETS; i++)
+        {
+            Target &target = this->targets[i];
+            target.tg = 0;
+            if (target.card == nullptr || payload[0] >= this->listMaxTargets)
+            {
+                continue;
+            }
+
+            target.card->activate();
+            target.tg = ++payload[0];
+            uint8_t header[] = {target.tg, 0x00, 0x44, 0x20, Ntag424Card::UID_LENGTH};
+            memcpy(payload + length, header, sizeof(header));
+            memcpy(payload + length + sizeof(header), target.card->getUid(), Ntag424Card::UID_LENGTH);
+            memcpy(payload + length + sizeof(header) + Ntag424Card::UID_LENGTH, ATS, sizeof(ATS));
+            length += TARGET_SIZE;
+        }
+        this->stats.detections++;
+        this->respond(0x4A, payload, length);
+    }
+
+    void dataExchange(const uint8_t *params, uint8_t length)
+    {
+        // Status 0x01: the target did not answer in time
+        uint8_t payload[1 + 255] = {0x01};
+        Target *target = nullptr;
+        for (uint8_t i = 0; i < MAX_TARGETS && length >= 1; i++)
+        {
+            if (params[0] != 0 && this->targets[i].tg == params[0] && this->targets[i].card != nullptr)
+            {
+                target = &this->targets[i];
+            }
+        }
+        if (target == nullptr)
+        {
+            this->respond(0x40, payload, 1);
+            return;
+        }
+        if (this->exchangesToDrop > 0)
+        {
+            this->exchangesToDrop--;
+            this->respond(0x40, payload, 1);
+            return;
+        }
+
+        this->stats.apdus++;
+        payload[0] = 0x00;
+        uint8_t responseLength = target->card->transceive(params + 1, length - 1, payload + 1);
+        this->respond(0x40, payload, 1 + responseLength);
+    }
+};
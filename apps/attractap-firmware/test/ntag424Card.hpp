@@ -0,0 +1,599 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "esp_random.h"
+#include "mbedtls/aes.h"
+#include "nfc/mbedtlscmac.h"
+
+// Software NTAG 424 DNA for the emulated PN532: the NDEF application with its
+// five AES keys and the commands the reader uses, ISOSelectFile, GetVersion,
+// AuthenticateEV2First, ChangeKey, GetCardUID and ReadData. Secure messaging
+// follows the NT4H2421Gx datasheet and NXP AN12196, with real AES and CMAC.
+// With another hardware type in GetVersion it stands in for a different
+// DESFire family card that the reader has to tell apart.
+class Ntag424Card
+{
+public:
+    static constexpr uint8_t UID_LENGTH = 7;
+    static constexpr uint8_t KEY_COUNT = 5;
+    static constexpr uint8_t KEY_SIZE = 16;
+    static constexpr uint16_t CC_FILE_SIZE = 32;
+    static constexpr uint16_t NDEF_FILE_SIZE = 256;
+    static constexpr uint16_t PROPRIETARY_FILE_SIZE = 128;
+
+    // Hardware type byte of GetVersion
+    static constexpr uint8_t HW_TYPE_DESFIRE = 0x01;
+    static constexpr uint8_t HW_TYPE_NTAG = 0x04;
+
+    // SW2 of native commands, SW1 is 0x91
+    static constexpr uint8_t OPERATION_OK = 0x00;
+    static constexpr uint8_t ILLEGAL_COMMAND = 0x1C;
+    static constexpr uint8_t INTEGRITY_ERROR = 0x1E;
+    static constexpr uint8_t NO_SUCH_KEY = 0x40;
+    static constexpr uint8_t LENGTH_ERROR = 0x7E;
+    static constexpr uint8_t PERMISSION_DENIED = 0x9D;
+    static constexpr uint8_t PARAMETER_ERROR = 0x9E;
+    static constexpr uint8_t AUTHENTICATION_ERROR = 0xAE;
+    static constexpr uint8_t ADDITIONAL_FRAME = 0xAF;
+    static constexpr uint8_t BOUNDARY_ERROR = 0xBE;
+
+    // Factory state: all keys zero at version 0
+    explicit Ntag424Card(const uint8_t uid[UID_LENGTH], uint8_t hwType = HW_TYPE_NTAG) : hwType(hwType)
+    {
+        memcpy(this->uid, uid, UID_LENGTH);
+        memset(this->keys, 0, sizeof(this->keys));
+        memset(this->keyVersions, 0, sizeof(this->keyVersions));
+        memset(this->ccFile, 0, sizeof(this->ccFile));
+        memset(this->ndefFile, 0, sizeof(this->ndefFile));
+        memset(this->proprietaryFile, 0, sizeof(this->proprietaryFile));
+
+        static const uint8_t CAPABILITY_CONTAINER[] = {0x00, 0x17, 0x20, 0x01, 0x00, 0x00, 0xFF, 0x04, 0x06, 0xE1, 0x04,
+                                                       0x01, 0x00, 0x00, 0x00, 0x05, 0x06, 0xE1, 0x05, 0x00, 0x80, 0x82,
+                                                       0x83, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+        memcpy(this->ccFile, CAPABILITY_CONTAINER, sizeof(CAPABILITY_CONTAINER));
+        this->activate();
+    }
+
+    const uint8_t *getUid() const { return this->uid; }
+    const uint8_t *getKey(uint8_t keyNo) const { return this->keys[keyNo]; }
+    uint8_t getKeyVersion(uint8_t keyNo) const { return this->keyVersions[keyNo]; }
+    bool isAuthenticated() const { return this->authenticated; }
+    uint8_t getAuthenticatedKey() const { return this->authKeyNo; }
+    uint16_t getCommandCounter() const { return this->cmdCtr; }
+    uint32_t getApduCount() const { return this->apdus; }
+    uint32_t getSelectCount() const { return this->selects; }
+    uint32_t getVersionCount() const { return this->versions; }
+
+    void writeNdefFile(uint16_t offset, const uint8_t *data, uint16_t length)
+    {
+        memcpy(this->ndefFile + offset, data, length);
+    }
+
+    // ISO14443-4 activation by the reader: nothing selected, no session
+    void activate()
+    {
+        this->appSelected = false;
+        this->endSession();
+        this->pending = PENDING_NONE;
+    }
+
+    // One C-APDU in, the R-APDU (data, SW1, SW2) out
+    uint8_t transceive(const uint8_t *apdu, uint8_t length, uint8_t *response)
+    {
+        this->apdus++;
+        if (length < 4)
+        {
+            return this->isoStatus(response, 0, 0x67, 0x00);
+        }
+
+        Command command;
+        command.cla = apdu[0];
+        command.ins = apdu[1];
+        command.p1 = apdu[2];
+        command.p2 = apdu[3];
+        command.lc = length > 5 ? apdu[4] : 0;
+        command.data = apdu + 5;
+        if (5 + command.lc > length)
+        {
+            return this->isoStatus(response, 0, 0x67, 0x00);
+        }
+
+        if (command.cla == 0x00)
+        {
+            this->pending = PENDING_NONE;
+            if (command.ins == 0xA4)
+            {
+                this->selects++;
+                return this->isoSelectFile(command, response);
+            }
+            return this->isoStatus(response, 0, 0x6D, 0x00);
+        }
+        if (command.cla != 0x90)
+        {
+            return this->isoStatus(response, 0, 0x6E, 0x00);
+        }
+
+        // A command other than the expected additional frame aborts the chain
+        uint8_t pending = this->pending;
+        this->pending = PENDING_NONE;
+        if (command.ins == 0xAF)
+        {
+            if (pending == PENDING_AUTHENTICATION)
+            {
+                return this->authenticatePart2(command, response);
+            }
+            if (pending == PENDING_VERSION_2 || pending == PENDING_VERSION_3)
+            {
+                return this->getVersion(pending, response);
+            }
+            return this->status(response, 0, ILLEGAL_COMMAND);
+        }
+
+        switch (command.ins)
+        {
+        case 0x60:
+            return this->getVersion(PENDING_NONE, response);
+        case 0x71:
+            return this->authenticateEV2First(command, response);
+        case 0xC4:
+            return this->changeKey(command, response);
+        case 0x51:
+            return this->getCardUid(command, response);
+        case 0xAD:
+            return this->readData(command, response);
+        default:
+            return this->status(response, 0, ILLEGAL_COMMAND);
+        }
+    }
+
+private:
+    static constexpr uint8_t PENDING_NONE = 0;
+    static constexpr uint8_t PENDING_AUTHENTICATION = 1;
+    static constexpr uint8_t PENDING_VERSION_2 = 2;
+    static constexpr uint8_t PENDING_VERSION_3 = 3;
+
+    struct Command
+    {
+        uint8_t cla;
+        uint8_t ins;
+        uint8_t p1;
+        uint8_t p2;
+        uint8_t lc;
+        const uint8_t *data;
+    };
+
+    uint8_t uid[UID_LENGTH];
+    uint8_t keys[KEY_COUNT][KEY_SIZE];
+    uint8_t keyVersions[KEY_COUNT];
+    uint8_t ccFile[CC_FILE_SIZE];
+    uint8_t ndefFile[NDEF_FILE_SIZE];
+    uint8_t proprietaryFile[PROPRIETARY_FILE_SIZE];
+
+    bool appSelected = false;
+    uint8_t pending = PENDING_NONE;
+    uint8_t pendingKeyNo = 0;
+    uint8_t rndB[16];
+
+    bool authenticated = false;
+    uint8_t authKeyNo = 0;
+    uint8_t ti[4];
+    uint16_t cmdCtr = 0;
+    uint8_t sesAuthEncKey[KEY_SIZE];
+    uint8_t sesAuthMacKey[KEY_SIZE];
+
+    uint8_t hwType;
+    uint32_t apdus = 0;
+    uint32_t selects = 0;
+    uint32_t versions = 0;
+
+    uint8_t isoStatus(uint8_t *response, uint8_t length, uint8_t sw1, uint8_t sw2)
+    {
+        response[length] = sw1;
+        response[length + 1] = sw2;
+        return length + 2;
+    }
+
+    uint8_t status(uint8_t *response, uint8_t length, uint8_t sw2)
+    {
+        // An error ends the session, except for the additional frame request
+        if (sw2 != OPERATION_OK && sw2 != ADDITIONAL_FRAME)
+        {
+            this->endSession();
+        }
+        return this->isoStatus(response, length, 0x91, sw2);
+    }
+
+    void endSession()
+    {
+        this->authenticated = false;
+        this->cmdCtr = 0;
+        memset(this->sesAuthEncKey, 0, sizeof(this->sesAuthEncKey));
+        memset(this->sesAuthMacKey, 0, sizeof(this->sesAuthMacKey));
+    }
+
+    uint8_t isoSelectFile(const Command &command, uint8_t *response)
+    {
+        static const uint8_t NTAG424_DF_NAME[7] = {0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01};
+
+        // Selecting a DF ends the session, selecting a file of the application does not
+        if (command.p1 == 0x04)
+        {
+            this->endSession();
+            if (command.lc != sizeof(NTAG424_DF_NAME) || memcmp(command.data, NTAG424_DF_NAME, sizeof(NTAG424_DF_NAME)) != 0)
+            {
+                this->appSelected = false;
+                return this->isoStatus(response, 0, 0x6A, 0x82);
+            }
+            this->appSelected = true;
+            return this->isoStatus(response, 0, 0x90, 0x00);
+        }
+
+        if (command.p1 != 0x00 || command.lc != 2)
+        {
+            return this->isoStatus(response, 0, 0x6A, 0x86);
+        }
+        uint16_t fileId = (command.data[0] << 8) | command.data[1];
+        if (fileId == 0x3F00 || fileId == 0xE110)
+        {
+            this->endSession();
+            this->appSelected = fileId == 0xE110;
+        }
+        else if (!this->appSelected || fileId < 0xE103 || fileId > 0xE105)
+        {
+            return this->isoStatus(response, 0, 0x6A, 0x82);
+        }
+        return this->isoStatus(response, 0, 0x90, 0x00);
+    }
+
+    uint8_t getVersion(uint8_t part, uint8_t *response)
+    {
+        // Vendor NXP, HW type (4 for NTAG), 50 pF, v3.0, 416 bytes, ISO14443-4
+        static const uint8_t HW_INFO[7] = {0x04, 0x04, 0x02, 0x30, 0x00, 0x11, 0x05};
+        static const uint8_t SW_INFO[7] = {0x04, 0x04, 0x02, 0x01, 0x02, 0x11, 0x05};
+        // Batch number, fab key, production week and year (2024)
+        static const uint8_t PRODUCTION[7] = {0xCF, 0x39, 0x41, 0xB2, 0x40, 0x1D, 0x24};
+
+        if (part == PENDING_NONE)
+        {
+            this->versions++;
+            memcpy(response, HW_INFO, sizeof(HW_INFO));
+            response[1] = this->hwType;
+            this->pending = PENDING_VERSION_2;
+            return this->status(response, sizeof(HW_INFO), ADDITIONAL_FRAME);
+        }
+        if (part == PENDING_VERSION_2)
+        {
+            memcpy(response, SW_INFO, sizeof(SW_INFO));
+            this->pending = PENDING_VERSION_3;
+            return this->status(response, sizeof(SW_INFO), ADDITIONAL_FRAME);
+        }
+        memcpy(response, this->uid, UID_LENGTH);
+        memcpy(response + UID_LENGTH, PRODUCTION, sizeof(PRODUCTION));
+        return this->status(response, UID_LENGTH + sizeof(PRODUCTION), OPERATION_OK);
+    }
+
+    uint8_t authenticateEV2First(const Command &command, uint8_t *response)
+    {
+        // A new authentication always ends the previous session
+        this->endSession();
+        if (!this->appSelected)
+        {
+            return this->status(response, 0, PERMISSION_DENIED);
+        }
+        if (command.lc < 2 || command.lc != 2 + command.data[1])
+        {
+            return this->status(response, 0, LENGTH_ERROR);
+        }
+        if (command.data[0] >= KEY_COUNT)
+        {
+            return this->status(response, 0, NO_SUCH_KEY);
+        }
+
+        this->pendingKeyNo = command.data[0];
+        esp_fill_random(this->rndB, sizeof(this->rndB));
+        uint8_t iv[16] = {};
+        if (!this->cbc(MBEDTLS_AES_ENCRYPT, this->keys[this->pendingKeyNo], iv, this->rndB, sizeof(this->rndB), response))
+        {
+            return this->status(response, 0, AUTHENTICATION_ERROR);
+        }
+        this->pending = PENDING_AUTHENTICATION;
+        return this->status(response, sizeof(this->rndB), ADDITIONAL_FRAME);
+    }
+
+    uint8_t authenticatePart2(const Command &command, uint8_t *response)
+    {
+        if (command.lc != 32)
+        {
+            return this->status(response, 0, LENGTH_ERROR);
+        }
+
+        const uint8_t *key = this->keys[this->pendingKeyNo];
+        uint8_t iv[16] = {};
+        uint8_t plain[32];
+        if (!this->cbc(MBEDTLS_AES_DECRYPT, key, iv, command.data, 32, plain))
+        {
+            return this->status(response, 0, AUTHENTICATION_ERROR);
+        }
+
+        // RndA || RndB rotated left by one byte
+        const uint8_t *rndA = plain;
+        for (uint8_t i = 0; i < 16; i++)
+        {
+            if (plain[16 + i] != this->rndB[(i + 1) % 16])
+            {
+                return this->status(response, 0, AUTHENTICATION_ERROR);
+            }
+        }
+
+        // TI || RndA rotated left || PDcap2 || PCDcap2
+        uint8_t answer[32] = {};
+        esp_fill_random(this->ti, sizeof(this->ti));
+        memcpy(answer, this->ti, sizeof(this->ti));
+        for (uint8_t i = 0; i < 16; i++)
+        {
+            answer[4 + i] = rndA[(i + 1) % 16];
+        }
+        memset(iv, 0, sizeof(iv));
+        if (!this->cbc(MBEDTLS_AES_ENCRYPT, key, iv, answer, sizeof(answer), response) ||
+            !this->deriveSessionKeys(key, rndA))
+        {
+            return this->status(response, 0, AUTHENTICATION_ERROR);
+        }
+
+        this->authenticated = true;
+        this->authKeyNo = this->pendingKeyNo;
+        this->cmdCtr = 0;
+        return this->status(response, sizeof(answer), OPERATION_OK);
+    }
+
+    // SV1/SV2 = label || 00 01 00 80 || RndA[15..14] || (RndA[13..8] ^ RndB[15..10]) || RndB[9..0] || RndA[7..0]
+    bool deriveSessionKeys(const uint8_t *key, const uint8_t *rndA)
+    {
+        uint8_t sv[32] = {0xA5, 0x5A, 0x00, 0x01, 0x00, 0x80};
+        sv[6] = rndA[0];
+        sv[7] = rndA[1];
+        for (uint8_t i = 0; i < 6; i++)
+        {
+            sv[8 + i] = rndA[2 + i] ^ this->rndB[i];
+        }
+        memcpy(sv + 14, this->rndB + 6, 10);
+        memcpy(sv + 24, rndA + 8, 8);
+        if (!this->cmac(key, sv, sizeof(sv), this->sesAuthEncKey))
+        {
+            return false;
+        }
+        sv[0] = 0x5A;
+        sv[1] = 0xA5;
+        return this->cmac(key, sv, sizeof(sv), this->sesAuthMacKey);
+    }
+
+    // ChangeKey, CommMode.Full: KeyNo || E(KeyData) || MACt
+    uint8_t changeKey(const Command &command, uint8_t *response)
+    {
+        if (!this->authenticated || this->authKeyNo != 0)
+        {
+            return this->status(response, 0, PERMISSION_DENIED);
+        }
+        if (command.lc != 1 + 32 + 8)
+        {
+            return this->status(response, 0, LENGTH_ERROR);
+        }
+        uint8_t keyNo = command.data[0];
+        if (keyNo >= KEY_COUNT)
+        {
+            return this->status(response, 0, NO_SUCH_KEY);
+        }
+        if (!this->verifyCommandMac(command.ins, command.data, 1 + 32, command.data + 1 + 32))
+        {
+            return this->status(response, 0, INTEGRITY_ERROR);
+        }
+
+        uint8_t keyData[32];
+        if (!this->decryptCommandData(command.data + 1, sizeof(keyData), keyData))
+        {
+            return this->status(response, 0, INTEGRITY_ERROR);
+        }
+
+        // Key 0: NewKey || KeyVer, others: (NewKey ^ OldKey) || KeyVer || CRC32NK
+        uint8_t newKey[KEY_SIZE];
+        uint8_t dataLength = keyNo == 0 ? 17 : 21;
+        for (uint8_t i = 0; i < KEY_SIZE; i++)
+        {
+            newKey[i] = keyNo == 0 ? keyData[i] : keyData[i] ^ this->keys[keyNo][i];
+        }
+        if (keyNo != 0)
+        {
+            uint32_t crc = jamCrc32(newKey, KEY_SIZE);
+            uint8_t crcBytes[4] = {(uint8_t)crc, (uint8_t)(crc >> 8), (uint8_t)(crc >> 16), (uint8_t)(crc >> 24)};
+            if (memcmp(keyData + 17, crcBytes, sizeof(crcBytes)) != 0)
+            {
+                return this->status(response, 0, INTEGRITY_ERROR);
+            }
+        }
+        if (keyData[dataLength] != 0x80)
+        {
+            return this->status(response, 0, INTEGRITY_ERROR);
+        }
+
+        memcpy(this->keys[keyNo], newKey, KEY_SIZE);
+        this->keyVersions[keyNo] = keyData[16];
+        this->cmdCtr++;
+
+        // Changing the key of the session ends it, the answer has no MAC
+        if (keyNo == this->authKeyNo)
+        {
+            this->endSession();
+            return this->status(response, 0, OPERATION_OK);
+        }
+        uint8_t length = this->responseMac(nullptr, 0, response);
+        return this->status(response, length, OPERATION_OK);
+    }
+
+    // GetCardUID, CommMode.Full: E(UID) || MACt
+    uint8_t getCardUid(const Command &command, uint8_t *response)
+    {
+        if (!this->authenticated)
+        {
+            return this->status(response, 0, PERMISSION_DENIED);
+        }
+        if (command.lc != 8 || !this->verifyCommandMac(command.ins, nullptr, 0, command.data))
+        {
+            return this->status(response, 0, INTEGRITY_ERROR);
+        }
+        this->cmdCtr++;
+
+        uint8_t plain[16] = {};
+        memcpy(plain, this->uid, UID_LENGTH);
+        plain[UID_LENGTH] = 0x80;
+        uint8_t iv[16];
+        if (!this->sessionIv(0x5A, 0xA5, iv) ||
+            !this->cbc(MBEDTLS_AES_ENCRYPT, this->sesAuthEncKey, iv, plain, sizeof(plain), response))
+        {
+            return this->status(response, 0, INTEGRITY_ERROR);
+        }
+        uint8_t length = this->responseMac(response, sizeof(plain), response + sizeof(plain));
+        return this->status(response, sizeof(plain) + length, OPERATION_OK);
+    }
+
+    // ReadData, CommMode.Plain: FileNo || Offset (3, LSB first) || Length (3)
+    uint8_t readData(const Command &command, uint8_t *response)
+    {
+        if (!this->appSelected)
+        {
+            return this->status(response, 0, PERMISSION_DENIED);
+        }
+        if (command.lc != 7)
+        {
+            return this->status(response, 0, LENGTH_ERROR);
+        }
+
+        const uint8_t *file;
+        uint32_t fileSize;
+        switch (command.data[0])
+        {
+        case 0x01:
+            file = this->ccFile;
+            fileSize = sizeof(this->ccFile);
+            break;
+        case 0x02:
+            file = this->ndefFile;
+            fileSize = sizeof(this->ndefFile);
+            break;
+        case 0x03:
+            // Read with key 2 in CommMode.Full only
+            return this->status(response, 0, PERMISSION_DENIED);
+        default:
+            return this->status(response, 0, PARAMETER_ERROR);
+        }
+
+        uint32_t offset = command.data[1] | (command.data[2] << 8) | (command.data[3] << 16);
+        uint32_t length = command.data[4] | (command.data[5] << 8) | (command.data[6] << 16);
+        if (length == 0 && offset < fileSize)
+        {
+            length = fileSize - offset;
+        }
+        // The reader's frame holds a short answer only, longer reads would chain
+        if (offset + length > fileSize || length > 59)
+        {
+            return this->status(response, 0, BOUNDARY_ERROR);
+        }
+
+        if (this->authenticated)
+        {
+            this->cmdCtr++;
+        }
+        memcpy(response, file + offset, length);
+        return this->status(response, length, OPERATION_OK);
+    }
+
+    // MACt(SesAuthMACKey, Cmd || CmdCtr || TI || header and data)
+    bool verifyCommandMac(uint8_t ins, const uint8_t *data, uint8_t length, const uint8_t *mac)
+    {
+        uint8_t expected[8];
+        return this->truncatedMac(ins, data, length, expected) && memcmp(expected, mac, sizeof(expected)) == 0;
+    }
+
+    // MACt(SesAuthMACKey, RC || CmdCtr || TI || data), called after CmdCtr was increased
+    uint8_t responseMac(const uint8_t *data, uint8_t length, uint8_t *mac)
+    {
+        return this->truncatedMac(OPERATION_OK, data, length, mac) ? 8 : 0;
+    }
+
+    bool truncatedMac(uint8_t code, const uint8_t *data, uint8_t length, uint8_t *mac)
+    {
+        uint8_t input[7 + 64];
+        input[0] = code;
+        input[1] = (uint8_t)this->cmdCtr;
+        input[2] = (uint8_t)(this->cmdCtr >> 8);
+        memcpy(input + 3, this->ti, sizeof(this->ti));
+        if (length > 0)
+        {
+            memcpy(input + 7, data, length);
+        }
+        uint8_t full[16];
+        if (!this->cmac(this->sesAuthMacKey, input, 7 + length, full))
+        {
+            return false;
+        }
+        // The odd bytes of the CMAC
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            mac[i] = full[2 * i + 1];
+        }
+        return true;
+    }
+
+    bool decryptCommandData(const uint8_t *data, uint8_t length, uint8_t *plain)
+    {
+        uint8_t iv[16];
+        return this->sessionIv(0xA5, 0x5A, iv) &&
+               this->cbc(MBEDTLS_AES_DECRYPT, this->sesAuthEncKey, iv, data, length, plain);
+    }
+
+    // IV = E(SesAuthENCKey, label || TI || CmdCtr || 00 * 8)
+    bool sessionIv(uint8_t label0, uint8_t label1, uint8_t iv[16])
+    {
+        uint8_t input[16] = {label0, label1};
+        memcpy(input + 2, this->ti, sizeof(this->ti));
+        input[6] = (uint8_t)this->cmdCtr;
+        input[7] = (uint8_t)(this->cmdCtr >> 8);
+        uint8_t zero[16] = {};
+        return this->cbc(MBEDTLS_AES_ENCRYPT, this->sesAuthEncKey, zero, input, sizeof(input), iv);
+    }
+
+    static bool cbc(int mode, const uint8_t *key, uint8_t iv[16], const uint8_t *input, size_t length, uint8_t *output)
+    {
+        mbedtls_aes_context context;
+        mbedtls_aes_init(&context);
+        int ret = mode == MBEDTLS_AES_ENCRYPT ? mbedtls_aes_setkey_enc(&context, key, 128)
+                                              : mbedtls_aes_setkey_dec(&context, key, 128);
+        if (ret == 0)
+        {
+            ret = mbedtls_aes_crypt_cbc(&context, mode, length, iv, input, output);
+        }
+        mbedtls_aes_free(&context);
+        return ret == 0;
+    }
+
+    static bool cmac(const uint8_t *key, const uint8_t *input, size_t length, uint8_t *output)
+    {
+        return mbedtls_cipher_cmac(mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB),
+                                   key, 128, input, length, output) == 0;
+    }
+
+    // CRC32 of the IEEE polynomial without the final inversion
+    static uint32_t jamCrc32(const uint8_t *data, size_t length)
+    {
+        uint32_t crc = 0xFFFFFFFF;
+        for (size_t i = 0; i < length; i++)
+        {
+            crc ^= data[i];
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+            }
+        }
+        return crc;
+    }
+};
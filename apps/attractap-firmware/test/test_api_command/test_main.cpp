@@ -0,0 +1,371 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <new>
+#include <string>
+#include "api/apiCommand.hpp"
+#include "api/arenaAllocator.hpp"
+#include "../benchmark.hpp"
+
+// Every operator new of the process is counted, the tests compare the count
+// before and after a decode
+static std::atomic<uint32_t> heapAllocations(0);
+
+void *operator new(size_t size)
+{
+    heapAllocations++;
+    void *pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t size) noexcept
+{
+    (void)size;
+    free(pointer);
+}
+
+namespace
+{
+    // Recorded server traffic of a reader in the wait-for-nfc-tap state, one
+    // tap from enabling card checking to the success message
+    const char *const TRAFFIC[] = {
+        R"({"event":"RESPONSE","data":{"type":"HEARTBEAT","payload":{"seq":1842,"ts":1760613019443}}})",
+        R"({"event":"EVENT","data":{"type":"NFC_ENABLE_CARD_CHECKING","payload":{"type":"toggle-resource-usage","resource":{"id":3,"name":"Laser Cutter","description":"Epilog Zing 24","imageFilename":null},"isActive":false,"activeUsageSession":null,"hasActiveMaintenance":false,"maintenances":[]}}})",
+        R"({"event":"EVENT","data":{"type":"DISPLAY_TEXT","payload":{"message":"Do not remove card!"}}})",
+        R"({"event":"EVENT","data":{"type":"NFC_AUTHENTICATE","payload":{"authenticationKey":"8f4e2c1d9a7b6053e1f2a3b4c5d6e7f8","keyNumber":0}}})",
+        R"({"event":"EVENT","data":{"type":"DISPLAY_SUCCESS","payload":{"message":"Resource started"}}})",
+        R"({"event":"RESPONSE","data":{"type":"HEARTBEAT","payload":{"seq":1843,"ts":1760613049448}}})",
+    };
+    const size_t TRAFFIC_COUNT = sizeof(TRAFFIC) / sizeof(TRAFFIC[0]);
+
+    const char *const CHANGE_KEY = R"({"event":"EVENT","data":{"type":"NFC_CHANGE_KEY","payload":{"keyNumber":1,"authKey":"00000000000000000000000000000000","oldKey":"00000000000000000000000000000000","newKey":"000102030405060708090a0b0c0d0e0F"}}})";
+
+    // One frame per event type of apps/api/src/attractap/websockets/websocket.types.ts,
+    // with the payloads of websocket.encoding.spec.ts
+    const char *const EVENT_TYPE_FRAMES[] = {
+        R"({"event":"EVENT","data":{"type":"READER_REGISTER","payload":{"id":12,"token":"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"}}})",
+        R"({"event":"EVENT","data":{"type":"READER_AUTHENTICATE","payload":{}}})",
+        R"({"event":"EVENT","data":{"type":"NFC_AUTHENTICATE","payload":{"keyNumber":1,"authenticationKey":"00112233445566778899aabbccddeeff"}}})",
+        R"({"event":"EVENT","data":{"type":"READER_UNAUTHORIZED","payload":{"message":"PLEASE_REREGISTER"}}})",
+        R"({"event":"EVENT","data":{"type":"READER_REQUEST_AUTHENTICATION","payload":{"id":12,"token":"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa","encodings":["MSGPACK"]}}})",
+        R"({"event":"EVENT","data":{"type":"READER_AUTHENTICATED","payload":{"name":"Laser Cutter","features":["BATCH"],"encoding":"MSGPACK"}}})",
+        R"({"event":"EVENT","data":{"type":"NFC_TAP","payload":{"cardUID":"04a1b2c3d4e5f6"}}})",
+        R"({"event":"EVENT","data":{"type":"NFC_CHANGE_KEY","payload":{"keyNumber":0,"authKey":"00112233445566778899aabbccddeeff","oldKey":"00112233445566778899aabbccddeeff","newKey":"00112233445566778899aabbccddeeff"}}})",
+        R"({"event":"EVENT","data":{"type":"NFC_ENABLE_CARD_CHECKING","payload":{"type":"toggle-resource-usage","user":{"id":3,"username":"jane"}}}})",
+        R"({"event":"EVENT","data":{"type":"WAIT_FOR_PROCESSING","payload":{"message":"Processing..."}}})",
+        R"({"event":"EVENT","data":{"type":"DISPLAY_TEXT","payload":{"message":"Tap your card","duration":5000}}})",
+        R"({"event":"EVENT","data":{"type":"DISPLAY_SUCCESS","payload":{"message":"Usage started","duration":3000}}})",
+        R"({"event":"EVENT","data":{"type":"DISPLAY_ERROR","payload":{"message":"Unknown card","duration":3000}}})",
+        R"({"event":"EVENT","data":{"type":"CANCEL","payload":{}}})",
+        R"({"event":"EVENT","data":{"type":"READER_FIRMWARE_UPDATE_REQUIRED","payload":{"current":{"name":"attractap_solo","variant":"default","version":"1.0.0"},"available":{"name":"attractap_solo","variant":"default","version":"1.1.0"},"firmware":{"chunks":256,"totalSize":1048576}}}})",
+        R"({"event":"EVENT","data":{"type":"READER_FIRMWARE_STREAM_CHUNK","payload":{"chunkIndex":42}}})",
+        R"({"event":"EVENT","data":{"type":"READER_FIRMWARE_INFO","payload":{"name":"attractap_solo","variant":"default","version":"1.0.0"}}})",
+        R"({"event":"EVENT","data":{"type":"SELECT_ITEM","payload":{"label":"Select resource","options":[{"id":1,"label":"Laser Cutter"},{"id":2,"label":"3D Printer"}]}}})",
+        R"({"event":"EVENT","data":{"type":"CONFIRM_ACTION","payload":{"message":"Start usage?"}}})",
+        R"({"event":"EVENT","data":{"type":"HEARTBEAT","payload":{"seq":1234,"ts":98765432}}})",
+        R"({"event":"EVENT","data":{"type":"READER_JOURNAL_ENTRY","payload":{"id":1073741825,"kind":"NFC_TAP","cardUID":"04a1b2c3d4e5f6","ageMs":42000}}})",
+        R"({"event":"EVENT","data":{"type":"READER_ACCESS_LIST","payload":{"version":2,"baseVersion":1,"reset":false,"issuedAt":1700000000,"expiresAt":1700086400,"resources":[7],"upsert":[["04a1b2c3d4e5f6",1,0]],"remove":["04c0ffee"],"signature":"abababababababababababababababababababababababababababababababab"}}})",
+    };
+    const size_t EVENT_TYPE_COUNT = sizeof(EVENT_TYPE_FRAMES) / sizeof(EVENT_TYPE_FRAMES[0]);
+}
+
+class ApiCommandTest : public ::testing::Test
+{
+protected:
+    ApiCommandTest() : arena(arenaBuffer, sizeof(arenaBuffer)), scratch(&arena) {}
+
+    bool decode(const char *message, ApiCommand &command, ApiEncoding encoding = API_ENCODING_JSON, size_t length = 0)
+    {
+        this->scratch.clear();
+        this->arena.reset();
+        return ApiCommandDecoder::decode(message, length > 0 ? length : strlen(message), command, this->scratch, encoding);
+    }
+
+    // Twice the websocket's DECODE_ARENA_SIZE, ArduinoJson's slots and pools
+    // are twice as large with 64 bit pointers
+    alignas(max_align_t) uint8_t arenaBuffer[6144];
+    ArenaAllocator arena;
+    JsonDocument scratch;
+};
+
+TEST_F(ApiCommandTest, TypeNamesRoundTrip)
+{
+    for (uint8_t type = API_COMMAND_READER_REGISTER; type <= API_COMMAND_READER_FIRMWARE_STREAM_CHUNK; type++)
+    {
+        const char *name = ApiCommandDecoder::typeToName((ApiCommandType)type);
+        EXPECT_EQ(ApiCommandDecoder::typeFromName(name, strlen(name)), type) << name;
+    }
+
+    EXPECT_EQ(ApiCommandDecoder::typeFromName("DISPLAY_TEXTS", 13), API_COMMAND_UNKNOWN);
+    EXPECT_EQ(ApiCommandDecoder::typeFromName(nullptr, 0), API_COMMAND_UNKNOWN);
+}
+
+TEST_F(ApiCommandTest, ChangeKeyIsTyped)
+{
+    ApiCommand command;
+    ASSERT_TRUE(decode(CHANGE_KEY, command));
+    EXPECT_EQ(command.type, API_COMMAND_NFC_CHANGE_KEY);
+    EXPECT_STREQ(command.name, "NFC_CHANGE_KEY");
+    EXPECT_TRUE(command.payloadValid);
+    EXPECT_EQ(command.document, nullptr);
+    EXPECT_EQ(command.nfcChangeKey.keyNumber, 1);
+
+    for (uint8_t i = 0; i < API_COMMAND_KEY_LENGTH; i++)
+    {
+        EXPECT_EQ(command.nfcChangeKey.authKey[i], 0);
+        EXPECT_EQ(command.nfcChangeKey.newKey[i], i);
+    }
+
+    // Nothing to copy, the payload travels in the command itself
+    EXPECT_TRUE(ApiCommandDecoder::detach(command, this->scratch));
+    EXPECT_EQ(command.document, nullptr);
+}
+
+TEST_F(ApiCommandTest, MalformedKeysInvalidateThePayload)
+{
+    ApiCommand command;
+    ASSERT_TRUE(decode(R"({"event":"EVENT","data":{"type":"NFC_AUTHENTICATE","payload":{"authenticationKey":"8f4e2c1d9a7b6053e1f2a3b4c5d6e7fg","keyNumber":0}}})", command));
+    EXPECT_EQ(command.type, API_COMMAND_NFC_AUTHENTICATE);
+    EXPECT_FALSE(command.payloadValid);
+
+    ASSERT_TRUE(decode(R"({"event":"EVENT","data":{"type":"NFC_AUTHENTICATE","payload":{"authenticationKey":"8f4e2c1d","keyNumber":0}}})", command));
+    EXPECT_FALSE(command.payloadValid);
+
+    ASSERT_TRUE(decode(R"({"event":"EVENT","data":{"type":"NFC_AUTHENTICATE","payload":{"authenticationKey":"8f4e2c1d9a7b6053e1f2a3b4c5d6e7f8"}}})", command));
+    EXPECT_FALSE(command.payloadValid);
+}
+
+TEST_F(ApiCommandTest, InvalidMessagesAreRejected)
+{
+    ApiCommand command;
+    EXPECT_FALSE(decode("{\"event\":\"EVENT\",", command));
+    EXPECT_FALSE(decode(R"({"event":"EVENT","data":{"payload":{}}})", command));
+    EXPECT_EQ(command.document, nullptr);
+
+    ASSERT_TRUE(decode(R"({"event":"EVENT","data":{"type":"SOMETHING_NEW","payload":{}}})", command));
+    EXPECT_EQ(command.type, API_COMMAND_UNKNOWN);
+    EXPECT_STREQ(command.name, "SOMETHING_NEW");
+}
+
+TEST_F(ApiCommandTest, HotCommandsDoNotTouchTheHeap)
+{
+    // Heartbeat echo and NFC_AUTHENTICATE
+    const char *const hot[] = {TRAFFIC[0], TRAFFIC[3]};
+    for (const char *message : hot)
+    {
+        ApiCommand command;
+        uint32_t before = heapAllocations;
+        ASSERT_TRUE(decode(message, command));
+        EXPECT_EQ(heapAllocations - before, 0u) << message;
+        EXPECT_EQ(command.document, nullptr);
+        ApiCommandDecoder::release(command);
+    }
+
+    ApiCommand heartbeat;
+    ASSERT_TRUE(decode(TRAFFIC[0], heartbeat));
+    JsonObjectConst payload = ApiCommandDecoder::payloadOf(heartbeat, this->scratch);
+    EXPECT_EQ(payload["seq"].as<uint32_t>(), 1842u);
+    EXPECT_EQ(payload["ts"].as<uint64_t>(), 1760613019443ull);
+}
+
+TEST_F(ApiCommandTest, DetachedCommandsOutliveTheScratchDocument)
+{
+    ApiCommand command;
+    ASSERT_TRUE(decode(TRAFFIC[1], command));
+    EXPECT_EQ(command.type, API_COMMAND_NFC_ENABLE_CARD_CHECKING);
+    EXPECT_EQ(command.document, nullptr);
+    ASSERT_TRUE(ApiCommandDecoder::detach(command, this->scratch));
+    ASSERT_NE(command.document, nullptr);
+
+    // The next message reuses the arena
+    ApiCommand next;
+    ASSERT_TRUE(decode(TRAFFIC[2], next));
+
+    JsonObjectConst payload = ApiCommandDecoder::payloadOf(command, this->scratch);
+    EXPECT_STREQ(payload["resource"]["name"].as<const char *>(), "Laser Cutter");
+    EXPECT_STREQ(ApiCommandDecoder::payloadOf(next, this->scratch)["message"].as<const char *>(), "Do not remove card!");
+
+    ApiCommandDecoder::release(command);
+    EXPECT_EQ(command.document, nullptr);
+}
+
+TEST_F(ApiCommandTest, MessagesLargerThanTheArenaFallBackToTheHeap)
+{
+    // A SELECT_ITEM with more options than the scratch arena holds
+    String message = R"({"event":"EVENT","data":{"type":"SELECT_ITEM","payload":{"label":"Resource","options":[)";
+    for (int i = 0; i < 300; i++)
+    {
+        message += (i > 0 ? ",{\"id\":" : "{\"id\":") + String(i) + ",\"label\":\"Resource number " + String(i) + "\"}";
+    }
+    message += "]}}}";
+
+    ApiCommand command;
+    ASSERT_TRUE(decode(message.c_str(), command));
+    EXPECT_EQ(command.type, API_COMMAND_SELECT_ITEM);
+    ASSERT_NE(command.document, nullptr);
+    EXPECT_GT(this->arena.getStats().failedAllocations, 0u);
+
+    JsonObjectConst payload = ApiCommandDecoder::payloadOf(command, this->scratch);
+    EXPECT_EQ(payload["options"].size(), 300u);
+    EXPECT_STREQ(payload["options"][299]["label"].as<const char *>(), "Resource number 299");
+
+    // Already owns its document
+    JsonDocument *document = command.document;
+    EXPECT_TRUE(ApiCommandDecoder::detach(command, this->scratch));
+    EXPECT_EQ(command.document, document);
+    ApiCommandDecoder::release(command);
+}
+
+TEST_F(ApiCommandTest, DecodesMessagePack)
+{
+    JsonDocument source;
+    source["event"] = "EVENT";
+    source["data"]["type"] = "NFC_AUTHENTICATE";
+    source["data"]["payload"]["authenticationKey"] = "8f4e2c1d9a7b6053e1f2a3b4c5d6e7f8";
+    source["data"]["payload"]["keyNumber"] = 2;
+    char packed[256];
+    size_t length = serializeMsgPack(source, packed, sizeof(packed));
+
+    ApiCommand command;
+    ASSERT_TRUE(decode(packed, command, API_ENCODING_MSGPACK, length));
+    EXPECT_EQ(command.type, API_COMMAND_NFC_AUTHENTICATE);
+    EXPECT_TRUE(command.payloadValid);
+    EXPECT_EQ(command.nfcAuthenticate.keyNumber, 2);
+    EXPECT_EQ(command.nfcAuthenticate.authKey[0], 0x8f);
+    EXPECT_EQ(command.nfcAuthenticate.authKey[15], 0xf8);
+}
+
+TEST_F(ApiCommandTest, WrapsRawFirmwareChunks)
+{
+    uint8_t chunk[64];
+    for (size_t i = 0; i < sizeof(chunk); i++)
+    {
+        chunk[i] = (uint8_t)i;
+    }
+
+    ApiCommand command;
+    ASSERT_TRUE(ApiCommandDecoder::wrapFirmwareChunk(chunk, sizeof(chunk), command));
+    EXPECT_EQ(command.type, API_COMMAND_READER_FIRMWARE_STREAM_CHUNK);
+    ASSERT_NE(command.document, nullptr);
+
+    MsgPackBinary data = ApiCommandDecoder::payloadOf(command, this->scratch)["data"].as<MsgPackBinary>();
+    ASSERT_EQ(data.size(), sizeof(chunk));
+    EXPECT_EQ(memcmp(data.data(), chunk, sizeof(chunk)), 0);
+    ApiCommandDecoder::release(command);
+}
+
+TEST_F(ApiCommandTest, BenchmarkRecordedTraffic)
+{
+    size_t next = 0;
+    uint32_t decoded = 0;
+
+    // Before: every message was parsed into a heap document of its own
+    uint32_t before = heapAllocations;
+    BenchmarkResult heap = runBenchmark("decode into a heap document", 100000, [&]()
+                                        {
+        const char *message = TRAFFIC[next++ % TRAFFIC_COUNT];
+        JsonDocument *doc = new JsonDocument();
+        if (!deserializeJson(*doc, message, strlen(message)))
+        {
+            const char *name = (*doc)["data"]["type"].as<const char *>();
+            decoded += ApiCommandDecoder::typeFromName(name, strlen(name)) != API_COMMAND_UNKNOWN;
+        }
+        delete doc; });
+    uint32_t heapDocuments = heapAllocations - before;
+    uint32_t heapMessages = heap.iterations + heap.iterations / 10 + 1;
+
+    // After: parsed in the arena, only commands for the API task are copied out
+    before = heapAllocations;
+    BenchmarkResult arena = runBenchmark("decode into the arena document", 100000, [&]()
+                                         {
+        ApiCommand command;
+        if (decode(TRAFFIC[next++ % TRAFFIC_COUNT], command))
+        {
+            decoded++;
+            if (command.type != API_COMMAND_HEARTBEAT)
+            {
+                ApiCommandDecoder::detach(command, this->scratch);
+            }
+            ApiCommandDecoder::release(command);
+        } });
+    uint32_t arenaDocuments = heapAllocations - before;
+    uint32_t arenaMessages = arena.iterations + arena.iterations / 10 + 1;
+
+    printf("[ BENCH    ] heap documents per message: %.2f before, %.2f after (arena high water %u of %u bytes), %.2fx time per message\n",
+           (double)heapDocuments / heapMessages, (double)arenaDocuments / arenaMessages,
+           (unsigned)this->arena.getStats().highWater, (unsigned)this->arena.getStats().capacity,
+           arena.nsPerOp / heap.nsPerOp);
+
+    EXPECT_GT(decoded, 0u);
+    // Heartbeats and NFC_AUTHENTICATE, half of the recorded traffic, stay in the arena
+    EXPECT_LE((double)arenaDocuments / arenaMessages, 0.51);
+    EXPECT_EQ(this->arena.getStats().failedAllocations, 0u);
+}
+
+// Frame size and encode/decode time of every event type in both encodings,
+// decoded into the arena document like the websocket task does
+TEST_F(ApiCommandTest, BenchmarkEncodingPerEventType)
+{
+    char json[512];
+    char packed[512];
+    double jsonBytes = 0;
+    double packedBytes = 0;
+
+    for (size_t i = 0; i < EVENT_TYPE_COUNT; i++)
+    {
+        JsonDocument source;
+        ASSERT_FALSE(deserializeJson(source, EVENT_TYPE_FRAMES[i]));
+        const char *type = source["data"]["type"].as<const char *>();
+        size_t jsonLength = serializeJson(source, json, sizeof(json));
+        size_t packedLength = serializeMsgPack(source, packed, sizeof(packed));
+
+        BenchmarkResult jsonEncode = measureBenchmark(10000, [&]()
+                                                      { serializeJson(source, json, sizeof(json)); });
+        BenchmarkResult packedEncode = measureBenchmark(10000, [&]()
+                                                        { serializeMsgPack(source, packed, sizeof(packed)); });
+        BenchmarkResult jsonDecode = measureBenchmark(10000, [&]()
+                                                      {
+            this->scratch.clear();
+            this->arena.reset();
+            deserializeJson(this->scratch, json, jsonLength); });
+        BenchmarkResult packedDecode = measureBenchmark(10000, [&]()
+                                                        {
+            this->scratch.clear();
+            this->arena.reset();
+            deserializeMsgPack(this->scratch, packed, packedLength); });
+
+        printf("[ BENCH    ] %-32s JSON %4u B %6.1f/%6.1f ns, MSGPACK %4u B %6.1f/%6.1f ns (encode/decode)\n",
+               type, (unsigned)jsonLength, jsonEncode.nsPerOp, jsonDecode.nsPerOp,
+               (unsigned)packedLength, packedEncode.nsPerOp, packedDecode.nsPerOp);
+        jsonBytes += jsonLength;
+        packedBytes += packedLength;
+
+        // The last decode is the MessagePack frame, it reads back as the JSON one
+        std::string roundTrip;
+        serializeJson(this->scratch, roundTrip);
+        EXPECT_EQ(roundTrip, std::string(json, jsonLength)) << type;
+        EXPECT_LE(packedLength, jsonLength) << type;
+    }
+
+    printf("[ BENCH    ] %-32s MSGPACK frames are %.0f%% of JSON\n", "all event types", 100.0 * packedBytes / jsonBytes);
+    EXPECT_EQ(this->arena.getStats().failedAllocations, 0u);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include "nfc/cardPresence.hpp"
+
+namespace
+{
+    // Same timing as NFC: TAP_HOLD_OFF_MS and CARD_REARM_MS
+    const uint32_t HOLD_OFF_MS = 1000;
+    const uint32_t REARM_MS = 300;
+
+    const uint8_t CARD_A[7] = {0x04, 0x51, 0x2a, 0x6a, 0x9c, 0x11, 0x90};
+    const uint8_t CARD_B[7] = {0x04, 0x7e, 0x13, 0x02, 0xb1, 0x5d, 0x80};
+}
+
+class CardPresenceTest : public ::testing::Test
+{
+protected:
+    CardPresenceTest() : presence(HOLD_OFF_MS, REARM_MS) {}
+
+    // Polls finding the card every `intervalMs` from `fromMs` to `toMs`, returns the reported taps
+    int pollWithCard(const uint8_t *uid, uint32_t fromMs, uint32_t toMs, uint32_t intervalMs = 100)
+    {
+        int taps = 0;
+        for (uint32_t now = fromMs; now <= toMs; now += intervalMs)
+        {
+            taps += this->presence.onCardSeen(uid, 7, now) ? 1 : 0;
+        }
+        return taps;
+    }
+
+    CardPresence presence;
+};
+
+TEST_F(CardPresenceTest, OneTapPerPresentation)
+{
+    EXPECT_EQ(this->presence.getState(0), CardPresence::ABSENT);
+    EXPECT_EQ(pollWithCard(CARD_A, 0, 5000), 1);
+    EXPECT_EQ(this->presence.getState(5000), CardPresence::PRESENT);
+    EXPECT_TRUE(this->presence.isPresent(CARD_A, 7, 5000));
+    EXPECT_FALSE(this->presence.isPresent(CARD_B, 7, 5000));
+}
+
+TEST_F(CardPresenceTest, CardCountsAsRemovedAfterRearmTime)
+{
+    EXPECT_EQ(pollWithCard(CARD_A, 0, 1000), 1);
+
+    // The armed detection stays silent while the field is empty
+    EXPECT_EQ(this->presence.getState(1000 + REARM_MS - 1), CardPresence::PRESENT);
+    EXPECT_EQ(this->presence.getState(1000 + REARM_MS), CardPresence::ABSENT);
+
+    EXPECT_EQ(pollWithCard(CARD_A, 2000, 2500), 1);
+}
+
+TEST_F(CardPresenceTest, ShortDropoutIsTheSamePresentation)
+{
+    EXPECT_EQ(pollWithCard(CARD_A, 0, 2000), 1);
+
+    // A poll that saw only some other target
+    this->presence.onCardGone();
+    EXPECT_EQ(this->presence.getState(2100), CardPresence::REMOVED);
+
+    EXPECT_EQ(pollWithCard(CARD_A, 2200, 3000), 0);
+    EXPECT_EQ(this->presence.getState(3000), CardPresence::PRESENT);
+}
+
+TEST_F(CardPresenceTest, SecondCardWaitsForTheHoldOff)
+{
+    EXPECT_TRUE(this->presence.onCardSeen(CARD_A, 7, 0));
+
+    // Swapped within the hold-off, reported once it has passed
+    EXPECT_EQ(pollWithCard(CARD_B, 200, HOLD_OFF_MS - 100), 0);
+    EXPECT_EQ(pollWithCard(CARD_B, HOLD_OFF_MS, 3000), 1);
+}
+
+TEST_F(CardPresenceTest, CardLeftOnTheReaderWhileDetectionIsDisabled)
+{
+    EXPECT_EQ(pollWithCard(CARD_A, 0, 500), 1);
+
+    // The server processes the tap (WAIT_FOR_PROCESSING, DISPLAY_SUCCESS
+    // for 10 s) and enables card checking again; the card never moved
+    this->presence.suspend(550);
+    EXPECT_EQ(this->presence.getState(6000), CardPresence::PRESENT);
+    this->presence.suspend(8000);
+    this->presence.resume(11000);
+
+    EXPECT_EQ(pollWithCard(CARD_A, 11100, 12000), 0);
+}
+
+TEST_F(CardPresenceTest, PresenceKeepsAgingOnlyWhilePolling)
+{
+    EXPECT_EQ(pollWithCard(CARD_A, 0, 500), 1);
+
+    this->presence.suspend(600);
+    this->presence.resume(10600);
+
+    // 100 ms unseen before the suspension, so 200 ms of polling are left
+    EXPECT_EQ(this->presence.getState(10600 + REARM_MS - 100 - 1), CardPresence::PRESENT);
+    EXPECT_EQ(this->presence.getState(10600 + REARM_MS - 100), CardPresence::ABSENT);
+
+    EXPECT_EQ(pollWithCard(CARD_A, 11000, 11500), 1);
+}
+
+TEST_F(CardPresenceTest, ResumeWithoutSuspendChangesNothing)
+{
+    EXPECT_EQ(pollWithCard(CARD_A, 0, 500), 1);
+    this->presence.resume(5000);
+    EXPECT_EQ(this->presence.getState(5000), CardPresence::ABSENT);
+}
+
+TEST_F(CardPresenceTest, SurvivesTickWraparound)
+{
+    const uint32_t start = UINT32_MAX - 250;
+    EXPECT_TRUE(this->presence.onCardSeen(CARD_A, 7, start));
+    EXPECT_FALSE(this->presence.onCardSeen(CARD_A, 7, start + 200));
+    EXPECT_FALSE(this->presence.onCardSeen(CARD_A, 7, start + 400));
+    EXPECT_EQ(this->presence.getState(start + 400 + REARM_MS - 1), CardPresence::PRESENT);
+    EXPECT_EQ(this->presence.getState(start + 400 + REARM_MS), CardPresence::ABSENT);
+}
+
+TEST_F(CardPresenceTest, ResetForgetsThePresentation)
+{
+    EXPECT_EQ(pollWithCard(CARD_A, 0, 500), 1);
+    this->presence.reset();
+    EXPECT_EQ(this->presence.getState(500), CardPresence::ABSENT);
+
+    // The hold-off still applies to the next tap
+    EXPECT_FALSE(this->presence.onCardSeen(CARD_A, 7, 600));
+    EXPECT_TRUE(this->presence.onCardSeen(CARD_A, 7, 1000));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
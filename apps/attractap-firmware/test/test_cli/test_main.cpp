@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <atomic>
+#include "cli/CLIService.hpp"
+
+// The serial task polls every 10 ms, give it a few rounds to pick up a line
+static bool waitFor(const std::atomic<int> &counter, int expected)
+{
+    for (int i = 0; i < 100 && counter.load() < expected; i++)
+    {
+        delay(5);
+    }
+    return counter.load() >= expected;
+}
+
+class CLIServiceTest : public ::testing::Test
+{
+protected:
+    static CLIService cli;
+    static std::atomic<int> versionRequests;
+    static std::atomic<int> configurationWrites;
+    static String lastPayload;
+
+    static void SetUpTestSuite()
+    {
+        cli.registerCommandHandler(CLI_SERVICE::CLI_COMMAND_GET, "firmware.version", [](const String &payload)
+                                   {
+            lastPayload = payload;
+            versionRequests++; });
+        cli.registerCommandHandler(CLI_SERVICE::CLI_COMMAND_SET, "attraccess.configuration", [](const String &payload)
+                                   {
+            lastPayload = payload;
+            configurationWrites++; });
+        cli.setup();
+    }
+};
+
+CLIService CLIServiceTest::cli;
+std::atomic<int> CLIServiceTest::versionRequests(0);
+std::atomic<int> CLIServiceTest::configurationWrites(0);
+String CLIServiceTest::lastPayload;
+
+TEST_F(CLIServiceTest, DispatchesGetWithoutPayload)
+{
+    int before = versionRequests.load();
+    Serial.inject("CMND GET firmware.version\n");
+
+    ASSERT_TRUE(waitFor(versionRequests, before + 1));
+    EXPECT_TRUE(lastPayload.isEmpty());
+}
+
+TEST_F(CLIServiceTest, DispatchesSetWithPayload)
+{
+    int before = configurationWrites.load();
+    Serial.inject("CMND SET attraccess.configuration {\"hostname\":\"example.com\",\"port\":443}\r\n");
+
+    ASSERT_TRUE(waitFor(configurationWrites, before + 1));
+    EXPECT_EQ(lastPayload, "{\"hostname\":\"example.com\",\"port\":443}");
+}
+
+TEST_F(CLIServiceTest, SkipsLineNoiseBeforeFraming)
+{
+    int before = versionRequests.load();
+    Serial.inject("\x01\x7f garbage CMND get firmware.version\n");
+
+    EXPECT_TRUE(waitFor(versionRequests, before + 1));
+}
+
+TEST_F(CLIServiceTest, IgnoresUnknownCommands)
+{
+    int versions = versionRequests.load();
+    int writes = configurationWrites.load();
+    Serial.inject("CMND GET does.not.exist\nCMND GET firmware.version\n");
+
+    ASSERT_TRUE(waitFor(versionRequests, versions + 1));
+    EXPECT_EQ(configurationWrites.load(), writes);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
@@ -0,0 +1,406 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <vector>
+#include "mbedtls/sha256.h"
+#include <Preferences.h>
+#include "esp_system.h"
+#include "firmwareUpdate/firmwareStream.hpp"
+#include "firmwareUpdate/firmwareUpdate.hpp"
+#include "settings/settings.hpp"
+
+namespace
+{
+    // OTA partition in RAM with the checks esp_ota_* would do: in order
+    // writes only, nothing past the announced size, finish() only for a
+    // complete image
+    class SimulatedSlot : public FirmwareSlot
+    {
+    public:
+        bool begin(size_t imageSize) override
+        {
+            this->begun++;
+            this->image.clear();
+            this->imageSize = imageSize;
+            this->open = imageSize <= CAPACITY;
+            this->bootable = false;
+            this->error = this->open ? nullptr : "image larger than the slot";
+            return this->open;
+        }
+
+        bool write(const uint8_t *data, size_t length) override
+        {
+            if (!this->open || this->image.size() + length > this->imageSize)
+            {
+                this->error = "write outside the image";
+                return false;
+            }
+            if (this->failWriteAt >= 0 && this->image.size() + length > (size_t)this->failWriteAt)
+            {
+                this->error = "flash write failed";
+                return false;
+            }
+            this->image.insert(this->image.end(), data, data + length);
+            return true;
+        }
+
+        bool finish() override
+        {
+            if (!this->open || this->image.size() != this->imageSize)
+            {
+                this->error = "image incomplete";
+                return false;
+            }
+            this->open = false;
+            this->bootable = true;
+            return true;
+        }
+
+        void abort() override
+        {
+            this->aborted++;
+            this->open = false;
+            this->bootable = false;
+        }
+
+        const char *lastError() const override { return this->error; }
+
+        static const size_t CAPACITY = 0x1E0000;
+
+        std::vector<uint8_t> image;
+        size_t imageSize = 0;
+        bool open = false;
+        bool bootable = false;
+        int begun = 0;
+        int aborted = 0;
+        // Offset at which the flash starts refusing writes, -1 for never
+        long failWriteAt = -1;
+        const char *error = nullptr;
+    };
+
+    std::vector<uint8_t> makeImage(size_t size)
+    {
+        std::vector<uint8_t> image(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            image[i] = (uint8_t)(i * 31 + 7);
+        }
+        image[0] = 0xE9;
+        return image;
+    }
+
+    void sha256(const std::vector<uint8_t> &data, uint8_t out[FirmwareStream::SHA256_LENGTH])
+    {
+        mbedtls_sha256_ret(data.data(), data.size(), out, 0);
+    }
+}
+
+class FirmwareStreamTest : public ::testing::Test
+{
+protected:
+    FirmwareStreamTest() : stream(slot) {}
+
+    void startImage(size_t size, size_t chunkSize)
+    {
+        this->image = makeImage(size);
+        this->chunkSize = chunkSize;
+        sha256(this->image, this->hash);
+        ASSERT_TRUE(this->stream.start(size, this->chunkCount(), this->hash));
+    }
+
+    uint32_t chunkCount() const
+    {
+        return (this->image.size() + this->chunkSize - 1) / this->chunkSize;
+    }
+
+    FirmwareStream::ChunkResult sendChunk(uint32_t index, int32_t chunkIndex)
+    {
+        size_t offset = index * this->chunkSize;
+        size_t length = std::min(this->chunkSize, this->image.size() - offset);
+        return this->stream.processChunk(chunkIndex, this->image.data() + offset, length);
+    }
+
+    FirmwareStream::ChunkResult sendChunk(uint32_t index)
+    {
+        return this->sendChunk(index, (int32_t)index);
+    }
+
+    SimulatedSlot slot;
+    FirmwareStream stream;
+    std::vector<uint8_t> image;
+    size_t chunkSize = 0;
+    uint8_t hash[FirmwareStream::SHA256_LENGTH];
+};
+
+TEST_F(FirmwareStreamTest, StreamsTheImageIntoTheSlot)
+{
+    startImage(10000, 1024);
+    EXPECT_EQ(this->slot.begun, 1);
+
+    for (uint32_t i = 0; i + 1 < chunkCount(); i++)
+    {
+        ASSERT_EQ(sendChunk(i), FirmwareStream::CHUNK_WRITTEN) << i;
+        EXPECT_EQ(this->stream.getProgress().nextChunk, i + 1);
+    }
+    EXPECT_FALSE(this->slot.bootable);
+
+    EXPECT_EQ(sendChunk(chunkCount() - 1), FirmwareStream::CHUNK_COMPLETE);
+
+    FirmwareStream::Progress progress = this->stream.getProgress();
+    EXPECT_EQ(progress.status, FirmwareStream::STREAM_COMPLETE);
+    EXPECT_EQ(progress.bytesWritten, 10000u);
+    EXPECT_EQ(progress.error, nullptr);
+    EXPECT_TRUE(this->slot.bootable);
+    EXPECT_EQ(this->slot.image, this->image);
+
+    // Late chunks after the end change nothing
+    EXPECT_EQ(sendChunk(3), FirmwareStream::CHUNK_IGNORED);
+}
+
+TEST_F(FirmwareStreamTest, RawFramesWithoutIndexAreTakenInOrder)
+{
+    startImage(3000, 1000);
+    EXPECT_EQ(sendChunk(0, -1), FirmwareStream::CHUNK_WRITTEN);
+    EXPECT_EQ(sendChunk(1, -1), FirmwareStream::CHUNK_WRITTEN);
+    EXPECT_EQ(sendChunk(2, -1), FirmwareStream::CHUNK_COMPLETE);
+    EXPECT_EQ(this->slot.image, this->image);
+}
+
+TEST_F(FirmwareStreamTest, DuplicateAndFutureChunksAreIgnored)
+{
+    startImage(4096, 1024);
+    ASSERT_EQ(sendChunk(0), FirmwareStream::CHUNK_WRITTEN);
+    ASSERT_EQ(sendChunk(1), FirmwareStream::CHUNK_WRITTEN);
+
+    // A retry crossed the answer, and a chunk that skipped ahead
+    EXPECT_EQ(sendChunk(1), FirmwareStream::CHUNK_IGNORED);
+    EXPECT_EQ(sendChunk(3), FirmwareStream::CHUNK_IGNORED);
+    EXPECT_EQ(this->stream.getProgress().nextChunk, 2u);
+
+    ASSERT_EQ(sendChunk(2), FirmwareStream::CHUNK_WRITTEN);
+    EXPECT_EQ(sendChunk(3), FirmwareStream::CHUNK_COMPLETE);
+    EXPECT_EQ(this->slot.image, this->image);
+}
+
+TEST_F(FirmwareStreamTest, HashMismatchLeavesTheSlotUnbootable)
+{
+    startImage(5000, 1000);
+    this->image[2500] ^= 0x01;
+
+    for (uint32_t i = 0; i + 1 < chunkCount(); i++)
+    {
+        ASSERT_EQ(sendChunk(i), FirmwareStream::CHUNK_WRITTEN);
+    }
+    EXPECT_EQ(sendChunk(chunkCount() - 1), FirmwareStream::CHUNK_FAILED);
+
+    FirmwareStream::Progress progress = this->stream.getProgress();
+    EXPECT_EQ(progress.status, FirmwareStream::STREAM_FAILED);
+    EXPECT_STREQ(progress.error, "SHA-256 mismatch");
+    EXPECT_FALSE(this->slot.bootable);
+    EXPECT_EQ(this->slot.aborted, 1);
+}
+
+TEST_F(FirmwareStreamTest, RejectsWhatIsNotAnApplicationImage)
+{
+    startImage(2048, 1024);
+    this->image[0] = 0x00;
+    EXPECT_EQ(sendChunk(0), FirmwareStream::CHUNK_FAILED);
+    EXPECT_STREQ(this->stream.getProgress().error, "not an application image");
+    EXPECT_TRUE(this->slot.image.empty());
+}
+
+TEST_F(FirmwareStreamTest, ChunksBeyondTheAnnouncedSizeFail)
+{
+    this->image = makeImage(3000);
+    sha256(this->image, this->hash);
+    ASSERT_TRUE(this->stream.start(2500, 3, this->hash));
+
+    EXPECT_EQ(this->stream.processChunk(0, this->image.data(), 1000), FirmwareStream::CHUNK_WRITTEN);
+    EXPECT_EQ(this->stream.processChunk(1, this->image.data() + 1000, 1000), FirmwareStream::CHUNK_WRITTEN);
+    EXPECT_EQ(this->stream.processChunk(2, this->image.data() + 2000, 1000), FirmwareStream::CHUNK_FAILED);
+    EXPECT_STREQ(this->stream.getProgress().error, "chunk exceeds the announced image size");
+    EXPECT_EQ(this->slot.image.size(), 2000u);
+}
+
+TEST_F(FirmwareStreamTest, ImageEndingBeforeItsSizeFails)
+{
+    this->image = makeImage(3000);
+    sha256(this->image, this->hash);
+    ASSERT_TRUE(this->stream.start(3000, 2, this->hash));
+
+    EXPECT_EQ(this->stream.processChunk(0, this->image.data(), 1000), FirmwareStream::CHUNK_WRITTEN);
+    EXPECT_EQ(this->stream.processChunk(1, this->image.data() + 1000, 1000), FirmwareStream::CHUNK_FAILED);
+    EXPECT_STREQ(this->stream.getProgress().error, "image ended early");
+    EXPECT_FALSE(this->slot.bootable);
+}
+
+TEST_F(FirmwareStreamTest, FlashErrorsEndTheStream)
+{
+    this->slot.failWriteAt = 1500;
+    startImage(4000, 1000);
+
+    EXPECT_EQ(sendChunk(0), FirmwareStream::CHUNK_WRITTEN);
+    EXPECT_EQ(sendChunk(1), FirmwareStream::CHUNK_FAILED);
+    EXPECT_STREQ(this->stream.getProgress().error, "flash write failed");
+    EXPECT_EQ(this->slot.aborted, 1);
+
+    // Nothing is written after a failure
+    EXPECT_EQ(sendChunk(1), FirmwareStream::CHUNK_IGNORED);
+    EXPECT_EQ(this->slot.image.size(), 1000u);
+}
+
+TEST_F(FirmwareStreamTest, ImageLargerThanTheSlotIsRefused)
+{
+    std::vector<uint8_t> image = makeImage(16);
+    sha256(image, this->hash);
+    EXPECT_FALSE(this->stream.start(SimulatedSlot::CAPACITY + 1, 1000, this->hash));
+    EXPECT_EQ(this->stream.getProgress().status, FirmwareStream::STREAM_FAILED);
+    EXPECT_STREQ(this->stream.getProgress().error, "image larger than the slot");
+}
+
+TEST_F(FirmwareStreamTest, SameImageContinuesAfterAReconnect)
+{
+    startImage(6000, 1000);
+    ASSERT_EQ(sendChunk(0), FirmwareStream::CHUNK_WRITTEN);
+    ASSERT_EQ(sendChunk(1), FirmwareStream::CHUNK_WRITTEN);
+
+    // FirmwareUpdate asks before restarting the download
+    EXPECT_TRUE(this->stream.isReceiving(6000, this->hash));
+    uint8_t otherHash[FirmwareStream::SHA256_LENGTH];
+    memcpy(otherHash, this->hash, sizeof(otherHash));
+    otherHash[0] ^= 0xFF;
+    EXPECT_FALSE(this->stream.isReceiving(6000, otherHash));
+    EXPECT_FALSE(this->stream.isReceiving(6001, this->hash));
+
+    for (uint32_t i = 2; i + 1 < chunkCount(); i++)
+    {
+        ASSERT_EQ(sendChunk(i), FirmwareStream::CHUNK_WRITTEN);
+    }
+    EXPECT_EQ(sendChunk(chunkCount() - 1), FirmwareStream::CHUNK_COMPLETE);
+    EXPECT_EQ(this->slot.begun, 1);
+    EXPECT_EQ(this->slot.image, this->image);
+}
+
+TEST_F(FirmwareStreamTest, NewImageReplacesAnUnfinishedOne)
+{
+    startImage(6000, 1000);
+    ASSERT_EQ(sendChunk(0), FirmwareStream::CHUNK_WRITTEN);
+
+    startImage(3000, 1000);
+    EXPECT_EQ(this->slot.aborted, 1);
+    EXPECT_EQ(this->slot.begun, 2);
+    EXPECT_EQ(this->stream.getProgress().nextChunk, 0u);
+
+    for (uint32_t i = 0; i < chunkCount(); i++)
+    {
+        sendChunk(i);
+    }
+    EXPECT_EQ(this->stream.getProgress().status, FirmwareStream::STREAM_COMPLETE);
+    EXPECT_EQ(this->slot.image, this->image);
+}
+
+TEST_F(FirmwareStreamTest, WithoutHashOnlyTheSlotDecides)
+{
+    this->image = makeImage(2000);
+    this->chunkSize = 1000;
+    ASSERT_TRUE(this->stream.start(2000, 2, nullptr));
+    EXPECT_FALSE(this->stream.isReceiving(2000, nullptr));
+
+    EXPECT_EQ(sendChunk(0), FirmwareStream::CHUNK_WRITTEN);
+    EXPECT_EQ(sendChunk(1), FirmwareStream::CHUNK_COMPLETE);
+    EXPECT_TRUE(this->slot.bootable);
+}
+
+TEST_F(FirmwareStreamTest, ParsesHexHashes)
+{
+    uint8_t parsed[FirmwareStream::SHA256_LENGTH];
+    ASSERT_TRUE(FirmwareStream::parseSha256("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852B855", parsed));
+    EXPECT_EQ(parsed[0], 0xe3);
+    EXPECT_EQ(parsed[31], 0x55);
+
+    EXPECT_FALSE(FirmwareStream::parseSha256("e3b0c442", parsed));
+    EXPECT_FALSE(FirmwareStream::parseSha256("x3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", parsed));
+    EXPECT_FALSE(FirmwareStream::parseSha256(nullptr, parsed));
+}
+
+// The running image (app0) was installed over app1 and has not reached the server yet
+class FirmwareTrialTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        Preferences::eraseAll();
+        Settings::setup();
+        Settings::saveFirmwareTrial("app1", 0);
+    }
+
+    void TearDown() override
+    {
+        esp_set_reset_reason(ESP_RST_POWERON);
+    }
+
+    // One boot of the image on trial after a reset for the given reason
+    uint8_t bootAfter(esp_reset_reason_t reason)
+    {
+        esp_set_reset_reason(reason);
+        FirmwareUpdate update;
+        update.setup();
+
+        String previous;
+        uint8_t boots = 0;
+        EXPECT_TRUE(Settings::getFirmwareTrial(previous, boots));
+        EXPECT_EQ(previous, "app1");
+        return boots;
+    }
+};
+
+TEST_F(FirmwareTrialTest, PowerCyclesDoNotCountAgainstTheImage)
+{
+    // Switched off every evening while the server is down for a week
+    for (int i = 0; i < 10; i++)
+    {
+        EXPECT_EQ(bootAfter(ESP_RST_POWERON), 0u);
+        EXPECT_EQ(bootAfter(ESP_RST_EXT), 0u);
+        EXPECT_EQ(bootAfter(ESP_RST_SW), 0u);
+        EXPECT_EQ(bootAfter(ESP_RST_BROWNOUT), 0u);
+    }
+}
+
+TEST_F(FirmwareTrialTest, CrashesAndWatchdogResetsCount)
+{
+    EXPECT_EQ(bootAfter(ESP_RST_PANIC), 1u);
+    EXPECT_EQ(bootAfter(ESP_RST_POWERON), 1u);
+    EXPECT_EQ(bootAfter(ESP_RST_TASK_WDT), 2u);
+    EXPECT_EQ(bootAfter(ESP_RST_INT_WDT), 3u);
+}
+
+TEST_F(FirmwareTrialTest, ReachingTheServerEndsTheTrial)
+{
+    EXPECT_EQ(bootAfter(ESP_RST_PANIC), 1u);
+
+    FirmwareUpdate update;
+    update.setup();
+    update.confirmRunningImage();
+
+    String previous;
+    uint8_t boots = 0;
+    EXPECT_FALSE(Settings::getFirmwareTrial(previous, boots));
+}
+
+TEST_F(FirmwareTrialTest, RollsBackAfterTooManyCrashes)
+{
+    Settings::saveFirmwareTrial("app1", 3);
+
+    // The shim ends the process in esp_restart()
+    esp_set_reset_reason(ESP_RST_WDT);
+    FirmwareUpdate update;
+    EXPECT_EXIT(update.setup(), ::testing::ExitedWithCode(EXIT_FAILURE), "esp_restart");
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <string>
+#include "nfc/nfc.hpp"
+#include "state/state.hpp"
+#include "../emulatedPn532.hpp"
+#include "../ntag424Card.hpp"
+
+// The NFC task of the firmware against an emulated PN532, enabled the way the
+// API task does it: network up and the server waiting for a tap.
+
+namespace
+{
+    const uint8_t NTAG_UID[Ntag424Card::UID_LENGTH] = {0x04, 0x5A, 0x11, 0x3C, 0x72, 0x61, 0x80};
+    const char *NTAG_UID_HEX = "045a113c726180";
+    const uint8_t DESFIRE_UID[Ntag424Card::UID_LENGTH] = {0x04, 0x9E, 0x27, 0x0A, 0x4B, 0xC3, 0x90};
+    const char *DESFIRE_UID_HEX = "049e270a4bc390";
+    const uint8_t FACTORY_KEY[16] = {};
+
+    // GetVersion is three exchanges, the part with the hardware type and two additional frames
+    const uint32_t GET_VERSION_APDUS = 3;
+    const uint32_t EVENT_TIMEOUT_MS = 2000;
+
+    // Same as NFC
+    const uint32_t TAP_HOLD_OFF_MS = 1000;
+    const uint32_t CARD_REARM_MS = 300;
+    const uint32_t PRESENT_REPOLL_MS = 100;
+
+    // Polls of a card left on the reader, well past the hold-off
+    const uint32_t POLL_CYCLES = 20;
+
+    // Never destroyed, the NFC task runs until the program ends
+    EmulatedPn532 *transport = nullptr;
+    NFC *nfc = nullptr;
+
+    bool waitForEvent(State::ApiInputEvent &event, uint32_t timeoutMs)
+    {
+        uint32_t start = millis();
+        while (millis() - start < timeoutMs)
+        {
+            if (State::getNextApiInputEvent(event))
+            {
+                return true;
+            }
+            delay(5);
+        }
+        return false;
+    }
+
+    template <typename Predicate>
+    bool waitFor(Predicate condition, uint32_t timeoutMs)
+    {
+        uint32_t start = millis();
+        while (!condition())
+        {
+            if (millis() - start >= timeoutMs)
+            {
+                return false;
+            }
+            delay(5);
+        }
+        return true;
+    }
+}
+
+class NfcTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        transport = new EmulatedPn532();
+        nfc = new NFC(transport);
+        nfc->setup();
+
+        esp_ip4_addr_t ip = {0x0100a8c0};
+        State::setWifiState(true, ip, "workshop");
+        JsonDocument payload;
+        State::setApiEventData(State::API_EVENT_STATE_WAIT_FOR_NFC_TAP, payload.to<JsonObject>());
+    }
+
+    void SetUp() override
+    {
+        // Nothing left over from the previous test: empty field, hold-off of
+        // the last tap passed, no pending events
+        transport->setCards(nullptr, nullptr);
+        delay(TAP_HOLD_OFF_MS);
+        State::ApiInputEvent event;
+        while (State::getNextApiInputEvent(event))
+        {
+        }
+    }
+
+    void TearDown() override
+    {
+        Serial.capture(nullptr);
+        transport->setCards(nullptr, nullptr);
+    }
+};
+
+TEST_F(NfcTest, PicksTheNtag424NextToAnotherCard)
+{
+    // The other card answers GetVersion but is no NTAG, and it is listed first
+    Ntag424Card desfire(DESFIRE_UID, Ntag424Card::HW_TYPE_DESFIRE);
+    Ntag424Card ntag(NTAG_UID);
+    std::string log;
+    Serial.capture(&log);
+
+    transport->setCards(&desfire, &ntag);
+
+    State::ApiInputEvent event;
+    ASSERT_TRUE(waitForEvent(event, EVENT_TIMEOUT_MS));
+    EXPECT_EQ(event.type, State::API_INPUT_EVENT_NFC_CARD_DETECTED);
+    EXPECT_STREQ(event.payload, NTAG_UID_HEX);
+
+    // Decided on the first poll: each card was asked once
+    EXPECT_EQ(desfire.getVersionCount(), 1u);
+    EXPECT_EQ(ntag.getVersionCount(), 1u);
+    Serial.capture(nullptr);
+    EXPECT_NE(log.find(std::string("Ignoring second card UID=") + DESFIRE_UID_HEX + " SAK=0x20"), std::string::npos) << log;
+}
+
+TEST_F(NfcTest, CommandsGoToTheChosenTarget)
+{
+    Ntag424Card desfire(DESFIRE_UID, Ntag424Card::HW_TYPE_DESFIRE);
+    Ntag424Card ntag(NTAG_UID);
+    transport->setCards(&desfire, &ntag);
+
+    State::ApiInputEvent event;
+    ASSERT_TRUE(waitForEvent(event, EVENT_TIMEOUT_MS));
+    ASSERT_STREQ(event.payload, NTAG_UID_HEX);
+
+    State::NfcCommand command = {};
+    command.type = State::NFC_COMMAND_TYPE_AUTHENTICATE;
+    command.correlationId = 42;
+    command.authenticate.keyNumber = 0;
+    memcpy(command.authenticate.authKey, FACTORY_KEY, sizeof(FACTORY_KEY));
+    State::pushNfcCommandToQueue(command);
+
+    // The login runs against the NTAG424, the other card only saw GetVersion
+    ASSERT_TRUE(waitFor([&]()
+                        { return ntag.isAuthenticated(); }, EVENT_TIMEOUT_MS));
+    EXPECT_EQ(desfire.getApduCount(), desfire.getVersionCount() * GET_VERSION_APDUS);
+    EXPECT_EQ(desfire.getSelectCount(), 0u);
+
+    // The result follows once the card was taken away
+    transport->setCards(nullptr, nullptr);
+    ASSERT_TRUE(waitForEvent(event, EVENT_TIMEOUT_MS));
+    EXPECT_EQ(event.type, State::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_SUCCESS);
+    EXPECT_EQ(event.correlationId, 42u);
+}
+
+TEST_F(NfcTest, OnlyOtherCardsGiveNoTap)
+{
+    Ntag424Card desfire(DESFIRE_UID, Ntag424Card::HW_TYPE_DESFIRE);
+    transport->setCard(&desfire);
+
+    State::ApiInputEvent event;
+    EXPECT_FALSE(waitForEvent(event, 500));
+    EXPECT_GE(desfire.getVersionCount(), 1u);
+}
+
+TEST_F(NfcTest, CardLeftOnTheReaderTapsOnce)
+{
+    Ntag424Card ntag(NTAG_UID);
+    transport->setCard(&ntag);
+
+    State::ApiInputEvent event;
+    ASSERT_TRUE(waitForEvent(event, EVENT_TIMEOUT_MS));
+    EXPECT_EQ(event.type, State::API_INPUT_EVENT_NFC_CARD_DETECTED);
+
+    uint32_t detections = transport->getStats().detections;
+    ASSERT_TRUE(waitFor([&]()
+                        { return transport->getStats().detections >= detections + POLL_CYCLES; },
+                        2 * POLL_CYCLES * PRESENT_REPOLL_MS));
+
+    // Still there on every poll: no second tap, no second GetVersion
+    EXPECT_FALSE(State::getNextApiInputEvent(event));
+    EXPECT_EQ(ntag.getVersionCount(), 1u);
+}
+
+TEST_F(NfcTest, ShortRemovalKeepsThePresentation)
+{
+    Ntag424Card ntag(NTAG_UID);
+    transport->setCard(&ntag);
+
+    State::ApiInputEvent event;
+    ASSERT_TRUE(waitForEvent(event, EVENT_TIMEOUT_MS));
+    delay(TAP_HOLD_OFF_MS);
+
+    // Lifted for less than CARD_REARM_MS: the same presentation
+    transport->setCard(nullptr);
+    delay(CARD_REARM_MS / 3);
+    transport->setCard(&ntag);
+    EXPECT_FALSE(waitForEvent(event, 5 * PRESENT_REPOLL_MS));
+    EXPECT_EQ(ntag.getVersionCount(), 1u);
+
+    // Gone for longer than CARD_REARM_MS: a new tap as soon as it is back
+    transport->setCard(nullptr);
+    delay(2 * CARD_REARM_MS);
+    transport->setCard(&ntag);
+    ASSERT_TRUE(waitForEvent(event, CARD_REARM_MS));
+    EXPECT_EQ(event.type, State::API_INPUT_EVENT_NFC_CARD_DETECTED);
+    EXPECT_EQ(ntag.getVersionCount(), 2u);
+}
+
+TEST_F(NfcTest, NewPresentationWaitsOutTheHoldOff)
+{
+    Ntag424Card ntag(NTAG_UID);
+    transport->setCard(&ntag);
+
+    State::ApiInputEvent event;
+    ASSERT_TRUE(waitForEvent(event, EVENT_TIMEOUT_MS));
+    uint32_t tappedAt = millis();
+
+    // Removed and back after the rearm time, but inside the hold-off
+    transport->setCard(nullptr);
+    delay(2 * CARD_REARM_MS);
+    transport->setCard(&ntag);
+
+    uint32_t elapsed = millis() - tappedAt;
+    ASSERT_LT(elapsed + 20, TAP_HOLD_OFF_MS);
+    EXPECT_FALSE(waitForEvent(event, TAP_HOLD_OFF_MS - elapsed - 20));
+
+    // Reported once the hold-off has passed, the card is still there
+    ASSERT_TRUE(waitForEvent(event, 3 * PRESENT_REPOLL_MS));
+    EXPECT_EQ(event.type, State::API_INPUT_EVENT_NFC_CARD_DETECTED);
+    EXPECT_GE(millis() - tappedAt, TAP_HOLD_OFF_MS - 10);
+    EXPECT_EQ(ntag.getVersionCount(), 2u);
+    EXPECT_FALSE(waitForEvent(event, 3 * PRESENT_REPOLL_MS));
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
@@ -0,0 +1,421 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <string.h>
+#include <string>
+#include "nfc/Adafruit_PN532_NTAG424.h"
+#include "../emulatedPn532.hpp"
+#include "../ntag424Card.hpp"
+#include "../benchmark.hpp"
+
+namespace
+{
+    const uint8_t CARD_UID[Ntag424Card::UID_LENGTH] = {0x04, 0x5A, 0x11, 0x3C, 0x72, 0x61, 0x80};
+    const uint8_t FACTORY_KEY[16] = {};
+    const uint8_t READER_KEY[16] = {0x4B, 0x11, 0x0F, 0xD2, 0x97, 0x20, 0x55, 0xA3,
+                                    0x6E, 0x38, 0xC1, 0x04, 0xB9, 0x7A, 0x2D, 0xE6};
+    const uint8_t OTHER_KEY[16] = {0x10, 0x21, 0x32, 0x43, 0x54, 0x65, 0x76, 0x87,
+                                   0x98, 0xA9, 0xBA, 0xCB, 0xDC, 0xED, 0xFE, 0x0F};
+
+    // NLEN, then a well known text record: D1 01 PL 'T', status (UTF-8, "en")
+    const uint8_t NDEF_TEXT[] = {0x00, 0x11, 0xD1, 0x01, 0x0D, 0x54, 0x02, 0x65, 0x6E,
+                                 'a', 't', 't', 'r', 'a', 'c', 'c', 'e', 's', 's'};
+
+    // Retries of NFC::authenticate. Before, every attempt selected the
+    // NTAG424 application again and failed attempts waited 500 ms each.
+    struct AuthRetryPolicy
+    {
+        const char *name;
+        bool selectEveryAttempt;
+        uint32_t firstBackoffMs;
+        uint32_t backoffFactor;
+    };
+
+    const AuthRetryPolicy SELECT_AND_500MS = {"select each time, 500 ms retries", true, 500, 1};
+    const AuthRetryPolicy CACHED_AND_BACKOFF = {"cached select, 20/40 ms retries", false, 20, 2};
+    const uint8_t AUTH_ATTEMPTS = 3;
+
+    // Assumed time of one InDataExchange (I2C at 100 kHz plus the card's
+    // answer at 106 kbit/s), only used to weigh APDUs against retry sleeps
+    const uint32_t EXCHANGE_MS = 8;
+
+    // Console of the firmware, 10 bits on the wire per byte
+    const uint32_t CONSOLE_BAUD = 115200;
+
+    struct EnrollCycle
+    {
+        bool success;
+        uint32_t apdus;
+        uint32_t selects;
+        uint32_t verificationSelects;
+        uint32_t sleptMs;
+
+        uint32_t simulatedMs() const { return this->apdus * EXCHANGE_MS + this->sleptMs; }
+    };
+
+    // The same calls the NFC task makes, against the emulated reader
+    class Ntag424Test : public ::testing::Test
+    {
+    protected:
+        EmulatedPn532 transport;
+        Ntag424Card card{CARD_UID};
+        Adafruit_PN532 pn532{&transport};
+        uint8_t key[16];
+
+        void SetUp() override
+        {
+            // The traces of the native_trace_* builds would bury the results,
+            // the trace output benchmark counts them through capture()
+            Serial.mute(true);
+            ASSERT_TRUE(this->pn532.begin());
+            this->transport.setCard(&this->card);
+            this->detect();
+        }
+
+        void TearDown() override
+        {
+            Serial.mute(false);
+        }
+
+        void detect()
+        {
+            uint8_t uid[PN532_MAX_UID_LENGTH];
+            uint8_t uidLength = 0;
+            ASSERT_TRUE(this->pn532.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLength, 100, PN532_MAX_TARGETS));
+            ASSERT_EQ(uidLength, Ntag424Card::UID_LENGTH);
+            EXPECT_EQ(memcmp(uid, CARD_UID, uidLength), 0);
+        }
+
+        // The driver takes non-const keys
+        bool authenticate(const uint8_t *authKey, uint8_t keyNo)
+        {
+            memcpy(this->key, authKey, sizeof(this->key));
+            return this->pn532.ntag424_Authenticate(this->key, keyNo, 0x71);
+        }
+
+        bool changeKey(const uint8_t *oldKey, const uint8_t *newKey, uint8_t keyNo)
+        {
+            uint8_t oldCopy[16];
+            uint8_t newCopy[16];
+            memcpy(oldCopy, oldKey, sizeof(oldCopy));
+            memcpy(newCopy, newKey, sizeof(newCopy));
+            return this->pn532.ntag424_ChangeKey(oldCopy, newCopy, keyNo);
+        }
+
+        // NFC::authenticate with the given retry policy
+        bool authenticateWithRetries(const AuthRetryPolicy &policy, const uint8_t *authKey, uint8_t keyNo, uint32_t &sleptMs)
+        {
+            uint32_t backoffMs = policy.firstBackoffMs;
+            for (uint8_t attempt = 1; attempt <= AUTH_ATTEMPTS; attempt++)
+            {
+                // The old driver gave up on the attempt when the select failed
+                uint8_t dfn[] = {0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01};
+                bool selected = !policy.selectEveryAttempt || this->pn532.ntag424_ISOSelectFileByDFN(dfn);
+                if (selected && this->authenticate(authKey, keyNo))
+                {
+                    return true;
+                }
+                if (attempt < AUTH_ATTEMPTS)
+                {
+                    sleptMs += backoffMs;
+                    backoffMs *= policy.backoffFactor;
+                }
+            }
+            return false;
+        }
+
+        // NFC::changeKey on the master key of a freshly presented card:
+        // authenticate, ChangeKey, then log in with the new key
+        EnrollCycle enroll(const AuthRetryPolicy &policy, const uint8_t *oldKey, const uint8_t *newKey, uint32_t droppedExchanges)
+        {
+            this->detect();
+            this->transport.dropNextExchanges(droppedExchanges);
+
+            EnrollCycle cycle = {};
+            uint32_t apdus = this->card.getApduCount();
+            uint32_t selects = this->card.getSelectCount();
+
+            cycle.success = this->authenticateWithRetries(policy, oldKey, 0, cycle.sleptMs) &&
+                            this->changeKey(oldKey, newKey, 0);
+            uint32_t verificationSelects = this->card.getSelectCount();
+            cycle.success = cycle.success && this->authenticateWithRetries(policy, newKey, 0, cycle.sleptMs);
+
+            // A timed out exchange takes the bus just like one the card answered
+            cycle.apdus = this->card.getApduCount() - apdus + droppedExchanges;
+            cycle.selects = this->card.getSelectCount() - selects;
+            cycle.verificationSelects = this->card.getSelectCount() - verificationSelects;
+            return cycle;
+        }
+    };
+}
+
+TEST_F(Ntag424Test, DetectsTheCardAndReadsTheFirmwareVersion)
+{
+    EXPECT_EQ(this->pn532.getFirmwareVersion(), 0x32010607u);
+    EXPECT_EQ(this->pn532.getTargetCount(), 1);
+    EXPECT_EQ(this->pn532.getTarget(0).sel_res & PN532_SEL_RES_ISO14443_4, PN532_SEL_RES_ISO14443_4);
+    EXPECT_TRUE(this->pn532.ntag424_isNTAG424());
+    EXPECT_EQ(this->transport.getStats().badFrames, 0u);
+}
+
+TEST_F(Ntag424Test, AuthenticatesWithTheFactoryKey)
+{
+    EXPECT_TRUE(this->authenticate(FACTORY_KEY, 0));
+    EXPECT_TRUE(this->card.isAuthenticated());
+    EXPECT_EQ(this->card.getAuthenticatedKey(), 0);
+}
+
+TEST_F(Ntag424Test, WrongKeyFailsAuthentication)
+{
+    EXPECT_FALSE(this->authenticate(READER_KEY, 0));
+    EXPECT_FALSE(this->card.isAuthenticated());
+
+    // The card is still there, the right key works afterwards
+    EXPECT_TRUE(this->authenticate(FACTORY_KEY, 0));
+}
+
+TEST_F(Ntag424Test, ChangedKeyReplacesTheOldOne)
+{
+    ASSERT_TRUE(this->authenticate(FACTORY_KEY, 0));
+    ASSERT_TRUE(this->changeKey(FACTORY_KEY, READER_KEY, 1));
+    EXPECT_EQ(memcmp(this->card.getKey(1), READER_KEY, 16), 0);
+    EXPECT_EQ(this->card.getKeyVersion(1), 1);
+
+    // Key 0 stays authenticated, the session goes on
+    EXPECT_TRUE(this->card.isAuthenticated());
+
+    EXPECT_TRUE(this->authenticate(READER_KEY, 1));
+    EXPECT_FALSE(this->authenticate(FACTORY_KEY, 1));
+}
+
+TEST_F(Ntag424Test, ChangingTheSessionKeyEndsTheSession)
+{
+    ASSERT_TRUE(this->authenticate(FACTORY_KEY, 0));
+    ASSERT_TRUE(this->changeKey(FACTORY_KEY, READER_KEY, 0));
+    EXPECT_FALSE(this->card.isAuthenticated());
+    EXPECT_EQ(memcmp(this->card.getKey(0), READER_KEY, 16), 0);
+
+    // What the NFC task does after enrolling a card: log in with the new key
+    EXPECT_TRUE(this->authenticate(READER_KEY, 0));
+    ASSERT_TRUE(this->changeKey(FACTORY_KEY, OTHER_KEY, 2));
+    EXPECT_EQ(memcmp(this->card.getKey(2), OTHER_KEY, 16), 0);
+}
+
+TEST_F(Ntag424Test, WrongOldKeyFailsTheKeyChecksum)
+{
+    ASSERT_TRUE(this->authenticate(FACTORY_KEY, 0));
+    EXPECT_FALSE(this->changeKey(OTHER_KEY, READER_KEY, 3));
+    EXPECT_EQ(memcmp(this->card.getKey(3), FACTORY_KEY, 16), 0);
+    EXPECT_FALSE(this->card.isAuthenticated());
+}
+
+TEST_F(Ntag424Test, CommandCounterStaysInSync)
+{
+    ASSERT_TRUE(this->authenticate(FACTORY_KEY, 0));
+
+    uint8_t uid[16];
+    for (int i = 0; i < 5; i++)
+    {
+        ASSERT_EQ(this->pn532.ntag424_GetCardUID(uid), Ntag424Card::UID_LENGTH) << "call " << i;
+        EXPECT_EQ(memcmp(uid, CARD_UID, Ntag424Card::UID_LENGTH), 0);
+    }
+    EXPECT_EQ(this->card.getCommandCounter(), 5);
+
+    // A plain command in the session counts as well
+    this->card.writeNdefFile(0, NDEF_TEXT, sizeof(NDEF_TEXT));
+    uint8_t text[32];
+    ASSERT_GT(this->pn532.ntag424_ReadData(text, 2, 0, 32), 0);
+    EXPECT_EQ(this->pn532.ntag424_GetCardUID(uid), Ntag424Card::UID_LENGTH);
+}
+
+TEST_F(Ntag424Test, ReadsTheNdefText)
+{
+    this->card.writeNdefFile(0, NDEF_TEXT, sizeof(NDEF_TEXT));
+    ASSERT_TRUE(this->authenticate(FACTORY_KEY, 0));
+
+    // ReadData returns the record's payload length and copies from the text on
+    uint8_t text[32] = {};
+    EXPECT_EQ(this->pn532.ntag424_ReadData(text, 2, 0, 32), 0x0D);
+    EXPECT_EQ(memcmp(text, "attraccess", 10), 0);
+
+    EXPECT_EQ(this->pn532.ntag424_ReadData(text, 3, 0, 32), 0);
+    EXPECT_EQ(this->pn532.ntag424_ReadData(text, 2, 240, 32), 0);
+}
+
+TEST_F(Ntag424Test, RemovedCardEndsTheSession)
+{
+    ASSERT_TRUE(this->authenticate(FACTORY_KEY, 0));
+
+    this->transport.setCard(nullptr);
+    EXPECT_FALSE(this->authenticate(FACTORY_KEY, 0));
+
+    // Back in the field the card needs a new detection and a new session
+    this->transport.setCard(&this->card);
+    this->detect();
+    EXPECT_TRUE(this->authenticate(FACTORY_KEY, 0));
+}
+
+TEST_F(Ntag424Test, AbortedDetectionLeavesNothingPending)
+{
+    this->transport.setCard(nullptr);
+    ASSERT_TRUE(this->pn532.startPassiveTargetIDDetection(PN532_MIFARE_ISO14443A, PN532_MAX_TARGETS));
+    EXPECT_FALSE(this->pn532.isResponseReady());
+
+    this->pn532.abortCommand();
+    this->transport.setCard(&this->card);
+    EXPECT_FALSE(this->pn532.isResponseReady());
+    EXPECT_EQ(this->transport.getStats().aborts, 1u);
+}
+
+// The card login of a tap: select, both authentication parts and the
+// session key derivation, through framing and the transport
+TEST_F(Ntag424Test, BenchmarkAuthenticate)
+{
+    uint32_t apdus = this->card.getApduCount();
+    uint32_t transactions = this->pn532.getBusTransactionCount();
+    BenchmarkResult result = runBenchmark("ntag424_Authenticate (emulated)", 2000, [&]()
+                                          { this->authenticate(FACTORY_KEY, 0); });
+
+    uint32_t runs = result.iterations + result.iterations / 10 + 1;
+    printf("[ BENCH    ] %-40s %10.1f APDUs, %.1f bus transactions per op\n", "ntag424_Authenticate (emulated)",
+           (double)(this->card.getApduCount() - apdus) / runs,
+           (double)(this->pn532.getBusTransactionCount() - transactions) / runs);
+
+    Adafruit_PN532_TraceEntry entries[4];
+    uint32_t recorded = 0;
+    EXPECT_GT(this->pn532.ntag424_TraceSnapshot(entries, 4, &recorded), 0);
+    EXPECT_GE(recorded, 2 * runs);
+    EXPECT_TRUE(this->card.isAuthenticated());
+}
+
+// Serial output of a login at the trace level this suite was built with.
+// DATA prints what the driver used to print on every APDU (command counter,
+// full frames and the AUTH 2 dumps); the native_trace_frames and
+// native_trace_data envs build the suite at the other levels to compare.
+TEST_F(Ntag424Test, BenchmarkAuthenticateTraceOutput)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "ntag424_Authenticate, trace level %u", (unsigned)ntag424_trace_level);
+
+    std::string output;
+    Serial.capture(&output);
+    BenchmarkResult result = runBenchmark(name, 500, [&]()
+                                          { this->authenticate(FACTORY_KEY, 0); });
+    Serial.capture(nullptr);
+
+    uint32_t runs = result.iterations + result.iterations / 10 + 1;
+    double bytes = (double)output.size() / runs;
+    printf("[ BENCH    ] %-40s %10.1f Serial bytes, %.2f ms at %u baud per op\n", name, bytes,
+           bytes * 10 * 1000 / CONSOLE_BAUD, CONSOLE_BAUD);
+
+    EXPECT_TRUE(this->card.isAuthenticated());
+    if (ntag424_trace_level == NTAG424_TRACE_OFF)
+    {
+        EXPECT_EQ(output.size(), 0u);
+    }
+    else
+    {
+        EXPECT_GT(output.size(), 0u);
+    }
+}
+
+#if NTAG424_TRACE_RING_SIZE > 0
+// What keeping every APDU in the trace ring adds to a login
+TEST_F(Ntag424Test, BenchmarkTraceRing)
+{
+    Adafruit_PN532_TraceRing ring;
+    Adafruit_PN532_TraceEntry entry = {};
+    BenchmarkResult record = runBenchmark("Adafruit_PN532_TraceRing::record", 100000, [&]()
+                                          {
+                                              entry.cmd_counter++;
+                                              ring.record(entry); });
+
+    uint32_t apdus = this->card.getApduCount();
+    BenchmarkResult login = runBenchmark("ntag424_Authenticate (ring enabled)", 500, [&]()
+                                         { this->authenticate(FACTORY_KEY, 0); });
+    double apdusPerLogin = (double)(this->card.getApduCount() - apdus) / (login.iterations + login.iterations / 10 + 1);
+    double ringNs = record.nsPerOp * apdusPerLogin;
+    printf("[ BENCH    ] %-40s %10.1f ns per login (%.1f APDUs, %.2f%%), %u bytes of RAM\n", "trace ring",
+           ringNs, apdusPerLogin, 100.0 * ringNs / login.nsPerOp, (unsigned)sizeof(ring));
+    EXPECT_TRUE(this->card.isAuthenticated());
+
+    Adafruit_PN532_TraceEntry entries[NTAG424_TRACE_RING_SIZE];
+    uint32_t recorded = 0;
+    EXPECT_EQ(ring.snapshot(entries, NTAG424_TRACE_RING_SIZE, &recorded), NTAG424_TRACE_RING_SIZE);
+    EXPECT_EQ(entries[NTAG424_TRACE_RING_SIZE - 1].cmd_counter, entry.cmd_counter);
+}
+#endif
+
+TEST_F(Ntag424Test, EnrollVerificationKeepsTheSelectedApplication)
+{
+    EnrollCycle cycle = this->enroll(CACHED_AND_BACKOFF, FACTORY_KEY, READER_KEY, 0);
+    ASSERT_TRUE(cycle.success);
+    EXPECT_EQ(memcmp(this->card.getKey(0), READER_KEY, 16), 0);
+
+    // ChangeKey ended the session, not the selection
+    EXPECT_EQ(cycle.selects, 1u);
+    EXPECT_EQ(cycle.verificationSelects, 0u);
+    EXPECT_EQ(cycle.sleptMs, 0u);
+
+    EnrollCycle before = this->enroll(SELECT_AND_500MS, READER_KEY, FACTORY_KEY, 0);
+    ASSERT_TRUE(before.success);
+    EXPECT_EQ(before.verificationSelects, 1u);
+    EXPECT_EQ(before.apdus, cycle.apdus + 1);
+}
+
+TEST_F(Ntag424Test, TransientFailureRetriesAfterTheBackoff)
+{
+    EnrollCycle cycle = this->enroll(CACHED_AND_BACKOFF, FACTORY_KEY, READER_KEY, 1);
+    ASSERT_TRUE(cycle.success);
+    EXPECT_EQ(cycle.sleptMs, 20u);
+
+    EnrollCycle before = this->enroll(SELECT_AND_500MS, READER_KEY, FACTORY_KEY, 1);
+    ASSERT_TRUE(before.success);
+    EXPECT_EQ(before.sleptMs, 500u);
+}
+
+// A whole enrollment: Authenticate, ChangeKey of the master key and the
+// verification login, for a clean presentation and one where the first
+// exchange times out
+TEST_F(Ntag424Test, BenchmarkEnrollCycle)
+{
+    for (uint32_t dropped = 0; dropped <= 1; dropped++)
+    {
+        for (const AuthRetryPolicy *policy : {&SELECT_AND_500MS, &CACHED_AND_BACKOFF})
+        {
+            EnrollCycle total = {};
+            uint32_t runs = 0;
+            char name[64];
+            snprintf(name, sizeof(name), "enroll, %s%s", policy->name, dropped ? ", 1 timeout" : "");
+
+            runBenchmark(name, 200, [&]()
+                         {
+                             // Alternate the keys so every run enrolls the card again
+                             bool factory = memcmp(this->card.getKey(0), FACTORY_KEY, 16) == 0;
+                             EnrollCycle cycle = this->enroll(*policy, factory ? FACTORY_KEY : READER_KEY,
+                                                              factory ? READER_KEY : FACTORY_KEY, dropped);
+                             ASSERT_TRUE(cycle.success);
+                             total.apdus += cycle.apdus;
+                             total.selects += cycle.selects;
+                             total.verificationSelects += cycle.verificationSelects;
+                             total.sleptMs += cycle.sleptMs;
+                             runs++; });
+
+            printf("[ BENCH    ] %-40s %10.1f APDUs (%.1f selects), %.1f ms simulated per enroll\n", name,
+                   (double)total.apdus / runs, (double)total.selects / runs, (double)total.simulatedMs() / runs);
+
+            if (!policy->selectEveryAttempt)
+            {
+                EXPECT_EQ(total.verificationSelects, 0u);
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
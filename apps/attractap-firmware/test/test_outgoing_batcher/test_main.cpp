@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "state/state.hpp"
+#include "websocket/outgoingBatcher.hpp"
+
+namespace
+{
+    class RecordingSender : public OutgoingBatcher::FrameSender
+    {
+    public:
+        std::vector<std::string> frames;
+        std::vector<uint8_t> messages;
+        bool fail = false;
+
+        bool sendFrame(const char *data, size_t length, uint8_t count) override
+        {
+            if (this->fail)
+            {
+                return false;
+            }
+            this->frames.emplace_back(data, length);
+            this->messages.push_back(count);
+            return true;
+        }
+    };
+
+    void queue(const std::string &message)
+    {
+        char *slot = State::reserveOutgoingWebsocketMessage(message.size());
+        ASSERT_NE(slot, nullptr);
+        memcpy(slot, message.data(), message.size());
+        State::commitOutgoingWebsocketMessage(slot);
+    }
+
+    const char *ACK = R"({"event":"RESPONSE","data":{"type":"ACK_NFC_AUTHENTICATE","payload":{}}})";
+    const char *RESPONSE = R"({"event":"RESPONSE","data":{"type":"NFC_AUTHENTICATE","payload":{"successful":true}}})";
+}
+
+class OutgoingBatcherTest : public ::testing::Test
+{
+protected:
+    RecordingSender sender;
+    OutgoingBatcher batcher{sender};
+
+    void SetUp() override
+    {
+        State::WebsocketMessage message;
+        while (State::getNextOutgoingWebsocketMessage(message))
+        {
+            State::releaseOutgoingWebsocketMessage(message);
+        }
+    }
+};
+
+TEST_F(OutgoingBatcherTest, SendsOneFramePerMessageWithoutBatching)
+{
+    queue(ACK);
+    queue(RESPONSE);
+
+    EXPECT_TRUE(batcher.drain(8));
+    ASSERT_EQ(sender.frames.size(), 2u);
+    EXPECT_EQ(sender.frames[0], ACK);
+    EXPECT_EQ(sender.frames[1], RESPONSE);
+    EXPECT_EQ(batcher.getBatchesSent(), 0u);
+}
+
+TEST_F(OutgoingBatcherTest, FrameLimitLeavesTheRestQueued)
+{
+    queue(ACK);
+    queue(RESPONSE);
+
+    EXPECT_TRUE(batcher.drain(1));
+    EXPECT_EQ(sender.frames.size(), 1u);
+    EXPECT_TRUE(batcher.drain(1));
+    ASSERT_EQ(sender.frames.size(), 2u);
+    EXPECT_EQ(sender.frames[1], RESPONSE);
+}
+
+TEST_F(OutgoingBatcherTest, CoalescesJsonMessagesIntoOneBatch)
+{
+    batcher.setBatching(true);
+    queue(ACK);
+    queue(RESPONSE);
+
+    EXPECT_TRUE(batcher.drain(8));
+    ASSERT_EQ(sender.frames.size(), 1u);
+    EXPECT_EQ(sender.frames[0], std::string("{\"event\":\"BATCH\",\"data\":[") + ACK + "," + RESPONSE + "]}");
+    EXPECT_EQ(sender.messages[0], 2u);
+    EXPECT_EQ(batcher.getBatchesSent(), 1u);
+}
+
+TEST_F(OutgoingBatcherTest, LoneMessageIsNotWrapped)
+{
+    batcher.setBatching(true);
+    queue(ACK);
+
+    EXPECT_TRUE(batcher.drain(8));
+    ASSERT_EQ(sender.frames.size(), 1u);
+    EXPECT_EQ(sender.frames[0], ACK);
+    EXPECT_EQ(batcher.getBatchesSent(), 0u);
+}
+
+TEST_F(OutgoingBatcherTest, MessagePackBatchCountsInTheArrayHeader)
+{
+    batcher.setBatching(true);
+    // fixmaps {"a":1} and {"b":2}
+    const std::string first("\x81\xa1" "a" "\x01", 4);
+    const std::string second("\x81\xa1" "b" "\x02", 4);
+    queue(first);
+    queue(second);
+    // A JSON message does not go into the MessagePack batch
+    queue(ACK);
+
+    EXPECT_TRUE(batcher.drain(8));
+    ASSERT_EQ(sender.frames.size(), 2u);
+    const std::string prefix("\x82\xa5" "event" "\xa5" "BATCH" "\xa4" "data" "\x92", 19);
+    EXPECT_EQ(sender.frames[0], prefix + first + second);
+    EXPECT_EQ(sender.frames[1], ACK);
+}
+
+TEST_F(OutgoingBatcherTest, FullBatchDefersTheNextMessage)
+{
+    batcher.setBatching(true);
+    for (uint8_t i = 0; i < OutgoingBatcher::MAX_BATCH_MESSAGES + 1; i++)
+    {
+        queue(ACK);
+    }
+
+    EXPECT_TRUE(batcher.drain(8));
+    ASSERT_EQ(sender.frames.size(), 2u);
+    EXPECT_EQ(sender.messages[0], (uint8_t)OutgoingBatcher::MAX_BATCH_MESSAGES);
+    EXPECT_EQ(sender.frames[1], ACK);
+}
+
+TEST_F(OutgoingBatcherTest, FailedSendStopsTheDrain)
+{
+    queue(ACK);
+    queue(RESPONSE);
+    sender.fail = true;
+
+    EXPECT_FALSE(batcher.drain(8));
+    // The failed message is dropped, the next one waits for the next drain
+    sender.fail = false;
+    EXPECT_TRUE(batcher.drain(8));
+    ASSERT_EQ(sender.frames.size(), 1u);
+    EXPECT_EQ(sender.frames[0], RESPONSE);
+}
+
+TEST_F(OutgoingBatcherTest, RecordsQueueLatencyPerMessage)
+{
+    batcher.setBatching(true);
+    queue(ACK);
+    queue(RESPONSE);
+    delay(30);
+    queue(ACK);
+
+    EXPECT_TRUE(batcher.drain(8));
+    LatencyHistogram::Snapshot latency = batcher.getQueueLatency();
+    EXPECT_EQ(latency.count, 3u);
+    EXPECT_GE(latency.maxMs, 30u);
+    EXPECT_LE(latency.minMs, 5u);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_I2CDevice.h>
+#include <string.h>
+#include "nfc/Adafruit_PN532_NTAG424.h"
+#include "../emulatedPn532.hpp"
+#include "../ntag424Card.hpp"
+
+// The I2C transport of the PN532 driver on the Wire stand-in, with the
+// emulated PN532 answering as an I2C device.
+
+namespace
+{
+    const uint8_t CARD_UID[Ntag424Card::UID_LENGTH] = {0x04, 0x5A, 0x11, 0x3C, 0x72, 0x61, 0x80};
+    const uint32_t LOGINS = 200;
+
+    struct BusStats
+    {
+        uint32_t transactions;
+        uint32_t bytes;
+    };
+
+    struct ExchangeCost
+    {
+        double transactions;
+        double busBytes;
+        double copiedBytes;
+    };
+
+    // PN532 in I2C mode: writes carry a whole frame, every read starts with
+    // the RDY status byte, followed by the pending frame once it is ready
+    class I2cPn532 : public TwoWireDevice
+    {
+    public:
+        explicit I2cPn532(EmulatedPn532 &pn532) : pn532(pn532) {}
+
+        bool onWrite(const uint8_t *data, size_t length) override
+        {
+            this->stats.transactions++;
+            this->stats.bytes += length;
+            this->pn532.writeFrame(data, (uint8_t)length);
+            return true;
+        }
+
+        size_t onRead(uint8_t *data, size_t length) override
+        {
+            this->stats.transactions++;
+            this->stats.bytes += length;
+            bool ready = this->pn532.isReady();
+            data[0] = ready ? PN532_I2C_READY : 0x00;
+            if (length > 1 && ready)
+            {
+                this->pn532.read(data + 1, (uint8_t)(length - 1));
+            }
+            else if (length > 1)
+            {
+                memset(data + 1, 0, length - 1);
+            }
+            return length;
+        }
+
+        BusStats getStats() const { return this->stats; }
+
+    private:
+        EmulatedPn532 &pn532;
+        BusStats stats = {};
+    };
+
+    // Adafruit_PN532_I2CTransport before the direct read: BusIO reads RDY
+    // and the frame into an n + 1 byte VLA, the frame is copied out of it
+    class LegacyI2cTransport : public Adafruit_PN532_Transport
+    {
+    public:
+        bool begin(void) override { return this->i2c.begin(false); }
+        void writeFrame(const uint8_t *frame, uint8_t len) override { this->i2c.write(frame, len); }
+
+        void read(uint8_t *buff, uint8_t n) override
+        {
+            uint8_t rbuff[n + 1]; // +1 for leading RDY byte
+            this->i2c.read(rbuff, n + 1);
+            memcpy(buff, rbuff + 1, n);
+            this->copied += n;
+            this->stackBytes = n + 1u > this->stackBytes ? n + 1u : this->stackBytes;
+        }
+
+        bool isReady(void) override
+        {
+            uint8_t rdy[1];
+            this->i2c.read(rdy, 1);
+            return rdy[0] == PN532_I2C_READY;
+        }
+
+        uint16_t settleDelayUs(void) const override { return 1000; }
+
+        // Bytes memcpy'd out of the VLA, on top of what Wire hands out
+        uint32_t copied = 0;
+        uint32_t stackBytes = 0;
+
+    private:
+        Adafruit_I2CDevice i2c{PN532_I2C_ADDRESS, &Wire};
+    };
+
+    // Start, address byte and stop of each transaction, 9 clocks per byte
+    // including the ACK bit
+    double busUs(const ExchangeCost &cost, uint32_t hz)
+    {
+        return (cost.transactions * (1 + 9 + 1) + 9.0 * cost.busBytes) * 1e6 / hz;
+    }
+
+    class Pn532I2cTest : public ::testing::Test
+    {
+    protected:
+        EmulatedPn532 emulated;
+        I2cPn532 device{emulated};
+        Ntag424Card card{CARD_UID};
+        uint8_t key[16] = {};
+
+        void SetUp() override
+        {
+            Wire.attach(PN532_I2C_ADDRESS, &this->device);
+            this->emulated.setCard(&this->card);
+        }
+
+        void TearDown() override
+        {
+            Wire.attach(PN532_I2C_ADDRESS, nullptr);
+        }
+
+        void detect(Adafruit_PN532 &pn532)
+        {
+            uint8_t uid[PN532_MAX_UID_LENGTH];
+            uint8_t uidLength = 0;
+            ASSERT_TRUE(pn532.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, &uidLength, 100));
+            ASSERT_EQ(uidLength, Ntag424Card::UID_LENGTH);
+            EXPECT_EQ(memcmp(uid, CARD_UID, uidLength), 0);
+        }
+
+        // Bus traffic and copies per InDataExchange over LOGINS logins; legacy
+        // is the transport again if it is the old one, for its VLA copies.
+        // The emulated PN532 is ready on the first poll, so this is the least
+        // traffic an exchange can cause.
+        ExchangeCost measureLogins(const char *name, Adafruit_PN532_Transport &transport, const LegacyI2cTransport *legacy)
+        {
+            ExchangeCost cost = {};
+            Adafruit_PN532 pn532(&transport);
+            EXPECT_TRUE(pn532.begin());
+            this->detect(pn532);
+
+            BusStats bus = this->device.getStats();
+            uint32_t copied = Wire.getBytesRead() + (legacy != nullptr ? legacy->copied : 0);
+            uint32_t apdus = this->card.getApduCount();
+            for (uint32_t i = 0; i < LOGINS; i++)
+            {
+                EXPECT_TRUE(pn532.ntag424_Authenticate(this->key, 0, 0x71));
+            }
+
+            double exchanges = this->card.getApduCount() - apdus;
+            BusStats after = this->device.getStats();
+            cost.transactions = (after.transactions - bus.transactions) / exchanges;
+            cost.busBytes = (after.bytes - bus.bytes) / exchanges;
+            cost.copiedBytes = (Wire.getBytesRead() + (legacy != nullptr ? legacy->copied : 0) - copied) / exchanges;
+
+            printf("[ BENCH    ] %-40s %10.1f bus transactions, %.1f bytes, %.0f us at 100 kHz, %.0f us at 400 kHz per InDataExchange\n",
+                   name, cost.transactions, cost.busBytes, busUs(cost, 100000), busUs(cost, 400000));
+            printf("[ BENCH    ] %-40s %10.1f bytes copied, up to %u bytes of stack, %u us settle per InDataExchange\n",
+                   name, cost.copiedBytes, legacy != nullptr ? legacy->stackBytes : 0, transport.settleDelayUs());
+            return cost;
+        }
+    };
+}
+
+TEST_F(Pn532I2cTest, DirectReadAuthenticates)
+{
+    Adafruit_PN532_I2CTransport transport(&Wire);
+    Adafruit_PN532 pn532(&transport);
+    ASSERT_TRUE(pn532.begin());
+    EXPECT_EQ(pn532.getFirmwareVersion() >> 24, 0x32u);
+
+    this->detect(pn532);
+    EXPECT_TRUE(pn532.ntag424_Authenticate(this->key, 0, 0x71));
+    EXPECT_TRUE(this->card.isAuthenticated());
+    EXPECT_EQ(this->emulated.getStats().badFrames, 0u);
+}
+
+TEST_F(Pn532I2cTest, FailedReadLeavesAZeroedBuffer)
+{
+    Adafruit_PN532_I2CTransport transport(&Wire);
+    Wire.attach(PN532_I2C_ADDRESS, nullptr);
+
+    uint8_t buffer[16];
+    memset(buffer, 0xAA, sizeof(buffer));
+    transport.read(buffer, sizeof(buffer));
+    for (uint8_t value : buffer)
+    {
+        EXPECT_EQ(value, 0);
+    }
+    EXPECT_FALSE(transport.isReady());
+    EXPECT_EQ(Wire.available(), 0);
+}
+
+// The old read through BusIO against the single read into the caller's
+// buffer: the bus carries the same bytes, the frame is copied once less
+TEST_F(Pn532I2cTest, BenchmarkInDataExchangeBusTime)
+{
+    LegacyI2cTransport legacy;
+    ExchangeCost old = this->measureLogins("old read (n + 1 VLA, memcpy)", legacy, &legacy);
+    Adafruit_PN532_I2CTransport direct(&Wire);
+    ExchangeCost now = this->measureLogins("direct read into the caller buffer", direct, nullptr);
+
+    EXPECT_EQ(now.transactions, old.transactions);
+    EXPECT_EQ(now.busBytes, old.busBytes);
+    EXPECT_LT(now.copiedBytes, old.copiedBytes);
+    EXPECT_GT(legacy.stackBytes, 0u);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
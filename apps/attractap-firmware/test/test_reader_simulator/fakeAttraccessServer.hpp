@@ -0,0 +1,479 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Server side of one reader connection, replaying the reader states of
+// apps/api/src/attractap/websockets: InitialReaderState (authentication and
+// firmware info), then WaitForNFCTapState for a reader with one resource.
+// Like the gateway's sendMessage(), every message waits for the reader's
+// ACK_<type> before the state goes on. Frames are JSON text, exchanged with
+// whatever stands in for the websocket through receive() and takeFrame();
+// BATCH frames from the reader are unwrapped like the gateway's handler does.
+class FakeAttraccessServer
+{
+public:
+    struct Options
+    {
+        uint32_t readerId = 1;
+        std::string token;
+        // InitialReaderState waits a second before asking for authentication
+        uint32_t authenticationDelayMs = 1000;
+        // How long WaitForNFCTapState shows a result before it restarts
+        uint32_t successHoldMs = 10000;
+        uint32_t errorHoldMs = 5000;
+        // The gateway gives up on a message after 3 attempts of 4 s
+        uint32_t ackTimeoutMs = 4000;
+        uint8_t ackAttempts = 3;
+    };
+
+    struct Stats
+    {
+        uint32_t framesFromReader;
+        // Messages in those frames, more than frames once the reader batches
+        uint32_t messagesFromReader;
+        uint32_t framesToReader;
+        uint32_t ackTimeouts;
+        uint32_t tapsServed;
+        uint32_t tapsRejected;
+        // Card checking is enabled and no tap arrived since
+        bool waitingForTap;
+    };
+
+    explicit FakeAttraccessServer(const Options &options) : options(options) {}
+    ~FakeAttraccessServer() { this->stop(); }
+
+    // A card the server knows, with its key 0 as 32 hex digits
+    void addCard(const std::string &uidHex, const std::string &keyHex)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->cards[uidHex] = keyHex;
+    }
+
+    /*
+     *  Send an unrelated message right after each NFC_TAP and answer the tap
+     *  only after a delay, like a tap arriving while the gateway refreshes
+     *  the access list next to the states
+     */
+    void setBackgroundMessageOnTap(bool enabled, uint32_t tapAnswerDelayMs)
+    {
+        this->backgroundMessageOnTap = enabled;
+        this->tapAnswerDelayMs = tapAnswerDelayMs;
+    }
+
+    void start()
+    {
+        this->thread = std::thread([this]()
+                                   { this->run(); });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->inboxChanged.notify_all();
+        if (this->thread.joinable())
+        {
+            this->thread.join();
+        }
+    }
+
+    // A frame the reader sent
+    void receive(const char *data, size_t length)
+    {
+        std::vector<std::string> messages;
+        JsonDocument frame;
+        if (deserializeJson(frame, data, length) == DeserializationError::Ok && frame["event"] == "BATCH")
+        {
+            for (JsonVariantConst message : frame["data"].as<JsonArrayConst>())
+            {
+                std::string text;
+                serializeJson(message, text);
+                messages.push_back(std::move(text));
+            }
+        }
+        else
+        {
+            messages.emplace_back(data, length);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            for (std::string &message : messages)
+            {
+                this->inbox.push_back(std::move(message));
+            }
+            this->stats.framesFromReader++;
+            this->stats.messagesFromReader += messages.size();
+        }
+        this->inboxChanged.notify_all();
+    }
+
+    // The next frame for the reader, false if there is none
+    bool takeFrame(std::string &frame)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->outbox.empty())
+        {
+            return false;
+        }
+        frame = std::move(this->outbox.front());
+        this->outbox.pop_front();
+        return true;
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->stats;
+    }
+
+    // Why the connection was given up, empty while it is fine
+    std::string getFailure()
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->failure;
+    }
+
+private:
+    const Options options;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable inboxChanged;
+    bool stopping = false;
+    std::deque<std::string> inbox;
+    std::deque<std::string> outbox;
+    // Frames that arrived while a message waited for its ACK, handled next
+    std::deque<std::string> pending;
+    std::map<std::string, std::string> cards;
+    Stats stats = {};
+    std::string failure;
+
+    std::atomic<bool> backgroundMessageOnTap{false};
+    std::atomic<uint32_t> tapAnswerDelayMs{0};
+    bool resourceInUse = false;
+
+    void run()
+    {
+        if (!this->authenticate())
+        {
+            return;
+        }
+
+        if (!this->enableCardChecking())
+        {
+            return;
+        }
+
+        JsonDocument tap;
+        while (this->waitFor("EVENT", "NFC_TAP", tap))
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->stats.waitingForTap = false;
+            }
+            std::string cardUid = tap["data"]["payload"]["cardUID"] | "";
+            if (!this->onNfcTap(cardUid))
+            {
+                return;
+            }
+        }
+    }
+
+    bool authenticate()
+    {
+        if (!this->sleepFor(this->options.authenticationDelayMs) ||
+            !this->sendMessage("EVENT", "READER_REQUEST_AUTHENTICATION", emptyPayload().as<JsonVariantConst>()))
+        {
+            return false;
+        }
+
+        JsonDocument request;
+        if (!this->waitFor("RESPONSE", "READER_REQUEST_AUTHENTICATION", request))
+        {
+            return false;
+        }
+        JsonObjectConst credentials = request["data"]["payload"];
+        if (credentials["id"] != this->options.readerId || credentials["token"] != this->options.token)
+        {
+            JsonDocument unauthorized;
+            unauthorized["message"] = "PLEASE_REREGISTER";
+            this->sendMessage("EVENT", "READER_UNAUTHORIZED", unauthorized.as<JsonVariantConst>());
+            this->fail("reader sent unknown credentials");
+            return false;
+        }
+
+        // The websocket stand-in batches when a test asks for it, whatever is announced here
+        JsonDocument authenticated;
+        authenticated["name"] = "Simulated reader";
+        authenticated["features"].to<JsonArray>();
+        authenticated["encoding"] = "JSON";
+        if (!this->sendMessage("RESPONSE", "READER_AUTHENTICATED", authenticated.as<JsonVariantConst>()) ||
+            !this->sendMessage("EVENT", "READER_FIRMWARE_INFO", emptyPayload().as<JsonVariantConst>()))
+        {
+            return false;
+        }
+
+        JsonDocument firmware;
+        return this->waitFor("RESPONSE", "READER_FIRMWARE_INFO", firmware);
+    }
+
+    // WaitForNFCTapState.onNFCTap() and onAuthenticate()
+    bool onNfcTap(const std::string &cardUid)
+    {
+        if (this->backgroundMessageOnTap &&
+            !this->sendMessage("EVENT", "READER_FIRMWARE_INFO", emptyPayload().as<JsonVariantConst>()))
+        {
+            return false;
+        }
+        if (!this->sleepFor(this->tapAnswerDelayMs))
+        {
+            return false;
+        }
+
+        JsonDocument text;
+        text["message"] = "Do not remove card!";
+        if (!this->sendMessage("EVENT", "DISPLAY_TEXT", text.as<JsonVariantConst>()))
+        {
+            return false;
+        }
+
+        std::string key;
+        if (!this->findCard(cardUid, key))
+        {
+            return this->rejectCard();
+        }
+
+        JsonDocument authenticate;
+        authenticate["authenticationKey"] = key;
+        authenticate["keyNumber"] = 0;
+        if (!this->sendMessage("EVENT", "NFC_AUTHENTICATE", authenticate.as<JsonVariantConst>()))
+        {
+            return false;
+        }
+
+        JsonDocument result;
+        if (!this->waitFor("RESPONSE", "NFC_AUTHENTICATE", result))
+        {
+            return false;
+        }
+        if (!result["data"]["payload"]["successful"].as<bool>())
+        {
+            return this->rejectCard();
+        }
+
+        this->resourceInUse = !this->resourceInUse;
+        JsonDocument success;
+        success["message"] = this->resourceInUse ? "Resource started" : "Resource stopped";
+        // Counted first, the reader shows the message before its ACK gets back here
+        this->count(&Stats::tapsServed);
+        if (!this->sendMessage("EVENT", "DISPLAY_SUCCESS", success.as<JsonVariantConst>()))
+        {
+            return false;
+        }
+
+        return this->sleepFor(this->options.successHoldMs) && this->restart();
+    }
+
+    // WaitForNFCTapState.onInvalidCard()
+    bool rejectCard()
+    {
+        if (!this->disableCardChecking())
+        {
+            return false;
+        }
+
+        JsonDocument error;
+        error["message"] = "Invalid card";
+        this->count(&Stats::tapsRejected);
+        if (!this->sendMessage("EVENT", "DISPLAY_ERROR", error.as<JsonVariantConst>()))
+        {
+            return false;
+        }
+
+        return this->sleepFor(this->options.errorHoldMs) && this->restart();
+    }
+
+    bool findCard(const std::string &cardUid, std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto card = this->cards.find(cardUid);
+        if (card == this->cards.end())
+        {
+            return false;
+        }
+        key = card->second;
+        return true;
+    }
+
+    bool restart()
+    {
+        return this->disableCardChecking() && this->enableCardChecking();
+    }
+
+    bool enableCardChecking()
+    {
+        JsonDocument payload;
+        payload["type"] = "toggle-resource-usage";
+        payload["resource"]["id"] = 1;
+        payload["resource"]["name"] = "Laser cutter";
+        payload["isActive"] = this->resourceInUse;
+        payload["activeUsageSession"] = nullptr;
+        payload["hasActiveMaintenance"] = false;
+        payload["maintenances"].to<JsonArray>();
+        if (!this->sendMessage("EVENT", "NFC_ENABLE_CARD_CHECKING", payload.as<JsonVariantConst>()))
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stats.waitingForTap = true;
+        return true;
+    }
+
+    bool disableCardChecking()
+    {
+        // Sent without a payload, JSON.stringify() drops the undefined one
+        return this->sendMessage("EVENT", "WAIT_FOR_PROCESSING", JsonVariantConst());
+    }
+
+    static JsonDocument emptyPayload()
+    {
+        JsonDocument payload;
+        payload.to<JsonObject>();
+        return payload;
+    }
+
+    /*
+     *  Send a message and wait for its ACK, retrying like the gateway
+     *  @return false if the reader never acknowledged it (the gateway closes the connection)
+     */
+    bool sendMessage(const char *event, const char *type, JsonVariantConst payload)
+    {
+        JsonDocument message;
+        message["event"] = event;
+        message["data"]["type"] = type;
+        if (!payload.isNull())
+        {
+            message["data"]["payload"] = payload;
+        }
+        std::string frame;
+        serializeJson(message, frame);
+        std::string ack = std::string("ACK_") + type;
+
+        for (uint8_t attempt = 0; attempt < this->options.ackAttempts; attempt++)
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->outbox.push_back(frame);
+            this->stats.framesToReader++;
+
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(this->options.ackTimeoutMs);
+            while (!this->stopping)
+            {
+                if (this->inbox.empty())
+                {
+                    if (this->inboxChanged.wait_until(lock, deadline) == std::cv_status::timeout)
+                    {
+                        break;
+                    }
+                    continue;
+                }
+
+                std::string received = std::move(this->inbox.front());
+                this->inbox.pop_front();
+                if (isMessage(received, "RESPONSE", ack.c_str()))
+                {
+                    return true;
+                }
+                this->pending.push_back(std::move(received));
+            }
+            if (this->stopping)
+            {
+                return false;
+            }
+            this->stats.ackTimeouts++;
+        }
+
+        this->fail("no " + ack + " from the reader");
+        return false;
+    }
+
+    /*
+     *  Wait for a message of the given type, dropping everything else like a
+     *  state that does not handle it
+     *  @return false once the server is stopped
+     */
+    bool waitFor(const char *event, const char *type, JsonDocument &message)
+    {
+        while (true)
+        {
+            std::string received;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                if (!this->pending.empty())
+                {
+                    received = std::move(this->pending.front());
+                    this->pending.pop_front();
+                }
+                else
+                {
+                    this->inboxChanged.wait(lock, [this]()
+                                            { return this->stopping || !this->inbox.empty(); });
+                    if (this->stopping)
+                    {
+                        return false;
+                    }
+                    received = std::move(this->inbox.front());
+                    this->inbox.pop_front();
+                }
+            }
+
+            if (deserializeJson(message, received) == DeserializationError::Ok &&
+                message["event"] == event && message["data"]["type"] == type)
+            {
+                return true;
+            }
+        }
+    }
+
+    static bool isMessage(const std::string &frame, const char *event, const char *type)
+    {
+        JsonDocument message;
+        return deserializeJson(message, frame) == DeserializationError::Ok &&
+               message["event"] == event && message["data"]["type"] == type;
+    }
+
+    // False if the server was stopped meanwhile
+    bool sleepFor(uint32_t ms)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        return !this->inboxChanged.wait_for(lock, std::chrono::milliseconds(ms), [this]()
+                                            { return this->stopping; });
+    }
+
+    void count(uint32_t Stats::*counter)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stats.*counter += 1;
+    }
+
+    void fail(const std::string &reason)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->failure.empty())
+        {
+            this->failure = reason;
+        }
+    }
+};
@@ -0,0 +1,505 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "api/api.hpp"
+#include "firmwareUpdate/firmwareUpdate.hpp"
+#include "settings/settings.hpp"
+#include "state/state.hpp"
+#include "websocket/outgoingBatcher.hpp"
+#include "fakeAttraccessServer.hpp"
+
+// The API task of the firmware against a server replaying the reader states.
+// The websocket and NFC tasks are stood in for at their State queues: the
+// websocket client needs the generated certificate bundle and the NFC task a
+// PN532. Numbers are host numbers, the API task still polls its queues every
+// 20 ms like on the reader. More taps:
+//   PLATFORMIO_BUILD_FLAGS=-DREADER_SIMULATOR_TAPS=5000 pio test -e native -f test_reader_simulator -v
+
+#ifndef READER_SIMULATOR_TAPS
+#define READER_SIMULATOR_TAPS 200
+#endif
+
+namespace
+{
+    const uint32_t READER_ID = 7;
+    const char *READER_TOKEN = "simulated-reader-token";
+
+    const char *CARD_UID = "04512a6a9c1190";
+    const char *CARD_KEY = "000102030405060708090a0b0c0d0e0f";
+    const uint8_t CARD_KEY_BYTES[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                                        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+    const char *UNKNOWN_CARD_UID = "047e1302b15d80";
+
+    // Generous, a tap takes a few API loops
+    const uint32_t TAP_TIMEOUT_MS = 5000;
+
+    // Same as the websocket task
+    const uint32_t WEBSOCKET_WAKEUP_MS = 20;
+    const uint8_t MAX_FRAMES_PER_WAKEUP = 8;
+
+    FakeAttraccessServer::Options serverOptions()
+    {
+        FakeAttraccessServer::Options options;
+        options.readerId = READER_ID;
+        options.token = READER_TOKEN;
+        // The simulation measures the reader, not how long results are shown
+        options.authenticationDelayMs = 0;
+        options.successHoldMs = 0;
+        options.errorHoldMs = 0;
+        return options;
+    }
+
+    // Never destroyed, the tasks using them run until the program ends
+    FakeAttraccessServer *server = nullptr;
+    FirmwareUpdate *firmwareUpdate = nullptr;
+    API *api = nullptr;
+    OutgoingBatcher *outgoing = nullptr;
+
+    // How the websocket stand-in drains the outgoing ring. It wakes up every
+    // millisecond unless a test asks for the websocket task's 20 ms.
+    std::atomic<uint32_t> websocketWakeupMs{1};
+    std::atomic<uint8_t> framesPerWakeup{MAX_FRAMES_PER_WAKEUP};
+    std::atomic<bool> batching{false};
+
+    // The websocket client: frames go straight to the server
+    class ServerLink : public OutgoingBatcher::FrameSender
+    {
+    public:
+        bool sendFrame(const char *data, size_t length, uint8_t messages) override
+        {
+            (void)messages;
+            server->receive(data, length);
+            return true;
+        }
+    };
+
+    // Websocket task: frames between the State rings and the server, sent
+    // through the firmware's OutgoingBatcher and decoded like
+    // Websocket::decodeIncomingMessages()
+    void websocketTask(void *parameter)
+    {
+        (void)parameter;
+        JsonDocument decodeDoc;
+        State::setWebsocketState(true, "loopback", 80, false);
+
+        while (true)
+        {
+            outgoing->setBatching(batching);
+            outgoing->drain(framesPerWakeup);
+
+            std::string frame;
+            while (server->takeFrame(frame))
+            {
+                // Counted as dropped by State if the ring is full
+                char *slot = State::reserveIncomingWebsocketMessage(frame.size() + 1);
+                if (slot != nullptr)
+                {
+                    slot[0] = 'T';
+                    memcpy(slot + 1, frame.data(), frame.size());
+                    State::commitIncomingWebsocketMessage(slot);
+                }
+            }
+
+            State::WebsocketMessage message;
+            while (State::getNextIncomingWebsocketMessage(message))
+            {
+                decodeDoc.clear();
+                ApiCommand command;
+                bool decoded = ApiCommandDecoder::decode(message.data + 1, message.length - 1, command, decodeDoc, API_ENCODING_JSON);
+                State::releaseIncomingWebsocketMessage(message);
+                if (!decoded)
+                {
+                    continue;
+                }
+
+                if (!ApiCommandDecoder::detach(command, decodeDoc) || !State::pushApiCommandToQueue(command))
+                {
+                    ApiCommandDecoder::release(command);
+                }
+            }
+
+            vTaskDelay(pdMS_TO_TICKS(websocketWakeupMs));
+        }
+    }
+
+    // NFC task: presents a card whenever the reader waits for a tap and
+    // answers NFC_AUTHENTICATE by comparing the key. Also the display, which
+    // ends a tap once the result is shown.
+    class SimulatedCard
+    {
+    public:
+        struct Result
+        {
+            uint32_t successes;
+            uint32_t errors;
+            uint32_t wrongKeys;
+            // Tap to the result on the display
+            std::vector<uint32_t> latenciesUs;
+        };
+
+        void present(const char *uid, uint32_t taps)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->uid = uid;
+            this->tapsLeft = taps;
+            this->result = Result();
+        }
+
+        bool finished()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->tapsLeft == 0 && !this->tapInFlight;
+        }
+
+        Result getResult()
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->result;
+        }
+
+        static void taskFn(void *parameter)
+        {
+            SimulatedCard *card = (SimulatedCard *)parameter;
+            EventGroupHandle_t subscription = State::subscribe(State::STATE_CHANGE_API_EVENT);
+            while (true)
+            {
+                State::waitForChanges(subscription, 5);
+                card->answerNfcCommands();
+                card->onDisplay(State::getApiEventData().state);
+            }
+        }
+
+    private:
+        std::mutex mutex;
+        String uid;
+        uint32_t tapsLeft = 0;
+        bool tapInFlight = false;
+        unsigned long tappedAtUs = 0;
+        Result result = {};
+
+        void answerNfcCommands()
+        {
+            State::NfcCommand command;
+            while (State::getNextNfcCommand(command))
+            {
+                bool keyMatches = command.type == State::NfcCommandType::NFC_COMMAND_TYPE_AUTHENTICATE &&
+                                  memcmp(command.authenticate.authKey, CARD_KEY_BYTES, sizeof(CARD_KEY_BYTES)) == 0;
+                if (!keyMatches)
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    this->result.wrongKeys++;
+                }
+                State::pushNfcResultToApi(keyMatches ? State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_SUCCESS
+                                                     : State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_AUTHENTICATE_FAILED,
+                                          command.correlationId);
+            }
+        }
+
+        void onDisplay(State::ApiEventState state)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (this->tapInFlight)
+            {
+                if (state == State::ApiEventState::API_EVENT_STATE_DISPLAY_SUCCESS ||
+                    state == State::ApiEventState::API_EVENT_STATE_DISPLAY_ERROR)
+                {
+                    this->result.latenciesUs.push_back(micros() - this->tappedAtUs);
+                    if (state == State::ApiEventState::API_EVENT_STATE_DISPLAY_SUCCESS)
+                    {
+                        this->result.successes++;
+                    }
+                    else
+                    {
+                        this->result.errors++;
+                    }
+                    this->tapInFlight = false;
+                }
+                return;
+            }
+
+            if (this->tapsLeft > 0 && state == State::ApiEventState::API_EVENT_STATE_WAIT_FOR_NFC_TAP)
+            {
+                this->tapsLeft--;
+                this->tapInFlight = true;
+                this->tappedAtUs = micros();
+                State::pushEventToApi(State::ApiInputEventType::API_INPUT_EVENT_NFC_CARD_DETECTED, this->uid);
+            }
+        }
+    };
+
+    SimulatedCard *card = nullptr;
+
+    bool waitFor(uint32_t timeoutMs, bool (*done)())
+    {
+        unsigned long start = millis();
+        while (!done())
+        {
+            if (millis() - start > timeoutMs)
+            {
+                return false;
+            }
+            delay(5);
+        }
+        return true;
+    }
+
+    double percentileMs(std::vector<uint32_t> samplesUs, uint8_t percent)
+    {
+        if (samplesUs.empty())
+        {
+            return 0;
+        }
+        std::sort(samplesUs.begin(), samplesUs.end());
+        size_t index = (samplesUs.size() * percent + 99) / 100;
+        return samplesUs[std::max<size_t>(index, 1) - 1] / 1000.0;
+    }
+
+    // Tap latency samples the API recorded between two snapshots
+    LatencyHistogram::Snapshot samplesBetween(const LatencyHistogram::Snapshot &before, const LatencyHistogram::Snapshot &after)
+    {
+        LatencyHistogram::Snapshot samples = after;
+        samples.count -= before.count;
+        samples.sumMs -= before.sumMs;
+        for (uint8_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++)
+        {
+            samples.buckets[i] -= before.buckets[i];
+        }
+        return samples;
+    }
+
+    // Samples in buckets entirely below `ms`
+    uint32_t samplesBelow(const LatencyHistogram::Snapshot &samples, uint32_t ms)
+    {
+        uint32_t count = 0;
+        for (uint8_t i = 0; i < LatencyHistogram::BUCKET_COUNT && (1u << i) <= ms; i++)
+        {
+            count += samples.buckets[i];
+        }
+        return count;
+    }
+}
+
+namespace
+{
+    // An ACK, the response it announced and a heartbeat, queued together
+    // like at the end of a tap. The reader's own heartbeat is written by the
+    // websocket task after the drain; it is queued here so all three take
+    // the same path.
+    void queueBurst(uint32_t seq)
+    {
+        char heartbeat[64];
+        snprintf(heartbeat, sizeof(heartbeat), "{\"event\":\"HEARTBEAT\",\"data\":{\"seq\":%u,\"ts\":%lu}}", seq, millis());
+        const char *messages[] = {
+            R"({"event":"RESPONSE","data":{"type":"ACK_NFC_AUTHENTICATE","payload":{}}})",
+            R"({"event":"RESPONSE","data":{"type":"NFC_AUTHENTICATE","payload":{"successful":true}}})",
+            heartbeat,
+        };
+        for (const char *message : messages)
+        {
+            size_t length = strlen(message);
+            char *slot = State::reserveOutgoingWebsocketMessage(length);
+            ASSERT_NE(slot, nullptr);
+            memcpy(slot, message, length);
+            State::commitOutgoingWebsocketMessage(slot);
+        }
+    }
+
+    bool waitForMessagesFromReader(uint32_t count, uint32_t timeoutMs)
+    {
+        unsigned long start = millis();
+        while (server->getStats().messagesFromReader < count)
+        {
+            if (millis() - start > timeoutMs)
+            {
+                return false;
+            }
+            delay(1);
+        }
+        return true;
+    }
+}
+
+class ReaderSimulatorTest : public ::testing::Test
+{
+protected:
+    // One reader for the whole suite, its tasks run for the rest of the program
+    static void SetUpTestSuite()
+    {
+        Serial.mute(true);
+
+        Settings::saveAttraccessAuthConfig(READER_TOKEN, READER_ID);
+        server = new FakeAttraccessServer(serverOptions());
+        server->addCard(CARD_UID, CARD_KEY);
+        server->start();
+
+        firmwareUpdate = new FirmwareUpdate();
+        firmwareUpdate->setup();
+        outgoing = new OutgoingBatcher(*new ServerLink());
+        card = new SimulatedCard();
+        xTaskCreate(websocketTask, "Websocket", 8192, nullptr, 1, nullptr);
+        xTaskCreate(SimulatedCard::taskFn, "NFC", 4096, card, 1, nullptr);
+        api = new API();
+        api->setup(firmwareUpdate);
+    }
+
+    void SetUp() override
+    {
+        ASSERT_TRUE(waitFor(TAP_TIMEOUT_MS, []()
+                            { return server->getStats().waitingForTap; }))
+            << "reader did not reach WaitForNFCTapState: " << server->getFailure();
+        server->setBackgroundMessageOnTap(false, 0);
+    }
+
+    void TearDown() override
+    {
+        EXPECT_EQ(server->getFailure(), "");
+    }
+
+    static bool runTaps(const char *uid, uint32_t taps)
+    {
+        card->present(uid, taps);
+        return waitFor(taps * TAP_TIMEOUT_MS, []()
+                       { return card->finished(); });
+    }
+};
+
+TEST_F(ReaderSimulatorTest, AuthenticatesAndWaitsForTaps)
+{
+    EXPECT_TRUE(State::getApiState().authenticated);
+    EXPECT_EQ(State::getApiState().deviceName, "Simulated reader");
+    // The reader ACKs a command before it acts on it
+    EXPECT_TRUE(waitFor(TAP_TIMEOUT_MS, []()
+                        { return State::getApiEventData().state == State::ApiEventState::API_EVENT_STATE_WAIT_FOR_NFC_TAP; }));
+}
+
+TEST_F(ReaderSimulatorTest, UnknownCardIsRejected)
+{
+    FakeAttraccessServer::Stats before = server->getStats();
+    ASSERT_TRUE(runTaps(UNKNOWN_CARD_UID, 1));
+
+    SimulatedCard::Result result = card->getResult();
+    EXPECT_EQ(result.errors, 1u);
+    EXPECT_EQ(result.successes, 0u);
+    EXPECT_EQ(server->getStats().tapsRejected, before.tapsRejected + 1);
+}
+
+// The API's tap latency ends at the answer to the tap, not at whatever the
+// server sent in between
+TEST_F(ReaderSimulatorTest, TapLatencyWaitsForTheTapsAnswer)
+{
+    const uint32_t TAPS = 10;
+    const uint32_t ANSWER_DELAY_MS = 100;
+    server->setBackgroundMessageOnTap(true, ANSWER_DELAY_MS);
+
+    LatencyHistogram::Snapshot before = api->getTapLatency();
+    ASSERT_TRUE(runTaps(CARD_UID, TAPS));
+    LatencyHistogram::Snapshot samples = samplesBetween(before, api->getTapLatency());
+
+    EXPECT_EQ(card->getResult().successes, TAPS);
+    EXPECT_EQ(samples.count, TAPS);
+    EXPECT_EQ(samplesBelow(samples, ANSWER_DELAY_MS), 0u);
+}
+
+TEST_F(ReaderSimulatorTest, SimulateTaps)
+{
+    const uint32_t TAPS = READER_SIMULATOR_TAPS;
+    FakeAttraccessServer::Stats serverBefore = server->getStats();
+    LatencyHistogram::Snapshot apiBefore = api->getTapLatency();
+    unsigned long start = millis();
+
+    ASSERT_TRUE(runTaps(CARD_UID, TAPS));
+
+    double seconds = (millis() - start) / 1000.0;
+    SimulatedCard::Result result = card->getResult();
+    FakeAttraccessServer::Stats serverAfter = server->getStats();
+    LatencyHistogram::Snapshot apiSamples = samplesBetween(apiBefore, api->getTapLatency());
+
+    EXPECT_EQ(result.successes, TAPS);
+    EXPECT_EQ(result.errors, 0u);
+    EXPECT_EQ(result.wrongKeys, 0u);
+    EXPECT_EQ(serverAfter.tapsServed - serverBefore.tapsServed, TAPS);
+    EXPECT_EQ(serverAfter.ackTimeouts, serverBefore.ackTimeouts);
+    // One sample per tap, none left over for the restart after it
+    EXPECT_EQ(apiSamples.count, TAPS);
+
+    uint32_t fromReader = serverAfter.framesFromReader - serverBefore.framesFromReader;
+    uint32_t toReader = serverAfter.framesToReader - serverBefore.framesToReader;
+    printf("[ BENCH    ] %u taps in %.1f s, tap to DISPLAY_SUCCESS p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+           TAPS, seconds,
+           percentileMs(result.latenciesUs, 50), percentileMs(result.latenciesUs, 90),
+           percentileMs(result.latenciesUs, 99), percentileMs(result.latenciesUs, 100));
+    printf("[ BENCH    ] %u frames from the reader, %u to it, %.1f messages/s\n",
+           fromReader, toReader, (fromReader + toReader) / seconds);
+    printf("[ BENCH    ] API tap latency (NFC_TAP to its answer) p50 <= %u ms, p99 <= %u ms\n",
+           apiSamples.percentile(50), apiSamples.percentile(99));
+}
+
+// Queued to sent for an outgoing burst, with the websocket task's 20 ms
+// wakeups: one frame per wakeup like the old loop, draining all of it, and
+// draining it into one BATCH frame
+TEST_F(ReaderSimulatorTest, BenchmarkOutgoingBurstLatency)
+{
+    const uint32_t BURSTS = 50;
+    const uint32_t BURST_MESSAGES = 3;
+    struct Variant
+    {
+        const char *name;
+        uint8_t framesPerWakeup;
+        bool batching;
+        double meanMs;
+        double framesPerBurst;
+    };
+    Variant variants[] = {
+        {"one frame per wakeup (old loop)", 1, false, 0, 0},
+        {"drain all per wakeup", MAX_FRAMES_PER_WAKEUP, false, 0, 0},
+        {"drain all per wakeup, BATCH", MAX_FRAMES_PER_WAKEUP, true, 0, 0},
+    };
+
+    websocketWakeupMs = WEBSOCKET_WAKEUP_MS;
+    for (Variant &variant : variants)
+    {
+        framesPerWakeup = variant.framesPerWakeup;
+        batching = variant.batching;
+        delay(2 * WEBSOCKET_WAKEUP_MS);
+
+        LatencyHistogram::Snapshot before = outgoing->getQueueLatency();
+        FakeAttraccessServer::Stats serverBefore = server->getStats();
+        for (uint32_t burst = 0; burst < BURSTS; burst++)
+        {
+            // Spread over the wakeup period, a burst does not wait for the tick
+            delay(burst * 7 % WEBSOCKET_WAKEUP_MS);
+            queueBurst(burst);
+            ASSERT_TRUE(waitForMessagesFromReader(serverBefore.messagesFromReader + (burst + 1) * BURST_MESSAGES, TAP_TIMEOUT_MS));
+        }
+
+        LatencyHistogram::Snapshot samples = samplesBetween(before, outgoing->getQueueLatency());
+        FakeAttraccessServer::Stats serverAfter = server->getStats();
+        ASSERT_EQ(samples.count, BURSTS * BURST_MESSAGES);
+        variant.meanMs = (double)samples.sumMs / samples.count;
+        variant.framesPerBurst = (double)(serverAfter.framesFromReader - serverBefore.framesFromReader) / BURSTS;
+        printf("[ BENCH    ] %-40s queued to sent mean %.1f ms, p50 <= %u ms, p99 <= %u ms, %.1f frames per burst\n",
+               variant.name, variant.meanMs, samples.percentile(50), samples.percentile(99), variant.framesPerBurst);
+    }
+
+    websocketWakeupMs = 1;
+    framesPerWakeup = MAX_FRAMES_PER_WAKEUP;
+    batching = false;
+
+    // The old loop leaves the second and third message for later wakeups
+    EXPECT_GT(variants[0].meanMs, variants[1].meanMs + WEBSOCKET_WAKEUP_MS / 2);
+    EXPECT_EQ(variants[1].framesPerBurst, BURST_MESSAGES);
+    // A wakeup between two commits may split a burst in two frames
+    EXPECT_LT(variants[2].framesPerBurst, 1.5);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
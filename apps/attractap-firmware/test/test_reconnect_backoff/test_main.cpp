@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include "websocket/reconnectBackoff.hpp"
+
+// Same schedule as the websocket client
+static const uint32_t INITIAL_DELAY_MS = 1000;
+static const uint32_t MAX_DELAY_MS = 60000;
+static const uint32_t STABLE_AFTER_MS = 30000;
+
+class ReconnectBackoffTest : public ::testing::Test
+{
+protected:
+    ReconnectBackoff backoff{INITIAL_DELAY_MS, MAX_DELAY_MS, STABLE_AFTER_MS};
+
+    // Attempt that fails without ever connecting
+    uint32_t failAttempt(uint32_t nowMs, uint32_t randomValue)
+    {
+        EXPECT_TRUE(backoff.isAttemptDue(nowMs));
+        backoff.beginAttempt();
+        return backoff.onConnectionLost(nowMs, randomValue);
+    }
+
+    // Connect at nowMs and drop the connection after uptimeMs
+    uint32_t dropAfter(uint32_t nowMs, uint32_t uptimeMs, uint32_t randomValue)
+    {
+        EXPECT_TRUE(backoff.isAttemptDue(nowMs));
+        backoff.beginAttempt();
+        backoff.onConnected(nowMs);
+        return backoff.onConnectionLost(nowMs + uptimeMs, randomValue);
+    }
+};
+
+TEST_F(ReconnectBackoffTest, FirstRetryIsImmediate)
+{
+    EXPECT_TRUE(backoff.isAttemptDue(0));
+
+    EXPECT_EQ(dropAfter(1000, 5000, 12345), 0u);
+    EXPECT_TRUE(backoff.isAttemptDue(6000));
+    EXPECT_EQ(backoff.msUntilNextAttempt(6000), 0u);
+}
+
+TEST_F(ReconnectBackoffTest, DelaysGrowExponentiallyWithEqualJitter)
+{
+    uint32_t now = 0;
+    EXPECT_EQ(failAttempt(now, 0), 0u);
+
+    uint32_t cap = INITIAL_DELAY_MS;
+    for (uint32_t failure = 2; cap < MAX_DELAY_MS; failure++, cap *= 2)
+    {
+        // Smallest and largest jitter land on the two ends of [cap / 2, cap]
+        EXPECT_EQ(ReconnectBackoff::delayForFailure(failure, INITIAL_DELAY_MS, MAX_DELAY_MS, 0), cap / 2) << "failure " << failure;
+        EXPECT_EQ(ReconnectBackoff::delayForFailure(failure, INITIAL_DELAY_MS, MAX_DELAY_MS, cap - cap / 2), cap) << "failure " << failure;
+
+        uint32_t delay = failAttempt(now, 0x9E3779B9u * failure);
+        EXPECT_GE(delay, cap / 2) << "failure " << failure;
+        EXPECT_LE(delay, cap) << "failure " << failure;
+
+        EXPECT_FALSE(backoff.isAttemptDue(now + delay - 1));
+        EXPECT_EQ(backoff.msUntilNextAttempt(now + delay - 1), 1u);
+        now += delay;
+    }
+}
+
+TEST_F(ReconnectBackoffTest, DelayIsCappedAtSixtySeconds)
+{
+    for (uint32_t failure = 1; failure <= 64; failure++)
+    {
+        EXPECT_LE(ReconnectBackoff::delayForFailure(failure, INITIAL_DELAY_MS, MAX_DELAY_MS, UINT32_MAX), MAX_DELAY_MS);
+    }
+    EXPECT_EQ(ReconnectBackoff::delayForFailure(40, INITIAL_DELAY_MS, MAX_DELAY_MS, 0), MAX_DELAY_MS / 2);
+    EXPECT_EQ(ReconnectBackoff::delayForFailure(40, INITIAL_DELAY_MS, MAX_DELAY_MS, MAX_DELAY_MS / 2), MAX_DELAY_MS);
+
+    uint32_t now = 0;
+    for (int i = 0; i < 20; i++)
+    {
+        now += failAttempt(now, MAX_DELAY_MS / 2);
+    }
+    EXPECT_EQ(backoff.getStats(now).lastDelayMs, MAX_DELAY_MS);
+}
+
+TEST_F(ReconnectBackoffTest, ShortConnectionDoesNotResetSchedule)
+{
+    uint32_t now = 0;
+    now += failAttempt(now, 0);
+    now += failAttempt(now, 0);
+    EXPECT_EQ(backoff.getStats(now).consecutiveFailures, 2u);
+
+    // The server accepts and drops right away, the schedule keeps growing
+    uint32_t delay = dropAfter(now, STABLE_AFTER_MS - 1, 0);
+    EXPECT_EQ(backoff.getStats(now).consecutiveFailures, 3u);
+    EXPECT_EQ(delay, INITIAL_DELAY_MS);
+}
+
+TEST_F(ReconnectBackoffTest, StableConnectionResetsSchedule)
+{
+    uint32_t now = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        now += failAttempt(now, 0);
+    }
+    EXPECT_EQ(backoff.getStats(now).consecutiveFailures, 5u);
+
+    EXPECT_EQ(dropAfter(now, STABLE_AFTER_MS, 0), 0u);
+    EXPECT_EQ(backoff.getStats(now).consecutiveFailures, 1u);
+}
+
+TEST_F(ReconnectBackoffTest, RepeatedLossReportsAreCountedOnce)
+{
+    backoff.beginAttempt();
+    uint32_t delay = backoff.onConnectionLost(0, 0);
+
+    // Error and disconnect events for the same failure
+    EXPECT_EQ(backoff.onConnectionLost(0, 0), delay);
+    EXPECT_EQ(backoff.getStats(0).failures, 1u);
+    EXPECT_EQ(backoff.getStats(0).consecutiveFailures, 1u);
+}
+
+TEST_F(ReconnectBackoffTest, UptimeSurvivesTickWraparound)
+{
+    const uint32_t connectedAt = UINT32_MAX - 10000;
+    backoff.beginAttempt();
+    backoff.onConnected(connectedAt);
+
+    // 20 s later the millisecond tick has wrapped
+    const uint32_t later = connectedAt + 20000;
+    ASSERT_LT(later, connectedAt);
+    EXPECT_EQ(backoff.getStats(later).currentUptimeMs, 20000u);
+
+    const uint32_t droppedAt = connectedAt + STABLE_AFTER_MS;
+    EXPECT_EQ(backoff.onConnectionLost(droppedAt, 0), 0u);
+
+    ReconnectBackoff::Stats stats = backoff.getStats(droppedAt);
+    EXPECT_EQ(stats.longestUptimeMs, STABLE_AFTER_MS);
+    EXPECT_EQ(stats.totalUptimeMs, (uint64_t)STABLE_AFTER_MS);
+    EXPECT_EQ(stats.currentUptimeMs, 0u);
+    EXPECT_EQ(stats.consecutiveFailures, 1u);
+}
+
+TEST_F(ReconnectBackoffTest, FirstAttemptIsDueLateInTheTickRange)
+{
+    // After about 25 days of uptime the tick is in the upper half of its range
+    EXPECT_TRUE(backoff.isAttemptDue(0x80000001u));
+    EXPECT_EQ(backoff.msUntilNextAttempt(0x80000001u), 0u);
+
+    failAttempt(0x90000000u, 0);
+    failAttempt(0x90000000u, 0);
+    backoff.reset();
+    EXPECT_TRUE(backoff.isAttemptDue(0xF0000000u));
+}
+
+TEST_F(ReconnectBackoffTest, BackoffDeadlineSurvivesTickWraparound)
+{
+    uint32_t now = UINT32_MAX - 500;
+    failAttempt(now, 0);
+    uint32_t delay = failAttempt(now, 0);
+    ASSERT_EQ(delay, INITIAL_DELAY_MS / 2);
+
+    EXPECT_FALSE(backoff.isAttemptDue(now + delay - 1));
+    EXPECT_TRUE(backoff.isAttemptDue(now + delay));
+    EXPECT_EQ(backoff.msUntilNextAttempt(now + 100), delay - 100);
+}
+
+TEST_F(ReconnectBackoffTest, TotalUptimeDoesNotOverflowThirtyTwoBits)
+{
+    uint32_t now = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        // Three connections of about 24 days each
+        dropAfter(now, 0x7FFFFFFFu, 0);
+        now += 0x7FFFFFFFu;
+    }
+    EXPECT_EQ(backoff.getStats(now).totalUptimeMs, 3ull * 0x7FFFFFFFu);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <string.h>
+#include "nfc/Adafruit_PN532_SessionCrypto.h"
+#include "../benchmark.hpp"
+
+namespace
+{
+    // RFC 4493 section 4 (the AES-128 examples of NIST SP 800-38B D.1)
+    const uint8_t RFC_KEY[16] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                                 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+
+    const uint8_t RFC_MESSAGE[64] = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+        0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+        0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+        0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10};
+
+    struct RfcExample
+    {
+        uint8_t length;
+        uint8_t cmac[16];
+    };
+
+    const RfcExample RFC_EXAMPLES[] = {
+        {0, {0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46}},
+        {16, {0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c}},
+        {40, {0xdf, 0xa6, 0x67, 0x47, 0xde, 0x9a, 0xe6, 0x30, 0x30, 0xca, 0x32, 0x61, 0x14, 0x97, 0xc8, 0x27}},
+        {64, {0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92, 0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe}},
+    };
+
+    // NXP AN12196, AuthenticateEV2First with the all zero key 0: the session
+    // keys are the CMACs of SV1 and SV2 built from RndA and RndB
+    const uint8_t NXP_KEY[16] = {};
+    const uint8_t NXP_RND_A[16] = {0x13, 0xC5, 0xDB, 0x8A, 0x59, 0x30, 0x43, 0x9F,
+                                   0xC3, 0xDE, 0xF9, 0xA4, 0xC6, 0x75, 0x36, 0x0F};
+    const uint8_t NXP_RND_B[16] = {0xB9, 0xE2, 0xFC, 0x78, 0x9B, 0x64, 0xBF, 0x23,
+                                   0x7C, 0xCC, 0xAA, 0x20, 0xEC, 0x7E, 0x6E, 0x48};
+    const uint8_t NXP_SES_AUTH_ENC_KEY[16] = {0x13, 0x09, 0xC8, 0x77, 0x50, 0x9E, 0x5A, 0x21,
+                                              0x50, 0x07, 0xFF, 0x0E, 0xD1, 0x9C, 0xA5, 0x64};
+    const uint8_t NXP_SES_AUTH_MAC_KEY[16] = {0x4C, 0x66, 0x26, 0xF5, 0xE7, 0x2E, 0xA6, 0x94,
+                                              0x20, 0x21, 0x39, 0x29, 0x5C, 0x7A, 0x7F, 0xC7};
+
+    // Same layout as Adafruit_PN532::ntag424_derive_session_keys
+    void sessionVector(uint8_t label0, uint8_t label1, uint8_t sv[32])
+    {
+        const uint8_t header[6] = {label0, label1, 0x00, 0x01, 0x00, 0x80};
+        memcpy(sv, header, 6);
+        sv[6] = NXP_RND_A[0];
+        sv[7] = NXP_RND_A[1];
+        for (int i = 0; i < 6; i++)
+        {
+            sv[8 + i] = NXP_RND_A[2 + i] ^ NXP_RND_B[i];
+        }
+        memcpy(sv + 14, NXP_RND_B + 6, 10);
+        memcpy(sv + 24, NXP_RND_A + 8, 8);
+    }
+
+    // ntag424_cmac() with a key other than the session mac key
+    bool oneShotCmac(const uint8_t *key, const uint8_t *input, size_t length, uint8_t *cmac)
+    {
+        return mbedtls_cipher_cmac(mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB),
+                                   key, 128, input, length, cmac) == 0;
+    }
+}
+
+TEST(SessionCrypto, MatchesTheRfc4493Examples)
+{
+    Adafruit_PN532_SessionCrypto crypto;
+    ASSERT_TRUE(crypto.begin(RFC_KEY, RFC_KEY));
+
+    for (const RfcExample &example : RFC_EXAMPLES)
+    {
+        uint8_t cmac[16];
+        ASSERT_TRUE(crypto.cmac(RFC_MESSAGE, example.length, cmac));
+        EXPECT_EQ(memcmp(cmac, example.cmac, 16), 0) << "length " << (int)example.length;
+
+        ASSERT_TRUE(oneShotCmac(RFC_KEY, RFC_MESSAGE, example.length, cmac));
+        EXPECT_EQ(memcmp(cmac, example.cmac, 16), 0) << "one-shot length " << (int)example.length;
+    }
+}
+
+TEST(SessionCrypto, DerivesTheNxpSessionKeys)
+{
+    uint8_t sv1[32];
+    uint8_t sv2[32];
+    sessionVector(0xA5, 0x5A, sv1);
+    sessionVector(0x5A, 0xA5, sv2);
+
+    uint8_t keyEnc[16];
+    uint8_t keyMac[16];
+    ASSERT_TRUE(oneShotCmac(NXP_KEY, sv1, sizeof(sv1), keyEnc));
+    ASSERT_TRUE(oneShotCmac(NXP_KEY, sv2, sizeof(sv2), keyMac));
+    EXPECT_EQ(memcmp(keyEnc, NXP_SES_AUTH_ENC_KEY, 16), 0);
+    EXPECT_EQ(memcmp(keyMac, NXP_SES_AUTH_MAC_KEY, 16), 0);
+
+    // The derived keys set up a session that MACs like a one-shot context
+    Adafruit_PN532_SessionCrypto crypto;
+    ASSERT_TRUE(crypto.begin(keyEnc, keyMac));
+    uint8_t session[16];
+    uint8_t reference[16];
+    ASSERT_TRUE(crypto.cmac(sv2, sizeof(sv2), session));
+    ASSERT_TRUE(oneShotCmac(keyMac, sv2, sizeof(sv2), reference));
+    EXPECT_EQ(memcmp(session, reference, 16), 0);
+}
+
+TEST(SessionCrypto, SessionCmacDoesNotShareStateWithOneShotCmac)
+{
+    Adafruit_PN532_SessionCrypto crypto;
+    ASSERT_TRUE(crypto.begin(RFC_KEY, RFC_KEY));
+
+    // A one-shot CMAC in progress on the shared state, e.g. key derivation
+    // while the session of another task is MACing an APDU
+    mbedtls_cipher_context_t ctx;
+    mbedtls_cipher_init(&ctx);
+    ASSERT_EQ(mbedtls_cipher_setup(&ctx, mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB)), 0);
+    ASSERT_EQ(mbedtls_cipher_cmac_starts(&ctx, NXP_KEY, 128), 0);
+
+    uint8_t sv2[32];
+    sessionVector(0x5A, 0xA5, sv2);
+    ASSERT_EQ(mbedtls_cipher_cmac_update(&ctx, sv2, 20), 0);
+
+    uint8_t cmac[16];
+    ASSERT_TRUE(crypto.cmac(RFC_MESSAGE, 40, cmac));
+    EXPECT_EQ(memcmp(cmac, RFC_EXAMPLES[2].cmac, 16), 0);
+
+    ASSERT_EQ(mbedtls_cipher_cmac_update(&ctx, sv2 + 20, 12), 0);
+    ASSERT_TRUE(crypto.cmac(RFC_MESSAGE, 64, cmac));
+    EXPECT_EQ(memcmp(cmac, RFC_EXAMPLES[3].cmac, 16), 0);
+
+    ASSERT_EQ(mbedtls_cipher_cmac_finish(&ctx, cmac), 0);
+    EXPECT_EQ(memcmp(cmac, NXP_SES_AUTH_MAC_KEY, 16), 0);
+    mbedtls_cipher_free(&ctx);
+
+    // And the other way round, one-shot CMACs between session CMACs
+    ASSERT_TRUE(oneShotCmac(NXP_KEY, sv2, sizeof(sv2), cmac));
+    EXPECT_EQ(memcmp(cmac, NXP_SES_AUTH_MAC_KEY, 16), 0);
+    ASSERT_TRUE(crypto.cmac(RFC_MESSAGE, 16, cmac));
+    EXPECT_EQ(memcmp(cmac, RFC_EXAMPLES[1].cmac, 16), 0);
+}
+
+TEST(SessionCrypto, RestartsWithNewKeys)
+{
+    Adafruit_PN532_SessionCrypto crypto;
+    EXPECT_FALSE(crypto.isReady());
+    uint8_t cmac[16];
+    EXPECT_FALSE(crypto.cmac(RFC_MESSAGE, 16, cmac));
+
+    ASSERT_TRUE(crypto.begin(NXP_SES_AUTH_ENC_KEY, NXP_SES_AUTH_MAC_KEY));
+    ASSERT_TRUE(crypto.begin(RFC_KEY, RFC_KEY));
+    ASSERT_TRUE(crypto.cmac(RFC_MESSAGE, 64, cmac));
+    EXPECT_EQ(memcmp(cmac, RFC_EXAMPLES[3].cmac, 16), 0);
+
+    crypto.end();
+    EXPECT_FALSE(crypto.isReady());
+    EXPECT_FALSE(crypto.cmac(RFC_MESSAGE, 16, cmac));
+}
+
+TEST(SessionCrypto, CbcRoundTrip)
+{
+    Adafruit_PN532_SessionCrypto crypto;
+    ASSERT_TRUE(crypto.begin(NXP_SES_AUTH_ENC_KEY, NXP_SES_AUTH_MAC_KEY));
+
+    uint8_t iv[16] = {};
+    uint8_t encrypted[64];
+    ASSERT_TRUE(crypto.encrypt(iv, sizeof(encrypted), RFC_MESSAGE, encrypted));
+    EXPECT_NE(memcmp(encrypted, RFC_MESSAGE, sizeof(encrypted)), 0);
+
+    uint8_t decrypted[64];
+    memset(iv, 0, sizeof(iv));
+    ASSERT_TRUE(crypto.decrypt(iv, sizeof(decrypted), encrypted, decrypted));
+    EXPECT_EQ(memcmp(decrypted, RFC_MESSAGE, sizeof(decrypted)), 0);
+}
+
+// An APDU MAC (command, counter, transaction id and data) per call
+TEST(SessionCrypto, BenchmarkSessionAgainstOneShotCmac)
+{
+    Adafruit_PN532_SessionCrypto crypto;
+    ASSERT_TRUE(crypto.begin(NXP_SES_AUTH_ENC_KEY, NXP_SES_AUTH_MAC_KEY));
+
+    uint8_t cmac[16];
+    BenchmarkResult session = runBenchmark("session cmac (40 bytes)", 20000, [&]()
+                                           { crypto.cmac(RFC_MESSAGE, 40, cmac); });
+    BenchmarkResult oneShot = runBenchmark("one-shot cmac (40 bytes)", 20000, [&]()
+                                           { oneShotCmac(NXP_SES_AUTH_MAC_KEY, RFC_MESSAGE, 40, cmac); });
+
+    // The session skips the key expansion and the context setup
+    EXPECT_LT(session.nsPerOp, oneShot.nsPerOp);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
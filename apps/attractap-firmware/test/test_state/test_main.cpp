@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <atomic>
+#include "state/state.hpp"
+
+// State keeps its subscriptions for the lifetime of the program (at most 8),
+// so the suite shares a few of them and drains them before each test.
+class StateNotificationTest : public ::testing::Test
+{
+protected:
+    static EventGroupHandle_t networkAndKeypad;
+    static EventGroupHandle_t keypadOnly;
+
+    static void SetUpTestSuite()
+    {
+        networkAndKeypad = State::subscribe(State::STATE_CHANGE_NETWORK | State::STATE_CHANGE_KEYPAD);
+        keypadOnly = State::subscribe(State::STATE_CHANGE_KEYPAD);
+    }
+
+    void SetUp() override
+    {
+        ASSERT_NE(networkAndKeypad, nullptr);
+        ASSERT_NE(keypadOnly, nullptr);
+        State::waitForChanges(networkAndKeypad, 0);
+        State::waitForChanges(keypadOnly, 0);
+    }
+};
+
+EventGroupHandle_t StateNotificationTest::networkAndKeypad = nullptr;
+EventGroupHandle_t StateNotificationTest::keypadOnly = nullptr;
+
+TEST(StateSubscriptionTest, FirstWaitReturnsSubscribedDomains)
+{
+    EventGroupHandle_t subscription = State::subscribe(State::STATE_CHANGE_API | State::STATE_CHANGE_API_EVENT);
+    ASSERT_NE(subscription, nullptr);
+
+    EXPECT_EQ(State::waitForChanges(subscription, 0), (uint32_t)(State::STATE_CHANGE_API | State::STATE_CHANGE_API_EVENT));
+    EXPECT_EQ(State::waitForChanges(subscription, 0), 0u);
+}
+
+TEST_F(StateNotificationTest, NothingPendingAfterDrain)
+{
+    EXPECT_EQ(State::waitForChanges(networkAndKeypad, 10), 0u);
+}
+
+TEST_F(StateNotificationTest, SettersInTheSameTickAreBothDelivered)
+{
+    esp_ip4_addr_t ip = {0x0100a8c0};
+
+    // Back to back, well within one tick; millis() based polling saw one change at most
+    TickType_t before = xTaskGetTickCount();
+    State::setEthernetState(true, ip);
+    State::setKeypadValue("1234");
+    TickType_t after = xTaskGetTickCount();
+
+    uint32_t changes = State::waitForChanges(networkAndKeypad, 0);
+    EXPECT_EQ(changes, (uint32_t)(State::STATE_CHANGE_NETWORK | State::STATE_CHANGE_KEYPAD)) << "ticks " << before << ".." << after;
+    EXPECT_TRUE(State::getNetworkState().ethernet_connected);
+    EXPECT_EQ(State::getKeypadValue(), "1234");
+}
+
+TEST_F(StateNotificationTest, OnlySubscribedDomainsAreRaised)
+{
+    esp_ip4_addr_t ip = {};
+    State::setEthernetState(false, ip);
+
+    EXPECT_EQ(State::waitForChanges(keypadOnly, 0), 0u);
+    EXPECT_EQ(State::waitForChanges(networkAndKeypad, 0), (uint32_t)State::STATE_CHANGE_NETWORK);
+}
+
+TEST_F(StateNotificationTest, UnchangedKeypadValueDoesNotNotify)
+{
+    State::setKeypadValue("42");
+    EXPECT_EQ(State::waitForChanges(keypadOnly, 0), (uint32_t)State::STATE_CHANGE_KEYPAD);
+
+    State::setKeypadValue("42");
+    EXPECT_EQ(State::waitForChanges(keypadOnly, 0), 0u);
+}
+
+TEST_F(StateNotificationTest, WaiterWakesUpForChangeFromAnotherTask)
+{
+    xTaskCreate([](void *)
+                {
+        vTaskDelay(pdMS_TO_TICKS(20));
+        State::setKeypadValue("from task");
+        vTaskDelete(NULL); },
+                "setter", 2048, nullptr, 1, nullptr);
+
+    EXPECT_EQ(State::waitForChanges(keypadOnly, 1000), (uint32_t)State::STATE_CHANGE_KEYPAD);
+    EXPECT_EQ(State::getKeypadValue(), "from task");
+}
+
+namespace
+{
+    const int SETTER_TASKS = 4;
+    const int CHANGES_PER_TASK = 500;
+
+    std::atomic<int> settersDone(0);
+
+    void keypadSetterTask(void *parameter)
+    {
+        int task = (int)(intptr_t)parameter;
+        for (int i = 1; i <= CHANGES_PER_TASK; i++)
+        {
+            State::setKeypadValue(String(task) + ":" + String(i));
+        }
+        settersDone++;
+        vTaskDelete(NULL);
+    }
+
+    void networkSetterTask(void *parameter)
+    {
+        (void)parameter;
+        for (int i = 1; i <= CHANGES_PER_TASK; i++)
+        {
+            esp_ip4_addr_t ip = {(uint32_t)i};
+            State::setEthernetState(true, ip);
+        }
+        settersDone++;
+        vTaskDelete(NULL);
+    }
+}
+
+TEST_F(StateNotificationTest, NoUpdateIsLostUnderConcurrentSetters)
+{
+    // Many changes per tick from several tasks. A subscriber may see them
+    // coalesced, but after the last change it must always wake up once more
+    // and then read the final values.
+    settersDone = 0;
+    for (int task = 0; task < SETTER_TASKS; task++)
+    {
+        xTaskCreate(keypadSetterTask, "keypad", 2048, (void *)(intptr_t)task, 1, nullptr);
+    }
+    xTaskCreate(networkSetterTask, "network", 2048, nullptr, 1, nullptr);
+
+    uint32_t seen = 0;
+    int wakeups = 0;
+    while (settersDone.load() < SETTER_TASKS + 1)
+    {
+        uint32_t changes = State::waitForChanges(networkAndKeypad, 5);
+        seen |= changes;
+        wakeups += changes != 0;
+    }
+
+    // Everything set before settersDone was raised is pending or was consumed above
+    seen |= State::waitForChanges(networkAndKeypad, 0);
+    EXPECT_EQ(seen, (uint32_t)(State::STATE_CHANGE_NETWORK | State::STATE_CHANGE_KEYPAD));
+    EXPECT_GT(wakeups, 0);
+    EXPECT_EQ(State::getNetworkState().ethernet_ip.addr, (uint32_t)CHANGES_PER_TASK);
+    EXPECT_TRUE(State::getKeypadValue().endsWith(":" + String(CHANGES_PER_TASK)));
+
+    // The last change is reported exactly once, then the subscription is quiet
+    State::setKeypadValue("final");
+    EXPECT_EQ(State::waitForChanges(keypadOnly, 100) & State::STATE_CHANGE_KEYPAD, (uint32_t)State::STATE_CHANGE_KEYPAD);
+    EXPECT_EQ(State::waitForChanges(keypadOnly, 0), 0u);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
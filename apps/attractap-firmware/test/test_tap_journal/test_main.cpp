@@ -0,0 +1,382 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "journal/tapJournal.hpp"
+
+namespace
+{
+    const size_t SECTOR_SIZE = 4096;
+    const size_t SECTORS = 4;
+    // Header slot and 127 record slots per sector
+    const uint32_t SLOTS_PER_SECTOR = SECTOR_SIZE / 32 - 1;
+    const size_t RECORD_SIZE = 32;
+
+    const uint32_t BOOT_A = 0x1a2b3c4d;
+    const uint32_t BOOT_B = 0x5e6f7081;
+    // No 0xFF byte in the ids, so a record torn after its first bytes never reads as erased
+    const uint32_t SEED_ID = 0x10203040;
+
+    const uint8_t CARD[7] = {0x04, 0x51, 0x2a, 0x6a, 0x9c, 0x11, 0x90};
+
+    // Kept across reboots, unlike the FileFlash instances
+    struct FlashWear
+    {
+        // Writes that tried to set a bit NOR flash cannot set without an erase
+        uint32_t bitsRaised;
+        uint32_t erases[SECTORS];
+    };
+
+    // Journal partition in a file with NOR flash semantics: writes can only
+    // clear bits, erasing a sector sets it to 0xFF. A power loss can be
+    // scheduled after a number of written bytes; the write in progress is
+    // torn there and every access fails until the flash is opened again,
+    // which is what a reboot looks like to the journal.
+    class FileFlash : public JournalStorage
+    {
+    public:
+        FileFlash(const std::string &path, FlashWear &wear) : wear(wear)
+        {
+            this->file = fopen(path.c_str(), "r+b");
+            if (this->file == nullptr)
+            {
+                this->file = fopen(path.c_str(), "w+b");
+                std::vector<uint8_t> erased(SECTOR_SIZE * SECTORS, 0xFF);
+                fwrite(erased.data(), 1, erased.size(), this->file);
+            }
+        }
+
+        ~FileFlash() override
+        {
+            fclose(this->file);
+        }
+
+        size_t sectorSize() const override { return SECTOR_SIZE; }
+        size_t sectorCount() const override { return SECTORS; }
+
+        bool read(size_t offset, void *data, size_t length) override
+        {
+            if (this->powerLost || offset + length > SECTOR_SIZE * SECTORS)
+            {
+                return false;
+            }
+            fseek(this->file, (long)offset, SEEK_SET);
+            return fread(data, 1, length, this->file) == length;
+        }
+
+        bool write(size_t offset, const void *data, size_t length) override
+        {
+            if (this->powerLost || offset + length > SECTOR_SIZE * SECTORS)
+            {
+                return false;
+            }
+
+            size_t allowed = length;
+            if (this->bytesUntilPowerLoss >= 0 && (size_t)this->bytesUntilPowerLoss < length)
+            {
+                allowed = (size_t)this->bytesUntilPowerLoss;
+                this->powerLost = true;
+            }
+            if (this->bytesUntilPowerLoss >= 0)
+            {
+                this->bytesUntilPowerLoss -= (long)allowed;
+            }
+
+            std::vector<uint8_t> flash(allowed);
+            fseek(this->file, (long)offset, SEEK_SET);
+            if (fread(flash.data(), 1, allowed, this->file) != allowed)
+            {
+                return false;
+            }
+            const uint8_t *bytes = (const uint8_t *)data;
+            for (size_t i = 0; i < allowed; i++)
+            {
+                if ((bytes[i] & ~flash[i]) != 0)
+                {
+                    this->wear.bitsRaised++;
+                }
+                flash[i] &= bytes[i];
+            }
+            fseek(this->file, (long)offset, SEEK_SET);
+            fwrite(flash.data(), 1, allowed, this->file);
+            fflush(this->file);
+            return !this->powerLost;
+        }
+
+        bool eraseSector(size_t sector) override
+        {
+            if (this->powerLost || sector >= SECTORS)
+            {
+                return false;
+            }
+            std::vector<uint8_t> erased(SECTOR_SIZE, 0xFF);
+            fseek(this->file, (long)(sector * SECTOR_SIZE), SEEK_SET);
+            fwrite(erased.data(), 1, erased.size(), this->file);
+            fflush(this->file);
+            this->wear.erases[sector]++;
+            return true;
+        }
+
+        void losePowerAfter(long bytes) { this->bytesUntilPowerLoss = bytes; }
+
+    private:
+        FlashWear &wear;
+        FILE *file = nullptr;
+        long bytesUntilPowerLoss = -1;
+        bool powerLost = false;
+    };
+}
+
+class TapJournalTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        this->path = ::testing::TempDir() + "tap_journal_" +
+                     ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".bin";
+        remove(this->path.c_str());
+        this->wear = {};
+        this->reboot(BOOT_A);
+    }
+
+    void TearDown() override
+    {
+        this->journal.reset();
+        this->flash.reset();
+        remove(this->path.c_str());
+    }
+
+    // Drops all RAM state and scans the file again
+    void reboot(uint32_t bootId)
+    {
+        this->journal.reset();
+        this->flash.reset();
+        this->flash.reset(new FileFlash(this->path, this->wear));
+        this->journal.reset(new TapJournal(*this->flash));
+        ASSERT_TRUE(this->journal->begin(bootId, SEED_ID));
+    }
+
+    bool appendTap(uint8_t marker, uint32_t uptimeMs = 1000)
+    {
+        uint8_t uid[7];
+        memcpy(uid, CARD, sizeof(uid));
+        uid[6] = marker;
+        return this->journal->append(TapJournal::ENTRY_NFC_TAP, uid, sizeof(uid), uptimeMs);
+    }
+
+    // Acknowledges everything pending and returns the markers in replay order
+    std::vector<uint8_t> drain()
+    {
+        std::vector<uint8_t> markers;
+        TapJournal::Entry entry;
+        while (this->journal->peek(entry))
+        {
+            markers.push_back(entry.data[6]);
+            if (!this->journal->acknowledge(entry.id))
+            {
+                break;
+            }
+        }
+        return markers;
+    }
+
+    std::string path;
+    FlashWear wear;
+    std::unique_ptr<FileFlash> flash;
+    std::unique_ptr<TapJournal> journal;
+};
+
+TEST_F(TapJournalTest, ReplaysInOrderAcrossReboots)
+{
+    for (uint8_t i = 1; i <= 5; i++)
+    {
+        ASSERT_TRUE(this->appendTap(i, 1000 * i));
+    }
+
+    TapJournal::Entry entry;
+    ASSERT_TRUE(this->journal->peek(entry));
+    EXPECT_EQ(entry.id, SEED_ID);
+    EXPECT_TRUE(this->journal->acknowledge(entry.id));
+
+    this->reboot(BOOT_B);
+    EXPECT_EQ(this->journal->getStats().pending, 4u);
+
+    ASSERT_TRUE(this->journal->peek(entry));
+    EXPECT_EQ(entry.id, SEED_ID + 1);
+    EXPECT_EQ(entry.bootId, BOOT_A);
+    EXPECT_EQ(entry.uptimeMs, 2000u);
+    EXPECT_EQ(entry.kind, TapJournal::ENTRY_NFC_TAP);
+    ASSERT_EQ(entry.length, 7);
+    EXPECT_EQ(memcmp(entry.data, CARD, 6), 0);
+
+    // Only the head entry can be acknowledged, a late confirmation is ignored
+    EXPECT_FALSE(this->journal->acknowledge(SEED_ID));
+    EXPECT_FALSE(this->journal->acknowledge(SEED_ID + 2));
+
+    // Ids continue after a reboot, the server drops duplicates by id
+    ASSERT_TRUE(this->appendTap(6));
+    EXPECT_EQ(this->drain(), (std::vector<uint8_t>{2, 3, 4, 5, 6}));
+
+    this->reboot(BOOT_A);
+    ASSERT_TRUE(this->appendTap(7));
+    ASSERT_TRUE(this->journal->peek(entry));
+    EXPECT_EQ(entry.id, SEED_ID + 6);
+    EXPECT_EQ(this->wear.bitsRaised, 0u);
+}
+
+TEST_F(TapJournalTest, KeypadEntries)
+{
+    const char *value = "0042";
+    ASSERT_TRUE(this->journal->append(TapJournal::ENTRY_KEYPAD_CONFIRM, (const uint8_t *)value, strlen(value), 500));
+    ASSERT_TRUE(this->journal->append(TapJournal::ENTRY_KEYPAD_CANCEL, nullptr, 0, 600));
+
+    this->reboot(BOOT_B);
+
+    TapJournal::Entry entry;
+    ASSERT_TRUE(this->journal->peek(entry));
+    EXPECT_EQ(entry.kind, TapJournal::ENTRY_KEYPAD_CONFIRM);
+    ASSERT_EQ(entry.length, 4);
+    EXPECT_EQ(memcmp(entry.data, value, 4), 0);
+    ASSERT_TRUE(this->journal->acknowledge(entry.id));
+
+    ASSERT_TRUE(this->journal->peek(entry));
+    EXPECT_EQ(entry.kind, TapJournal::ENTRY_KEYPAD_CANCEL);
+    EXPECT_EQ(entry.length, 0);
+}
+
+// Power lost at every byte of a record write: the entries before it survive,
+// the torn one is either gone or complete, and the journal keeps working
+TEST_F(TapJournalTest, RecordWriteTornAtEveryByte)
+{
+    for (long tornAt = 0; tornAt <= (long)RECORD_SIZE; tornAt++)
+    {
+        SCOPED_TRACE("torn after " + std::to_string(tornAt) + " bytes");
+        this->TearDown();
+        this->SetUp();
+
+        ASSERT_TRUE(this->appendTap(1));
+        ASSERT_TRUE(this->appendTap(2));
+        this->flash->losePowerAfter(tornAt);
+        this->appendTap(3);
+
+        this->reboot(BOOT_B);
+        TapJournal::Stats stats = this->journal->getStats();
+        // The ack word is written as 0xFF, so the record is complete before it
+        bool complete = tornAt >= (long)(RECORD_SIZE - sizeof(uint32_t));
+        EXPECT_EQ(stats.corrupt, complete || tornAt == 0 ? 0u : 1u);
+        EXPECT_EQ(stats.pending, complete ? 3u : 2u);
+
+        ASSERT_TRUE(this->appendTap(4));
+        std::vector<uint8_t> expected = complete ? std::vector<uint8_t>{1, 2, 3, 4} : std::vector<uint8_t>{1, 2, 4};
+        EXPECT_EQ(this->drain(), expected);
+        EXPECT_EQ(this->wear.bitsRaised, 0u);
+
+        // Ids stay consecutive; a torn entry was never sent, so its id is free again
+        this->reboot(BOOT_A);
+        ASSERT_TRUE(this->appendTap(5));
+        TapJournal::Entry entry;
+        ASSERT_TRUE(this->journal->peek(entry));
+        EXPECT_EQ(entry.id, complete ? SEED_ID + 4 : SEED_ID + 3);
+    }
+}
+
+TEST_F(TapJournalTest, AcknowledgeTornAtEveryByte)
+{
+    for (long tornAt = 0; tornAt <= (long)sizeof(uint32_t); tornAt++)
+    {
+        SCOPED_TRACE("torn after " + std::to_string(tornAt) + " bytes");
+        this->TearDown();
+        this->SetUp();
+
+        ASSERT_TRUE(this->appendTap(1));
+        ASSERT_TRUE(this->appendTap(2));
+        this->flash->losePowerAfter(tornAt);
+        this->journal->acknowledge(SEED_ID);
+
+        // Any cleared byte counts, otherwise the server gets the entry again
+        // and filters it by id
+        this->reboot(BOOT_B);
+        EXPECT_EQ(this->drain(), tornAt == 0 ? (std::vector<uint8_t>{1, 2}) : (std::vector<uint8_t>{2}));
+    }
+}
+
+TEST_F(TapJournalTest, SectorHeaderTornWhileOpeningTheNextSector)
+{
+    for (uint32_t i = 0; i < SLOTS_PER_SECTOR; i++)
+    {
+        ASSERT_TRUE(this->appendTap((uint8_t)(i + 1)));
+    }
+
+    // The next append erases sector 1 and writes its header first
+    this->flash->losePowerAfter(6);
+    EXPECT_FALSE(this->appendTap(200));
+
+    this->reboot(BOOT_B);
+    TapJournal::Stats stats = this->journal->getStats();
+    EXPECT_EQ(stats.pending, SLOTS_PER_SECTOR);
+    EXPECT_EQ(stats.corrupt, 0u);
+
+    ASSERT_TRUE(this->appendTap(201));
+    std::vector<uint8_t> markers = this->drain();
+    ASSERT_EQ(markers.size(), SLOTS_PER_SECTOR + 1);
+    EXPECT_EQ(markers.front(), 1);
+    EXPECT_EQ(markers[SLOTS_PER_SECTOR - 1], SLOTS_PER_SECTOR);
+    EXPECT_EQ(markers.back(), 201);
+}
+
+TEST_F(TapJournalTest, FullRingDropsTheOldestSector)
+{
+    const uint32_t capacity = SLOTS_PER_SECTOR * SECTORS;
+    EXPECT_EQ(this->journal->getStats().capacity, capacity);
+
+    for (uint32_t i = 0; i < capacity + 1; i++)
+    {
+        ASSERT_TRUE(this->appendTap((uint8_t)i));
+    }
+    TapJournal::Stats stats = this->journal->getStats();
+    EXPECT_EQ(stats.dropped, SLOTS_PER_SECTOR);
+    EXPECT_EQ(stats.pending, capacity - SLOTS_PER_SECTOR + 1);
+
+    this->reboot(BOOT_B);
+    EXPECT_EQ(this->journal->getStats().pending, capacity - SLOTS_PER_SECTOR + 1);
+
+    TapJournal::Entry entry;
+    ASSERT_TRUE(this->journal->peek(entry));
+    EXPECT_EQ(entry.id, SEED_ID + SLOTS_PER_SECTOR);
+}
+
+// The ring erases each sector once per lap, and only right before reuse
+TEST_F(TapJournalTest, ErasesAreSpreadOverAllSectors)
+{
+    const uint32_t laps = 5;
+    for (uint32_t i = 0; i < laps * SLOTS_PER_SECTOR * SECTORS; i++)
+    {
+        ASSERT_TRUE(this->appendTap((uint8_t)i));
+        if (i % 3 == 0)
+        {
+            this->drain();
+        }
+        if (i % 200 == 0)
+        {
+            this->reboot(i % 400 == 0 ? BOOT_A : BOOT_B);
+        }
+    }
+
+    for (size_t sector = 0; sector < SECTORS; sector++)
+    {
+        EXPECT_EQ(this->wear.erases[sector], laps) << "sector " << sector;
+    }
+    EXPECT_EQ(this->wear.bitsRaised, 0u);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
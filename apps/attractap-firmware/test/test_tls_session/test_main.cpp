@@ -0,0 +1,351 @@
+#include <gtest/gtest.h>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <atomic>
+#include <thread>
+#include "mbedtls/ssl_cache.h"
+#include "mbedtls/ssl_ticket.h"
+#include "websocket/tlsSessionCache.hpp"
+#include "websocket/tlsConnection.hpp"
+#include "../benchmark.hpp"
+#include "testCertificate.hpp"
+
+namespace
+{
+    const uint32_t TIMEOUT_MS = 5000;
+
+    // TLS server on 127.0.0.1 that echoes what it receives, one connection
+    // at a time, with the given way of resuming sessions
+    class LoopbackTlsServer
+    {
+    public:
+        enum Resumption
+        {
+            NONE,
+            SESSION_ID,
+            TICKETS,
+        };
+
+        explicit LoopbackTlsServer(Resumption resumption)
+        {
+            mbedtls_net_init(&this->listener);
+            mbedtls_ssl_config_init(&this->config);
+            mbedtls_x509_crt_init(&this->cert);
+            mbedtls_pk_init(&this->key);
+            mbedtls_entropy_init(&this->entropy);
+            mbedtls_ctr_drbg_init(&this->ctrDrbg);
+            mbedtls_ssl_cache_init(&this->cache);
+            mbedtls_ssl_ticket_init(&this->tickets);
+
+            EXPECT_EQ(mbedtls_ctr_drbg_seed(&this->ctrDrbg, mbedtls_entropy_func, &this->entropy, nullptr, 0), 0);
+            EXPECT_EQ(mbedtls_x509_crt_parse_der(&this->cert, TEST_SERVER_CERT_DER, sizeof(TEST_SERVER_CERT_DER)), 0);
+            EXPECT_EQ(mbedtls_pk_parse_key(&this->key, (const unsigned char *)TEST_SERVER_KEY_PEM, sizeof(TEST_SERVER_KEY_PEM), nullptr, 0), 0);
+
+            EXPECT_EQ(mbedtls_ssl_config_defaults(&this->config, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT), 0);
+            mbedtls_ssl_conf_rng(&this->config, mbedtls_ctr_drbg_random, &this->ctrDrbg);
+            mbedtls_ssl_conf_read_timeout(&this->config, TIMEOUT_MS);
+            EXPECT_EQ(mbedtls_ssl_conf_own_cert(&this->config, &this->cert, &this->key), 0);
+
+            if (resumption == SESSION_ID)
+            {
+                mbedtls_ssl_conf_session_cache(&this->config, &this->cache, mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
+            }
+            else if (resumption == TICKETS)
+            {
+                EXPECT_EQ(mbedtls_ssl_ticket_setup(&this->tickets, mbedtls_ctr_drbg_random, &this->ctrDrbg, MBEDTLS_CIPHER_AES_256_GCM, 86400), 0);
+                mbedtls_ssl_conf_session_tickets_cb(&this->config, mbedtls_ssl_ticket_write, mbedtls_ssl_ticket_parse, &this->tickets);
+            }
+
+            // Port 0: the system picks a free one
+            EXPECT_EQ(mbedtls_net_bind(&this->listener, "127.0.0.1", "0", MBEDTLS_NET_PROTO_TCP), 0);
+            struct sockaddr_in address;
+            socklen_t addressLength = sizeof(address);
+            getsockname(this->listener.fd, (struct sockaddr *)&address, &addressLength);
+            this->port = ntohs(address.sin_port);
+
+            this->thread = std::thread([this]()
+                                       { this->serve(); });
+        }
+
+        ~LoopbackTlsServer()
+        {
+            this->stopping = true;
+            this->thread.join();
+
+            mbedtls_net_free(&this->listener);
+            mbedtls_ssl_ticket_free(&this->tickets);
+            mbedtls_ssl_cache_free(&this->cache);
+            mbedtls_ssl_config_free(&this->config);
+            mbedtls_x509_crt_free(&this->cert);
+            mbedtls_pk_free(&this->key);
+            mbedtls_ctr_drbg_free(&this->ctrDrbg);
+            mbedtls_entropy_free(&this->entropy);
+        }
+
+        uint16_t getPort() const { return this->port; }
+        uint32_t getHandshakes() const { return this->handshakes; }
+
+    private:
+        mbedtls_net_context listener;
+        mbedtls_ssl_config config;
+        mbedtls_x509_crt cert;
+        mbedtls_pk_context key;
+        mbedtls_entropy_context entropy;
+        mbedtls_ctr_drbg_context ctrDrbg;
+        mbedtls_ssl_cache_context cache;
+        mbedtls_ssl_ticket_context tickets;
+
+        uint16_t port = 0;
+        std::thread thread;
+        std::atomic<bool> stopping{false};
+        std::atomic<uint32_t> handshakes{0};
+
+        void serve()
+        {
+            while (!this->stopping)
+            {
+                // Accept only once a client is waiting, so the destructor gets
+                // the thread back
+                if (mbedtls_net_poll(&this->listener, MBEDTLS_NET_POLL_READ, 20) <= 0)
+                {
+                    continue;
+                }
+
+                mbedtls_net_context client;
+                mbedtls_net_init(&client);
+                if (mbedtls_net_accept(&this->listener, &client, nullptr, 0, nullptr) == 0)
+                {
+                    this->echo(&client);
+                }
+                mbedtls_net_free(&client);
+            }
+        }
+
+        void echo(mbedtls_net_context *client)
+        {
+            mbedtls_ssl_context ssl;
+            mbedtls_ssl_init(&ssl);
+            mbedtls_ssl_setup(&ssl, &this->config);
+            mbedtls_ssl_set_bio(&ssl, client, mbedtls_net_send, nullptr, mbedtls_net_recv_timeout);
+
+            if (mbedtls_ssl_handshake(&ssl) == 0)
+            {
+                this->handshakes++;
+
+                // Until the client sends close_notify or goes away
+                uint8_t buffer[256];
+                int received;
+                while ((received = mbedtls_ssl_read(&ssl, buffer, sizeof(buffer))) > 0)
+                {
+                    mbedtls_ssl_write(&ssl, buffer, received);
+                }
+                mbedtls_ssl_close_notify(&ssl);
+            }
+
+            mbedtls_ssl_free(&ssl);
+        }
+    };
+
+    bool connectTo(TlsConnection &connection, const LoopbackTlsServer &server)
+    {
+        return connection.connect("localhost", server.getPort(), TEST_SERVER_CERT_DER, sizeof(TEST_SERVER_CERT_DER), TIMEOUT_MS);
+    }
+}
+
+class TlsSessionTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        Preferences::eraseAll();
+    }
+};
+
+TEST_F(TlsSessionTest, ResumesWithSessionId)
+{
+    LoopbackTlsServer server(LoopbackTlsServer::SESSION_ID);
+    TlsSessionCache cache(false);
+    TlsConnection connection(cache);
+
+    ASSERT_TRUE(connectTo(connection, server));
+    EXPECT_FALSE(connection.wasResumed());
+    connection.close();
+
+    ASSERT_TRUE(connectTo(connection, server));
+    EXPECT_TRUE(connection.wasResumed());
+    connection.close();
+
+    TlsSessionCache::Stats stats = cache.getStats();
+    EXPECT_EQ(stats.offered, 1u);
+    EXPECT_EQ(stats.resumed, 1u);
+    EXPECT_EQ(stats.full, 1u);
+    EXPECT_EQ(stats.stored, 1u);
+    EXPECT_EQ(stats.persisted, 0u);
+    EXPECT_FLOAT_EQ(TlsSessionCache::hitRate(stats), 0.5f);
+}
+
+TEST_F(TlsSessionTest, ResumesWithTicket)
+{
+    LoopbackTlsServer server(LoopbackTlsServer::TICKETS);
+    TlsSessionCache cache(false);
+    TlsConnection connection(cache);
+
+    ASSERT_TRUE(connectTo(connection, server));
+    connection.close();
+
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE(connectTo(connection, server));
+        EXPECT_TRUE(connection.wasResumed());
+        connection.close();
+    }
+
+    TlsSessionCache::Stats stats = cache.getStats();
+    EXPECT_EQ(stats.offered, 3u);
+    EXPECT_EQ(stats.resumed, 3u);
+    EXPECT_EQ(stats.full, 1u);
+}
+
+TEST_F(TlsSessionTest, ServerWithoutResumptionFallsBackToFullHandshake)
+{
+    LoopbackTlsServer server(LoopbackTlsServer::NONE);
+    TlsSessionCache cache(false);
+    TlsConnection connection(cache);
+
+    ASSERT_TRUE(connectTo(connection, server));
+    connection.close();
+
+    // The server hands out session IDs but forgets them: offered, not resumed
+    ASSERT_TRUE(connectTo(connection, server));
+    EXPECT_FALSE(connection.wasResumed());
+    connection.close();
+
+    TlsSessionCache::Stats stats = cache.getStats();
+    EXPECT_EQ(stats.offered, 1u);
+    EXPECT_EQ(stats.resumed, 0u);
+    EXPECT_EQ(stats.full, 2u);
+    EXPECT_EQ(server.getHandshakes(), 2u);
+}
+
+TEST_F(TlsSessionTest, SessionIsOnlyOfferedToItsServer)
+{
+    LoopbackTlsServer first(LoopbackTlsServer::SESSION_ID);
+    LoopbackTlsServer second(LoopbackTlsServer::SESSION_ID);
+    TlsSessionCache cache(false);
+    TlsConnection connection(cache);
+
+    ASSERT_TRUE(connectTo(connection, first));
+    connection.close();
+
+    ASSERT_TRUE(connectTo(connection, second));
+    EXPECT_FALSE(connection.wasResumed());
+    connection.close();
+
+    EXPECT_EQ(cache.getStats().offered, 0u);
+}
+
+TEST_F(TlsSessionTest, PersistedSessionResumesAfterRestart)
+{
+    LoopbackTlsServer server(LoopbackTlsServer::SESSION_ID);
+    {
+        TlsSessionCache cache(true);
+        cache.begin();
+        TlsConnection connection(cache);
+
+        ASSERT_TRUE(connectTo(connection, server));
+        connection.close();
+        EXPECT_EQ(cache.getStats().persisted, 1u);
+    }
+
+    // A new cache stands in for the reader after a reboot
+    TlsSessionCache cache(true);
+    cache.begin();
+    TlsConnection connection(cache);
+
+    ASSERT_TRUE(connectTo(connection, server));
+    EXPECT_TRUE(connection.wasResumed());
+    connection.close();
+
+    // Cleared sessions are gone from NVS as well
+    cache.clear();
+    TlsSessionCache restarted(true);
+    restarted.begin();
+    TlsConnection again(restarted);
+    ASSERT_TRUE(connectTo(again, server));
+    EXPECT_FALSE(again.wasResumed());
+    EXPECT_EQ(restarted.getStats().offered, 0u);
+}
+
+TEST_F(TlsSessionTest, ResumedConnectionCarriesData)
+{
+    LoopbackTlsServer server(LoopbackTlsServer::SESSION_ID);
+    TlsSessionCache cache(false);
+    TlsConnection connection(cache);
+
+    ASSERT_TRUE(connectTo(connection, server));
+    connection.close();
+    ASSERT_TRUE(connectTo(connection, server));
+    ASSERT_TRUE(connection.wasResumed());
+
+    const char message[] = "hello over a resumed session";
+    ASSERT_TRUE(connection.write((const uint8_t *)message, sizeof(message), TIMEOUT_MS));
+
+    uint8_t received[sizeof(message)];
+    size_t length = 0;
+    while (length < sizeof(message))
+    {
+        ASSERT_TRUE(connection.waitReadable(TIMEOUT_MS));
+        int ret = connection.read(received + length, sizeof(received) - length, TIMEOUT_MS);
+        ASSERT_GT(ret, 0);
+        length += ret;
+    }
+    EXPECT_EQ(memcmp(received, message, sizeof(message)), 0);
+
+    connection.close();
+    EXPECT_EQ(connection.read(received, sizeof(received), 10), -1);
+}
+
+TEST_F(TlsSessionTest, BenchmarkFullAgainstResumedHandshake)
+{
+    const uint32_t connects = 20;
+    LoopbackTlsServer server(LoopbackTlsServer::SESSION_ID);
+    TlsSessionCache cache(false);
+    TlsConnection connection(cache);
+
+    bool allConnected = true;
+    BenchmarkResult full = runBenchmark("TLS connect, full handshake", connects, [&]()
+                                        {
+        cache.clear();
+        allConnected &= connectTo(connection, server);
+        connection.close(); });
+
+    ASSERT_TRUE(connectTo(connection, server));
+    connection.close();
+
+    BenchmarkResult resumed = runBenchmark("TLS connect, resumed handshake", connects, [&]()
+                                           {
+        allConnected &= connectTo(connection, server);
+        allConnected &= connection.wasResumed();
+        connection.close(); });
+
+    TlsSessionCache::Stats stats = cache.getStats();
+    printf("[ BENCH    ] resumed %lu of %lu handshakes (hit rate %.2f), %.1fx faster\n",
+           (unsigned long)stats.resumed, (unsigned long)(stats.resumed + stats.full), TlsSessionCache::hitRate(stats),
+           full.nsPerOp / resumed.nsPerOp);
+
+    EXPECT_TRUE(allConnected);
+    // Resuming skips the certificate check and the ECDHE exchange
+    EXPECT_LT(resumed.nsPerOp, full.nsPerOp);
+}
+
+int main(int argc, char **argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    if (RUN_ALL_TESTS())
+    {
+    }
+    return 0;
+}
@@ -7,7 +7,9 @@ Features:
 - Downloads Mozilla's CA certificate bundle
 - Extracts individual PEM certificates 
 - Prioritizes common CAs (Let's Encrypt, DigiCert, etc.)
-- Generates C++ headers and data files for ESP32
+- Generates C++ headers and a compact DER bundle with offset table for ESP32
+- Generates a subject-hash index so the firmware can pick the issuing
+  root of a server chain in one lookup
 - Caches downloads for 7 days to avoid unnecessary network requests
 - Use --force to download fresh certificates regardless of age
 """
@@ -20,6 +22,7 @@ import hashlib
 import shutil
 import time
 import argparse
+import base64
 from pathlib import Path
 from datetime import datetime, timedelta
 
@@ -29,6 +32,9 @@ OUTPUT_DIR = Path("src/certs")
 INDEX_FILE = OUTPUT_DIR / "ca_index.hpp"
 TIMESTAMP_FILE = OUTPUT_DIR / ".last_download"
 MAX_CERT_AGE_DAYS = 7
+# Bump when the generated files change shape so cached output is rebuilt
+INDEX_FORMAT_VERSION = 3
+INDEX_FORMAT_MARKER = f"// CA index format: {INDEX_FORMAT_VERSION}"
 
 # Most common Certificate Authorities in order of popularity
 # Based on SSL certificate market share and usage statistics
@@ -136,6 +142,10 @@ def check_certificates_age():
     if not INDEX_FILE.exists():
         print(f"Index file {INDEX_FILE} doesn't exist - need to download certificates")
         return False
+
+    if INDEX_FORMAT_MARKER not in INDEX_FILE.read_text():
+        print(f"Index file {INDEX_FILE} uses an older format - need to regenerate certificates")
+        return False
     
     try:
         # Read the timestamp of last download
@@ -264,68 +274,147 @@ def generate_safe_filename(name):
     safe_name = re.sub(r'[-\s]+', '_', safe_name)
     return safe_name.lower()
 
-def create_ca_index_header(cert_files):
+def _der_header(der, offset):
+    """Return (tag, content_start, content_length) of the DER TLV at offset."""
+    tag = der[offset]
+    length = der[offset + 1]
+    header_length = 2
+    if length & 0x80:
+        length_bytes = length & 0x7F
+        length = int.from_bytes(der[offset + 2:offset + 2 + length_bytes], 'big')
+        header_length += length_bytes
+    return tag, offset + header_length, length
+
+def der_subject(pem):
+    """Extract the raw DER subject Name (including its SEQUENCE header)."""
+    body = ''.join(line for line in pem.splitlines() if not line.startswith('-----'))
+    der = base64.b64decode(body)
+
+    _, cert_start, _ = _der_header(der, 0)          # Certificate
+    _, field_offset, _ = _der_header(der, cert_start)  # tbsCertificate
+
+    # version [0] (optional), serialNumber, signature, issuer, validity, subject
+    fields = []
+    while len(fields) < 6:
+        tag, content_start, length = _der_header(der, field_offset)
+        fields.append((tag, field_offset, content_start + length))
+        field_offset = content_start + length
+    if fields[0][0] == 0xA0:
+        fields = fields[1:]
+
+    _, subject_start, subject_end = fields[4]
+    return der[subject_start:subject_end]
+
+def subject_hash(pem):
+    """First 4 bytes (big endian) of SHA-256 over the DER subject.
+
+    The firmware computes the same value over the issuer of the certificates
+    a server presents (mbedtls issuer_raw) to find the matching root."""
+    return int.from_bytes(hashlib.sha256(der_subject(pem)).digest()[:4], 'big')
+
+def create_ca_index_header(cert_files, bundle_size):
     """Create a header file with CA certificate index."""
     header_content = [
         "#pragma once",
         "",
         "// Auto-generated CA certificate index",
+        INDEX_FORMAT_MARKER,
         "#include <Arduino.h>",
         "",
         f"#define CA_CERT_COUNT {len(cert_files)}",
+        f"#define CA_BUNDLE_SIZE {bundle_size}",
         "",
+        "// One root CA; its DER encoding lives in ca_bundle_der",
         "struct CACertInfo {",
         "    const char* name;",
-        "    const char* filename;",
-        "    const char* data;",
+        "    uint32_t derOffset;",
+        "    uint16_t derLength;",
         "};",
         "",
-        "// Individual CA certificate data"
-    ]
-    
-    # Add extern declarations for each certificate
-    for i, (name, filename) in enumerate(cert_files):
-        var_name = f"ca_cert_{i:02d}_data"
-        header_content.append(f"extern const char {var_name}[] PROGMEM;")
-    
-    header_content.extend([
+        "// Truncated SHA-256 of a certificate's DER subject -> ca_certificates index",
+        "struct CASubjectHashEntry {",
+        "    uint32_t hash;",
+        "    uint16_t certIndex;",
+        "};",
         "",
-        "// CA certificate index array",
+        "// All distinct root certificates, DER encoded, ordered by subject hash",
+        "extern const uint8_t ca_bundle_der[CA_BUNDLE_SIZE] PROGMEM;",
+        "",
+        "// CA certificate index array, most common CAs first",
         "extern const CACertInfo ca_certificates[CA_CERT_COUNT] PROGMEM;",
+        "",
+        "// Sorted by hash for binary search; equal hashes are adjacent",
+        "extern const CASubjectHashEntry ca_subject_hashes[CA_CERT_COUNT] PROGMEM;",
         ""
-    ])
+    ]
     
     return '\n'.join(header_content)
 
-def create_ca_data_file(cert_files, certificates_map):
+def pem_to_der(pem):
+    """Decode a single PEM certificate to DER bytes."""
+    body = ''.join(line for line in pem.splitlines() if not line.startswith('-----'))
+    return base64.b64decode(body)
+
+def build_der_bundle(cert_files, certificates_map):
+    """Concatenate the DER certificates ordered by subject hash.
+
+    Identical certificates are stored once. Returns the bundle bytes, the
+    (offset, length) of every entry in cert_files order and the sorted
+    subject hash index."""
+    ders = [pem_to_der(certificates_map[name]['data']) for name, filename in cert_files]
+    hash_entries = sorted(
+        (subject_hash(certificates_map[name]['data']), i)
+        for i, (name, filename) in enumerate(cert_files)
+    )
+
+    bundle = bytearray()
+    locations = [None] * len(cert_files)
+    stored = {}
+    for hash_value, i in hash_entries:
+        der = ders[i]
+        if der not in stored:
+            stored[der] = (len(bundle), len(der))
+            bundle.extend(der)
+        locations[i] = stored[der]
+
+    return bytes(bundle), locations, hash_entries
+
+def create_ca_data_file(cert_files, bundle, locations, hash_entries):
     """Create implementation file with certificate data."""
     cpp_content = [
         '#include "ca_index.hpp"',
         "",
-        "// Individual CA certificate data"
+        "// DER certificate bundle",
+        "const uint8_t ca_bundle_der[CA_BUNDLE_SIZE] PROGMEM = {"
     ]
     
-    # Add certificate data arrays
-    for i, (name, filename) in enumerate(cert_files):
-        var_name = f"ca_cert_{i:02d}_data"
-        cert_data = certificates_map[name]['data']
-        
-        cpp_content.append(f"const char {var_name}[] PROGMEM = R\"CERT(")
-        cpp_content.append(cert_data)
-        cpp_content.append(")CERT\";")
-        cpp_content.append("")
+    for offset in range(0, len(bundle), 16):
+        chunk = bundle[offset:offset + 16]
+        cpp_content.append("    " + ", ".join(f"0x{byte:02X}" for byte in chunk) + ",")
+    cpp_content.append("};")
     
     # Add index array
     cpp_content.extend([
+        "",
         "// CA certificate index array",
         "const CACertInfo ca_certificates[CA_CERT_COUNT] PROGMEM = {"
     ])
     
     for i, (name, filename) in enumerate(cert_files):
-        var_name = f"ca_cert_{i:02d}_data"
-        cpp_content.append(f'    {{"{name}", "{filename}", {var_name}}},')
+        der_offset, der_length = locations[i]
+        cpp_content.append(f'    {{"{name}", {der_offset}, {der_length}}},')
     
     cpp_content.append("};")
+
+    # Add subject hash index
+    cpp_content.extend([
+        "",
+        "// Subject hash index, sorted by hash",
+        "const CASubjectHashEntry ca_subject_hashes[CA_CERT_COUNT] PROGMEM = {"
+    ])
+    for hash_value, i in hash_entries:
+        cpp_content.append(f"    {{0x{hash_value:08X}, {i}}},")
+    cpp_content.append("};")
     
     return '\n'.join(cpp_content)
 
@@ -393,12 +482,14 @@ def main():
             f.write(cert['data'])
     
     # Generate header and implementation files
-    header_content = create_ca_index_header(cert_files)
+    bundle, locations, hash_entries = build_der_bundle(cert_files, certificates_map)
+
+    header_content = create_ca_index_header(cert_files, len(bundle))
     with open(INDEX_FILE, 'w') as f:
         f.write(header_content)
     
     cpp_file = OUTPUT_DIR / "ca_data.cpp"
-    cpp_content = create_ca_data_file(cert_files, certificates_map)
+    cpp_content = create_ca_data_file(cert_files, bundle, locations, hash_entries)
     with open(cpp_file, 'w') as f:
         f.write(cpp_content)
     
@@ -408,7 +499,7 @@ def main():
     print(f"\n✅ Generated {len(cert_files)} certificate files")
     print(f"✅ Created index: {INDEX_FILE}")
     print(f"✅ Created data: {cpp_file}")
-    print(f"📊 Total size: ~{sum(len(cert['data']) for cert in prioritized_certs) // 1024}KB")
+    print(f"📊 PEM size: ~{sum(len(cert['data']) for cert in prioritized_certs) // 1024}KB, DER bundle: ~{len(bundle) // 1024}KB")
 
 if __name__ == "__main__":
     main() 
\ No newline at end of file
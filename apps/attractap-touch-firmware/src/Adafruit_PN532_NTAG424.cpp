@@ -82,6 +82,10 @@ byte pn532response_firmwarevers[] = {
 byte pn532_packetbuffer[PN532_PACKBUFFSIZ]; ///< Packet buffer used in various
                                             ///< transactions
 
+#define PN532_I2C_SETTLE_US 500      ///< Pause after a write before polling
+#define PN532_WAITREADY_MIN_US 100   ///< First pause between ready checks
+#define PN532_WAITREADY_MAX_US 10000 ///< Longest pause between ready checks
+
 /**************************************************************************/
 /*!
     @brief  Instantiates a new PN532 class using software SPI.
@@ -115,6 +119,7 @@ Adafruit_PN532::Adafruit_PN532(uint8_t irq, uint8_t reset, TwoWire *theWire)
   pinMode(_irq, INPUT);
   pinMode(_reset, OUTPUT);
   i2c_dev = new Adafruit_I2CDevice(PN532_I2C_ADDRESS, theWire);
+  _wire = theWire;
 }
 
 /**************************************************************************/
@@ -363,15 +368,15 @@ bool Adafruit_PN532::sendCommandCheckAck(uint8_t *cmd, uint8_t cmdlen,
 
   // I2C works without using IRQ pin by polling for RDY byte
   // seems to work best with some delays between transactions
-  uint8_t SLOWDOWN = 0;
+  uint16_t SLOWDOWN = 0;
   if (i2c_dev)
-    SLOWDOWN = 1;
+    SLOWDOWN = PN532_I2C_SETTLE_US;
 
   // write the command
   writecommand(cmd, cmdlen);
 
   // I2C TUNING
-  delay(SLOWDOWN);
+  delayMicroseconds(SLOWDOWN);
 
   // Wait for chip to say its ready!
   if (!waitready(timeout))
@@ -396,7 +401,7 @@ bool Adafruit_PN532::sendCommandCheckAck(uint8_t *cmd, uint8_t cmdlen,
   }
 
   // I2C TUNING
-  delay(SLOWDOWN);
+  delayMicroseconds(SLOWDOWN);
 
   // Wait for chip to say its ready!
   if (!waitready(timeout))
@@ -1433,8 +1438,7 @@ uint8_t Adafruit_PN532::ntag424_apdu_send(
     uint8_t cmd_header_length, uint8_t *cmd_data, uint8_t cmd_data_length,
     uint8_t le, uint8_t comm_mode, uint8_t *response, uint8_t response_le)
 {
-  Serial.print("cmd_counter: ");
-  Serial.println(ntag424_Session.cmd_counter);
+  NTAG424_TRACE(NTAG424_TRACE_DATA, "cmd_counter: ", ntag424_Session.cmd_counter);
   uint8_t apdusize = 8 + (7 + cmd_header_length + cmd_data_length + 2) & 0xff;
   uint8_t apdu[apdusize];
   uint8_t offset = 0;
@@ -1570,10 +1574,10 @@ uint8_t Adafruit_PN532::ntag424_apdu_send(
     offset++;
   }
   apdusize = offset;
-  // #ifdef NTAG424DEBUG
-  PN532DEBUGPRINT.print(F("PCD->PICC:"));
-  Adafruit_PN532::PrintHexChar(apdu + 2, apdusize - 2);
-  // #endif
+  // the command data can hold key material, frame level only shows the header
+  NTAG424_TRACE_HEX(NTAG424_TRACE_FRAMES, "PCD->PICC: ", apdu + 2,
+                    ntag424_trace_level >= NTAG424_TRACE_DATA ? apdusize - 2
+                                                              : 4);
   if (!sendCommandCheckAck((uint8_t *)apdu, apdusize))
   {
 #ifdef NTAG424DEBUG
@@ -1584,12 +1588,8 @@ uint8_t Adafruit_PN532::ntag424_apdu_send(
   /* Read the response packet */
   // readdata(pn532_packetbuffer, 41);
   readdata(pn532_packetbuffer, response_le);
-  // #ifdef NTAG424DEBUG
-  PN532DEBUGPRINT.print(F("PCD<-PICC: "));
-  // Adafruit_PN532::PrintHexChar(pn532_packetbuffer + 8, 5 +
-  // pn532_packetbuffer[3] - 8);
-  Adafruit_PN532::PrintHexChar(pn532_packetbuffer, 5 + pn532_packetbuffer[3]);
-  // #endif
+  NTAG424_TRACE_HEX(NTAG424_TRACE_DATA, "PCD<-PICC: ", pn532_packetbuffer,
+                    5 + pn532_packetbuffer[3]);
   //  increase cmd_counter
   ntag424_Session.cmd_counter += 1;
 
@@ -1658,7 +1658,9 @@ uint8_t Adafruit_PN532::ntag424_apdu_send(
         return 0;
       }
     }
+#ifdef NTAG424DEBUG
     PN532DEBUGPRINT.println(F("Response CMAC ok! (picc == pcd)"));
+#endif
   }
   // decrypt the response in mode.full
   if ((response_length >= 10) && (comm_mode == NTAG424_COMM_MODE_FULL))
@@ -2119,9 +2121,9 @@ void Adafruit_PN532::ntag424_derive_session_keys(uint8_t *key, uint8_t *RndA,
 
 uint32_t Adafruit_PN532::ntag424_crc32(uint8_t *data, uint8_t datalength)
 {
-  Adafruit_PN532::PrintHexChar((uint8_t const *)data, datalength);
+  NTAG424_TRACE_HEX(NTAG424_TRACE_DATA, "crc32 input: ", data, datalength);
   uint32_t const crc32_res = crc32.calc((uint8_t const *)data, datalength);
-  Serial.println(crc32_res, HEX);
+  NTAG424_TRACE(NTAG424_TRACE_DATA, "crc32: ", crc32_res, HEX);
   return crc32_res;
 }
 
@@ -2309,8 +2311,8 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
   {
 #ifdef NTAG424DEBUG
     PN532DEBUGPRINT.println(F("Decryption error"));
-    return 0;
 #endif
+    return 0;
   }
   memset(RndBRotl, 0, sizeof(RndBRotl));
   ntag424_rotl(RndB, RndBRotl, blocklength, 1);
@@ -2357,12 +2359,9 @@ uint8_t Adafruit_PN532::ntag424_Authenticate(uint8_t *key, uint8_t keyno,
   }
   /* Read the response packet */
   readdata(pn532_packetbuffer, 42);
-  // #ifdef NTAG424DEBUG
-  PN532DEBUGPRINT.println(F("> AUTH 2 - PCD encrypted answer: "));
-  Adafruit_PN532::PrintHexChar(apdu, apdusize);
-  PN532DEBUGPRINT.print(F("Received: "));
-  Adafruit_PN532::PrintHexChar(pn532_packetbuffer, 42);
-  // #endif
+  NTAG424_TRACE_HEX(NTAG424_TRACE_DATA, "> AUTH 2 - PCD encrypted answer: ",
+                    apdu, apdusize);
+  NTAG424_TRACE_HEX(NTAG424_TRACE_DATA, "Received: ", pn532_packetbuffer, 42);
   if (pn532_packetbuffer[7] != 0x00 || pn532_packetbuffer[40] != 0x91 ||
       pn532_packetbuffer[41] != 0x00)
   {
@@ -2576,7 +2575,8 @@ uint8_t Adafruit_PN532::ntag424_ChangeKey(uint8_t *oldkey, uint8_t *newkey,
       NTAG424_COMM_MODE_FULL, result, sizeof(result)
 
   );
-  Adafruit_PN532::PrintHex(result, response_length);
+  NTAG424_TRACE_HEX(NTAG424_TRACE_DATA, "ChangeKey response: ", result,
+                    response_length);
 
   if ((result[0] != 0x91) || (result[1] != 0x00))
   {
@@ -3030,9 +3030,7 @@ bool Adafruit_PN532::ntag424_FormatNDEF()
   uint8_t datalen = sizeof(ndefdata);
   for (int i = 0; i < memsize; i += sizeof(ndefdata))
   {
-    Serial.print(i);
-    Serial.print(": ");
-    Serial.println(offset);
+    NTAG424_TRACE(NTAG424_TRACE_DATA, "UpdateBinary offset: ", offset);
     p2[0] = offset;
     if ((offset + datalen) > memsize)
     {
@@ -3049,7 +3047,7 @@ bool Adafruit_PN532::ntag424_FormatNDEF()
     }
     offset += datalen;
 
-    Serial.println(bytesread);
+    NTAG424_TRACE(NTAG424_TRACE_DATA, "UpdateBinary bytes: ", bytesread);
   }
   return ret;
 }
@@ -3079,9 +3077,7 @@ bool Adafruit_PN532::ntag424_ISOUpdateBinary(uint8_t *data_to_write,
   uint8_t datalen = PN532_PACKBUFFSIZ - 10;
   for (int i = 0; i < length; i += datalen)
   {
-    Serial.print(i);
-    Serial.print(": ");
-    Serial.println(offset);
+    NTAG424_TRACE(NTAG424_TRACE_DATA, "UpdateBinary offset: ", offset);
     p2[0] = offset;
     if ((offset + datalen) > length)
     {
@@ -3684,9 +3680,9 @@ bool Adafruit_PN532::isready()
   else if (i2c_dev)
   {
     // I2C ready check via reading RDY byte
-    uint8_t rdy[1];
-    i2c_dev->read(rdy, 1);
-    return rdy[0] == PN532_I2C_READY;
+    if (_wire->requestFrom((uint8_t)PN532_I2C_ADDRESS, (size_t)1, true) != 1)
+      return false;
+    return _wire->read() == PN532_I2C_READY;
   }
   else if (ser_dev)
   {
@@ -3703,28 +3699,34 @@ bool Adafruit_PN532::isready()
 
 /**************************************************************************/
 /*!
-    @brief  Waits until the PN532 is ready.
+    @brief  Waits until the PN532 is ready. The pause between ready checks
+            starts below a millisecond, as ACKs and most APDU responses are
+            ready within one or two, and doubles up to 10 ms for slow
+            commands such as waiting for a target.
 
-    @param  timeout   Timeout before giving up
+    @param  timeout   Timeout in ms before giving up, 0 waits forever
 */
 /**************************************************************************/
 bool Adafruit_PN532::waitready(uint16_t timeout)
 {
-  uint16_t timer = 0;
+  uint32_t started = millis();
+  uint32_t pause_us = PN532_WAITREADY_MIN_US;
   while (!isready())
   {
-    if (timeout != 0)
+    if (timeout != 0 && millis() - started > timeout)
     {
-      timer += 10;
-      if (timer > timeout)
-      {
 #ifdef PN532DEBUG
-        PN532DEBUGPRINT.println("TIMEOUT!");
+      PN532DEBUGPRINT.println("TIMEOUT!");
 #endif
-        return false;
-      }
+      return false;
     }
-    delay(10);
+    if (pause_us < 1000)
+      delayMicroseconds(pause_us);
+    else
+      delay(pause_us / 1000);
+    pause_us *= 2;
+    if (pause_us > PN532_WAITREADY_MAX_US)
+      pause_us = PN532_WAITREADY_MAX_US;
   }
   return true;
 }
@@ -3747,12 +3749,21 @@ void Adafruit_PN532::readdata(uint8_t *buff, uint8_t n)
   }
   else if (i2c_dev)
   {
-    // I2C read
-    uint8_t rbuff[n + 1]; // +1 for leading RDY byte
-    i2c_dev->read(rbuff, n + 1);
-    for (uint8_t i = 0; i < n; i++)
+    // I2C read: one transaction of RDY byte + n frame bytes, the frame goes
+    // from the Wire receive buffer straight into buff. Reading in parts is
+    // not an option: the PN532 only repeats a frame after a NACK, so
+    // probing LEN first would cost another write and read.
+    size_t length = (size_t)n + 1;
+    if (_wire->requestFrom((uint8_t)PN532_I2C_ADDRESS, length, true) != length)
+    {
+      while (_wire->available())
+        _wire->read();
+      memset(buff, 0, n);
+    }
+    else
     {
-      buff[i] = rbuff[i + 1];
+      _wire->read(); // RDY
+      _wire->readBytes(buff, n);
     }
   }
   else if (ser_dev)
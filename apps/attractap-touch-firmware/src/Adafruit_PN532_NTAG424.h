@@ -17,6 +17,7 @@
 
 #include <Adafruit_I2CDevice.h>
 #include <Adafruit_SPIDevice.h>
+#include "Adafruit_PN532_Trace.h"
 #include "mbedtls/aes.h"
 #include "mbedtlscmac.h"
 #include <Arduino_CRC32.h>
@@ -381,6 +382,7 @@ private:
 
   Adafruit_SPIDevice *spi_dev = NULL;
   Adafruit_I2CDevice *i2c_dev = NULL;
+  TwoWire *_wire = NULL; // frames are read through TwoWire directly
   HardwareSerial *ser_dev = NULL;
 };
 
@@ -1781,8 +1781,8 @@ export interface AttractapFirmware {
    */
   filename: string;
   /**
-   * The filename of the firmware for OTA updates (zlib compressed)
-   * @example "attractap_eth.bin.zz"
+   * The filename of the firmware for OTA updates (application image only)
+   * @example "attractap_eth.ota.bin"
    */
   filenameOTA: string;
 }
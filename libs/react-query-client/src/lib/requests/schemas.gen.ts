@@ -2728,8 +2728,8 @@ export const $AttractapFirmware = {
         },
         filenameOTA: {
             type: 'string',
-            description: 'The filename of the firmware for OTA updates (zlib compressed)',
-            example: 'attractap_eth.bin.zz'
+            description: 'The filename of the firmware for OTA updates (application image only)',
+            example: 'attractap_eth.ota.bin'
         }
     },
     required: ['name', 'friendlyName', 'variant', 'variantFriendlyName', 'version', 'boardFamily', 'filename', 'filenameOTA']
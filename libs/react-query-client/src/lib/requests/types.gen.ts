@@ -1798,7 +1798,7 @@ export type AttractapFirmware = {
      */
     filename: string;
     /**
-     * The filename of the firmware for OTA updates (zlib compressed)
+     * The filename of the firmware for OTA updates (application image only)
      */
     filenameOTA: string;
 };